@@ -0,0 +1,583 @@
+/*
+ * Window (GLFW) or headless (EGL + FBO) setup and frame loop control
+ * shared by the demo programs.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include "app.h"
+#include "asset_pack.h"
+#include "embedded_assets.h"
+#include "mapped_file.h"
+#include "timing.h"
+
+bool app_flag(int argc, char** argv, const char* name)
+{
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], name) == 0)
+        return true;
+    }
+  return false;
+}
+
+const char* app_option(int argc, char** argv, const char* name)
+{
+  int i;
+  for(i = 1; i < argc - 1; i++)
+    {
+      if (strcmp(argv[i], name) == 0)
+        return argv[i + 1];
+    }
+  return NULL;
+}
+
+bool app_option_value(char** argv, int i, const char* const* extra)
+{
+  // every option parse_options reads a value for
+  static const char* const common[] = { "--frames", "--seconds", "--size", "--backend",
+                                        "--program-cache", "--pack", "--profile", "--watch",
+                                        "--assets", "--fps", NULL };
+  if (i < 1)
+    return false;
+  int k;
+  for(k = 0; common[k] != NULL; k++)
+    {
+      if (strcmp(argv[i - 1], common[k]) == 0)
+        return true;
+    }
+  for(k = 0; extra != NULL && extra[k] != NULL; k++)
+    {
+      if (strcmp(argv[i - 1], extra[k]) == 0)
+        return true;
+    }
+  return false;
+}
+
+static void parse_options(struct app_options* options, int argc, char** argv)
+{
+  options->headless = app_flag(argc, argv, "--headless");
+  options->backend = APP_BACKEND_GL21;
+  options->frames = 0;
+  options->seconds = 0;
+  options->width = 640;
+  options->height = 480;
+  options->programCacheDir = "program-cache";
+
+  const char* value = app_option(argc, argv, "--frames");
+  if (value != NULL)
+    options->frames = atoi(value);
+  value = app_option(argc, argv, "--seconds");
+  if (value != NULL)
+    options->seconds = atof(value);
+  value = app_option(argc, argv, "--size");
+  if (value != NULL)
+    {
+      int w;
+      int h;
+      if (sscanf(value, "%dx%d", &w, &h) == 2 && w > 0 && h > 0)
+        {
+          options->width = w;
+          options->height = h;
+        }
+      else
+        {
+          fprintf(stderr, "WARNING: ignoring malformed --size '%s'\n", value);
+        }
+    }
+
+  value = app_option(argc, argv, "--backend");
+  if (value != NULL && strcmp(value, "gl33") == 0)
+    options->backend = APP_BACKEND_GL33;
+  else if (value != NULL && strcmp(value, "gl21") != 0)
+    fprintf(stderr, "WARNING: unknown --backend '%s', using gl21\n", value);
+
+  value = app_option(argc, argv, "--program-cache");
+  if (value != NULL)
+    options->programCacheDir = value;
+  if (app_flag(argc, argv, "--no-program-cache"))
+    options->programCacheDir = NULL;
+
+  value = app_option(argc, argv, "--pack");
+  if (value != NULL)
+    options->assetPack = value;
+  else if (access("assets.pak", R_OK) == 0)
+    options->assetPack = "assets.pak";
+  else
+    options->assetPack = NULL;
+  if (app_flag(argc, argv, "--no-pack"))
+    options->assetPack = NULL;
+  options->embeddedAssets = !app_flag(argc, argv, "--no-embedded");
+
+  options->profileOutput = app_option(argc, argv, "--profile");
+  options->watchDirectory = app_option(argc, argv, "--watch");
+  options->assetDirectory = app_option(argc, argv, "--assets");
+  if (options->assetDirectory == NULL)
+    options->assetDirectory = options->watchDirectory;
+
+  // a window nobody benchmarks only needs redrawing when something changes
+  options->onDemand = app_flag(argc, argv, "--on-demand")
+    || (!options->headless && options->frames <= 0 && options->seconds <= 0
+        && !app_flag(argc, argv, "--continuous"));
+  value = app_option(argc, argv, "--fps");
+  options->fps = value != NULL ? atof(value) : 0;
+
+  // A headless run has nobody to press ESC
+  if (options->headless && options->frames <= 0 && options->seconds <= 0)
+    options->frames = 1000;
+}
+
+/*
+ * GLFW callbacks: they are global in this GLFW version, so the app comes
+ * from the window's user pointer (the hidden loader windows have none)
+ */
+static struct app* window_app(GLFWwindow window)
+{
+  return glfwGetWindowUserPointer(window);
+}
+
+static void mark_dirty(GLFWwindow window)
+{
+  struct app* app = window_app(window);
+  if (app != NULL)
+    __atomic_store_n(&app->redrawRequested, 1, __ATOMIC_RELEASE);
+}
+
+static void on_size(GLFWwindow window, int w, int h)
+{
+  struct app* app = window_app(window);
+  if (app == NULL)
+    return;
+  app->width = w;
+  app->height = h;
+  mark_dirty(window);
+}
+
+static void on_iconify(GLFWwindow window, int iconified)
+{
+  struct app* app = window_app(window);
+  if (app == NULL)
+    return;
+  app->iconified = iconified != 0;
+  mark_dirty(window);
+}
+
+static void on_key(GLFWwindow window, int key, int action)
+{
+  mark_dirty(window);
+}
+
+static void on_mouse_position(GLFWwindow window, int x, int y)
+{
+  mark_dirty(window);
+}
+
+static void on_mouse_button(GLFWwindow window, int button, int action)
+{
+  mark_dirty(window);
+}
+
+static bool init_window(struct app* app, const char* title, int depthBits)
+{
+  if (!glfwInit())
+    {
+      fprintf( stderr, "Failed to init glfw!\n");
+      return false;
+    }
+
+  glfwWindowHint(GLFW_FSAA_SAMPLES, 4);
+  if (depthBits > 0)
+    glfwWindowHint(GLFW_DEPTH_BITS, depthBits);
+  // so sad that nouveau driver cannot provide OpenGL 3.3..
+  // which is why it has to be asked for with --backend gl33
+  if (app->options.backend == APP_BACKEND_GL33)
+    {
+      glfwWindowHint(GLFW_OPENGL_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_OPENGL_VERSION_MINOR, 3);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    }
+  else
+    {
+      glfwWindowHint(GLFW_OPENGL_VERSION_MAJOR, 2);
+      glfwWindowHint(GLFW_OPENGL_VERSION_MINOR, 1);
+    }
+
+  app->window = glfwCreateWindow(app->options.width, app->options.height,
+                                 GLFW_WINDOWED, title, NULL);
+  if (app->window == NULL)
+    {
+      glfwTerminate();
+      fprintf( stderr, "Failed to open a window!\n");
+      fprintf( stderr, glfwErrorString(glfwGetError()));
+      fprintf( stderr, "\n");
+      return false;
+    }
+
+  /* obtain the OpenGL context of the newly-created window*/
+  glfwMakeContextCurrent(app->window);
+  glfwSetInputMode(app->window, GLFW_STICKY_KEYS, GL_TRUE);
+
+  // the size is tracked here rather than asked for every frame
+  glfwGetWindowSize(app->window, &app->width, &app->height);
+  glfwSetWindowUserPointer(app->window, app);
+  glfwSetWindowSizeCallback(on_size);
+  glfwSetWindowRefreshCallback(mark_dirty);
+  glfwSetWindowIconifyCallback(on_iconify);
+  glfwSetKeyCallback(on_key);
+  glfwSetMousePosCallback(on_mouse_position);
+  glfwSetMouseButtonCallback(on_mouse_button);
+  return true;
+}
+
+bool app_init(struct app* app, int argc, char** argv, const char* title, int depthBits)
+{
+  memset(app, 0, sizeof(*app));
+  app->wakePipe[0] = -1;
+  app->wakePipe[1] = -1;
+  parse_options(&app->options, argc, argv);
+  app->frameRate = app->options.fps;
+  if (app->options.onDemand && pipe(app->wakePipe) == 0)
+    {
+      fcntl(app->wakePipe[0], F_SETFL, O_NONBLOCK);
+      fcntl(app->wakePipe[1], F_SETFL, O_NONBLOCK);
+    }
+  frame_stats_init(&app->stats);
+  if (app->options.assetPack != NULL && !asset_pack_mount(app->options.assetPack))
+    return false;
+  embedded_assets_set_enabled(app->options.embeddedAssets);
+  mapped_file_set_directory(app->options.assetDirectory);
+
+  if (app->options.headless)
+    {
+      // no FSAA offscreen: the FBO is a plain single-sampled one
+      bool core = app->options.backend == APP_BACKEND_GL33;
+      if (!headless_context_create(&app->headless, core ? 3 : 2, core ? 3 : 1, core))
+        return false;
+    }
+  else if (!init_window(app, title, depthBits))
+    {
+      return false;
+    }
+
+  glewExperimental = true;
+  GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  // GLEW loads all GL entry points before looking for GLX, which an EGL
+  // context does not have.
+  if (app->options.headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+    glewStatus = GLEW_OK;
+#endif
+  if (glewStatus != GLEW_OK)
+    {
+      fprintf( stderr, "GLEW init failed!");
+      return false;
+    }
+
+  if (GLEW_VERSION_2_1)
+    {
+      printf("GL 2.1: supported\n");
+    }
+
+  // ???
+  if (GLEW_VERSION_3_3)
+    {
+      printf("GL 3.3: supported\n");
+    }
+
+  // a core context reports GL_INVALID_ENUM for GLEW's extension string query
+  glGetError();
+  if (app->options.backend == APP_BACKEND_GL33)
+    {
+      glGenVertexArrays(1, &app->defaultVertexArray);
+      glBindVertexArray(app->defaultVertexArray);
+    }
+
+  if (app->options.headless)
+    {
+      printf("headless: %s on %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+      if (!headless_framebuffer_create(&app->headless, app->options.width,
+                                       app->options.height, depthBits))
+        return false;
+    }
+
+  frame_profiler_init(&app->profiler, app->options.profileOutput);
+  app->frameScope = frame_profiler_scope(&app->profiler, "frame", false);
+  app->swapScope = frame_profiler_scope(&app->profiler, "swap", true);
+
+  app->startTime = timing_now();
+  return true;
+}
+
+void app_get_size(struct app* app, int* w, int* h)
+{
+  if (app->options.headless)
+    {
+      *w = app->options.width;
+      *h = app->options.height;
+    }
+  else
+    {
+      *w = app->width;
+      *h = app->height;
+    }
+}
+
+void app_set_frame_rate(struct app* app, double fps)
+{
+  if (app->options.fps <= 0)
+    app->frameRate = fps;
+}
+
+void app_request_redraw(struct app* app)
+{
+  __atomic_store_n(&app->redrawRequested, 1, __ATOMIC_RELEASE);
+  // a full pipe already has a wakeup in it
+  if (app->wakePipe[1] >= 0 && write(app->wakePipe[1], "r", 1) < 0)
+    return;
+}
+
+/* user + system time of all threads so far */
+static double cpu_seconds(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+    + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/* has the user asked the window to go away? */
+static bool window_closing(struct app* app)
+{
+  return glfwGetKey(app->window, GLFW_KEY_ESC) || glfwGetWindowParam(app->window, GLFW_CLOSE_REQUESTED);
+}
+
+/*
+ * Sleep until a redraw is due (see app.h). Returns false when the loop
+ * should end instead: the window is closing, --seconds is up, or a
+ * headless run has nothing left that could change the picture.
+ */
+static bool wait_for_redraw(struct app* app)
+{
+  double start = timing_now();
+  // windows notice other threads' requests only between slices
+  bool sliced = !app->options.headless && app->options.watchDirectory != NULL;
+  bool keepGoing = true;
+  while(true)
+    {
+      if (__atomic_exchange_n(&app->redrawRequested, 0, __ATOMIC_ACQ_REL))
+        break;
+      double now = timing_now();
+      bool animating = app->frameRate > 0 && !app->iconified;
+      if (animating && now >= app->nextFrame)
+        break;
+
+      // in seconds, < 0: no limit
+      double timeout = animating ? app->nextFrame - now : -1.0;
+      if (app->options.seconds > 0)
+        {
+          double left = app->startTime + app->options.seconds - now;
+          if (left <= 0)
+            {
+              keepGoing = false;
+              break;
+            }
+          if (timeout < 0 || left < timeout)
+            timeout = left;
+        }
+      if (sliced && (timeout < 0 || timeout > 0.05))
+        timeout = 0.05;
+
+      if (!app->options.headless && timeout < 0)
+        glfwWaitEvents();
+      else if (app->options.headless && timeout < 0 && app->options.watchDirectory == NULL)
+        {
+          keepGoing = false;
+          break;
+        }
+      else
+        {
+          struct pollfd fd = { app->wakePipe[0], POLLIN, 0 };
+          if (poll(&fd, 1, timeout < 0 ? -1 : (int)(timeout * 1000.0 + 0.999)) > 0)
+            {
+              char buffer[64];
+              while(read(app->wakePipe[0], buffer, sizeof(buffer)) > 0)
+                ;
+            }
+          if (!app->options.headless)
+            glfwPollEvents();
+        }
+      app->wakeups++;
+      if (!app->options.headless && window_closing(app))
+        {
+          keepGoing = false;
+          break;
+        }
+    }
+
+  if (app->frameRate > 0)
+    {
+      // keep the cadence, unless the frame was late by a whole period
+      double period = 1.0 / app->frameRate;
+      double now = timing_now();
+      app->nextFrame += period;
+      if (app->nextFrame < now)
+        app->nextFrame = now + period;
+    }
+  app->waitTime += timing_now() - start;
+  return keepGoing;
+}
+
+void app_begin_frame(struct app* app)
+{
+  if (!app->options.headless)
+    glfwMakeContextCurrent(app->window);
+  app->frameStart = timing_now();
+  frame_profiler_begin_frame(&app->profiler);
+  frame_profiler_begin(&app->profiler, app->frameScope);
+}
+
+bool app_end_frame(struct app* app)
+{
+  frame_profiler_begin(&app->profiler, app->swapScope);
+  if (app->options.headless)
+    {
+      // Nothing is presented, so wait for the GPU to really finish the
+      // frame; otherwise we would only measure command submission.
+      glFinish();
+    }
+  else
+    {
+      glfwSwapBuffers(app->window);
+    }
+  frame_profiler_end(&app->profiler, app->swapScope);
+  frame_profiler_end(&app->profiler, app->frameScope);
+  frame_profiler_end_frame(&app->profiler);
+
+  double now = timing_now();
+  frame_stats_add(&app->stats, app->frameStart, now);
+  if (app->stats.count == 1 && app->firstFrameLabel != NULL)
+    printf("%s to first frame: %.3f ms\n", app->firstFrameLabel,
+           (now - app->firstFrameSince) * 1000.0);
+  if (app->stats.count == 1)
+    {
+      app->firstFrameEnd = now;
+      app->firstFrameCpu = cpu_seconds();
+    }
+
+  if (app->options.frames > 0 && app->stats.count >= app->options.frames)
+    return false;
+  if (app->options.seconds > 0 && now - app->startTime >= app->options.seconds)
+    return false;
+
+  if (!app->options.headless)
+    {
+      // Input event check
+      glfwPollEvents();
+      if (window_closing(app))
+        return false;
+    }
+  if (app->options.onDemand)
+    return wait_for_redraw(app);
+  return true;
+}
+
+void app_time_to_first_frame(struct app* app, const char* label, double since)
+{
+  app->firstFrameLabel = label;
+  app->firstFrameSince = since;
+}
+
+bool app_shared_context_create(struct app* app, struct app_shared_context* shared)
+{
+  memset(shared, 0, sizeof(*shared));
+  shared->headless = app->options.headless;
+  if (shared->headless)
+    {
+      shared->display = app->headless.display;
+      shared->context = headless_context_share(&app->headless);
+      return shared->context != EGL_NO_CONTEXT;
+    }
+
+  // the version hints of init_window are still in effect
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  shared->window = glfwCreateWindow(1, 1, GLFW_WINDOWED, "loader", app->window);
+  glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+  glfwMakeContextCurrent(app->window);
+  if (shared->window == NULL)
+    {
+      fprintf(stderr, "Failed to create a shared context: %s\n", glfwErrorString(glfwGetError()));
+      return false;
+    }
+  return true;
+}
+
+bool app_shared_context_make_current(struct app_shared_context* shared)
+{
+  if (shared->headless)
+    return headless_context_bind(shared->display, shared->context);
+  glfwMakeContextCurrent(shared->window);
+  return true;
+}
+
+void app_shared_context_release(struct app_shared_context* shared)
+{
+  if (shared->headless)
+    headless_context_bind(shared->display, EGL_NO_CONTEXT);
+  else
+    glfwMakeContextCurrent(NULL);
+}
+
+void app_shared_context_destroy(struct app_shared_context* shared)
+{
+  if (shared->headless && shared->context != EGL_NO_CONTEXT)
+    eglDestroyContext(shared->display, shared->context);
+  else if (!shared->headless && shared->window != NULL)
+    glfwDestroyWindow(shared->window);
+  memset(shared, 0, sizeof(*shared));
+}
+
+void app_terminate(struct app* app)
+{
+  if (app->stats.count > 0
+      && (app->options.headless || app->options.frames > 0 || app->options.seconds > 0))
+    frame_stats_report(&app->stats, "benchmark", stdout);
+  if (app->options.onDemand && app->stats.count > 0)
+    {
+      // loading is over by the end of the first frame
+      double cpu = cpu_seconds() - app->firstFrameCpu;
+      double elapsed = timing_now() - app->firstFrameEnd;
+      printf("on demand, after the first frame: %d frames (%.1f/s), %ld wakeups (%.1f/s), "
+             "%.1f%% of the time waiting, CPU %.1f%% (%.3f s in %.3f s)\n",
+             app->stats.count - 1, (app->stats.count - 1) / elapsed, app->wakeups,
+             app->wakeups / elapsed, 100.0 * app->waitTime / elapsed,
+             100.0 * cpu / elapsed, cpu, elapsed);
+    }
+  if (app->wakePipe[0] >= 0)
+    {
+      close(app->wakePipe[0]);
+      close(app->wakePipe[1]);
+    }
+  frame_stats_free(&app->stats);
+  frame_profiler_free(&app->profiler);
+  asset_pack_unmount();
+  if (app->defaultVertexArray != 0)
+    glDeleteVertexArrays(1, &app->defaultVertexArray);
+
+  if (app->options.headless)
+    headless_context_destroy(&app->headless);
+  else
+    glfwTerminate();
+}
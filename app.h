@@ -0,0 +1,206 @@
+/*
+ * Window (GLFW) or headless (EGL + FBO) setup and frame loop control
+ * shared by the demo programs.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef APP_H
+#define APP_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "headless.h"
+#include "frame_stats.h"
+#include "frame_profiler.h"
+
+/*
+ * Options understood by every program:
+ *
+ *   --headless      render into an offscreen framebuffer, no window
+ *   --frames N      stop after N frames
+ *   --seconds T     stop after T seconds
+ *   --size WxH      window / framebuffer size (default 640x480)
+ *   --backend gl21|gl33   OpenGL 2.1 (default) or a 3.3 core profile
+ *                         context; see app_backend
+ *   --program-cache DIR   where linked program binaries are kept
+ *                         (default ./program-cache)
+ *   --no-program-cache    always compile shaders from source
+ *   --pack FILE     serve shaders and textures from this asset pack
+ *                   (default ./assets.pak, when it exists)
+ *   --no-pack       only load loose files
+ *   --no-embedded   do not use the shaders and images compiled into the
+ *                   program (see embedded_assets.h)
+ *   --assets DIR    read data files from DIR first, ahead of the embedded
+ *                   copies and the pack
+ *   --watch DIR     the same as --assets DIR (the source tree), and let
+ *                   programs that support it reload files on change
+ *                   (see hot_reload.h)
+ *   --profile FILE  time the frame phases (see app.profiler) and write
+ *                   the histograms to FILE, as JSON if it ends in .json
+ *                   and CSV otherwise; also on SIGUSR1
+ *   --on-demand     only draw when something changed (see
+ *                   app_request_redraw); the default for a window
+ *                   without --frames or --seconds
+ *   --continuous    draw frames back to back; the default otherwise
+ *   --fps N         frame rate of animated content (app_set_frame_rate)
+ *
+ * A headless run without --frames or --seconds renders 1000 frames.
+ * Whenever one of the limits is given, frame statistics are printed at exit.
+ */
+/*
+ * With gl33 the context has no fixed function pipeline and no default
+ * vertex array object. app_init binds one VAO for the whole program, so
+ * code that sets up attribute arrays every frame keeps working; programs
+ * with a real gl33 path bind their own. Shaders written for GLSL 1.20 are
+ * translated by program_cache.
+ */
+enum app_backend
+{
+  APP_BACKEND_GL21,
+  APP_BACKEND_GL33
+};
+
+struct app_options
+{
+  bool headless;
+  enum app_backend backend;
+  int frames;
+  double seconds;
+  int width;
+  int height;
+  const char* programCacheDir;  /* NULL when disabled */
+  const char* assetPack;        /* NULL when disabled */
+  bool embeddedAssets;
+  const char* assetDirectory;   /* NULL when disabled */
+  const char* profileOutput;    /* NULL when disabled */
+  const char* watchDirectory;   /* NULL when disabled */
+  bool onDemand;
+  double fps;                   /* 0: what the program asks for */
+};
+
+struct app
+{
+  struct app_options options;
+  GLFWwindow window;
+  struct headless_context headless;
+  GLuint defaultVertexArray;  /* gl33 only */
+  struct frame_stats stats;
+  /*
+   * "frame" (begin to end of frame, CPU only) and "swap" (present) are
+   * timed by app; programs add their own phases with frame_profiler_scope.
+   */
+  struct frame_profiler profiler;
+  int frameScope;
+  int swapScope;
+  double startTime;
+  double frameStart;
+  const char* firstFrameLabel;
+  double firstFrameSince;
+
+  /* redraw scheduling (--on-demand) */
+  int width;                  /* window size, kept by the size callback */
+  int height;
+  bool iconified;
+  double frameRate;           /* of animated content, 0: static */
+  double nextFrame;           /* when the next animation frame is due */
+  int redrawRequested;        /* atomic */
+  int wakePipe[2];            /* app_request_redraw from other threads */
+  long wakeups;               /* times the waiting loop woke up */
+  double waitTime;            /* seconds spent waiting */
+  double firstFrameEnd;       /* the report covers the time after it */
+  double firstFrameCpu;
+};
+
+/* returns true if 'name' is present in argv */
+bool app_flag(int argc, char** argv, const char* name);
+
+/* returns the argument following 'name' in argv, or NULL */
+const char* app_option(int argc, char** argv, const char* name);
+
+/*
+ * is argv[i] the value of an option rather than a file: of one of the
+ * common options app_init reads, or of one in 'extra' (NULL terminated,
+ * may be NULL) that only the program knows?
+ */
+bool app_option_value(char** argv, int i, const char* const* extra);
+
+/*
+ * Parse the common options, create the window (or headless context),
+ * make it current and initialize GLEW.
+ */
+bool app_init(struct app* app, int argc, char** argv, const char* title, int depthBits);
+
+/* current drawable size */
+void app_get_size(struct app* app, int* w, int* h);
+
+/* call before issuing the GL commands of one frame */
+void app_begin_frame(struct app* app);
+
+/*
+ * Present the frame (swap or glFinish when headless), record its time and
+ * process events. Returns false when the program should leave its loop.
+ */
+bool app_end_frame(struct app* app);
+
+/*
+ * With --on-demand, app_end_frame does not return until there is a reason
+ * to draw another frame: the window was resized, exposed, (de)iconified or
+ * got keyboard or mouse input, app_request_redraw was called, or the next
+ * frame of animated content is due. Meanwhile the thread sleeps in
+ * glfwWaitEvents, or in poll() on the redraw requests of other threads.
+ *
+ * This GLFW cannot interrupt glfwWaitEvents from another thread, so when
+ * one may request redraws (--watch) a window waits in 50 ms slices
+ * instead. A headless run has no events: it waits for requests and
+ * animation frames until --seconds is up, and stops when nothing can
+ * ever wake it.
+ */
+
+/*
+ * Content that changes over time: draw 'fps' frames per second (--fps
+ * takes precedence), 0 for a static picture (the default). Without
+ * --on-demand frames are drawn back to back regardless.
+ */
+void app_set_frame_rate(struct app* app, double fps);
+
+/* draw (at least) one more frame; may be called from any thread */
+void app_request_redraw(struct app* app);
+
+/*
+ * Print "<label> to first frame: N ms" once the first frame is done,
+ * measured from 'since' (a timing_now() value).
+ */
+void app_time_to_first_frame(struct app* app, const char* label, double since);
+
+/*
+ * A context sharing textures, buffers and sync objects with the app's,
+ * for a loader thread: a hidden window, or a second EGL context when
+ * headless. Create and destroy it on the render thread; make it current
+ * on the loader thread, and release it there before the thread ends.
+ */
+struct app_shared_context
+{
+  bool headless;
+  GLFWwindow window;
+  EGLDisplay display;
+  EGLContext context;
+};
+
+bool app_shared_context_create(struct app* app, struct app_shared_context* shared);
+bool app_shared_context_make_current(struct app_shared_context* shared);
+void app_shared_context_release(struct app_shared_context* shared);
+void app_shared_context_destroy(struct app_shared_context* shared);
+
+/*
+ * print statistics (if a benchmark was requested, and the wakeups and CPU
+ * use with --on-demand) and tear everything down
+ */
+void app_terminate(struct app* app);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Build-time tool: turn data files into a C source with one byte array
+ * per file and a table over them (see embedded_assets.h).
+ *
+ *   asset_embed output.c file...
+ *
+ * Entries are named after the file name without its directory, like in
+ * asset packs, and sorted so that the table can be binary searched. Each
+ * array has a NUL after the data, and a typedef that fails to compile if
+ * the array does not hold exactly the number of bytes that were read.
+ *
+ * Only uses stdio: the library with the generated file in it is built
+ * after this program.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+struct input
+{
+  const char* path;
+  const char* name;
+};
+
+static int compare_input(const void* a, const void* b)
+{
+  return strcmp(((const struct input*)a)->name, ((const struct input*)b)->name);
+}
+
+/* the file as array 'index'; returns its size, or -1 */
+static long write_array(FILE* out, const struct input* input, int index)
+{
+  FILE* fp = fopen(input->path, "rb");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot open '%s'\n", input->path);
+      return -1;
+    }
+  fprintf(out, "/* %s */\nstatic const unsigned char asset%d[] =\n  {", input->name, index);
+  unsigned char buffer[4096];
+  long size = 0;
+  size_t count;
+  while((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+      size_t i;
+      for(i = 0; i < count; i++, size++)
+        fprintf(out, "%s0x%02x,", size % 16 == 0 ? "\n    " : " ", buffer[i]);
+    }
+  bool failed = ferror(fp) != 0;
+  fclose(fp);
+  if (failed)
+    {
+      fprintf(stderr, "ERROR: cannot read '%s'\n", input->path);
+      return -1;
+    }
+  fprintf(out, "\n    0x00\n  };\n");
+  fprintf(out, "typedef char asset%d_size_check[sizeof(asset%d) == %ld + 1 ? 1 : -1];\n\n",
+          index, index, size);
+  return size;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+    {
+      fprintf(stderr, "usage: %s output.c file...\n", argv[0]);
+      return -1;
+    }
+
+  const char* output = argv[1];
+  int count = argc - 2;
+  struct input* inputs = calloc(count, sizeof(struct input));
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      inputs[i].path = argv[2 + i];
+      const char* slash = strrchr(inputs[i].path, '/');
+      inputs[i].name = slash != NULL ? slash + 1 : inputs[i].path;
+    }
+  qsort(inputs, count, sizeof(struct input), compare_input);
+  for(i = 1; i < count; i++)
+    {
+      if (strcmp(inputs[i - 1].name, inputs[i].name) == 0)
+        {
+          fprintf(stderr, "ERROR: '%s' and '%s' have the same name\n",
+                  inputs[i - 1].path, inputs[i].path);
+          free(inputs);
+          return -1;
+        }
+    }
+
+  FILE* out = fopen(output, "w");
+  if (out == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot write '%s'\n", output);
+      free(inputs);
+      return -1;
+    }
+  fprintf(out, "/* generated by asset_embed, do not edit */\n\n"
+          "#include <stddef.h>\n#include \"embedded_assets.h\"\n\n");
+  long total = 0;
+  bool ok = true;
+  for(i = 0; ok && i < count; i++)
+    {
+      long size = write_array(out, &inputs[i], i);
+      ok = size >= 0;
+      total += size;
+    }
+  if (ok)
+    {
+      fprintf(out, "const struct embedded_asset embeddedAssets[] =\n  {\n");
+      for(i = 0; i < count; i++)
+        fprintf(out, "    { \"%s\", asset%d, sizeof(asset%d) - 1 },\n", inputs[i].name, i, i);
+      fprintf(out, "  };\n\nconst size_t embeddedAssetCount = %d;\n", count);
+    }
+  ok = fclose(out) == 0 && ok;
+  if (!ok)
+    {
+      remove(output);
+      free(inputs);
+      return -1;
+    }
+  printf("%s: %d files, %ld bytes\n", output, count, total);
+  free(inputs);
+  return 0;
+}
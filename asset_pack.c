@@ -0,0 +1,180 @@
+/*
+ * Single-file asset packs: every shader and texture in one indexed,
+ * memory-mapped archive.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "asset_pack.h"
+
+static struct asset_pack mountedPack;
+static bool mounted = false;
+
+uint64_t asset_pack_hash(const char* name)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  while(*name != '\0')
+    {
+      hash ^= (unsigned char)*name++;
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+/* is [offset, offset + size) inside a file of 'fileSize' bytes? */
+static bool in_bounds(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+  return offset <= fileSize && size <= fileSize - offset;
+}
+
+static bool validate(const struct asset_pack* pack)
+{
+  const struct asset_pack_header* header = pack->header;
+  uint64_t fileSize = pack->file.size;
+  if (fileSize < sizeof(*header) || memcmp(header->magic, ASSET_PACK_MAGIC, 8) != 0)
+    return false;
+  if (header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0
+      || header->slotCount <= header->entryCount)
+    return false;
+  if (!in_bounds(header->entriesOffset, (uint64_t)header->entryCount * sizeof(struct asset_pack_entry), fileSize)
+      || !in_bounds(header->slotsOffset, (uint64_t)header->slotCount * sizeof(uint32_t), fileSize)
+      || header->namesOffset > fileSize
+      || header->entriesOffset % 8 != 0 || header->slotsOffset % 4 != 0)
+    return false;
+
+  uint64_t namesSize = fileSize - header->namesOffset;
+  uint32_t i;
+  for(i = 0; i < header->entryCount; i++)
+    {
+      const struct asset_pack_entry* entry = &pack->entries[i];
+      if (entry->nameOffset >= namesSize
+          || memchr(pack->names + entry->nameOffset, '\0', namesSize - entry->nameOffset) == NULL
+          || !in_bounds(entry->offset, entry->storedSize, fileSize)
+          || entry->compression > ASSET_ZLIB)
+        return false;
+    }
+  for(i = 0; i < header->slotCount; i++)
+    {
+      if (pack->slots[i] > header->entryCount)
+        return false;
+    }
+  return true;
+}
+
+bool asset_pack_open(struct asset_pack* pack, const char* path)
+{
+  memset(pack, 0, sizeof(*pack));
+  if (!mapped_file_open(&pack->file, path, MAPPED_RANDOM))
+    return false;
+
+  const unsigned char* base = pack->file.data;
+  pack->header = (const struct asset_pack_header*)base;
+  if (pack->file.size >= sizeof(struct asset_pack_header))
+    {
+      pack->entries = (const struct asset_pack_entry*)(base + pack->header->entriesOffset);
+      pack->slots = (const uint32_t*)(base + pack->header->slotsOffset);
+      pack->names = (const char*)(base + pack->header->namesOffset);
+    }
+  if (!validate(pack))
+    {
+      fprintf(stderr, "ERROR: '%s' is not a valid asset pack\n", path);
+      asset_pack_close(pack);
+      return false;
+    }
+  return true;
+}
+
+void asset_pack_close(struct asset_pack* pack)
+{
+  mapped_file_close(&pack->file);
+  memset(pack, 0, sizeof(*pack));
+}
+
+const char* asset_pack_entry_name(const struct asset_pack* pack, const struct asset_pack_entry* entry)
+{
+  return pack->names + entry->nameOffset;
+}
+
+const struct asset_pack_entry* asset_pack_find(const struct asset_pack* pack, const char* name)
+{
+  while(name[0] == '.' && name[1] == '/')
+    name += 2;
+  uint64_t hash = asset_pack_hash(name);
+  uint32_t mask = pack->header->slotCount - 1;
+  uint32_t slot = (uint32_t)hash & mask;
+  // the table is never full, so an empty slot always ends the probe
+  while(pack->slots[slot] != 0)
+    {
+      const struct asset_pack_entry* entry = &pack->entries[pack->slots[slot] - 1];
+      if (entry->nameHash == hash && strcmp(asset_pack_entry_name(pack, entry), name) == 0)
+        return entry;
+      slot = (slot + 1) & mask;
+    }
+  return NULL;
+}
+
+bool asset_pack_read(const struct asset_pack* pack, const struct asset_pack_entry* entry,
+                     struct mapped_file* file)
+{
+  const unsigned char* stored = pack->file.data + entry->offset;
+  if (entry->compression == ASSET_STORED)
+    {
+      file->data = stored;
+      file->size = entry->storedSize;
+      file->storage = MAPPED_STORAGE_PACK;
+      return true;
+    }
+
+  // one extra byte so an empty entry still gets a buffer
+  unsigned char* buffer = malloc(entry->size + 1);
+  uLongf size = entry->size;
+  if (buffer == NULL
+      || uncompress(buffer, &size, stored, entry->storedSize) != Z_OK
+      || size != entry->size)
+    {
+      fprintf(stderr, "ERROR: cannot inflate '%s' from the asset pack\n",
+              asset_pack_entry_name(pack, entry));
+      free(buffer);
+      return false;
+    }
+  file->data = buffer;
+  file->size = size;
+  file->storage = MAPPED_STORAGE_HEAP;
+  return true;
+}
+
+bool asset_pack_mount(const char* path)
+{
+  asset_pack_unmount();
+  struct asset_pack pack;
+  // open it before mounting, so the pack is not looked up in itself
+  if (!asset_pack_open(&pack, path))
+    return false;
+  mountedPack = pack;
+  mounted = true;
+  return true;
+}
+
+void asset_pack_unmount(void)
+{
+  if (!mounted)
+    return;
+  mounted = false;
+  asset_pack_close(&mountedPack);
+}
+
+bool asset_pack_open_mounted(const char* path, struct mapped_file* file)
+{
+  if (!mounted)
+    return false;
+  const struct asset_pack_entry* entry = asset_pack_find(&mountedPack, path);
+  return entry != NULL && asset_pack_read(&mountedPack, entry, file);
+}
@@ -0,0 +1,99 @@
+/*
+ * Single-file asset packs: every shader and texture in one indexed,
+ * memory-mapped archive.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "mapped_file.h"
+
+/*
+ * Layout (all integers little endian):
+ *
+ *   header    struct asset_pack_header
+ *   entries   entryCount x struct asset_pack_entry, sorted by name
+ *   slots     slotCount x uint32_t: open addressing hash table (linear
+ *             probing) over the name hashes, entry index + 1, 0 = empty
+ *   names     NUL-terminated entry names
+ *   data      every entry starts at a multiple of ASSET_PACK_ALIGNMENT
+ */
+#define ASSET_PACK_MAGIC "GLHPAK1"
+#define ASSET_PACK_ALIGNMENT 64
+
+enum asset_compression
+{
+  ASSET_STORED = 0,
+  ASSET_ZLIB = 1
+};
+
+struct asset_pack_header
+{
+  char magic[8];
+  uint32_t entryCount;
+  uint32_t slotCount;         /* power of two */
+  uint64_t entriesOffset;
+  uint64_t slotsOffset;
+  uint64_t namesOffset;
+};
+
+struct asset_pack_entry
+{
+  uint64_t nameHash;
+  uint32_t nameOffset;        /* relative to namesOffset */
+  uint32_t compression;       /* enum asset_compression */
+  uint64_t offset;
+  uint64_t storedSize;        /* bytes in the pack */
+  uint64_t size;              /* bytes after decompression */
+};
+
+struct asset_pack
+{
+  struct mapped_file file;
+  const struct asset_pack_header* header;
+  const struct asset_pack_entry* entries;
+  const uint32_t* slots;
+  const char* names;
+};
+
+/* FNV-1a of the entry name, as stored in nameHash */
+uint64_t asset_pack_hash(const char* name);
+
+/* map and validate a pack */
+bool asset_pack_open(struct asset_pack* pack, const char* path);
+void asset_pack_close(struct asset_pack* pack);
+
+/* NULL when there is no such entry; a leading "./" is ignored */
+const struct asset_pack_entry* asset_pack_find(const struct asset_pack* pack, const char* name);
+
+const char* asset_pack_entry_name(const struct asset_pack* pack, const struct asset_pack_entry* entry);
+
+/*
+ * Contents of an entry as a mapped_file: stored entries point into the
+ * pack's mapping, compressed ones are inflated into a buffer that
+ * mapped_file_close frees.
+ */
+bool asset_pack_read(const struct asset_pack* pack, const struct asset_pack_entry* entry,
+                     struct mapped_file* file);
+
+/*
+ * The mounted pack is searched by mapped_file_open before the file system,
+ * so everything loaded through it (shaders, PNG and KTX textures, atlases)
+ * comes out of the pack when it has the file. One pack at a time.
+ */
+bool asset_pack_mount(const char* path);
+void asset_pack_unmount(void);
+
+/* mapped_file_open's hook: true if the mounted pack had 'path' */
+bool asset_pack_open_mounted(const char* path, struct mapped_file* file);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Offline tool: bundle shaders and textures into one asset pack.
+ *
+ *   asset_packer [--compress] output.pak file...
+ *
+ * Entries are named after the file name without its directory, which is
+ * what the programs ask for. With --compress, entries are stored deflated
+ * when that saves at least 10%; PNG and KTX data rarely shrinks enough,
+ * shader sources do. See asset_pack.h for the layout.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <zlib.h>
+#include "asset_pack.h"
+#include "mapped_file.h"
+
+struct input
+{
+  const char* path;
+  const char* name;
+  unsigned char* data;          /* what goes into the pack */
+  size_t storedSize;
+  size_t size;
+  enum asset_compression compression;
+};
+
+static int compare_input(const void* a, const void* b)
+{
+  return strcmp(((const struct input*)a)->name, ((const struct input*)b)->name);
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool read_input(struct input* input, bool compress)
+{
+  struct mapped_file file;
+  if (!mapped_file_open(&file, input->path, MAPPED_SEQUENTIAL))
+    return false;
+  input->size = file.size;
+  input->storedSize = file.size;
+  input->compression = ASSET_STORED;
+  input->data = malloc(file.size + 1);
+  memcpy(input->data, file.data, file.size);
+
+  if (compress && file.size > 0)
+    {
+      uLongf packedSize = compressBound(file.size);
+      unsigned char* packed = malloc(packedSize);
+      if (compress2(packed, &packedSize, file.data, file.size, Z_BEST_COMPRESSION) == Z_OK
+          && packedSize <= file.size - file.size / 10)
+        {
+          free(input->data);
+          input->data = packed;
+          input->storedSize = packedSize;
+          input->compression = ASSET_ZLIB;
+        }
+      else
+        {
+          free(packed);
+        }
+    }
+  mapped_file_close(&file);
+  return true;
+}
+
+static bool write_padding(FILE* fp, uint64_t* position, uint64_t target)
+{
+  static const char zeros[ASSET_PACK_ALIGNMENT];
+  while(*position < target)
+    {
+      size_t count = target - *position < sizeof(zeros) ? target - *position : sizeof(zeros);
+      if (fwrite(zeros, 1, count, fp) != count)
+        return false;
+      *position += count;
+    }
+  return true;
+}
+
+static bool write_pack(const char* path, struct input* inputs, uint32_t count)
+{
+  struct asset_pack_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ASSET_PACK_MAGIC, 8);
+  header.entryCount = count;
+  // at most half full keeps the probes short
+  header.slotCount = 1;
+  while(header.slotCount < count * 2 + 1)
+    header.slotCount *= 2;
+
+  struct asset_pack_entry* entries = calloc(count + 1, sizeof(struct asset_pack_entry));
+  uint32_t* slots = calloc(header.slotCount, sizeof(uint32_t));
+  uint64_t namesSize = 0;
+  uint32_t i;
+  for(i = 0; i < count; i++)
+    namesSize += strlen(inputs[i].name) + 1;
+
+  header.entriesOffset = align_up(sizeof(header), 8);
+  header.slotsOffset = header.entriesOffset + (uint64_t)count * sizeof(struct asset_pack_entry);
+  header.namesOffset = header.slotsOffset + (uint64_t)header.slotCount * sizeof(uint32_t);
+  uint64_t offset = header.namesOffset + namesSize;
+  uint32_t nameOffset = 0;
+  for(i = 0; i < count; i++)
+    {
+      offset = align_up(offset, ASSET_PACK_ALIGNMENT);
+      entries[i].nameHash = asset_pack_hash(inputs[i].name);
+      entries[i].nameOffset = nameOffset;
+      entries[i].compression = inputs[i].compression;
+      entries[i].offset = offset;
+      entries[i].storedSize = inputs[i].storedSize;
+      entries[i].size = inputs[i].size;
+      nameOffset += strlen(inputs[i].name) + 1;
+      offset += inputs[i].storedSize;
+
+      uint32_t slot = (uint32_t)entries[i].nameHash & (header.slotCount - 1);
+      while(slots[slot] != 0)
+        slot = (slot + 1) & (header.slotCount - 1);
+      slots[slot] = i + 1;
+    }
+
+  FILE* fp = fopen(path, "wb");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot write '%s'\n", path);
+      free(entries);
+      free(slots);
+      return false;
+    }
+  uint64_t position = 0;
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  position += sizeof(header);
+  ok = ok && write_padding(fp, &position, header.entriesOffset);
+  ok = ok && fwrite(entries, sizeof(struct asset_pack_entry), count, fp) == count;
+  ok = ok && fwrite(slots, sizeof(uint32_t), header.slotCount, fp) == header.slotCount;
+  position = header.namesOffset;
+  for(i = 0; ok && i < count; i++)
+    {
+      size_t length = strlen(inputs[i].name) + 1;
+      ok = fwrite(inputs[i].name, 1, length, fp) == length;
+      position += length;
+    }
+  for(i = 0; ok && i < count; i++)
+    {
+      ok = write_padding(fp, &position, entries[i].offset)
+        && fwrite(inputs[i].data, 1, inputs[i].storedSize, fp) == inputs[i].storedSize;
+      position += inputs[i].storedSize;
+    }
+  ok = fclose(fp) == 0 && ok;
+  if (!ok)
+    fprintf(stderr, "ERROR: cannot write '%s'\n", path);
+  free(entries);
+  free(slots);
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  bool compress = false;
+  int first = 1;
+  if (first < argc && strcmp(argv[first], "--compress") == 0)
+    {
+      compress = true;
+      first++;
+    }
+  if (argc - first < 2)
+    {
+      fprintf(stderr, "usage: %s [--compress] output.pak file...\n", argv[0]);
+      return -1;
+    }
+
+  const char* output = argv[first];
+  uint32_t count = argc - first - 1;
+  struct input* inputs = calloc(count, sizeof(struct input));
+  uint32_t i;
+  for(i = 0; i < count; i++)
+    {
+      inputs[i].path = argv[first + 1 + i];
+      const char* slash = strrchr(inputs[i].path, '/');
+      inputs[i].name = slash != NULL ? slash + 1 : inputs[i].path;
+    }
+  // sorted, so the same inputs always give the same pack
+  qsort(inputs, count, sizeof(struct input), compare_input);
+
+  int status = 0;
+  for(i = 0; i < count && status == 0; i++)
+    {
+      if (i > 0 && strcmp(inputs[i - 1].name, inputs[i].name) == 0)
+        {
+          fprintf(stderr, "ERROR: '%s' and '%s' have the same name\n",
+                  inputs[i - 1].path, inputs[i].path);
+          status = -1;
+        }
+      else if (!read_input(&inputs[i], compress))
+        {
+          status = -1;
+        }
+    }
+  if (status == 0 && !write_pack(output, inputs, count))
+    status = -1;
+
+  if (status == 0)
+    {
+      size_t stored = 0;
+      size_t size = 0;
+      for(i = 0; i < count; i++)
+        {
+          stored += inputs[i].storedSize;
+          size += inputs[i].size;
+        }
+      printf("%s: %u entries, %zu bytes of data stored as %zu\n", output, count, size, stored);
+    }
+  for(i = 0; i < count; i++)
+    free(inputs[i].data);
+  free(inputs);
+  return status;
+}
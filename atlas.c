@@ -0,0 +1,317 @@
+/*
+ * Texture atlases: skyline packing (offline) and loading (runtime).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "atlas.h"
+#include "image_loader.h"
+#include "mapped_file.h"
+
+void skyline_init(struct skyline_packer* packer, int width, int height)
+{
+  packer->width = width;
+  packer->height = height;
+  // there can never be more nodes than pixel columns
+  packer->nodes = malloc(sizeof(struct skyline_node) * (width + 1));
+  packer->nodes[0].x = 0;
+  packer->nodes[0].y = 0;
+  packer->nodes[0].width = width;
+  packer->nodeCount = 1;
+}
+
+void skyline_free(struct skyline_packer* packer)
+{
+  free(packer->nodes);
+  packer->nodes = NULL;
+  packer->nodeCount = 0;
+}
+
+/* y at which a w x h rectangle starting at node 'index' would rest, or -1 */
+static int skyline_fit(const struct skyline_packer* packer, int index, int w, int h)
+{
+  int x = packer->nodes[index].x;
+  if (x + w > packer->width)
+    return -1;
+
+  int y = 0;
+  int remaining = w;
+  int i = index;
+  while(remaining > 0)
+    {
+      if (packer->nodes[i].y > y)
+        y = packer->nodes[i].y;
+      if (y + h > packer->height)
+        return -1;
+      remaining -= packer->nodes[i].width;
+      i++;
+    }
+  return y;
+}
+
+bool skyline_insert(struct skyline_packer* packer, int w, int h, int* x, int* y)
+{
+  int bestIndex = -1;
+  int bestBottom = INT_MAX;
+  int bestWidth = INT_MAX;
+  int i;
+  for(i = 0; i < packer->nodeCount; i++)
+    {
+      int fitY = skyline_fit(packer, i, w, h);
+      if (fitY < 0)
+        continue;
+      if (fitY + h < bestBottom
+          || (fitY + h == bestBottom && packer->nodes[i].width < bestWidth))
+        {
+          bestIndex = i;
+          bestBottom = fitY + h;
+          bestWidth = packer->nodes[i].width;
+        }
+    }
+  if (bestIndex < 0)
+    return false;
+
+  *x = packer->nodes[bestIndex].x;
+  *y = bestBottom - h;
+
+  // new node on top of the placed rectangle
+  memmove(&packer->nodes[bestIndex + 1], &packer->nodes[bestIndex],
+          sizeof(struct skyline_node) * (packer->nodeCount - bestIndex));
+  packer->nodeCount++;
+  packer->nodes[bestIndex].x = *x;
+  packer->nodes[bestIndex].y = bestBottom;
+  packer->nodes[bestIndex].width = w;
+
+  // shrink or drop the nodes now hidden below it
+  for(i = bestIndex + 1; i < packer->nodeCount; i++)
+    {
+      struct skyline_node* previous = &packer->nodes[i - 1];
+      struct skyline_node* node = &packer->nodes[i];
+      int previousEnd = previous->x + previous->width;
+      if (node->x >= previousEnd)
+        break;
+
+      int shrink = previousEnd - node->x;
+      node->x += shrink;
+      node->width -= shrink;
+      if (node->width > 0)
+        break;
+      memmove(node, node + 1, sizeof(struct skyline_node) * (packer->nodeCount - i - 1));
+      packer->nodeCount--;
+      i--;
+    }
+
+  // merge neighbours at the same height
+  for(i = 0; i < packer->nodeCount - 1; i++)
+    {
+      if (packer->nodes[i].y == packer->nodes[i + 1].y)
+        {
+          packer->nodes[i].width += packer->nodes[i + 1].width;
+          memmove(&packer->nodes[i + 1], &packer->nodes[i + 2],
+                  sizeof(struct skyline_node) * (packer->nodeCount - i - 2));
+          packer->nodeCount--;
+          i--;
+        }
+    }
+  return true;
+}
+
+static int compare_region(const void* a, const void* b)
+{
+  return strcmp(((const struct atlas_region*)a)->name, ((const struct atlas_region*)b)->name);
+}
+
+/* fgets over a mapped file: copies the next line, '\n' included */
+static bool next_line(const struct mapped_file* file, size_t* position, char* line, size_t size)
+{
+  if (*position >= file->size)
+    return false;
+  size_t length = 0;
+  while(*position < file->size && length + 1 < size)
+    {
+      char c = file->data[(*position)++];
+      line[length++] = c;
+      if (c == '\n')
+        break;
+    }
+  line[length] = '\0';
+  return true;
+}
+
+bool atlas_load(struct atlas* atlas, const char* path)
+{
+  memset(atlas, 0, sizeof(*atlas));
+  // through mapped_file, so atlases can come from the asset pack too
+  struct mapped_file file;
+  if (!mapped_file_open(&file, path, MAPPED_SEQUENTIAL))
+    return false;
+
+  // page files are relative to the directory of the .atlas file
+  char directory[4096];
+  snprintf(directory, sizeof(directory), "%s", path);
+  char* slash = strrchr(directory, '/');
+  if (slash != NULL)
+    slash[1] = '\0';
+  else
+    directory[0] = '\0';
+
+  int* pageWidths = NULL;
+  int* pageHeights = NULL;
+  int regionCapacity = 0;
+  bool success = true;
+  char line[1024];
+  int lineNumber = 0;
+  size_t position = 0;
+  while(next_line(&file, &position, line, sizeof(line)))
+    {
+      lineNumber++;
+      char pageFile[512];
+      int page;
+      int w;
+      int h;
+      struct atlas_region region;
+      memset(&region, 0, sizeof(region));
+
+      if (strncmp(line, "atlas ", 6) == 0 || line[0] == '#' || line[0] == '\n')
+        continue;
+
+      if (sscanf(line, "page %d %511s %d %d", &page, pageFile, &w, &h) == 4)
+        {
+          if (page != atlas->pageCount)
+            {
+              fprintf(stderr, "ERROR: %s:%d: pages must be listed in order\n", path, lineNumber);
+              success = false;
+              break;
+            }
+          // pageCount only counts loaded pages: atlas_free deletes that many
+          GLuint* textures = realloc(atlas->pageTextures, sizeof(GLuint) * (page + 1));
+          if (textures != NULL)
+            atlas->pageTextures = textures;
+          int* widths = realloc(pageWidths, sizeof(int) * (page + 1));
+          if (widths != NULL)
+            pageWidths = widths;
+          int* heights = realloc(pageHeights, sizeof(int) * (page + 1));
+          if (heights != NULL)
+            pageHeights = heights;
+          if (textures == NULL || widths == NULL || heights == NULL)
+            {
+              fprintf(stderr, "ERROR: %s:%d: out of memory\n", path, lineNumber);
+              success = false;
+              break;
+            }
+
+          char pagePath[4096 + 512];
+          snprintf(pagePath, sizeof(pagePath), "%s%s", directory, pageFile);
+          GLuint texture;
+          int channels = 4;
+          glGenTextures(1, &texture);
+          glBindTexture(GL_TEXTURE_2D, texture);
+          if (!load_texture_image(pagePath, &channels, true, &pageWidths[page], &pageHeights[page]))
+            {
+              glDeleteTextures(1, &texture);
+              success = false;
+              break;
+            }
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+          glGenerateMipmap(GL_TEXTURE_2D);
+          atlas->pageTextures[page] = texture;
+          atlas->pageCount++;
+        }
+      else if (sscanf(line, "region %63s %d %d %d %d %d", region.name, &region.page,
+                      &region.x, &region.y, &region.width, &region.height) == 6)
+        {
+          if (region.page < 0 || region.page >= atlas->pageCount)
+            {
+              fprintf(stderr, "ERROR: %s:%d: region on unknown page\n", path, lineNumber);
+              success = false;
+              break;
+            }
+          float pw = pageWidths[region.page];
+          float ph = pageHeights[region.page];
+          region.u0 = region.x / pw;
+          region.u1 = (region.x + region.width) / pw;
+          // rows were flipped on upload, so v counts from the bottom
+          region.v0 = (ph - region.y - region.height) / ph;
+          region.v1 = (ph - region.y) / ph;
+
+          if (atlas->regionCount == regionCapacity)
+            {
+              int capacity = regionCapacity == 0 ? 64 : regionCapacity * 2;
+              struct atlas_region* regions = realloc(atlas->regions, sizeof(struct atlas_region) * capacity);
+              if (regions == NULL)
+                {
+                  fprintf(stderr, "ERROR: %s:%d: out of memory\n", path, lineNumber);
+                  success = false;
+                  break;
+                }
+              atlas->regions = regions;
+              regionCapacity = capacity;
+            }
+          atlas->regions[atlas->regionCount++] = region;
+        }
+      else
+        {
+          fprintf(stderr, "WARNING: %s:%d: ignoring unknown line\n", path, lineNumber);
+        }
+    }
+  mapped_file_close(&file);
+  free(pageWidths);
+  free(pageHeights);
+
+  if (success)
+    {
+      qsort(atlas->regions, atlas->regionCount, sizeof(struct atlas_region), compare_region);
+      // atlas_find could return either of two regions of the same name
+      int i;
+      for(i = 1; i < atlas->regionCount && success; i++)
+        {
+          if (compare_region(&atlas->regions[i - 1], &atlas->regions[i]) == 0)
+            {
+              fprintf(stderr, "ERROR: %s: region '%s' is listed twice\n", path, atlas->regions[i].name);
+              success = false;
+            }
+        }
+    }
+  if (!success)
+    {
+      atlas_free(atlas);
+      return false;
+    }
+  return true;
+}
+
+void atlas_free(struct atlas* atlas)
+{
+  if (atlas->pageCount > 0)
+    glDeleteTextures(atlas->pageCount, atlas->pageTextures);
+  free(atlas->pageTextures);
+  free(atlas->regions);
+  memset(atlas, 0, sizeof(*atlas));
+}
+
+const struct atlas_region* atlas_find(const struct atlas* atlas, const char* name)
+{
+  struct atlas_region key;
+  snprintf(key.name, sizeof(key.name), "%s", name);
+  return bsearch(&key, atlas->regions, atlas->regionCount,
+                 sizeof(struct atlas_region), compare_region);
+}
+
+void atlas_remap_uv(const struct atlas_region* region, const GLfloat* uv, GLfloat* out, int count)
+{
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      out[i * 2] = region->u0 + uv[i * 2] * (region->u1 - region->u0);
+      out[i * 2 + 1] = region->v0 + uv[i * 2 + 1] * (region->v1 - region->v0);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Texture atlases: skyline packing (offline) and loading (runtime).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+
+/*
+ * Skyline bottom-left packer for one page. The skyline is the upper
+ * outline of everything placed so far; a new rectangle goes where it ends
+ * up lowest (ties: narrowest leftover).
+ * Coordinates are in pixels with y growing downwards, as in the PNG file.
+ */
+struct skyline_node
+{
+  int x;
+  int y;
+  int width;
+};
+
+struct skyline_packer
+{
+  int width;
+  int height;
+  struct skyline_node* nodes;
+  int nodeCount;
+};
+
+void skyline_init(struct skyline_packer* packer, int width, int height);
+void skyline_free(struct skyline_packer* packer);
+
+/* find room for w x h, returns false when the page is full */
+bool skyline_insert(struct skyline_packer* packer, int w, int h, int* x, int* y);
+
+/*
+ * Atlas metadata file (text):
+ *
+ *   atlas 1
+ *   page <index> <png file, relative to the .atlas file> <width> <height>
+ *   region <name> <page> <x> <y> <width> <height>
+ *
+ * x/y are the top-left corner of the image (excluding padding) in the page.
+ */
+struct atlas_region
+{
+  char name[64];
+  int page;
+  int x;
+  int y;
+  int width;
+  int height;
+  /* texture coordinates of the region in the GL convention (v = 0 at bottom) */
+  GLfloat u0;
+  GLfloat v0;
+  GLfloat u1;
+  GLfloat v1;
+};
+
+struct atlas
+{
+  GLuint* pageTextures;
+  int pageCount;
+  struct atlas_region* regions;  /* sorted by name */
+  int regionCount;
+};
+
+/* parse the metadata and upload every page (mipmapped, RGBA); region names must be unique */
+bool atlas_load(struct atlas* atlas, const char* path);
+void atlas_free(struct atlas* atlas);
+
+/* NULL when there is no region of that name */
+const struct atlas_region* atlas_find(const struct atlas* atlas, const char* name);
+
+/*
+ * Map 'count' (u, v) pairs given for a whole [0, 1] texture into the
+ * region's sub-rectangle, e.g. the static UV array of gl_texture.c.
+ */
+void atlas_remap_uv(const struct atlas_region* region, const GLfloat* uv, GLfloat* out, int count);
+
+#endif
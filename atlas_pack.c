@@ -0,0 +1,198 @@
+/*
+ * Offline atlas builder: packs PNG images into a few large pages.
+ *
+ *   atlas_pack [--size N] [--padding P] <output prefix> a.png b.png ...
+ *
+ * writes <prefix>_0.png, <prefix>_1.png, ... and <prefix>.atlas (see atlas.h).
+ * Every image is surrounded by P pixels copied from its own border, so that
+ * bilinear filtering and the smaller mipmap levels do not pull in colors of
+ * the neighbours.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "atlas.h"
+#include "image_loader.h"
+
+struct input_image
+{
+  const char* path;
+  char name[64];
+  unsigned char* pixels;  /* RGBA, bottom-up */
+  int width;
+  int height;
+  int page;
+  int x;                  /* top-left corner inside the page, padding excluded */
+  int y;
+};
+
+struct page
+{
+  struct skyline_packer packer;
+  unsigned char* pixels;  /* RGBA, bottom-up */
+};
+
+static void region_name(const char* path, char* name, size_t size)
+{
+  const char* base = strrchr(path, '/');
+  base = base == NULL ? path : base + 1;
+  snprintf(name, size, "%s", base);
+  char* dot = strrchr(name, '.');
+  if (dot != NULL)
+    *dot = '\0';
+}
+
+static int clamp(int v, int lo, int hi)
+{
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/* copy the image plus 'padding' extruded border pixels into the page */
+static void blit_padded(struct page* page, int pageSize, const struct input_image* image, int padding)
+{
+  int row;
+  int column;
+  for(row = -padding; row < image->height + padding; row++)
+    {
+      // both buffers are bottom-up; 'row' counts from the top of the image
+      int srcRow = image->height - 1 - clamp(row, 0, image->height - 1);
+      int dstRow = pageSize - 1 - (image->y + row);
+      for(column = -padding; column < image->width + padding; column++)
+        {
+          int srcColumn = clamp(column, 0, image->width - 1);
+          memcpy(&page->pixels[((size_t)dstRow * pageSize + image->x + column) * 4],
+                 &image->pixels[((size_t)srcRow * image->width + srcColumn) * 4], 4);
+        }
+    }
+}
+
+static int compare_height(const void* a, const void* b)
+{
+  const struct input_image* x = *(const struct input_image* const*)a;
+  const struct input_image* y = *(const struct input_image* const*)b;
+  if (x->height != y->height)
+    return y->height - x->height;
+  return y->width - x->width;
+}
+
+int main(int argc, char** argv)
+{
+  int pageSize = 2048;
+  int padding = 4;
+  int first = 1;
+  while(first < argc - 1 && strncmp(argv[first], "--", 2) == 0)
+    {
+      if (strcmp(argv[first], "--size") == 0)
+        pageSize = atoi(argv[first + 1]);
+      else if (strcmp(argv[first], "--padding") == 0)
+        padding = atoi(argv[first + 1]);
+      else
+        break;
+      first += 2;
+    }
+  if (argc - first < 2 || pageSize <= 0 || padding < 0)
+    {
+      fprintf(stderr, "usage: %s [--size N] [--padding P] <output prefix> image.png...\n", argv[0]);
+      return -1;
+    }
+
+  const char* prefix = argv[first];
+  int imageCount = argc - first - 1;
+  struct input_image* images = calloc(imageCount, sizeof(struct input_image));
+  struct input_image** order = malloc(sizeof(struct input_image*) * imageCount);
+  int i;
+  for(i = 0; i < imageCount; i++)
+    {
+      images[i].path = argv[first + 1 + i];
+      region_name(images[i].path, images[i].name, sizeof(images[i].name));
+      images[i].pixels = load_image_new(images[i].path, &images[i].width, &images[i].height);
+      if (images[i].pixels == NULL)
+        return -1;
+      if (images[i].width + 2 * padding > pageSize || images[i].height + 2 * padding > pageSize)
+        {
+          fprintf(stderr, "ERROR: '%s' (%dx%d) does not fit a %d page\n",
+                  images[i].path, images[i].width, images[i].height, pageSize);
+          return -1;
+        }
+      order[i] = &images[i];
+    }
+
+  // tallest first gives the skyline the flattest outline
+  qsort(order, imageCount, sizeof(struct input_image*), compare_height);
+
+  struct page* pages = NULL;
+  int pageCount = 0;
+  for(i = 0; i < imageCount; i++)
+    {
+      struct input_image* image = order[i];
+      int w = image->width + 2 * padding;
+      int h = image->height + 2 * padding;
+      int p;
+      int x = 0;
+      int y = 0;
+      for(p = 0; p < pageCount; p++)
+        {
+          if (skyline_insert(&pages[p].packer, w, h, &x, &y))
+            break;
+        }
+      if (p == pageCount)
+        {
+          pages = realloc(pages, sizeof(struct page) * (pageCount + 1));
+          skyline_init(&pages[p].packer, pageSize, pageSize);
+          pages[p].pixels = calloc((size_t)pageSize * pageSize, 4);
+          pageCount++;
+          skyline_insert(&pages[p].packer, w, h, &x, &y);
+        }
+      image->page = p;
+      image->x = x + padding;
+      image->y = y + padding;
+      blit_padded(&pages[p], pageSize, image, padding);
+    }
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s.atlas", prefix);
+  FILE* fp = fopen(path, "w");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot write '%s'\n", path);
+      return -1;
+    }
+  const char* prefixBase = strrchr(prefix, '/');
+  prefixBase = prefixBase == NULL ? prefix : prefixBase + 1;
+
+  fprintf(fp, "atlas 1\n");
+  long usedPixels = 0;
+  for(i = 0; i < pageCount; i++)
+    {
+      snprintf(path, sizeof(path), "%s_%d.png", prefix, i);
+      if (!save_image_png(path, pages[i].pixels, pageSize, pageSize, 4))
+        return -1;
+      fprintf(fp, "page %d %s_%d.png %d %d\n", i, prefixBase, i, pageSize, pageSize);
+      skyline_free(&pages[i].packer);
+      free(pages[i].pixels);
+    }
+  for(i = 0; i < imageCount; i++)
+    {
+      fprintf(fp, "region %s %d %d %d %d %d\n", images[i].name, images[i].page,
+              images[i].x, images[i].y, images[i].width, images[i].height);
+      usedPixels += (long)images[i].width * images[i].height;
+      free(images[i].pixels);
+    }
+  fclose(fp);
+
+  printf("%d images packed into %d page(s) of %dx%d, %.1f%% used\n",
+         imageCount, pageCount, pageSize, pageSize,
+         100.0 * usedPixels / ((double)pageCount * pageSize * pageSize));
+  free(pages);
+  free(order);
+  free(images);
+  return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * CPU cost of drawing gl_texture.c's square the three ways this project
+ * knows: fixed function client arrays (as gl_01.c), the GL 2.1 shader
+ * path and the GL 3.3 VAO path (see textured_quad.c).
+ *
+ *   backend_bench [--headless] [--backend gl21|gl33] [--draws N] [--runs N]
+ *
+ * Every frame draws the square --draws times (default 1000) and waits
+ * for the GPU afterwards; only the submission is timed. The fixed
+ * function path needs a compatibility context, the VAO path GL 3.0 or
+ * ARB_vertex_array_object. Run once with each --backend to see the
+ * shader paths in a 2.1 and in a 3.3 core context.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "frame_stats.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "textured_quad.h"
+#include "texture_file.h"
+#include "timing.h"
+
+static const GLfloat vertices[] =
+  {
+    -1.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,
+    1.0f, -1.0f, 0.0f
+  };
+
+static const GLfloat UV[] =
+  {
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+    0.0f, 0.0f,
+    1.0f, 0.0f
+  };
+
+static const GLuint indices[] =
+  {
+    0, 1, 2, 1, 3, 2
+  };
+
+/* gl_01.c's way: client state, no shader */
+struct fixed_quad
+{
+  GLuint vertexBuffer;
+  GLuint uvBuffer;
+  GLuint indexBuffer;
+};
+
+static void fixed_quad_init(struct fixed_quad* quad)
+{
+  glGenBuffers(1, &quad->vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glGenBuffers(1, &quad->uvBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->uvBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(UV), UV, GL_STATIC_DRAW);
+  glGenBuffers(1, &quad->indexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad->indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+static void fixed_quad_draw(const struct fixed_quad* quad)
+{
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->vertexBuffer);
+  glVertexPointer(3, GL_FLOAT, 0, NULL);
+
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->uvBuffer);
+  glTexCoordPointer(2, GL_FLOAT, 0, NULL);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad->indexBuffer);
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+static void fixed_quad_free(struct fixed_quad* quad)
+{
+  glDeleteBuffers(1, &quad->vertexBuffer);
+  glDeleteBuffers(1, &quad->uvBuffer);
+  glDeleteBuffers(1, &quad->indexBuffer);
+}
+
+enum bench_path
+{
+  PATH_FIXED,
+  PATH_GL21,
+  PATH_GL33
+};
+
+static const char* const pathNames[] = { "fixed", "gl21", "gl33 vao" };
+
+static void run(enum bench_path path, GLuint program, int draws, int runs)
+{
+  struct fixed_quad fixed;
+  struct textured_quad quad;
+  if (path == PATH_FIXED)
+    {
+      glUseProgram(0);
+      glEnable(GL_TEXTURE_2D);
+      fixed_quad_init(&fixed);
+    }
+  else
+    {
+      glUseProgram(program);
+      if (!textured_quad_init(&quad, path == PATH_GL33 ? APP_BACKEND_GL33 : APP_BACKEND_GL21, program))
+        return;
+    }
+
+  struct frame_stats stats;
+  frame_stats_init(&stats);
+  int frame;
+  int i;
+  for(frame = -2; frame < runs; frame++)
+    {
+      glClear(GL_COLOR_BUFFER_BIT);
+      double start = timing_now();
+      for(i = 0; i < draws; i++)
+        {
+          if (path == PATH_FIXED)
+            fixed_quad_draw(&fixed);
+          else
+            textured_quad_draw(&quad);
+        }
+      double end = timing_now();
+      glFinish();
+      // two warm-up frames
+      if (frame >= 0)
+        frame_stats_add(&stats, start, end);
+    }
+
+  double median = frame_stats_percentile(&stats, 50);
+  if (median < 0)
+    fprintf(stderr, "WARNING: no memory to sort the frame times\n");
+  printf("%-9s %9.3f ms per frame (p50), %7.3f us per draw, p99 %9.3f ms\n", pathNames[path],
+         median * 1000.0, median * 1e6 / draws, frame_stats_percentile(&stats, 99) * 1000.0);
+  frame_stats_free(&stats);
+
+  if (path == PATH_FIXED)
+    {
+      fixed_quad_free(&fixed);
+      glDisable(GL_TEXTURE_2D);
+    }
+  else
+    {
+      textured_quad_free(&quad);
+    }
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Backend benchmark", 0))
+    return -1;
+
+  const char* drawsOption = app_option(argc, argv, "--draws");
+  const char* runsOption = app_option(argc, argv, "--runs");
+  int draws = drawsOption != NULL ? atoi(drawsOption) : 1000;
+  int runs = runsOption != NULL ? atoi(runsOption) : 100;
+  if (draws < 1)
+    draws = 1;
+  if (runs < 1)
+    runs = 1;
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "texture.vertex", "texture.frag", NULL);
+  struct shader_variant* program = shader_variants_get(&variants, 0);
+  if (program == NULL)
+    return -1;
+  glUseProgram(program->source.program);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+  glUniform3f(program->uniforms[SHADER_UNIFORM_BACK_COLOR], 195 / 255.0f, 180 / 255.0f, 218 / 255.0f);
+
+  struct texture_load_options loadOptions;
+  texture_load_options_init(&loadOptions, 0);
+  struct texture_info textureInfo;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  if (!load_texture_file("texture.png", &loadOptions, &textureInfo))
+    return -1;
+
+  printf("%s, %d draws per frame, %d frames\n", glGetString(GL_VERSION), draws, runs);
+  if (app.options.backend == APP_BACKEND_GL21)
+    run(PATH_FIXED, program->source.program, draws, runs);
+  else
+    printf("%-9s not available in a core context\n", pathNames[PATH_FIXED]);
+  // in a core context this goes through app's default VAO
+  run(PATH_GL21, program->source.program, draws, runs);
+  if (GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object)
+    run(PATH_GL33, program->source.program, draws, runs);
+  else
+    printf("%-9s not available\n", pathNames[PATH_GL33]);
+
+  glDeleteTextures(1, &texture);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * BC1 / BC3 / BC4 (DXT1 / DXT5 / RGTC1) block encoders.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include <stddef.h>
+
+enum block_format
+{
+  BLOCK_BC1,  /* RGB, 8 bytes per 4x4 block */
+  BLOCK_BC3,  /* RGBA, 16 bytes per block */
+  BLOCK_BC4   /* one channel, 8 bytes per block */
+};
+
+/* bytes needed for a w x h image (partial blocks count as whole ones) */
+size_t block_compressed_size(enum block_format format, int w, int h);
+
+/*
+ * Compress a w x h image. 'pixels' has 'channels' bytes per pixel
+ * (4 for BC1/BC3, 1 or more for BC4 which uses the first channel).
+ * Rows are compressed in the order given, so a bottom-up image stays
+ * bottom-up. Edge blocks repeat the last row/column.
+ */
+void block_compress(enum block_format format, const unsigned char* pixels,
+                    int w, int h, int channels, unsigned char* out);
+
+#endif
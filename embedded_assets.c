@@ -0,0 +1,53 @@
+/*
+ * Data files compiled into the executables (the DATA list in
+ * CMakeLists.txt, see asset_embed.c).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <string.h>
+#include "embedded_assets.h"
+
+static bool embeddedEnabled = true;
+
+const struct embedded_asset* embedded_asset_find(const char* name)
+{
+  while(name[0] == '.' && name[1] == '/')
+    name += 2;
+  size_t low = 0;
+  size_t high = embeddedAssetCount;
+  while(low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      int order = strcmp(name, embeddedAssets[middle].name);
+      if (order == 0)
+        return &embeddedAssets[middle];
+      if (order < 0)
+        high = middle;
+      else
+        low = middle + 1;
+    }
+  return NULL;
+}
+
+void embedded_assets_set_enabled(bool enabled)
+{
+  embeddedEnabled = enabled;
+}
+
+bool embedded_assets_open(const char* path, struct mapped_file* file)
+{
+  if (!embeddedEnabled || path[0] == '/')
+    return false;
+  const struct embedded_asset* asset = embedded_asset_find(path);
+  if (asset == NULL)
+    return false;
+  file->data = asset->data;
+  file->size = asset->size;
+  file->storage = MAPPED_STORAGE_EMBEDDED;
+  return true;
+}
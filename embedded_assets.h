@@ -0,0 +1,43 @@
+/*
+ * Data files compiled into the executables (the DATA list in
+ * CMakeLists.txt, see asset_embed.c).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef EMBEDDED_ASSETS_H
+#define EMBEDDED_ASSETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mapped_file.h"
+
+struct embedded_asset
+{
+  const char* name;
+  const unsigned char* data;    /* followed by a NUL, not counted in size */
+  size_t size;
+};
+
+/* generated: sorted by name */
+extern const struct embedded_asset embeddedAssets[];
+extern const size_t embeddedAssetCount;
+
+/* NULL when there is no such asset; a leading "./" is ignored */
+const struct embedded_asset* embedded_asset_find(const char* name);
+
+/*
+ * mapped_file_open serves relative paths from the embedded copies, after
+ * the directory of mapped_file_set_directory and before the asset pack
+ * and the file system. Enabled by default.
+ */
+void embedded_assets_set_enabled(bool enabled);
+
+/* mapped_file_open's hook: true if 'path' is embedded (and enabled) */
+bool embedded_assets_open(const char* path, struct mapped_file* file);
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * Compare the ways assets are read, on a cold and on a warm page cache:
+ *
+ *   stdio  fopen/fseek/ftell/fread for text, one fread per libpng request
+ *          for PNGs (how the loaders used to work)
+ *   read   mapped_file with mapping disabled: one read() of the whole file
+ *   mmap   mapped_file: madvise'd mapping, libpng reads slices of it
+ *   pack   the same names out of the mounted asset pack: one mapping for
+ *          all files, no open() per file
+ *   embed  the copies compiled into the program (embedded_assets.h): no
+ *          file to open at all; warm only, the executable stays mapped
+ *
+ *   file_io_bench [--repeat N] [--no-cold] [--pack FILE] [file...]
+ *
+ * The pack defaults to ./assets.pak. Loose modes only run over the files
+ * that exist loosely, the pack mode over those the pack has, the embed
+ * mode over the embedded ones.
+ * PNG files are decoded to RGBA, everything else is only checksummed.
+ * Read system calls and bytes come from /proc/self/io (reading it costs
+ * about two calls itself), page faults from getrusage. Dropping a file
+ * from the page cache (posix_fadvise DONTNEED) needs no privileges, but
+ * only works for clean pages.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <png.h>
+#include "app.h"
+#include "asset_pack.h"
+#include "embedded_assets.h"
+#include "image_loader.h"
+#include "mapped_file.h"
+#include "texture_file.h"
+#include "timing.h"
+
+enum io_mode
+{
+  IO_STDIO,
+  IO_READ,
+  IO_MMAP,
+  IO_PACK,
+  IO_EMBEDDED
+};
+
+static const char* const modeNames[] = { "stdio", "read", "mmap", "pack", "embed" };
+
+static const char* const defaultFiles[] =
+  {
+    "passThrough.vertex", "passThrough.frag", "texture.vertex", "texture.frag",
+    "sprite.vertex", "texture.png", "Trollface.png", "demo_0.png",
+    "texture.ktx", "Trollface.ktx", NULL
+  };
+
+struct io_counters
+{
+  long long readCalls;
+  long long readBytes;
+  long majorFaults;
+  long minorFaults;
+};
+
+static void io_counters_now(struct io_counters* counters)
+{
+  memset(counters, 0, sizeof(*counters));
+  FILE* fp = fopen("/proc/self/io", "r");
+  if (fp != NULL)
+    {
+      char name[64];
+      long long value;
+      while(fscanf(fp, "%63[^:]: %lld\n", name, &value) == 2)
+        {
+          if (strcmp(name, "syscr") == 0)
+            counters->readCalls = value;
+          else if (strcmp(name, "rchar") == 0)
+            counters->readBytes = value;
+        }
+      fclose(fp);
+    }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  counters->majorFaults = usage.ru_majflt;
+  counters->minorFaults = usage.ru_minflt;
+}
+
+static void drop_from_page_cache(const char* path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+/* the old read_all_bytes, also returning the size */
+static char* stdio_read_text(const char* path, size_t* size)
+{
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL)
+    return NULL;
+
+  fseek(fp, 0, SEEK_END);
+  long fileSize = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  char* buffer = malloc(fileSize + 1);
+  size_t readCount = fread(buffer, 1, fileSize, fp);
+  buffer[readCount] = '\0';
+  fclose(fp);
+  *size = readCount;
+  return buffer;
+}
+
+static void stdio_png_read(png_structp readStruct, png_bytep ptr, png_size_t size)
+{
+  FILE* fp = (FILE*)png_get_io_ptr(readStruct);
+  fread(ptr, 1, size, fp);
+}
+
+/* the old PNG path: libpng pulls every chunk with its own fread */
+static unsigned char* stdio_load_png(const char* path, int* w, int* h)
+{
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL)
+    return NULL;
+  png_structp readStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png_create_info_struct(readStruct);
+  png_set_read_fn(readStruct, fp, stdio_png_read);
+  png_read_info(readStruct, info);
+  *w = png_get_image_width(readStruct, info);
+  *h = png_get_image_height(readStruct, info);
+
+  int colorType = png_get_color_type(readStruct, info);
+  png_set_expand(readStruct);
+  png_set_strip_16(readStruct);
+  if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+    png_set_gray_to_rgb(readStruct);
+  png_set_filler(readStruct, 0xFF, PNG_FILLER_AFTER);
+  png_read_update_info(readStruct, info);
+
+  unsigned char* pixels = malloc((size_t)*w * *h * 4);
+  png_bytep* rows = malloc(sizeof(png_bytep) * *h);
+  int y;
+  for(y = 0; y < *h; y++)
+    rows[*h - y - 1] = pixels + (size_t)y * *w * 4;
+  png_read_image(readStruct, rows);
+  free(rows);
+  png_destroy_read_struct(&readStruct, &info, NULL);
+  fclose(fp);
+  return pixels;
+}
+
+static unsigned checksum(const unsigned char* data, size_t size)
+{
+  unsigned sum = 0;
+  size_t i;
+  for(i = 0; i < size; i++)
+    sum = sum * 31 + data[i];
+  return sum;
+}
+
+/* read (and decode) one file; returns a value depending on its contents */
+static unsigned load_one(const char* path, enum io_mode mode)
+{
+  int w = 0;
+  int h = 0;
+  if (has_suffix(path, ".png"))
+    {
+      unsigned char* pixels = mode == IO_STDIO
+        ? stdio_load_png(path, &w, &h)
+        : load_image(path, 4, &w, &h, NULL);
+      unsigned sum = pixels != NULL ? pixels[0] + pixels[(size_t)w * h * 4 - 1] : 0;
+      free(pixels);
+      return sum;
+    }
+  if (mode == IO_STDIO)
+    {
+      size_t size = 0;
+      char* text = stdio_read_text(path, &size);
+      unsigned sum = text != NULL ? checksum((unsigned char*)text, size) : 0;
+      free(text);
+      return sum;
+    }
+  struct mapped_file file;
+  if (!mapped_file_open(&file, path, MAPPED_SEQUENTIAL))
+    return 0;
+  unsigned sum = checksum(file.data, file.size);
+  mapped_file_close(&file);
+  return sum;
+}
+
+static void run(const char** files, int count, int repeat, enum io_mode mode, bool cold,
+                const char* packPath)
+{
+  int i;
+  int r;
+  if (count == 0)
+    return;
+  if (cold && mode == IO_PACK)
+    {
+      drop_from_page_cache(packPath);
+    }
+  else if (cold)
+    {
+      for(i = 0; i < count; i++)
+        drop_from_page_cache(files[i]);
+    }
+  mapped_file_set_enabled(mode != IO_READ);
+  embedded_assets_set_enabled(mode == IO_EMBEDDED);
+
+  struct io_counters before;
+  struct io_counters after;
+  unsigned sum = 0;
+  io_counters_now(&before);
+  double start = timing_now();
+  // mounting is part of what a program pays at startup
+  if (mode == IO_PACK && !asset_pack_mount(packPath))
+    return;
+  for(r = 0; r < repeat; r++)
+    {
+      for(i = 0; i < count; i++)
+        sum += load_one(files[i], mode);
+    }
+  asset_pack_unmount();
+  double elapsed = timing_now() - start;
+  io_counters_now(&after);
+
+  printf("%-5s %-4s %10.3f ms %8lld read calls %10lld bytes read %6ld major %7ld minor faults  (%08x)\n",
+         modeNames[mode], cold ? "cold" : "warm", elapsed * 1000.0,
+         after.readCalls - before.readCalls, after.readBytes - before.readBytes,
+         after.majorFaults - before.majorFaults, after.minorFaults - before.minorFaults, sum);
+}
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  return strcmp(argv[i - 1], "--repeat") == 0 || strcmp(argv[i - 1], "--pack") == 0;
+}
+
+int main(int argc, char** argv)
+{
+  const char* repeatOption = app_option(argc, argv, "--repeat");
+  const char* packPath = app_option(argc, argv, "--pack");
+  int repeat = repeatOption != NULL ? atoi(repeatOption) : 1;
+  bool cold = !app_flag(argc, argv, "--no-cold");
+  if (repeat < 1)
+    repeat = 1;
+  if (packPath == NULL)
+    packPath = "assets.pak";
+
+  const char** names = malloc(sizeof(char*) * (argc + 16));
+  int count = 0;
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      names[count++] = argv[i];
+    }
+  if (count == 0)
+    {
+      for(i = 0; defaultFiles[i] != NULL; i++)
+        names[count++] = defaultFiles[i];
+    }
+
+  struct asset_pack pack;
+  bool havePack = access(packPath, R_OK) == 0 && asset_pack_open(&pack, packPath);
+  const char** looseFiles = malloc(sizeof(char*) * count);
+  const char** packFiles = malloc(sizeof(char*) * count);
+  const char** embeddedFiles = malloc(sizeof(char*) * count);
+  int looseCount = 0;
+  int packCount = 0;
+  int embeddedCount = 0;
+  for(i = 0; i < count; i++)
+    {
+      if (access(names[i], R_OK) == 0)
+        looseFiles[looseCount++] = names[i];
+      if (havePack && asset_pack_find(&pack, names[i]) != NULL)
+        packFiles[packCount++] = names[i];
+      if (embedded_asset_find(names[i]) != NULL)
+        embeddedFiles[embeddedCount++] = names[i];
+    }
+  if (havePack)
+    asset_pack_close(&pack);
+  if (looseCount == 0 && packCount == 0 && embeddedCount == 0)
+    {
+      fprintf(stderr, "usage: %s [--repeat N] [--no-cold] [--pack FILE] file...\n", argv[0]);
+      return -1;
+    }
+
+  printf("%d loose files, %d in %s, %d embedded, each loaded %d times per run\n",
+         looseCount, packCount, packPath, embeddedCount, repeat);
+  enum io_mode mode;
+  for(mode = IO_STDIO; mode <= IO_EMBEDDED; mode++)
+    {
+      const char** files = looseFiles;
+      int fileCount = looseCount;
+      if (mode == IO_PACK)
+        {
+          files = packFiles;
+          fileCount = packCount;
+        }
+      else if (mode == IO_EMBEDDED)
+        {
+          files = embeddedFiles;
+          fileCount = embeddedCount;
+        }
+      if (cold && mode != IO_EMBEDDED)
+        run(files, fileCount, repeat, mode, true, packPath);
+      run(files, fileCount, repeat, mode, false, packPath);
+    }
+  free(names);
+  free(looseFiles);
+  free(packFiles);
+  free(embeddedFiles);
+  return 0;
+}
@@ -0,0 +1,512 @@
+/*
+ * Capture rendered frames to disk without stalling the frame loop: the
+ * back buffer is read into a ring of pixel pack buffers, each mapped two
+ * frames later once its fence has signaled, and handed to a writer
+ * thread.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "frame_capture.h"
+#include "image_loader.h"
+#include "timing.h"
+
+static const char* const formatNames[] = { "raw RGBA", "PNG", "Y4M" };
+
+/* a 16.16 fixed point value, rounded, as a byte */
+static unsigned char clamp_byte(int fixed)
+{
+  int v = (fixed + 32768) >> 16;
+  return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/* RGB to full range BT.601 Y'CbCr */
+static unsigned char luma(int r, int g, int b)
+{
+  return clamp_byte(19595 * r + 38470 * g + 7471 * b);
+}
+
+// pure blue and pure red land on 255.5 before rounding
+static unsigned char chroma_blue(int r, int g, int b)
+{
+  return clamp_byte(-11059 * r - 21709 * g + 32768 * b + (128 << 16));
+}
+
+static unsigned char chroma_red(int r, int g, int b)
+{
+  return clamp_byte(32768 * r - 27439 * g - 5329 * b + (128 << 16));
+}
+
+/* one frame as Y, Cb and Cr planes, top row first; chroma averages 2x2 blocks */
+static void convert_y4m(const struct frame_capture* capture, const unsigned char* pixels,
+                        unsigned char* planes)
+{
+  int w = capture->width;
+  int h = capture->height;
+  int cw = (w + 1) / 2;
+  int ch = (h + 1) / 2;
+  unsigned char* y = planes;
+  unsigned char* cb = planes + (size_t)w * h;
+  unsigned char* cr = cb + (size_t)cw * ch;
+  int row;
+  int x;
+  for(row = 0; row < h; row++)
+    {
+      const unsigned char* src = pixels + (size_t)(h - 1 - row) * w * 4;
+      for(x = 0; x < w; x++)
+        y[(size_t)row * w + x] = luma(src[4 * x], src[4 * x + 1], src[4 * x + 2]);
+    }
+  for(row = 0; row < ch; row++)
+    {
+      // a missing last row or column repeats the edge
+      int top = h - 1 - 2 * row;
+      int bottom = top > 0 ? top - 1 : top;
+      const unsigned char* src0 = pixels + (size_t)top * w * 4;
+      const unsigned char* src1 = pixels + (size_t)bottom * w * 4;
+      for(x = 0; x < cw; x++)
+        {
+          int x0 = 2 * x;
+          int x1 = x0 + 1 < w ? x0 + 1 : x0;
+          int rgb[3];
+          int c;
+          for(c = 0; c < 3; c++)
+            rgb[c] = (src0[4 * x0 + c] + src0[4 * x1 + c] + src1[4 * x0 + c] + src1[4 * x1 + c] + 2) / 4;
+          cb[(size_t)row * cw + x] = chroma_blue(rgb[0], rgb[1], rgb[2]);
+          cr[(size_t)row * cw + x] = chroma_red(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+}
+
+static bool write_raw(struct frame_capture* capture, const struct captured_frame* frame)
+{
+  size_t rowSize = (size_t)capture->width * 4;
+  int row;
+  for(row = capture->height - 1; row >= 0; row--)
+    {
+      if (fwrite(frame->pixels + row * rowSize, 1, rowSize, capture->file) != rowSize)
+        return false;
+    }
+  return true;
+}
+
+static bool write_y4m(struct frame_capture* capture, const struct captured_frame* frame)
+{
+  size_t size = (size_t)capture->width * capture->height
+    + 2 * (size_t)((capture->width + 1) / 2) * ((capture->height + 1) / 2);
+  convert_y4m(capture, frame->pixels, capture->planes);
+  return fputs("FRAME\n", capture->file) >= 0
+    && fwrite(capture->planes, 1, size, capture->file) == size;
+}
+
+/* a batch of frames for the pool; failures counted atomically */
+struct png_batch
+{
+  struct frame_capture* capture;
+  struct captured_frame** frames;
+  long failures;
+};
+
+static void write_png(void* ctx, int i)
+{
+  struct png_batch* batch = ctx;
+  struct frame_capture* capture = batch->capture;
+  char path[4096];
+  if (batch->frames[i]->failed)
+    {
+      __atomic_add_fetch(&batch->failures, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  snprintf(path, sizeof(path), capture->path, (int)batch->frames[i]->number);
+  if (!save_image_png(path, batch->frames[i]->pixels, capture->width, capture->height, 4))
+    __atomic_add_fetch(&batch->failures, 1, __ATOMIC_RELAXED);
+}
+
+/* write everything queued, in order for the single file formats */
+static long write_frames(struct frame_capture* capture, struct captured_frame* frames,
+                         struct captured_frame** array, int* count)
+{
+  long failures = 0;
+  *count = 0;
+  struct captured_frame* frame;
+  for(frame = frames; frame != NULL; frame = frame->next)
+    {
+      array[(*count)++] = frame;
+      // lost in the readback: counted, not written
+      if (frame->failed && capture->format != CAPTURE_PNG)
+        failures++;
+      else if (capture->format == CAPTURE_RAW && !write_raw(capture, frame))
+        failures++;
+      else if (capture->format == CAPTURE_Y4M && !write_y4m(capture, frame))
+        failures++;
+    }
+  if (capture->format == CAPTURE_PNG)
+    {
+      struct png_batch batch = { capture, array, 0 };
+      thread_pool_parallel_for(capture->pool, *count, write_png, &batch);
+      failures = batch.failures;
+    }
+  return failures;
+}
+
+static void* writer_main(void* arg)
+{
+  struct frame_capture* capture = arg;
+  struct captured_frame** array = malloc(sizeof(struct captured_frame*) * capture->frameCount);
+  pthread_mutex_lock(&capture->lock);
+  while(true)
+    {
+      while(!capture->quit && capture->queue == NULL)
+        pthread_cond_wait(&capture->wake, &capture->lock);
+      // the queue is drained before quitting
+      if (capture->queue == NULL)
+        break;
+      struct captured_frame* frames = capture->queue;
+      capture->queue = NULL;
+      capture->queueTail = NULL;
+      pthread_mutex_unlock(&capture->lock);
+
+      int count = 0;
+      long failures = array != NULL ? write_frames(capture, frames, array, &count) : 0;
+      if (array == NULL)
+        {
+          struct captured_frame* frame;
+          for(frame = frames; frame != NULL; frame = frame->next)
+            failures++;
+        }
+      double now = timing_now();
+
+      pthread_mutex_lock(&capture->lock);
+      struct captured_frame* last = frames;
+      int n = 1;
+      while(last->next != NULL)
+        {
+          last = last->next;
+          n++;
+        }
+      last->next = capture->freeList;
+      capture->freeList = frames;
+      capture->stats.written += n - failures;
+      capture->stats.failures += failures;
+      capture->stats.lastWritten = now;
+      pthread_cond_broadcast(&capture->freed);
+    }
+  pthread_mutex_unlock(&capture->lock);
+  free(array);
+  return NULL;
+}
+
+/*
+ * 'path' as a snprintf format with exactly one int conversion: the first
+ * %d (with an optional 0 flag and width) is kept and every other '%'
+ * escaped; without one, "_%06d.png" replaces or follows the extension.
+ */
+static char* png_pattern(const char* path)
+{
+  size_t length = strlen(path);
+  char* pattern = malloc(2 * length + 16);
+  if (pattern == NULL)
+    return NULL;
+  bool found = false;
+  size_t j = 0;
+  size_t i;
+  for(i = 0; i < length; i++)
+    {
+      if (path[i] == '%' && !found)
+        {
+          size_t k = i + 1;
+          while(k - i <= 3 && path[k] >= '0' && path[k] <= '9')
+            k++;
+          if (path[k] == 'd')
+            {
+              memcpy(pattern + j, path + i, k - i + 1);
+              j += k - i + 1;
+              i = k;
+              found = true;
+              continue;
+            }
+        }
+      if (path[i] == '%')
+        pattern[j++] = '%';
+      pattern[j++] = path[i];
+    }
+  pattern[j] = '\0';
+  if (!found)
+    {
+      // before the extension, if there is one
+      if (j >= 4 && strcmp(pattern + j - 4, ".png") == 0)
+        j -= 4;
+      strcpy(pattern + j, "_%06d.png");
+    }
+  return pattern;
+}
+
+enum capture_format frame_capture_guess_format(const char* path)
+{
+  size_t length = strlen(path);
+  if (length >= 4 && strcmp(path + length - 4, ".y4m") == 0)
+    return CAPTURE_Y4M;
+  if (strchr(path, '%') != NULL)
+    return CAPTURE_PNG;
+  return CAPTURE_RAW;
+}
+
+bool frame_capture_init(struct frame_capture* capture, const char* path, enum capture_format format,
+                        int w, int h, int fps, int ringSize, int queueDepth, bool sync)
+{
+  memset(capture, 0, sizeof(*capture));
+  capture->format = format;
+  capture->width = w;
+  capture->height = h;
+  capture->fps = fps > 0 ? fps : 60;
+  capture->sync = sync;
+  capture->fences = GLEW_VERSION_3_2 || GLEW_ARB_sync;
+  capture->ringSize = ringSize < 3 ? 3 : ringSize;
+  // the PNG path becomes a format string: never one the user wrote
+  capture->path = format == CAPTURE_PNG ? png_pattern(path) : strdup(path);
+  if (capture->path == NULL)
+    return false;
+
+  if (format != CAPTURE_PNG)
+    {
+      capture->file = fopen(path, "wb");
+      if (capture->file == NULL)
+        {
+          fprintf(stderr, "ERROR: cannot create '%s'\n", path);
+          free(capture->path);
+          return false;
+        }
+    }
+  if (format == CAPTURE_Y4M)
+    {
+      capture->planes = malloc((size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2));
+      // without XCOLORRANGE decoders assume limited range (16..235)
+      fprintf(capture->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+              w, h, capture->fps);
+    }
+  if (format == CAPTURE_PNG)
+    capture->pool = thread_pool_create(0);
+
+  // the writer's buffers: one per read in flight, plus the queue
+  capture->frameCount = (sync ? 1 : capture->ringSize) + (queueDepth > 0 ? queueDepth : 1);
+  capture->frames = calloc(capture->frameCount, sizeof(struct captured_frame));
+  bool ok = capture->frames != NULL && (format != CAPTURE_Y4M || capture->planes != NULL);
+  int i;
+  for(i = 0; ok && i < capture->frameCount; i++)
+    {
+      capture->frames[i].pixels = malloc((size_t)w * h * 4);
+      ok = capture->frames[i].pixels != NULL;
+      capture->frames[i].next = capture->freeList;
+      capture->freeList = &capture->frames[i];
+    }
+
+  if (ok && !sync)
+    {
+      capture->buffers = calloc(capture->ringSize, sizeof(GLuint));
+      capture->syncs = calloc(capture->ringSize, sizeof(GLsync));
+      ok = capture->buffers != NULL && capture->syncs != NULL;
+      if (ok)
+        {
+          // GL_STREAM_READ: written by GL once, read by us once
+          glGenBuffers(capture->ringSize, capture->buffers);
+          for(i = 0; i < capture->ringSize; i++)
+            {
+              glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[i]);
+              glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)w * h * 4, NULL, GL_STREAM_READ);
+            }
+          glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+  pthread_mutex_init(&capture->lock, NULL);
+  pthread_cond_init(&capture->wake, NULL);
+  pthread_cond_init(&capture->freed, NULL);
+  if (!ok || pthread_create(&capture->thread, NULL, writer_main, capture) != 0)
+    {
+      fprintf(stderr, "ERROR: cannot start capturing to '%s'\n", path);
+      // nothing for frame_capture_finish to join
+      capture->quit = true;
+      capture->thread = 0;
+      frame_capture_free(capture);
+      return false;
+    }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  return true;
+}
+
+/* a free buffer, waiting for the writer if there is none */
+static struct captured_frame* take_frame(struct frame_capture* capture)
+{
+  pthread_mutex_lock(&capture->lock);
+  if (capture->freeList == NULL)
+    {
+      double start = timing_now();
+      while(capture->freeList == NULL)
+        pthread_cond_wait(&capture->freed, &capture->lock);
+      capture->stats.stallTime += timing_now() - start;
+    }
+  struct captured_frame* frame = capture->freeList;
+  capture->freeList = frame->next;
+  pthread_mutex_unlock(&capture->lock);
+  frame->next = NULL;
+  frame->failed = false;
+  return frame;
+}
+
+static void queue_frame(struct frame_capture* capture, struct captured_frame* frame)
+{
+  pthread_mutex_lock(&capture->lock);
+  if (capture->queueTail != NULL)
+    capture->queueTail->next = frame;
+  else
+    capture->queue = frame;
+  capture->queueTail = frame;
+  pthread_cond_signal(&capture->wake);
+  pthread_mutex_unlock(&capture->lock);
+  capture->stats.frames++;
+}
+
+/* map the oldest read in flight and queue a copy of it */
+static void map_oldest(struct frame_capture* capture)
+{
+  int slot = (int)(capture->oldest % capture->ringSize);
+  if (capture->syncs[slot] != NULL)
+    {
+      // two frames on, this is normally signaled already
+      while(glClientWaitSync(capture->syncs[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+                             1000000000) == GL_TIMEOUT_EXPIRED)
+        ;
+      glDeleteSync(capture->syncs[slot]);
+      capture->syncs[slot] = NULL;
+    }
+
+  size_t size = (size_t)capture->width * capture->height * 4;
+  struct captured_frame* frame = take_frame(capture);
+  frame->number = capture->oldest++;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[slot]);
+  const unsigned char* mapped;
+  if (GLEW_ARB_map_buffer_range)
+    mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  else
+    mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+  if (mapped != NULL)
+    {
+      memcpy(frame->pixels, mapped, size);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+  else
+    {
+      // the frame is lost; the writer counts it, under the lock
+      frame->failed = true;
+    }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  queue_frame(capture, frame);
+}
+
+void frame_capture_frame(struct frame_capture* capture)
+{
+  double start = timing_now();
+  if (capture->stats.frames == 0 && capture->next == 0)
+    capture->stats.firstFrame = start;
+
+  if (capture->sync)
+    {
+      struct captured_frame* frame = take_frame(capture);
+      frame->number = capture->next++;
+      glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, frame->pixels);
+      queue_frame(capture, frame);
+    }
+  else
+    {
+      // the read only queues a copy into the buffer; the fence says when it is done
+      int slot = (int)(capture->next % capture->ringSize);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[slot]);
+      glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      if (capture->fences)
+        capture->syncs[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      capture->next++;
+      // frame N is mapped as N + 2 is read (with the default ring of 3)
+      if (capture->next - capture->oldest >= capture->ringSize)
+        map_oldest(capture);
+    }
+
+  double elapsed = timing_now() - start;
+  capture->stats.captureTime += elapsed;
+  if (elapsed > capture->stats.maxCaptureTime)
+    capture->stats.maxCaptureTime = elapsed;
+}
+
+void frame_capture_finish(struct frame_capture* capture)
+{
+  if (capture->quit)
+    return;
+  while(!capture->sync && capture->oldest < capture->next)
+    map_oldest(capture);
+
+  pthread_mutex_lock(&capture->lock);
+  capture->quit = true;
+  pthread_cond_signal(&capture->wake);
+  pthread_mutex_unlock(&capture->lock);
+  pthread_join(capture->thread, NULL);
+  capture->thread = 0;
+
+  if (capture->file != NULL && fclose(capture->file) != 0)
+    fprintf(stderr, "ERROR: cannot write '%s'\n", capture->path);
+  capture->file = NULL;
+}
+
+void frame_capture_free(struct frame_capture* capture)
+{
+  frame_capture_finish(capture);
+  int i;
+  if (capture->buffers != NULL)
+    glDeleteBuffers(capture->ringSize, capture->buffers);
+  for(i = 0; capture->syncs != NULL && i < capture->ringSize; i++)
+    {
+      if (capture->syncs[i] != NULL)
+        glDeleteSync(capture->syncs[i]);
+    }
+  for(i = 0; capture->frames != NULL && i < capture->frameCount; i++)
+    free(capture->frames[i].pixels);
+  if (capture->file != NULL)
+    fclose(capture->file);
+  if (capture->pool != NULL)
+    thread_pool_destroy(capture->pool);
+  pthread_cond_destroy(&capture->freed);
+  pthread_cond_destroy(&capture->wake);
+  pthread_mutex_destroy(&capture->lock);
+  free(capture->buffers);
+  free(capture->syncs);
+  free(capture->frames);
+  free(capture->planes);
+  free(capture->path);
+  memset(capture, 0, sizeof(*capture));
+}
+
+void frame_capture_report(const struct frame_capture* capture, FILE* fp)
+{
+  const struct frame_capture_stats* stats = &capture->stats;
+  if (stats->frames == 0)
+    return;
+  double elapsed = stats->lastWritten - stats->firstFrame;
+  fprintf(fp, "capture: %ld of %ld frames (%dx%d, %s) written to '%s' in %.3f s: %.1f frames/s "
+          "sustained, %ld failed\n",
+          stats->written, stats->frames, capture->width, capture->height,
+          formatNames[capture->format], capture->path, elapsed,
+          elapsed > 0 ? stats->written / elapsed : 0.0, stats->failures);
+  if (capture->sync)
+    fprintf(fp, "capture: glReadPixels into client memory");
+  else
+    fprintf(fp, "capture: ring of %d pixel pack buffers%s", capture->ringSize,
+            capture->fences ? " with fences" : "");
+  fprintf(fp, ", %.3f ms per frame on the render thread (max %.3f ms), "
+          "%.3f ms of it waiting for the writer\n",
+          stats->captureTime * 1000.0 / stats->frames, stats->maxCaptureTime * 1000.0,
+          stats->stallTime * 1000.0 / stats->frames);
+}
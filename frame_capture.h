@@ -0,0 +1,113 @@
+/*
+ * Capture rendered frames to disk without stalling the frame loop: the
+ * back buffer is read into a ring of pixel pack buffers, each mapped two
+ * frames later once its fence has signaled, and handed to a writer
+ * thread.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#include "thread_pool.h"
+
+enum capture_format
+{
+  CAPTURE_RAW,          /* one file, RGBA8 frames back to back, top row first */
+  CAPTURE_PNG,          /* a file per frame; the path has a %d (e.g. %05d) for the frame number */
+  CAPTURE_Y4M           /* one YUV4MPEG2 file, 4:2:0, full range BT.601 (XCOLORRANGE=FULL) */
+};
+
+/* a frame on its way to the writer, or free */
+struct captured_frame
+{
+  unsigned char* pixels;          /* RGBA8, bottom row first, as GL reads them */
+  long number;
+  bool failed;                    /* the readback could not be mapped */
+  struct captured_frame* next;
+};
+
+struct frame_capture_stats
+{
+  long frames;          /* handed to the writer */
+  long written;
+  long failures;        /* frames lost in the readback or not written */
+  double captureTime;   /* seconds spent in frame_capture_frame, render thread */
+  double maxCaptureTime;
+  double stallTime;     /* ... of which waiting for the writer to free a buffer */
+  double firstFrame;    /* timing_now() of the first capture */
+  double lastWritten;   /* ... and of the last frame written */
+};
+
+struct frame_capture
+{
+  char* path;
+  enum capture_format format;
+  int width;
+  int height;
+  int fps;              /* Y4M header */
+  bool sync;            /* plain glReadPixels each frame, for comparison */
+  bool fences;          /* GL 3.2 or ARB_sync; otherwise mapping may wait */
+
+  int ringSize;
+  GLuint* buffers;      /* pixel pack buffers */
+  GLsync* syncs;
+  long next;            /* frame number of the next read */
+  long oldest;          /* the oldest read not mapped yet */
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;            /* writer: a frame was queued, or quit */
+  pthread_cond_t freed;           /* render thread: a buffer is free again */
+  struct captured_frame* frames;  /* every buffer, for frame_capture_free */
+  int frameCount;
+  struct captured_frame* freeList;
+  struct captured_frame* queue;   /* oldest first */
+  struct captured_frame* queueTail;
+  bool quit;
+  FILE* file;           /* raw and Y4M */
+  struct thread_pool* pool;       /* PNG: frames of a batch are compressed in parallel */
+  unsigned char* planes;          /* Y4M: one frame of Y, Cb and Cr */
+
+  struct frame_capture_stats stats;
+};
+
+/*
+ * Capture the bottom left w x h pixels of the current read buffer (the
+ * back buffer, or the headless framebuffer) of every frame to 'path'.
+ * 'ringSize' pixel pack buffers are in flight (at least 3: frame N is
+ * mapped while N + 1 and N + 2 are read); 'queueDepth' more frames may
+ * wait for the writer before frame_capture_frame blocks. With 'sync' each
+ * frame is instead read straight into client memory, stalling until the
+ * GPU is done, as a baseline. 'fps' only goes into the Y4M header.
+ */
+bool frame_capture_init(struct frame_capture* capture, const char* path, enum capture_format format,
+                        int w, int h, int fps, int ringSize, int queueDepth, bool sync);
+
+/* the format 'path' suggests: .y4m, a '%' pattern for PNG, raw otherwise */
+enum capture_format frame_capture_guess_format(const char* path);
+
+/*
+ * Call after drawing a frame, before swapping buffers: starts reading it
+ * back and hands the oldest finished read to the writer.
+ */
+void frame_capture_frame(struct frame_capture* capture);
+
+/* read back the frames still in flight, wait for the writer, close the files */
+void frame_capture_finish(struct frame_capture* capture);
+
+void frame_capture_free(struct frame_capture* capture);
+
+/* sustained capture rate and the cost on the render thread */
+void frame_capture_report(const struct frame_capture* capture, FILE* fp);
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ * Per-phase frame timing: CPU time and GL_TIME_ELAPSED queries for named
+ * scopes, aggregated into log-linear (HDR style) histograms and written
+ * as CSV or JSON.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "frame_profiler.h"
+#include "timing.h"
+
+#define SUB_COUNT (1 << PROFILE_SUB_BITS)
+
+static int bucket_index(uint64_t ns)
+{
+  if (ns < 2 * SUB_COUNT)
+    return (int)ns;
+  // shift ns down until it is in [SUB_COUNT, 2 * SUB_COUNT)
+  int shift = 0;
+  while((ns >> shift) >= 2 * SUB_COUNT)
+    shift++;
+  if (shift > PROFILE_MAX_SHIFT)
+    return PROFILE_BUCKETS - 1;
+  return 2 * SUB_COUNT + (shift - 1) * SUB_COUNT + (int)(ns >> shift) - SUB_COUNT;
+}
+
+static uint64_t bucket_lower(int index, uint64_t* width)
+{
+  if (index < 2 * SUB_COUNT)
+    {
+      *width = 1;
+      return index;
+    }
+  int shift = (index - 2 * SUB_COUNT) / SUB_COUNT + 1;
+  uint64_t sub = (index - 2 * SUB_COUNT) % SUB_COUNT + SUB_COUNT;
+  *width = (uint64_t)1 << shift;
+  return sub << shift;
+}
+
+void profile_histogram_init(struct profile_histogram* histogram)
+{
+  memset(histogram, 0, sizeof(*histogram));
+  histogram->counts = calloc(PROFILE_BUCKETS, sizeof(uint32_t));
+}
+
+void profile_histogram_free(struct profile_histogram* histogram)
+{
+  free(histogram->counts);
+  memset(histogram, 0, sizeof(*histogram));
+}
+
+void profile_histogram_add(struct profile_histogram* histogram, uint64_t ns)
+{
+  if (histogram->counts == NULL)
+    return;
+  histogram->counts[bucket_index(ns)]++;
+  if (histogram->count == 0 || ns < histogram->min)
+    histogram->min = ns;
+  if (ns > histogram->max)
+    histogram->max = ns;
+  histogram->count++;
+  histogram->total += ns;
+}
+
+uint64_t profile_histogram_percentile(const struct profile_histogram* histogram, double p)
+{
+  if (histogram->count == 0)
+    return 0;
+
+  // nearest rank, like frame_stats_percentile; the middle of its bucket
+  uint64_t rank = (uint64_t)(p / 100.0 * histogram->count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > histogram->count)
+    rank = histogram->count;
+  uint64_t seen = 0;
+  int i;
+  for(i = 0; i < PROFILE_BUCKETS; i++)
+    {
+      seen += histogram->counts[i];
+      if (seen >= rank)
+        break;
+    }
+  uint64_t width;
+  uint64_t value = bucket_lower(i, &width) + width / 2;
+  if (value < histogram->min)
+    value = histogram->min;
+  if (value > histogram->max)
+    value = histogram->max;
+  return value;
+}
+
+/* set from the signal handler, looked at once per frame */
+static volatile sig_atomic_t reportRequested;
+
+static void request_report(int number)
+{
+  (void)number;
+  reportRequested = 1;
+}
+
+void frame_profiler_init(struct frame_profiler* profiler, const char* outputPath)
+{
+  memset(profiler, 0, sizeof(*profiler));
+  profiler->activeQuery = -1;
+  if (outputPath == NULL)
+    return;
+
+  profiler->enabled = true;
+  profiler->outputPath = outputPath;
+  profiler->startTime = timing_now();
+  profiler->gpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  if (!profiler->gpuTimers)
+    fprintf(stderr, "WARNING: no timer queries, profiling CPU time only\n");
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = request_report;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, NULL);
+}
+
+static void collect(struct frame_profiler* profiler, int slot, bool wait)
+{
+  int s;
+  for(s = 0; s < profiler->scopeCount; s++)
+    {
+      if (!profiler->pending[slot][s])
+        continue;
+      profiler->pending[slot][s] = false;
+
+      GLint available = 0;
+      if (!wait)
+        glGetQueryObjectiv(profiler->queries[slot][s], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!wait && !available)
+        {
+          profiler->droppedQueries++;
+          continue;
+        }
+      GLuint64 elapsed;
+      glGetQueryObjectui64v(profiler->queries[slot][s], GL_QUERY_RESULT, &elapsed);
+      // llvmpipe answers the first query of a context with a timestamp
+      if (elapsed > (timing_now() - profiler->startTime) * 1e9)
+        {
+          profiler->droppedQueries++;
+          continue;
+        }
+      profile_histogram_add(&profiler->scopes[s].gpu, elapsed);
+    }
+}
+
+void frame_profiler_free(struct frame_profiler* profiler)
+{
+  if (profiler->enabled)
+    {
+      int slot;
+      for(slot = 0; slot < FRAME_PROFILER_LATENCY; slot++)
+        collect(profiler, slot, true);
+      frame_profiler_write(profiler);
+      signal(SIGUSR1, SIG_DFL);
+    }
+
+  int s;
+  for(s = 0; s < profiler->scopeCount; s++)
+    {
+      profile_histogram_free(&profiler->scopes[s].cpu);
+      profile_histogram_free(&profiler->scopes[s].gpu);
+    }
+  if (profiler->gpuTimers)
+    glDeleteQueries(FRAME_PROFILER_LATENCY * FRAME_PROFILER_MAX_SCOPES, &profiler->queries[0][0]);
+  memset(profiler, 0, sizeof(*profiler));
+  profiler->activeQuery = -1;
+}
+
+int frame_profiler_scope(struct frame_profiler* profiler, const char* name, bool gpu)
+{
+  int s;
+  for(s = 0; s < profiler->scopeCount; s++)
+    {
+      if (strcmp(profiler->scopes[s].name, name) == 0)
+        return s;
+    }
+  if (profiler->scopeCount == FRAME_PROFILER_MAX_SCOPES)
+    {
+      fprintf(stderr, "WARNING: too many profiler scopes, '%s' is not timed\n", name);
+      return -1;
+    }
+
+  struct profile_scope* scope = &profiler->scopes[profiler->scopeCount];
+  scope->name = name;
+  scope->timeGpu = gpu;
+  if (profiler->enabled)
+    {
+      profile_histogram_init(&scope->cpu);
+      profile_histogram_init(&scope->gpu);
+      if (profiler->gpuTimers && profiler->scopeCount == 0)
+        glGenQueries(FRAME_PROFILER_LATENCY * FRAME_PROFILER_MAX_SCOPES, &profiler->queries[0][0]);
+    }
+  return profiler->scopeCount++;
+}
+
+void frame_profiler_begin(struct frame_profiler* profiler, int scope)
+{
+  if (!profiler->enabled || scope < 0)
+    return;
+  if (profiler->gpuTimers && profiler->scopes[scope].timeGpu && profiler->activeQuery < 0)
+    {
+      int slot = profiler->frames % FRAME_PROFILER_LATENCY;
+      glBeginQuery(GL_TIME_ELAPSED, profiler->queries[slot][scope]);
+      profiler->activeQuery = scope;
+    }
+  profiler->scopes[scope].cpuStart = timing_now();
+}
+
+void frame_profiler_end(struct frame_profiler* profiler, int scope)
+{
+  if (!profiler->enabled || scope < 0)
+    return;
+  double now = timing_now();
+  profile_histogram_add(&profiler->scopes[scope].cpu,
+                        (uint64_t)((now - profiler->scopes[scope].cpuStart) * 1e9));
+  if (profiler->activeQuery == scope)
+    {
+      glEndQuery(GL_TIME_ELAPSED);
+      profiler->pending[profiler->frames % FRAME_PROFILER_LATENCY][scope] = true;
+      profiler->activeQuery = -1;
+    }
+}
+
+void frame_profiler_begin_frame(struct frame_profiler* profiler)
+{
+  if (!profiler->enabled || !profiler->gpuTimers)
+    return;
+  // the queries of this slot were issued FRAME_PROFILER_LATENCY frames ago
+  collect(profiler, profiler->frames % FRAME_PROFILER_LATENCY, false);
+}
+
+void frame_profiler_end_frame(struct frame_profiler* profiler)
+{
+  if (!profiler->enabled)
+    return;
+  profiler->frames++;
+  if (reportRequested)
+    {
+      reportRequested = 0;
+      frame_profiler_write(profiler);
+    }
+}
+
+static void write_csv(const struct frame_profiler* profiler, FILE* fp)
+{
+  fprintf(fp, "scope,clock,count,min_ms,mean_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms\n");
+  int s;
+  int c;
+  for(s = 0; s < profiler->scopeCount; s++)
+    {
+      for(c = 0; c < 2; c++)
+        {
+          const struct profile_histogram* h = c == 0 ? &profiler->scopes[s].cpu : &profiler->scopes[s].gpu;
+          if (h->count == 0)
+            continue;
+          fprintf(fp, "%s,%s,%llu,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+                  profiler->scopes[s].name, c == 0 ? "cpu" : "gpu", (unsigned long long)h->count,
+                  h->min / 1e6, h->total / 1e6 / h->count,
+                  profile_histogram_percentile(h, 50) / 1e6,
+                  profile_histogram_percentile(h, 90) / 1e6,
+                  profile_histogram_percentile(h, 99) / 1e6,
+                  profile_histogram_percentile(h, 99.9) / 1e6,
+                  h->max / 1e6);
+        }
+    }
+}
+
+static void write_json_histogram(const struct profile_histogram* h, FILE* fp)
+{
+  fprintf(fp, "{\"count\": %llu", (unsigned long long)h->count);
+  if (h->count > 0)
+    fprintf(fp, ", \"min_ms\": %.6f, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, "
+            "\"p99_ms\": %.6f, \"p999_ms\": %.6f, \"max_ms\": %.6f",
+            h->min / 1e6, h->total / 1e6 / h->count,
+            profile_histogram_percentile(h, 50) / 1e6,
+            profile_histogram_percentile(h, 90) / 1e6,
+            profile_histogram_percentile(h, 99) / 1e6,
+            profile_histogram_percentile(h, 99.9) / 1e6,
+            h->max / 1e6);
+
+  // non-empty buckets as [lower bound in ns, count]
+  fprintf(fp, ", \"buckets_ns\": [");
+  bool first = true;
+  int i;
+  for(i = 0; h->counts != NULL && i < PROFILE_BUCKETS; i++)
+    {
+      if (h->counts[i] == 0)
+        continue;
+      uint64_t width;
+      fprintf(fp, "%s[%llu, %u]", first ? "" : ", ",
+              (unsigned long long)bucket_lower(i, &width), h->counts[i]);
+      first = false;
+    }
+  fprintf(fp, "]}");
+}
+
+static void write_json(const struct frame_profiler* profiler, FILE* fp)
+{
+  fprintf(fp, "{\n  \"frames\": %d,\n  \"gpu_timers\": %s,\n  \"dropped_queries\": %d,\n  \"scopes\": [",
+          profiler->frames, profiler->gpuTimers ? "true" : "false", profiler->droppedQueries);
+  int s;
+  for(s = 0; s < profiler->scopeCount; s++)
+    {
+      fprintf(fp, "%s\n    {\"name\": \"%s\",\n     \"cpu\": ", s == 0 ? "" : ",", profiler->scopes[s].name);
+      write_json_histogram(&profiler->scopes[s].cpu, fp);
+      fprintf(fp, ",\n     \"gpu\": ");
+      write_json_histogram(&profiler->scopes[s].gpu, fp);
+      fprintf(fp, "}");
+    }
+  fprintf(fp, "\n  ]\n}\n");
+}
+
+bool frame_profiler_write(struct frame_profiler* profiler)
+{
+  if (!profiler->enabled)
+    return false;
+  FILE* fp = fopen(profiler->outputPath, "w");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "Cannot write profile '%s'\n", profiler->outputPath);
+      return false;
+    }
+
+  size_t length = strlen(profiler->outputPath);
+  if (length >= 5 && strcmp(profiler->outputPath + length - 5, ".json") == 0)
+    write_json(profiler, fp);
+  else
+    write_csv(profiler, fp);
+  fclose(fp);
+  printf("profile: %d frames written to %s (%d GPU results dropped)\n",
+         profiler->frames, profiler->outputPath, profiler->droppedQueries);
+  return true;
+}
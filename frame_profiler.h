@@ -0,0 +1,108 @@
+/*
+ * Per-phase frame timing: CPU time and GL_TIME_ELAPSED queries for named
+ * scopes, aggregated into log-linear (HDR style) histograms and written
+ * as CSV or JSON.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <GL/glew.h>
+
+/*
+ * Values below 2^(PROFILE_SUB_BITS + 1) ns are counted exactly, larger
+ * ones in buckets of 2^PROFILE_SUB_BITS per power of two (under 1%
+ * error), up to about 2^40 ns.
+ */
+#define PROFILE_SUB_BITS 7
+#define PROFILE_MAX_SHIFT 33
+#define PROFILE_BUCKETS ((2 << PROFILE_SUB_BITS) + PROFILE_MAX_SHIFT * (1 << PROFILE_SUB_BITS))
+
+struct profile_histogram
+{
+  uint32_t* counts;       /* PROFILE_BUCKETS entries */
+  uint64_t count;
+  uint64_t total;         /* ns */
+  uint64_t min;
+  uint64_t max;
+};
+
+void profile_histogram_init(struct profile_histogram* histogram);
+void profile_histogram_free(struct profile_histogram* histogram);
+void profile_histogram_add(struct profile_histogram* histogram, uint64_t ns);
+
+/* value (ns) at percentile p (0..100); 0 when empty */
+uint64_t profile_histogram_percentile(const struct profile_histogram* histogram, double p);
+
+#define FRAME_PROFILER_MAX_SCOPES 16
+
+/*
+ * GPU results are read back this many frames after they were issued; a
+ * query that is still not done by then is dropped rather than waited for.
+ */
+#define FRAME_PROFILER_LATENCY 4
+
+struct profile_scope
+{
+  const char* name;
+  bool timeGpu;           /* false: CPU time only */
+  struct profile_histogram cpu;
+  struct profile_histogram gpu;
+  double cpuStart;
+};
+
+struct frame_profiler
+{
+  bool enabled;
+  bool gpuTimers;         /* GL_TIME_ELAPSED queries are available */
+  const char* outputPath; /* .json gets JSON, anything else CSV */
+  int scopeCount;
+  struct profile_scope scopes[FRAME_PROFILER_MAX_SCOPES];
+  GLuint queries[FRAME_PROFILER_LATENCY][FRAME_PROFILER_MAX_SCOPES];
+  bool pending[FRAME_PROFILER_LATENCY][FRAME_PROFILER_MAX_SCOPES];
+  int activeQuery;        /* scope owning the running query, or -1 */
+  double startTime;
+  int frames;
+  int droppedQueries;     /* late, or longer than the profiler has existed */
+};
+
+/*
+ * 'outputPath' NULL leaves the profiler disabled: scopes can still be
+ * registered, begin and end do nothing. An enabled profiler writes its
+ * report when SIGUSR1 arrives (at the end of the next frame) and in
+ * frame_profiler_free, which first waits for the queries in flight.
+ */
+void frame_profiler_init(struct frame_profiler* profiler, const char* outputPath);
+void frame_profiler_free(struct frame_profiler* profiler);
+
+/*
+ * Id of the scope called 'name' (a string that outlives the profiler),
+ * added if new. Scopes that enclose others should pass gpu false, or the
+ * enclosed ones get no GPU time (see frame_profiler_begin).
+ */
+int frame_profiler_scope(struct frame_profiler* profiler, const char* name, bool gpu);
+
+/*
+ * Time a scope. Scopes may nest, but GL_TIME_ELAPSED queries cannot:
+ * while one scope has a query running, scopes inside it get CPU time only.
+ */
+void frame_profiler_begin(struct frame_profiler* profiler, int scope);
+void frame_profiler_end(struct frame_profiler* profiler, int scope);
+
+/* collects the GPU results of FRAME_PROFILER_LATENCY frames ago */
+void frame_profiler_begin_frame(struct frame_profiler* profiler);
+void frame_profiler_end_frame(struct frame_profiler* profiler);
+
+/* write the report now; queries still in flight are left out */
+bool frame_profiler_write(struct frame_profiler* profiler);
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * Per-frame timing collection and summary (fps, mean/p50/p99).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "frame_stats.h"
+
+void frame_stats_init(struct frame_stats* stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+void frame_stats_free(struct frame_stats* stats)
+{
+  free(stats->frameTimes);
+  memset(stats, 0, sizeof(*stats));
+}
+
+void frame_stats_add(struct frame_stats* stats, double start, double end)
+{
+  if (stats->count == stats->capacity)
+    {
+      int newCapacity = stats->capacity == 0 ? 1024 : stats->capacity * 2;
+      double* newTimes = realloc(stats->frameTimes, sizeof(double) * newCapacity);
+      if (newTimes == NULL)
+        return;
+      stats->frameTimes = newTimes;
+      stats->capacity = newCapacity;
+    }
+
+  if (stats->count == 0)
+    stats->firstStart = start;
+  stats->lastEnd = end;
+  stats->frameTimes[stats->count++] = end - start;
+  stats->totalTime += end - start;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+double frame_stats_percentile(const struct frame_stats* stats, double p)
+{
+  if (stats->count == 0)
+    return 0;
+
+  double* sorted = malloc(sizeof(double) * stats->count);
+  if (sorted == NULL)
+    return -1;
+  memcpy(sorted, stats->frameTimes, sizeof(double) * stats->count);
+  qsort(sorted, stats->count, sizeof(double), compare_double);
+
+  // nearest-rank percentile
+  int rank = (int)(p / 100.0 * stats->count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > stats->count)
+    rank = stats->count;
+  double value = sorted[rank - 1];
+  free(sorted);
+  return value;
+}
+
+void frame_stats_report(const struct frame_stats* stats, const char* label, FILE* fp)
+{
+  if (stats->count == 0)
+    {
+      fprintf(fp, "%s: no frames recorded\n", label);
+      return;
+    }
+
+  double wall = stats->lastEnd - stats->firstStart;
+  double mean = stats->totalTime / stats->count;
+  double maxTime = 0;
+  int i;
+  for(i = 0; i < stats->count; i++)
+    {
+      if (stats->frameTimes[i] > maxTime)
+        maxTime = stats->frameTimes[i];
+    }
+
+  fprintf(fp, "%s: %d frames in %.3f s, %.1f frames/sec\n",
+          label, stats->count, wall, wall > 0 ? stats->count / wall : 0.0);
+  double p50 = frame_stats_percentile(stats, 50);
+  double p99 = frame_stats_percentile(stats, 99);
+  if (p50 >= 0 && p99 >= 0)
+    fprintf(fp, "%s: frame time mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            label, mean * 1000.0, p50 * 1000.0, p99 * 1000.0, maxTime * 1000.0);
+  else
+    fprintf(fp, "%s: frame time mean %.3f ms, max %.3f ms\n", label, mean * 1000.0, maxTime * 1000.0);
+  // from the start of each frame to its glFinish / swap, not GPU time alone
+  fprintf(fp, "%s: total frame time %.3f s\n", label, stats->totalTime);
+}
@@ -0,0 +1,37 @@
+/*
+ * Per-frame timing collection and summary (fps, mean/p50/p99).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdio.h>
+
+struct frame_stats
+{
+  double* frameTimes;   /* seconds spent in each frame */
+  int count;
+  int capacity;
+  double firstStart;    /* start of the first recorded frame */
+  double lastEnd;       /* end of the last recorded frame */
+  double totalTime;     /* sum of frameTimes */
+};
+
+void frame_stats_init(struct frame_stats* stats);
+void frame_stats_free(struct frame_stats* stats);
+
+/* record one frame that began at 'start' and was finished at 'end' */
+void frame_stats_add(struct frame_stats* stats, double start, double end);
+
+/* p in [0, 100]; returns 0 when nothing was recorded, -1 when out of memory */
+double frame_stats_percentile(const struct frame_stats* stats, double p);
+
+void frame_stats_report(const struct frame_stats* stats, const char* label, FILE* fp);
+
+#endif
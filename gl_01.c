@@ -13,6 +13,7 @@
 #include <stdbool.h>
 #include <GL/glew.h>
 #include <GL/glfw3.h>
+#include "app.h"
 
 static const GLfloat vertices[] =
   {
@@ -28,59 +29,24 @@ static const GLfloat colors[] =
     0.0f, 1.0f, 0.0f
   };
 
-int main()
+int main(int argc, char** argv)
 {
-
-  if (!glfwInit())
+  struct app app;
+  if (!app_init(&app, argc, argv, "Hello world!", 16))
+    return -1;
+  if (app.options.backend != APP_BACKEND_GL21)
     {
-      fprintf( stderr, "Failed to init glfw!\n");
+      fprintf(stderr, "ERROR: this program uses the fixed function pipeline, which gl33 does not have\n");
+      app_terminate(&app);
       return -1;
     }
 
-  glfwWindowHint(GLFW_FSAA_SAMPLES, 4);
-  glfwWindowHint(GLFW_DEPTH_BITS, 16);
-  // so sad that nouveau driver cannot provide OpenGL 3.3..
-  glfwWindowHint(GLFW_OPENGL_VERSION_MAJOR, 2);
-  glfwWindowHint(GLFW_OPENGL_VERSION_MINOR, 1);
-  //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   int lastW = 640;
   int lastH = 480;
-  int curW = 640;
-  int curH = 480;
-  
-  GLFWwindow window = glfwCreateWindow(curW, curH, GLFW_WINDOWED, "Hello world!", NULL);
-  if (window == NULL)
-    {
-      glfwTerminate();
-      fprintf( stderr, "Failed to open a window!\n");
-      fprintf( stderr, glfwErrorString(glfwGetError()));
-      fprintf( stderr, "\n");
-      return -1;
-    }
-  
-  /* obtain the OpenGL context of the newly-created window*/
-  glfwMakeContextCurrent(window);
-
-  glewExperimental = true;
-  if( glewInit() != GLEW_OK)
-    {
-      fprintf( stderr, "GLEW init failed!");
-      return -1;
-    }
-
-  if (GLEW_VERSION_2_1)
-    {
-      printf("GL 2.1: supported\n");
-    }
-
-  // ???
-  if (GLEW_VERSION_3_3)
-    {
-      printf("GL 3.3: supported\n");
-    }
+  int curW = app.options.width;
+  int curH = app.options.height;
 
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-  glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
   GLuint vertexBufferHandle;
   glGenBuffers(1, &vertexBufferHandle);
@@ -94,7 +60,7 @@ int main()
 
   while(true)
     {
-      glfwGetWindowSize(window, &curW, &curH);
+      app_get_size(&app, &curW, &curH);
       if (curW != lastW || curH != lastH)
         {
           lastW = curW;
@@ -102,7 +68,7 @@ int main()
           glViewport(0, 0, curW, curH);
         }
       
-      glfwMakeContextCurrent(window);
+      app_begin_frame(&app);
       
       // OpenGL drawing code
       glClear( GL_COLOR_BUFFER_BIT );
@@ -121,18 +87,14 @@ int main()
       glDisableClientState(GL_VERTEX_ARRAY);
       glDisableClientState(GL_COLOR_ARRAY);
 
-      glfwSwapBuffers(window);
-      glfwPollEvents();
-      if (glfwGetKey(window, GLFW_KEY_ESC) )
+      if (!app_end_frame(&app))
         break;
-      if (glfwGetWindowParam(window, GLFW_CLOSE_REQUESTED))
-        break; 
     }
   
   // cleanup
   glDeleteBuffers(1, &vertexBufferHandle);
   glDeleteBuffers(1, &colorBufferHandle);
   
-  glfwTerminate();
+  app_terminate(&app);
   return 0;
 }
@@ -0,0 +1,185 @@
+/*
+ * Demonstrate many moving sprites drawn through sprite_batch.
+ *
+ *   gl_sprites [--sprites N] [--capacity N] [--no-sort] [--immediate]
+ *
+ * Sprites alternate between two textures in submission order, the worst
+ * case for a batcher that only merges neighbours. --no-sort keeps that
+ * order (a draw call per sprite); by default they are grouped by texture,
+ * which needs two draw calls per flush. --immediate uploads and draws
+ * every sprite on its own, the glBufferData + glDrawElements pair per
+ * quad this replaces. Batch statistics are printed at exit.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "sprite_batch.h"
+#include "texture_file.h"
+#include "timing.h"
+
+struct mover
+{
+  float x;
+  float y;
+  float dx;
+  float dy;
+  float spin;
+};
+
+static float random_between(float low, float high)
+{
+  return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+static bool load_texture(const char* path, GLuint* texture)
+{
+  struct texture_load_options options;
+  texture_load_options_init(&options, 0);
+  struct texture_info info;
+  glGenTextures(1, texture);
+  glBindTexture(GL_TEXTURE_2D, *texture);
+  return load_texture_file(path, &options, &info);
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Hello gl sprites!", 0))
+    return -1;
+
+  const char* spritesOption = app_option(argc, argv, "--sprites");
+  const char* capacityOption = app_option(argc, argv, "--capacity");
+  int spriteCount = spritesOption != NULL ? atoi(spritesOption) : 5000;
+  int capacity = capacityOption != NULL ? atoi(capacityOption) : 16384;
+  if (app_flag(argc, argv, "--immediate"))
+    capacity = 1;
+  enum sprite_sort sort = app_flag(argc, argv, "--no-sort") ? SPRITE_SORT_NONE : SPRITE_SORT_STATE;
+  if (spriteCount < 1)
+    spriteCount = 1;
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "sprite.vertex", "texture.frag", spriteAttributes);
+  struct shader_variant* program = shader_variants_get(&variants, SHADER_VERTEX_TINT);
+  if (program == NULL)
+    return -1;
+  program_cache_report(&programCache);
+  glUseProgram(program->source.program);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+
+  GLuint textures[2];
+  if (!load_texture("texture.png", &textures[0]) || !load_texture("Trollface.png", &textures[1]))
+    return -1;
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  srand(1);
+  struct mover* movers = malloc(sizeof(struct mover) * spriteCount);
+  int i;
+  for(i = 0; i < spriteCount; i++)
+    {
+      movers[i].x = random_between(-1.0f, 1.0f);
+      movers[i].y = random_between(-1.0f, 1.0f);
+      movers[i].dx = random_between(-0.01f, 0.01f);
+      movers[i].dy = random_between(-0.01f, 0.01f);
+      movers[i].spin = random_between(-3.0f, 3.0f);
+    }
+
+  struct sprite_batch batch;
+  sprite_batch_init(&batch, capacity);
+  struct sprite_batch_stats total;
+  memset(&total, 0, sizeof(total));
+  double submitTime = 0;
+  int lastW = 0;
+  int lastH = 0;
+  // the sprites move a step per frame
+  app_set_frame_rate(&app, 60);
+  while(true)
+    {
+      int curW;
+      int curH;
+      app_get_size(&app, &curW, &curH);
+      if (curW != lastW || curH != lastH)
+        {
+          lastW = curW;
+          lastH = curH;
+          glViewport(0, 0, curW, curH);
+        }
+
+      app_begin_frame(&app);
+      glClear(GL_COLOR_BUFFER_BIT);
+
+      double submitStart = timing_now();
+      double time = submitStart - app.startTime;
+      sprite_batch_begin(&batch, sort);
+      for(i = 0; i < spriteCount; i++)
+        {
+          struct mover* m = &movers[i];
+          m->x += m->dx;
+          m->y += m->dy;
+          if (m->x < -1.0f || m->x > 1.0f)
+            m->dx = -m->dx;
+          if (m->y < -1.0f || m->y > 1.0f)
+            m->dy = -m->dy;
+
+          struct sprite s =
+            {
+              program->source.program, textures[i % 2], 0, m->x, m->y, 0.08f, 0.08f,
+              (float)time * m->spin,
+              { 0.0f, 0.0f, 1.0f, 1.0f },
+              { 195 / 255.0f, 180 / 255.0f, 218 / 255.0f, 1.0f }
+            };
+          sprite_batch_submit(&batch, &s);
+        }
+      sprite_batch_end(&batch);
+      submitTime += timing_now() - submitStart;
+
+      total.sprites += batch.stats.sprites;
+      total.flushes += batch.stats.flushes;
+      total.vertices += batch.stats.vertices;
+      total.drawCalls += batch.stats.drawCalls;
+      total.stateChanges += batch.stats.stateChanges;
+      if (batch.stats.maxFlushVertices > total.maxFlushVertices)
+        total.maxFlushVertices = batch.stats.maxFlushVertices;
+
+      glFlush();
+
+      if (!app_end_frame(&app))
+        break;
+    }
+
+  int frames = app.stats.count > 0 ? app.stats.count : 1;
+  printf("sprites: %d per frame, %s, capacity %d\n", spriteCount,
+         sort == SPRITE_SORT_STATE ? "sorted by state" : "submission order", capacity);
+  printf("sprites: %.1f flushes, %.1f draw calls, %.1f state changes per frame\n",
+         total.flushes / (double)frames, total.drawCalls / (double)frames,
+         total.stateChanges / (double)frames);
+  printf("sprites: %.1f vertices per flush (max %d), %.3f ms CPU per frame\n",
+         total.flushes > 0 ? total.vertices / (double)total.flushes : 0.0,
+         total.maxFlushVertices, submitTime * 1000.0 / frames);
+
+  free(movers);
+  sprite_batch_free(&batch);
+  glDeleteTextures(2, textures);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+
+  app_terminate(&app);
+  return 0;
+}
@@ -13,317 +13,178 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
-#include <png.h>
 #include <GL/glew.h>
 #include <GL/glfw3.h>
+#include "app.h"
+#include "shader.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "textured_quad.h"
+#include "hot_reload.h"
+#include "image_loader.h"
+#include "texture_file.h"
+#include "timing.h"
+#include "frame_capture.h"
 
 int min(int a, int b)
 {
   return a < b ? a : b;
 }
 
-char* read_all_bytes(char* path)
-{
-  FILE* fp = fopen(path, "r");
-  if (fp == NULL)
-    return NULL;
-  
-  fseek(fp, 0, SEEK_END);
-  long fileSize = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
-  
-  char* buffer = malloc(fileSize + 1);
-  int readCount = fread(buffer, 1, fileSize, fp);
-  buffer[fileSize] = '\0';
-  fclose(fp);
-  return buffer;
-}
-
-void show_gl_shader_compilation_error(GLuint shaderHandle)
-{
-  int errorLogLength;
-  glGetShaderiv(shaderHandle, GL_INFO_LOG_LENGTH, &errorLogLength);
-  char* buffer = malloc(errorLogLength + 1);
-  glGetShaderInfoLog(shaderHandle, errorLogLength + 1, NULL, buffer);
-  fprintf(stderr, buffer);
-  free(buffer);
-}
-
-void show_gl_linking_error(GLuint programHandle)
-{
-  int errorLogLength;
-  glGetProgramiv(programHandle, GL_INFO_LOG_LENGTH, &errorLogLength);
-  char* buffer = malloc(errorLogLength + 1);
-  glGetProgramInfoLog(programHandle, errorLogLength + 1, NULL, buffer);
-  fprintf(stderr, buffer);
-  free(buffer);
-}
-
-void my_read(png_structp readStruct, png_bytep ptr, png_size_t size)
-{
-  FILE* fp = (FILE*)png_get_io_ptr(readStruct);
-  fread(ptr, 1, size, fp);
-}
-
-bool power_of_2(int i)
-{
-  while(true)
-    {
-      if (i == 1 || i == 2)
-        return true;
-      if (i % 2 != 0)
-        return false;
-      i /= 2;
-    }
-  return false;
-}
-
-unsigned char* load_image_new(const char* filename, int* w, int* h)
+/*
+ * Padding leaves the image in the bottom left corner of the texture:
+ * draw only that part (the texture itself clamps to the edge).
+ */
+static void fit_texture(const struct textured_quad* quad, const struct texture_info* info)
 {
-  FILE* fp = fopen(filename, "rb");
-  
-  if (fp == NULL)
-    {
-      fprintf(stderr, "ERROR: cannot open texture file '%s'\n", filename);
-      return NULL;
-    }
-
-  png_structp readStruct;
-  png_infop info;
-  char header[8];
-  unsigned char* buf;
-
-  fread(header, 1, 8, fp);
-  if(png_sig_cmp(header, 0, 8) != 0)
-    {
-      fprintf(stderr, "ERROR: file '%s' is not a PNG file\n", filename);
-      fclose(fp);
-      return NULL;
-    }
-  
-  // We did not set error pointers or error handling codes (setjmp..)
-  // If there're some problems in the PNG file, the application will be
-  // killed (by OS).
-  readStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  
-  info = png_create_info_struct(readStruct);
-
-  png_set_read_fn(readStruct, fp, my_read);
-  
-  png_set_sig_bytes(readStruct, 8);
-
-  png_read_info(readStruct, info);
-  
-  *w = png_get_image_width(readStruct, info);
-  *h = png_get_image_height(readStruct, info);
-  
-  if(power_of_2(*w) == false || power_of_2(*h) == false)
-    {
-      fprintf(stderr, "WARNING: texture have non-power-of-2 dimensions (width or height)\n");
-    }
-  
-  if(png_get_color_type(readStruct, info) != PNG_COLOR_TYPE_RGB_ALPHA
-     || png_get_bit_depth(readStruct, info) != 8)
-    {
-      fprintf(stderr, "WARNING: color type or bit depth not as expected");
-      png_destroy_read_struct(&readStruct, &info, NULL);
-      return NULL;
-    }
-  
-  buf = malloc(*w * *h * 4);
-  unsigned char** rowPointers = malloc(sizeof(unsigned char*) * (*h));
-  int i;
-  // This causes the last row placed in the start of the buffer, 
-  // as OpenGL's assumption.
-  // i.e. OpenGL's texture driver assumes upside-down image be sent
-  for(i = 0; i < (*h); i++)
-    {
-      rowPointers[(*h) - i - 1] = &buf[i * (*w) * 4];
-    }
-  
-  png_read_image(readStruct, rowPointers);
-
-  png_destroy_read_struct(&readStruct, &info, NULL);
-  fclose(fp);
-  free(rowPointers);
-  return buf;
+  if (info->npot == TEXTURE_NPOT_PAD)
+    textured_quad_set_uv_scale(quad, (float)info->imageWidth / info->width,
+                               (float)info->imageHeight / info->height);
+  else
+    textured_quad_set_uv_scale(quad, 1.0f, 1.0f);
 }
 
-static const GLfloat vertices[] =
-  {
-    -1.0f, 1.0f, 0.0f,
-    1.0f, 1.0f, 0.0f,
-    -1.0f, -1.0f, 0.0f,
-    1.0f, -1.0f, 0.0f
-  };
-
-static const GLfloat UV[] =
-  {
-    0.0f, 1.0f,
-    1.0f, 1.0f,
-    0.0f, 0.0f,
-    1.0f, 0.0f
-  };
-
-static const GLint indices[] = 
-  {
-    0, 1, 2, 1, 3, 2
-  };
-
-int main()
+int main(int argc, char** argv)
 {
+  struct app app;
+  if (!app_init(&app, argc, argv, "Hello gl texture!", 0))
+    return -1;
 
-  if (!glfwInit())
-    {
-      fprintf( stderr, "Failed to init glfw!\n");
-      return -1;
-    }
-
-  glfwWindowHint(GLFW_FSAA_SAMPLES, 4);
-  // so sad that nouveau driver cannot provide OpenGL 3.3..
-  glfwWindowHint(GLFW_OPENGL_VERSION_MAJOR, 2);
-  glfwWindowHint(GLFW_OPENGL_VERSION_MINOR, 1);
-  //glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   int lastW = 0;
   int lastH = 0;
-  int curW = 640;
-  int curH = 480;
-  
-  GLFWwindow window = glfwCreateWindow(curW, curH, GLFW_WINDOWED, "Hello gl texture!", NULL);
-  if (window == NULL)
-    {
-      glfwTerminate();
-      fprintf( stderr, "Failed to open a window!\n");
-      fprintf( stderr, glfwErrorString(glfwGetError()));
-      fprintf( stderr, "\n");
-      return -1;
-    }
-  
-  /* obtain the OpenGL context of the newly-created window*/
-  glfwMakeContextCurrent(window);
-
-  glewExperimental = true;
-  if( glewInit() != GLEW_OK)
-    {
-      fprintf( stderr, "GLEW init failed!");
-      return -1;
-    }
-
-  if (GLEW_VERSION_2_1)
-    {
-      printf("GL 2.1: supported\n");
-    }
-
-  // ???
-  if (GLEW_VERSION_3_3)
-    {
-      printf("GL 3.3: supported\n");
-    }
+  int curW = app.options.width;
+  int curH = app.options.height;
 
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-  glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
-
-  GLuint vertexBufferHandle;
-  glGenBuffers(1, &vertexBufferHandle);
-  glBindBuffer(GL_ARRAY_BUFFER, vertexBufferHandle);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-  GLuint UVBufferHandle;
-  glGenBuffers(1, &UVBufferHandle);
-  glBindBuffer(GL_ARRAY_BUFFER, UVBufferHandle);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(UV), UV, GL_STATIC_DRAW);
-
-  GLuint indicesBufferHandle;
-  glGenBuffers(1, &indicesBufferHandle);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferHandle);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
   // load shader
   //
-  // vertex shader
-  int compilationStatus;
-  int vertexShaderHandle = glCreateShader(GL_VERTEX_SHADER);
-  char* vertexShaderCode = read_all_bytes("texture.vertex");
-  glShaderSource(vertexShaderHandle, 1, (const GLchar**)&vertexShaderCode, NULL);
-  glCompileShader(vertexShaderHandle);
-  free(vertexShaderCode);
-  glGetShaderiv(vertexShaderHandle, GL_COMPILE_STATUS, &compilationStatus);
-  if (compilationStatus != GL_TRUE)
-    {
-      fprintf(stderr, "ERROR: while compiling vertex shader.");
-      show_gl_shader_compilation_error(vertexShaderHandle);
-      return -1;
-    }
+  // texture.frag without features; programs are compiled (or fetched
+  // from the program cache) once per feature mask
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "texture.vertex", "texture.frag", NULL);
+  struct shader_variant* program = shader_variants_get(&variants, 0);
+  if (program == NULL)
+    return -1;
+  program_cache_report(&programCache);
+  GLuint programHandle = program->source.program;
 
-  // fragment shader
-  int fragShaderHandle = glCreateShader(GL_FRAGMENT_SHADER);
-  char* fragShaderCode = read_all_bytes("texture.frag");
-  glShaderSource(fragShaderHandle, 1, (const GLchar**)&fragShaderCode, NULL);
-  glCompileShader(fragShaderHandle);
-  free(fragShaderCode);
-  glGetShaderiv(fragShaderHandle, GL_COMPILE_STATUS, &compilationStatus);
-  if (compilationStatus != GL_TRUE)
-    {
-      fprintf(stderr, "ERROR: while compiling fragment shader\n");
-      show_gl_shader_compilation_error(fragShaderHandle);
-      return -1;
-    }
-  
-  // We should link shaders after compilation
-  int programHandle = glCreateProgram();
-  glAttachShader(programHandle, vertexShaderHandle);
-  glAttachShader(programHandle, fragShaderHandle);
-  glLinkProgram(programHandle);
-  glGetProgramiv(programHandle, GL_LINK_STATUS, &compilationStatus);
-  if (compilationStatus != GL_TRUE)
-    {
-      fprintf(stderr, "ERROR: while linking shader\n");
-      show_gl_linking_error(programHandle);
-      return -1;
-    }
   // Tell OpenGL to use linked shader program
   glUseProgram(programHandle);
-  GLint vertexPositionIndex = glGetAttribLocation(programHandle, "vertexPosition");
-  GLint vertexUVIndex = glGetAttribLocation(programHandle, "vertexUV");
-  GLint textureIndex = glGetUniformLocation(programHandle, "myTexture");
-  GLint backcolorIndex = glGetUniformLocation(programHandle, "backColor");
-  fprintf(stderr, "vertexPositionIndex: %d\nvertexUVIndex: %d\n", vertexPositionIndex, vertexUVIndex);
+
+  // --backend gl33 draws from a VAO, gl21 sets the attribute arrays up each frame
+  struct textured_quad quad;
+  if (!textured_quad_init(&quad, app.options.backend, programHandle))
+    return -1;
+  fprintf(stderr, "vertexPositionIndex: %d\nvertexUVIndex: %d\n", quad.positionIndex, quad.uvIndex);
 
   // load texture
-  int textureW;
-  int textureH;
-  unsigned char* textureData = load_image_new("texture.png", &textureW, &textureH);
+  //
+  // --texture FILE replaces the default image (PNG, or KTX from ktx_convert);
+  // --compressed picks the prebuilt texture.ktx; --no-pbo decodes PNGs into
+  // a malloc'ed buffer first (the old path, for comparison); --cpu-mipmaps
+  // builds a gamma-correct chain on the CPU instead of glGenerateMipmap
+  // (--mip-filter box|kaiser); --npot resample|pad|keep says what happens
+  // to images whose sides are not powers of two (--resample-filter
+  // lanczos|mitchell)
+  const char* textureFile = app_option(argc, argv, "--texture");
+  if (textureFile == NULL)
+    textureFile = app_flag(argc, argv, "--compressed") ? "texture.ktx" : "texture.png";
+  struct texture_load_options loadOptions;
+  texture_load_options_init(&loadOptions, 0);
+  loadOptions.usePbo = !app_flag(argc, argv, "--no-pbo");
+  loadOptions.cpuMipmaps = app_flag(argc, argv, "--cpu-mipmaps");
+  const char* mipFilter = app_option(argc, argv, "--mip-filter");
+  if (mipFilter != NULL && strcmp(mipFilter, "kaiser") == 0)
+    loadOptions.mip.filter = MIP_FILTER_KAISER;
+  const char* npot = app_option(argc, argv, "--npot");
+  if (npot != NULL && strcmp(npot, "pad") == 0)
+    loadOptions.npot = TEXTURE_NPOT_PAD;
+  else if (npot != NULL && strcmp(npot, "keep") == 0)
+    loadOptions.npot = TEXTURE_NPOT_KEEP;
+  const char* resampleFilter = app_option(argc, argv, "--resample-filter");
+  if (resampleFilter != NULL && strcmp(resampleFilter, "mitchell") == 0)
+    loadOptions.resampleFilter = RESAMPLE_MITCHELL;
+  if (loadOptions.cpuMipmaps || loadOptions.npot == TEXTURE_NPOT_RESAMPLE)
+    loadOptions.pool = thread_pool_create(0);
+  double loadStart = timing_now();
+  struct texture_info textureInfo;
   GLuint textureHandle;
   glGenTextures(1, &textureHandle);
   glBindTexture(GL_TEXTURE_2D, textureHandle);
-  /*
-   * See http://www.opengl.org/sdk/docs/man/xhtml/glTexImage2D.xml
-   * for more information
-   */
-  glTexImage2D(GL_TEXTURE_2D,
-               0,
-               GL_RGBA,             /* internal format */
-               textureW, textureH,  /* width & height */
-               0,                   /* border, must be 0*/
-               GL_RGBA,             /* format of the input data*/
-               GL_UNSIGNED_BYTE,    /* data type*/
-               textureData);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  free(textureData);
+  if (!load_texture_file(textureFile, &loadOptions, &textureInfo))
+    return -1;
+  printf("texture load: %dx%d in %.3f ms (%s, %d levels, %zu KiB texture memory), peak RSS %ld KiB\n",
+         textureInfo.width, textureInfo.height, (timing_now() - loadStart) * 1000.0,
+         textureInfo.path, textureInfo.levels, textureInfo.bytes / 1024, peak_rss_kb());
+  if (textureInfo.npot != TEXTURE_NPOT_KEEP)
+    printf("non-power-of-two %dx%d image %s\n", textureInfo.imageWidth, textureInfo.imageHeight,
+           textureInfo.npot == TEXTURE_NPOT_PAD ? "padded" : "resampled");
+  fit_texture(&quad, &textureInfo);
+  app_time_to_first_frame(&app, "texture load", loadStart);
+
+  // --watch DIR: edits to the shaders or the texture in DIR show up
+  // without a restart
+  struct hot_reload reload;
+  bool watching = app.options.watchDirectory != NULL
+    && hot_reload_init(&reload, app.options.watchDirectory, &programCache);
+  if (watching)
+    {
+      hot_reload_notify(&reload, &app);
+      hot_reload_add_program(&reload, &program->source);
+      hot_reload_add_texture(&reload, textureFile, &textureHandle, &textureInfo, &loadOptions);
+    }
+  if (loadOptions.pool != NULL)
+    thread_pool_destroy(loadOptions.pool);
 
   // background color of THE SQUARE!
-  glUniform3f(backcolorIndex, 195 / 255.0f, 180 / 255.0f, 218 / 255.0f);
+  glUniform3f(program->uniforms[SHADER_UNIFORM_BACK_COLOR], 195 / 255.0f, 180 / 255.0f, 218 / 255.0f);
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+  // --capture FILE writes every frame out: raw RGBA, PNG (a printf
+  // pattern such as frame_%05d.png) or Y4M (.y4m), or as --capture-format
+  // raw|png|y4m says; --capture-ring N pixel buffers are in flight
+  // (default 3), --capture-sync reads each frame with a plain glReadPixels
+  // instead, for comparison. The window size at start is captured.
+  const char* capturePath = app_option(argc, argv, "--capture");
+  struct frame_capture capture;
+  bool capturing = false;
+  if (capturePath != NULL)
+    {
+      enum capture_format format = frame_capture_guess_format(capturePath);
+      const char* captureFormat = app_option(argc, argv, "--capture-format");
+      if (captureFormat != NULL && strcmp(captureFormat, "raw") == 0)
+        format = CAPTURE_RAW;
+      else if (captureFormat != NULL && strcmp(captureFormat, "png") == 0)
+        format = CAPTURE_PNG;
+      else if (captureFormat != NULL && strcmp(captureFormat, "y4m") == 0)
+        format = CAPTURE_Y4M;
+      const char* ringOption = app_option(argc, argv, "--capture-ring");
+      app_get_size(&app, &curW, &curH);
+      capturing = frame_capture_init(&capture, capturePath, format, curW, curH,
+                                     (int)(app.options.fps > 0 ? app.options.fps : 60),
+                                     ringOption != NULL ? atoi(ringOption) : 3, 8,
+                                     app_flag(argc, argv, "--capture-sync"));
+      if (!capturing)
+        return -1;
+    }
+
+  // --profile FILE times these phases (app times "frame" and "swap")
+  int clearScope = frame_profiler_scope(&app.profiler, "clear", true);
+  int drawScope = frame_profiler_scope(&app.profiler, "draw", true);
+  int flushScope = frame_profiler_scope(&app.profiler, "flush", true);
+  int captureScope = frame_profiler_scope(&app.profiler, "capture", true);
+
   // Event processor
   while(true)
     {
-      glfwGetWindowSize(window, &curW, &curH);
+      app_get_size(&app, &curW, &curH);
       if (curW != lastW || curH != lastH)
         {
           int minDimension = min(curW, curH);
@@ -343,67 +204,72 @@ int main()
           //        minDimension, minDimension);
         }
 
-      glfwMakeContextCurrent(window);
-      
-      glClear( GL_COLOR_BUFFER_BIT );
+      if (watching && hot_reload_apply(&reload))
+        {
+          // the texture may have been replaced by one of another size
+          fit_texture(&quad, &textureInfo);
+          if (programHandle != program->source.program)
+            {
+              // a new program: uniforms start over
+              program = shader_variants_get(&variants, 0);
+              programHandle = program->source.program;
+              glUseProgram(programHandle);
+              glUniform3f(program->uniforms[SHADER_UNIFORM_BACK_COLOR], 195 / 255.0f, 180 / 255.0f, 218 / 255.0f);
+            }
+        }
 
-      // Original opengl-tutorial.org tutorial uses 0 here
-      // I don't feel it right
-      glEnableVertexAttribArray(vertexPositionIndex);
-      glBindBuffer(GL_ARRAY_BUFFER, vertexBufferHandle);
-      glVertexAttribPointer(vertexPositionIndex, 3, GL_FLOAT,
-                            GL_FALSE, 0,
-                            NULL);
-                            
-      // Original opengl-tutorial.org tutorial uses 1 here
-      // I don't feel it right
-      glEnableVertexAttribArray(vertexUVIndex);
-      glBindBuffer(GL_ARRAY_BUFFER, UVBufferHandle);
-      glVertexAttribPointer(vertexUVIndex, 2, GL_FLOAT,
-                            GL_FALSE, 0,
-                            NULL);
+      app_begin_frame(&app);
       
-      // use index buffer
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferHandle);
+      frame_profiler_begin(&app.profiler, clearScope);
+      glClear( GL_COLOR_BUFFER_BIT );
+      frame_profiler_end(&app.profiler, clearScope);
 
+      frame_profiler_begin(&app.profiler, drawScope);
       // use designeated texture
       glBindTexture(GL_TEXTURE_2D, textureHandle);
       // glBindTexture will bind texture into texture slot 0
       // so we tell GLSL that sampler should use slot 0
-      glUniform1i(textureIndex, 0);
+      glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
 
       // Draw the square according to index buffer
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
-
-      glDisableVertexAttribArray(vertexPositionIndex);
-      glDisableVertexAttribArray(vertexUVIndex);
+      textured_quad_draw(&quad);
+      frame_profiler_end(&app.profiler, drawScope);
 
+      frame_profiler_begin(&app.profiler, flushScope);
       glFlush();
+      frame_profiler_end(&app.profiler, flushScope);
 
-      glfwSwapBuffers(window);
-      
-      // Input event check
-      glfwPollEvents();
-      if (glfwGetKey(window, GLFW_KEY_ESC) )
+      // before the swap: the back buffer is undefined after it
+      if (capturing)
+        {
+          frame_profiler_begin(&app.profiler, captureScope);
+          frame_capture_frame(&capture);
+          frame_profiler_end(&app.profiler, captureScope);
+        }
+
+      if (!app_end_frame(&app))
         break;
-      if (glfwGetWindowParam(window, GLFW_CLOSE_REQUESTED))
-        break; 
     }
   
   // cleanup
   //
+  if (capturing)
+    {
+      frame_capture_finish(&capture);
+      frame_capture_report(&capture, stdout);
+      frame_capture_free(&capture);
+    }
+  if (watching)
+    hot_reload_free(&reload);
+  glDeleteTextures(1, &textureHandle);
+
   // shader cleanup
   glUseProgram(0);
-  glDetachShader(programHandle, vertexShaderHandle);
-  glDeleteShader(vertexShaderHandle);
-  glDetachShader(programHandle, fragShaderHandle);
-  glDeleteShader(fragShaderHandle);
-  glDeleteProgram(programHandle);
+  shader_variants_free(&variants);
 
   // VBO cleanup
-  glDeleteBuffers(1, &vertexBufferHandle);
-  glDeleteBuffers(1, &UVBufferHandle);
+  textured_quad_free(&quad);
 
-  glfwTerminate();
+  app_terminate(&app);
   return 0;
 }
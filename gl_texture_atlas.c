@@ -0,0 +1,217 @@
+/*
+ * Demonstrate drawing many differently textured squares out of one
+ * texture atlas (see atlas_pack.c), with one texture bind and one draw
+ * call per atlas page.
+ *
+ *   gl_texture_atlas [--atlas demo.atlas]
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "atlas.h"
+
+int min(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+/* the square of gl_texture.c; atlas_remap_uv moves it into a region */
+static const GLfloat UV[] =
+  {
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+    0.0f, 0.0f,
+    1.0f, 0.0f
+  };
+
+static const GLuint quadIndices[] =
+  {
+    0, 1, 2, 1, 3, 2
+  };
+
+/* index range drawn with one page bound */
+struct page_batch
+{
+  GLuint texture;
+  int firstIndex;
+  int indexCount;
+};
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Hello gl texture atlas!", 0))
+    return -1;
+
+  int lastW = 0;
+  int lastH = 0;
+  int curW = app.options.width;
+  int curH = app.options.height;
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+  const char* atlasFile = app_option(argc, argv, "--atlas");
+  if (atlasFile == NULL)
+    atlasFile = "demo.atlas";
+  struct atlas atlas;
+  if (!atlas_load(&atlas, atlasFile) || atlas.regionCount == 0)
+    return -1;
+  printf("atlas: %d regions on %d page(s)\n", atlas.regionCount, atlas.pageCount);
+
+  // Lay the regions out on a grid covering the whole (-1 ~ 1) square
+  int columns = (int)ceil(sqrt(atlas.regionCount));
+  int rows = (atlas.regionCount + columns - 1) / columns;
+  GLfloat cellW = 2.0f / columns;
+  GLfloat cellH = 2.0f / rows;
+  GLfloat* vertices = malloc(sizeof(GLfloat) * 3 * 4 * atlas.regionCount);
+  GLfloat* uvs = malloc(sizeof(GLfloat) * 2 * 4 * atlas.regionCount);
+  GLuint* indices = malloc(sizeof(GLuint) * 6 * atlas.regionCount);
+  struct page_batch* batches = malloc(sizeof(struct page_batch) * atlas.pageCount);
+  int quad = 0;
+  int page;
+  int i;
+  for(page = 0; page < atlas.pageCount; page++)
+    {
+      batches[page].texture = atlas.pageTextures[page];
+      batches[page].firstIndex = quad * 6;
+      for(i = 0; i < atlas.regionCount; i++)
+        {
+          const struct atlas_region* region = &atlas.regions[i];
+          if (region->page != page)
+            continue;
+          GLfloat left = -1.0f + (i % columns) * cellW;
+          GLfloat top = 1.0f - (i / columns) * cellH;
+          GLfloat corners[] =
+            {
+              left, top, 0.0f,
+              left + cellW, top, 0.0f,
+              left, top - cellH, 0.0f,
+              left + cellW, top - cellH, 0.0f
+            };
+          memcpy(&vertices[quad * 12], corners, sizeof(corners));
+          atlas_remap_uv(region, UV, &uvs[quad * 8], 4);
+          int k;
+          for(k = 0; k < 6; k++)
+            indices[quad * 6 + k] = quad * 4 + quadIndices[k];
+          quad++;
+        }
+      batches[page].indexCount = quad * 6 - batches[page].firstIndex;
+    }
+
+  GLuint vertexBufferHandle;
+  glGenBuffers(1, &vertexBufferHandle);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBufferHandle);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 12 * quad, vertices, GL_STATIC_DRAW);
+
+  GLuint UVBufferHandle;
+  glGenBuffers(1, &UVBufferHandle);
+  glBindBuffer(GL_ARRAY_BUFFER, UVBufferHandle);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 8 * quad, uvs, GL_STATIC_DRAW);
+
+  GLuint indicesBufferHandle;
+  glGenBuffers(1, &indicesBufferHandle);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferHandle);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 6 * quad, indices, GL_STATIC_DRAW);
+  free(vertices);
+  free(uvs);
+  free(indices);
+
+  // load shader
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "texture.vertex", "texture.frag", NULL);
+  struct shader_variant* program = shader_variants_get(&variants, 0);
+  if (program == NULL)
+    return -1;
+  program_cache_report(&programCache);
+  GLuint programHandle = program->source.program;
+
+  glUseProgram(programHandle);
+  GLint vertexPositionIndex = glGetAttribLocation(programHandle, "vertexPosition");
+  GLint vertexUVIndex = glGetAttribLocation(programHandle, "vertexUV");
+
+  // background color of THE SQUARES!
+  glUniform3f(program->uniforms[SHADER_UNIFORM_BACK_COLOR], 195 / 255.0f, 180 / 255.0f, 218 / 255.0f);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  // Event processor
+  while(true)
+    {
+      app_get_size(&app, &curW, &curH);
+      if (curW != lastW || curH != lastH)
+        {
+          // keep the grid square and centered, as gl_texture does
+          int minDimension = min(curW, curH);
+          lastW = curW;
+          lastH = curH;
+          glViewport((curW - minDimension) / 2, (curH - minDimension) / 2, minDimension, minDimension);
+        }
+
+      app_begin_frame(&app);
+
+      glClear( GL_COLOR_BUFFER_BIT );
+
+      glEnableVertexAttribArray(vertexPositionIndex);
+      glBindBuffer(GL_ARRAY_BUFFER, vertexBufferHandle);
+      glVertexAttribPointer(vertexPositionIndex, 3, GL_FLOAT,
+                            GL_FALSE, 0,
+                            NULL);
+
+      glEnableVertexAttribArray(vertexUVIndex);
+      glBindBuffer(GL_ARRAY_BUFFER, UVBufferHandle);
+      glVertexAttribPointer(vertexUVIndex, 2, GL_FLOAT,
+                            GL_FALSE, 0,
+                            NULL);
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesBufferHandle);
+
+      // every square on a page shares its texture: one bind, one draw
+      for(page = 0; page < atlas.pageCount; page++)
+        {
+          if (batches[page].indexCount == 0)
+            continue;
+          glBindTexture(GL_TEXTURE_2D, batches[page].texture);
+          glDrawElements(GL_TRIANGLES, batches[page].indexCount, GL_UNSIGNED_INT,
+                         (void*)(batches[page].firstIndex * sizeof(GLuint)));
+        }
+
+      glDisableVertexAttribArray(vertexPositionIndex);
+      glDisableVertexAttribArray(vertexUVIndex);
+
+      glFlush();
+
+      if (!app_end_frame(&app))
+        break;
+    }
+
+  // cleanup
+  glUseProgram(0);
+  shader_variants_free(&variants);
+
+  glDeleteBuffers(1, &vertexBufferHandle);
+  glDeleteBuffers(1, &UVBufferHandle);
+  glDeleteBuffers(1, &indicesBufferHandle);
+  atlas_free(&atlas);
+  free(batches);
+
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Demonstrate drawing thousands of textured squares per frame with one
+ * instanced draw call (see instanced_quads.c).
+ *
+ *   gl_texture_instanced [--quads N] [--path auto|instanced|expanded|separate]
+ *                        [--texture FILE]
+ *
+ * Each square wobbles on its own, so the instance data changes every
+ * frame. expanded is the GL 2.1 fallback; separate issues one draw call
+ * per square, the way gl_texture.c draws its single one.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "instanced_quads.h"
+#include "texture_file.h"
+#include "timing.h"
+
+int min(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static enum quad_path parse_path(const char* name)
+{
+  enum quad_path path;
+  for(path = QUAD_PATH_AUTO; path <= QUAD_PATH_SEPARATE; path++)
+    {
+      if (name != NULL && strcmp(name, quad_path_name(path)) == 0)
+        return path;
+    }
+  return QUAD_PATH_AUTO;
+}
+
+/* a square grid filling the viewport, tinted around texture.frag's backColor */
+static void layout_quads(struct quad_instance* quads, int count, double time)
+{
+  int columns = (int)ceil(sqrt(count));
+  float cell = 2.0f / columns;
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      struct quad_instance* q = &quads[i];
+      float phase = (float)time * 2.0f + i * 0.37f;
+      q->offset[0] = -1.0f + cell * (i % columns + 0.5f) + 0.1f * cell * sinf(phase);
+      q->offset[1] = 1.0f - cell * (i / columns + 0.5f) + 0.1f * cell * cosf(phase);
+      q->scale[0] = 0.4f * cell;
+      q->scale[1] = 0.4f * cell;
+      q->uvRect[0] = 0.0f;
+      q->uvRect[1] = 0.0f;
+      q->uvRect[2] = 1.0f;
+      q->uvRect[3] = 1.0f;
+      q->tint[0] = 195 / 255.0f;
+      q->tint[1] = (180 + (i * 7) % 60) / 255.0f;
+      q->tint[2] = 218 / 255.0f;
+      q->tint[3] = 1.0f;
+    }
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Hello gl texture instanced!", 0))
+    return -1;
+
+  const char* quadsOption = app_option(argc, argv, "--quads");
+  int quadCount = quadsOption != NULL ? atoi(quadsOption) : 10000;
+  if (quadCount < 1)
+    quadCount = 1;
+
+  int lastW = 0;
+  int lastH = 0;
+  int curW = app.options.width;
+  int curH = app.options.height;
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "instancedTexture.vertex", "texture.frag", quadAttributes);
+  struct shader_variant* program = shader_variants_get(&variants, SHADER_VERTEX_TINT);
+  if (program == NULL)
+    return -1;
+  program_cache_report(&programCache);
+  glUseProgram(program->source.program);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+
+  struct quad_renderer renderer;
+  if (!quad_renderer_init(&renderer, parse_path(app_option(argc, argv, "--path"))))
+    return -1;
+  printf("%d quads, %s path\n", quadCount, quad_path_name(renderer.path));
+
+  const char* textureFile = app_option(argc, argv, "--texture");
+  if (textureFile == NULL)
+    textureFile = "texture.png";
+  struct texture_load_options loadOptions;
+  texture_load_options_init(&loadOptions, 0);
+  struct texture_info textureInfo;
+  GLuint textureHandle;
+  glGenTextures(1, &textureHandle);
+  glBindTexture(GL_TEXTURE_2D, textureHandle);
+  if (!load_texture_file(textureFile, &loadOptions, &textureInfo))
+    return -1;
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  struct quad_instance* quads = malloc(sizeof(struct quad_instance) * quadCount);
+  double submitTime = 0;
+  app_set_frame_rate(&app, 60);
+  while(true)
+    {
+      app_get_size(&app, &curW, &curH);
+      if (curW != lastW || curH != lastH)
+        {
+          // 1:1 and centered, as in gl_texture.c
+          int minDimension = min(curW, curH);
+          lastW = curW;
+          lastH = curH;
+          glViewport((curW - minDimension) / 2, (curH - minDimension) / 2, minDimension, minDimension);
+        }
+
+      app_begin_frame(&app);
+      glClear(GL_COLOR_BUFFER_BIT);
+
+      double submitStart = timing_now();
+      layout_quads(quads, quadCount, submitStart - app.startTime);
+      glBindTexture(GL_TEXTURE_2D, textureHandle);
+      quad_renderer_draw(&renderer, quads, quadCount);
+      submitTime += timing_now() - submitStart;
+
+      glFlush();
+
+      if (!app_end_frame(&app))
+        break;
+    }
+  if (app.stats.count > 0)
+    printf("CPU time to build and submit the quads: %.3f ms per frame, %d draw call(s)\n",
+           submitTime * 1000.0 / app.stats.count, renderer.drawCalls);
+
+  free(quads);
+  quad_renderer_free(&renderer);
+  glDeleteTextures(1, &textureHandle);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Fly over an image too large for one texture through virtual_texture:
+ * the camera zooms from the whole image down to single texels and back
+ * while panning, and only the tiles it sees are loaded.
+ *
+ *   gl_virtual_texture [--cache SLOTS] [--uploads N] [directory]
+ *
+ * 'directory' is a tile set written by vt_tiler (default Trollface.tiles,
+ * built with the demos; any PNG works, e.g. a 100000 x 50000 map). The
+ * cache holds SLOTS x SLOTS tiles (default 8, 16 MiB with 256 texel
+ * tiles); it has to hold the tiles one screen shows. At most --uploads
+ * tiles (default 4) are uploaded per frame. Prints the tile traffic and
+ * texture memory at exit.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "image_loader.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "sprite_batch.h"
+#include "virtual_texture.h"
+
+/* is argv[i] the value of an option rather than the directory? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--cache", "--uploads", NULL };
+  return app_option_value(argv, i, valued);
+}
+
+static double mib(double bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+/* texture memory of the image as one mipmapped texture, were that possible */
+static double full_texture_bytes(const struct vt_layout* layout)
+{
+  return layout->width * (double)layout->height * 4.0 * 4.0 / 3.0;
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Hello gl virtual texture!", 0))
+    return -1;
+
+  const char* cacheOption = app_option(argc, argv, "--cache");
+  const char* uploadsOption = app_option(argc, argv, "--uploads");
+  const char* directory = "Trollface.tiles";
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) != 0 && !is_option_value(argv, i))
+        directory = argv[i];
+    }
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "sprite.vertex", "texture.frag", spriteAttributes);
+  struct shader_variant* program = shader_variants_get(&variants, SHADER_VERTEX_TINT | SHADER_VIRTUAL);
+  if (program == NULL)
+    return -1;
+
+  struct virtual_texture vt;
+  if (!virtual_texture_open(&vt, directory, cacheOption != NULL ? atoi(cacheOption) : 8,
+                            uploadsOption != NULL ? atoi(uploadsOption) : 4, &app))
+    return -1;
+  const struct vt_layout* layout = &vt.layout;
+  printf("virtual texture: %s, %dx%d, %d levels of %dx%d tiles, cache %dx%d tiles\n",
+         directory, layout->width, layout->height, layout->levels, layout->tileSize,
+         layout->tileSize, vt.slotsPerSide, vt.slotsPerSide);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  struct sprite_batch batch;
+  sprite_batch_init(&batch, 1);
+  long frame = 0;
+  int maxMissing = 0;
+  long missingFrames = 0;
+  // the camera moves on its own
+  app_set_frame_rate(&app, 60);
+  while(true)
+    {
+      int w;
+      int h;
+      app_get_size(&app, &w, &h);
+      glViewport(0, 0, w, h);
+      app_begin_frame(&app);
+
+      // screen pixels per image texel: from the whole image in view to
+      // two pixels per texel, on a 20 second cycle
+      double t = frame / 60.0;
+      double fit = fmin((double)w / layout->width, (double)h / layout->height);
+      double zoom = 0.5 - 0.5 * cos(t * 2.0 * M_PI / 20.0);
+      double scale = fit * pow(2.0 / fit, zoom);
+      double centerX = layout->width * (0.5 + 0.35 * zoom * sin(t * 0.37));
+      double centerY = layout->height * (0.5 + 0.35 * zoom * sin(t * 0.23));
+
+      // the part of the image on screen, in texels, and where it goes
+      double x0 = fmax(centerX - w / 2.0 / scale, 0.0);
+      double x1 = fmin(centerX + w / 2.0 / scale, layout->width);
+      double y0 = fmax(centerY - h / 2.0 / scale, 0.0);
+      double y1 = fmin(centerY + h / 2.0 / scale, layout->height);
+      float visible[4] =
+        {
+          (float)(x0 / layout->width), (float)(y0 / layout->height),
+          (float)(x1 / layout->width), (float)(y1 / layout->height)
+        };
+      virtual_texture_update(&vt, visible, (float)((x1 - x0) * scale));
+      if (vt.stats.missing > 0)
+        missingFrames++;
+      if (vt.stats.missing > maxMissing)
+        maxMissing = vt.stats.missing;
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      glUseProgram(program->source.program);
+      virtual_texture_bind(&vt, program);
+      struct sprite s =
+        {
+          program->source.program, vt.cache, 0,
+          (float)(((x0 + x1) / 2.0 - centerX) * scale * 2.0 / w),
+          (float)(((y0 + y1) / 2.0 - centerY) * scale * 2.0 / h),
+          (float)((x1 - x0) * scale * 2.0 / w), (float)((y1 - y0) * scale * 2.0 / h), 0.0f,
+          { visible[0], visible[1], visible[2] - visible[0], visible[3] - visible[1] },
+          { 0.0f, 0.0f, 0.0f, 1.0f }
+        };
+      sprite_batch_begin(&batch, SPRITE_SORT_NONE);
+      sprite_batch_submit(&batch, &s);
+      sprite_batch_end(&batch);
+      glFlush();
+      frame++;
+      if (!app_end_frame(&app))
+        break;
+    }
+
+  const struct virtual_texture_stats* stats = &vt.stats;
+  printf("virtual texture: %ld frames, %ld tile requests, %ld uploads, %ld evictions, "
+         "%ld failures, %ld page table updates\n",
+         frame, stats->requests, stats->uploads, stats->evictions, stats->failures,
+         stats->pageUpdates);
+  printf("virtual texture: %ld frames drew a coarser level somewhere (at most %d tiles)\n",
+         missingFrames, maxMissing);
+  printf("virtual texture: %.1f MiB of texture memory (%d tiles resident) for a %.1f MiB "
+         "mipmapped image; peak RSS %.1f MiB\n",
+         mib(virtual_texture_bytes(&vt)), stats->resident, mib(full_texture_bytes(layout)),
+         peak_rss_kb() / 1024.0);
+
+  sprite_batch_free(&batch);
+  virtual_texture_free(&vt);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Window-less OpenGL context (EGL, no surface) rendering into an FBO.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "headless.h"
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static EGLDisplay open_display(void)
+{
+  // Prefer the surfaceless platform: it does not need X or a DRM device,
+  // so it also works on render boxes and CI machines.
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (getPlatformDisplay != NULL && clientExtensions != NULL
+      && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") != NULL)
+    {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+      if (display != EGL_NO_DISPLAY)
+        return display;
+    }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static EGLContext create_context(const struct headless_context* ctx, EGLContext share)
+{
+  const EGLint contextAttributes[] =
+    {
+      EGL_CONTEXT_MAJOR_VERSION_KHR, ctx->glMajor,
+      EGL_CONTEXT_MINOR_VERSION_KHR, ctx->glMinor,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+      ctx->core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+      EGL_NONE
+    };
+  return eglCreateContext(ctx->display, ctx->config, share, contextAttributes);
+}
+
+bool headless_context_create(struct headless_context* ctx, int glMajor, int glMinor, bool core)
+{
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->display = open_display();
+  if (ctx->display == EGL_NO_DISPLAY)
+    {
+      fprintf(stderr, "ERROR: no EGL display available\n");
+      return false;
+    }
+
+  EGLint eglMajor;
+  EGLint eglMinor;
+  if (eglInitialize(ctx->display, &eglMajor, &eglMinor) != EGL_TRUE)
+    {
+      fprintf(stderr, "ERROR: eglInitialize failed (0x%x)\n", eglGetError());
+      return false;
+    }
+
+  const char* extensions = eglQueryString(ctx->display, EGL_EXTENSIONS);
+  if (extensions == NULL || strstr(extensions, "EGL_KHR_surfaceless_context") == NULL)
+    {
+      fprintf(stderr, "ERROR: EGL_KHR_surfaceless_context is not supported\n");
+      eglTerminate(ctx->display);
+      return false;
+    }
+
+  if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE)
+    {
+      fprintf(stderr, "ERROR: desktop OpenGL is not available through EGL\n");
+      eglTerminate(ctx->display);
+      return false;
+    }
+
+  static const EGLint configAttributes[] =
+    {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE
+    };
+  EGLConfig config;
+  EGLint configCount = 0;
+  eglChooseConfig(ctx->display, configAttributes, &config, 1, &configCount);
+
+  // Without a matching config we still can try EGL_KHR_no_config_context
+  ctx->config = configCount > 0 ? config : (EGLConfig)0;
+  ctx->glMajor = glMajor;
+  ctx->glMinor = glMinor;
+  ctx->core = core;
+  ctx->context = create_context(ctx, EGL_NO_CONTEXT);
+  if (ctx->context == EGL_NO_CONTEXT)
+    {
+      fprintf(stderr, "ERROR: cannot create GL %d.%d %s context (0x%x)\n",
+              glMajor, glMinor, core ? "core" : "compatibility", eglGetError());
+      eglTerminate(ctx->display);
+      return false;
+    }
+
+  if (eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx->context) != EGL_TRUE)
+    {
+      fprintf(stderr, "ERROR: eglMakeCurrent failed (0x%x)\n", eglGetError());
+      eglDestroyContext(ctx->display, ctx->context);
+      eglTerminate(ctx->display);
+      return false;
+    }
+  return true;
+}
+
+EGLContext headless_context_share(const struct headless_context* ctx)
+{
+  EGLContext shared = create_context(ctx, ctx->context);
+  if (shared == EGL_NO_CONTEXT)
+    fprintf(stderr, "ERROR: cannot create a shared context (0x%x)\n", eglGetError());
+  return shared;
+}
+
+bool headless_context_bind(EGLDisplay display, EGLContext context)
+{
+  // the bound API is per thread
+  eglBindAPI(EGL_OPENGL_API);
+  if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) != EGL_TRUE)
+    {
+      fprintf(stderr, "ERROR: eglMakeCurrent failed (0x%x)\n", eglGetError());
+      return false;
+    }
+  return true;
+}
+
+bool headless_framebuffer_create(struct headless_context* ctx, int width, int height, int depthBits)
+{
+  ctx->width = width;
+  ctx->height = height;
+
+  glGenFramebuffers(1, &ctx->framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, ctx->framebuffer);
+
+  glGenRenderbuffers(1, &ctx->colorRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, ctx->colorRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, ctx->colorRenderbuffer);
+
+  if (depthBits > 0)
+    {
+      glGenRenderbuffers(1, &ctx->depthRenderbuffer);
+      glBindRenderbuffer(GL_RENDERBUFFER, ctx->depthRenderbuffer);
+      glRenderbufferStorage(GL_RENDERBUFFER,
+                            depthBits > 16 ? GL_DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT16,
+                            width, height);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, ctx->depthRenderbuffer);
+    }
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+      fprintf(stderr, "ERROR: offscreen framebuffer incomplete (0x%x)\n", status);
+      return false;
+    }
+
+  // Without a surface the initial viewport is empty
+  glViewport(0, 0, width, height);
+  return true;
+}
+
+void headless_context_destroy(struct headless_context* ctx)
+{
+  if (ctx->display == EGL_NO_DISPLAY || ctx->display == NULL)
+    return;
+
+  if (ctx->framebuffer != 0)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glDeleteFramebuffers(1, &ctx->framebuffer);
+      glDeleteRenderbuffers(1, &ctx->colorRenderbuffer);
+      if (ctx->depthRenderbuffer != 0)
+        glDeleteRenderbuffers(1, &ctx->depthRenderbuffer);
+    }
+
+  eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(ctx->display, ctx->context);
+  eglTerminate(ctx->display);
+  ctx->display = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,60 @@
+/*
+ * Window-less OpenGL context (EGL, no surface) rendering into an FBO.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <EGL/egl.h>
+
+struct headless_context
+{
+  EGLDisplay display;
+  EGLContext context;
+  EGLConfig config;
+  int glMajor;
+  int glMinor;
+  bool core;
+  GLuint framebuffer;
+  GLuint colorRenderbuffer;
+  GLuint depthRenderbuffer;
+  int width;
+  int height;
+};
+
+/*
+ * Create a desktop OpenGL context without any window and make it current.
+ * Works with Mesa's surfaceless platform (llvmpipe on machines without GPU)
+ * as well as with real drivers. 'core' asks for a core profile context
+ * (3.2 and later), otherwise a compatibility one.
+ */
+bool headless_context_create(struct headless_context* ctx, int glMajor, int glMinor, bool core);
+
+/*
+ * A further context of the same version sharing textures, buffers and
+ * sync objects with ctx, for use on another thread (EGL_NO_CONTEXT on
+ * failure). Make it current there with headless_context_bind.
+ */
+EGLContext headless_context_share(const struct headless_context* ctx);
+
+/* make 'context' current on the calling thread; EGL_NO_CONTEXT releases it */
+bool headless_context_bind(EGLDisplay display, EGLContext context);
+
+/*
+ * Create the offscreen framebuffer and bind it as draw target.
+ * Must be called after glewInit, since FBO functions come from GLEW.
+ * depthBits may be 0 for a color-only framebuffer.
+ */
+bool headless_framebuffer_create(struct headless_context* ctx, int width, int height, int depthBits);
+
+void headless_context_destroy(struct headless_context* ctx);
+
+#endif
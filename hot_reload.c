@@ -0,0 +1,256 @@
+/*
+ * Watch the data directory with inotify and rebuild only what changed:
+ * the affected programs (recompiling the changed stage) and textures.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include "hot_reload.h"
+#include "timing.h"
+
+static void queue_name(struct hot_reload* reload, const char* name)
+{
+  pthread_mutex_lock(&reload->lock);
+  if (reload->nameCount == reload->nameCapacity)
+    {
+      int capacity = reload->nameCapacity == 0 ? 16 : reload->nameCapacity * 2;
+      char** names = realloc(reload->names, sizeof(char*) * capacity);
+      if (names == NULL)
+        {
+          pthread_mutex_unlock(&reload->lock);
+          return;
+        }
+      reload->names = names;
+      reload->nameCapacity = capacity;
+    }
+  reload->names[reload->nameCount++] = strdup(name);
+  __atomic_store_n(&reload->changed, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&reload->lock);
+  struct app* app = __atomic_load_n(&reload->app, __ATOMIC_ACQUIRE);
+  if (app != NULL)
+    app_request_redraw(app);
+}
+
+static void* watcher_main(void* arg)
+{
+  struct hot_reload* reload = arg;
+  // inotify_event is followed by its name; keep the buffer aligned for it
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  struct pollfd fds[2] =
+    {
+      { reload->inotifyFd, POLLIN, 0 },
+      { reload->quitPipe[0], POLLIN, 0 }
+    };
+  while(true)
+    {
+      if (poll(fds, 2, -1) < 0)
+        continue;
+      if (fds[1].revents != 0)
+        break;
+
+      ssize_t length = read(reload->inotifyFd, buffer, sizeof(buffer));
+      ssize_t offset = 0;
+      while(length > 0 && offset < length)
+        {
+          const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+          if (event->len > 0)
+            queue_name(reload, event->name);
+          offset += sizeof(struct inotify_event) + event->len;
+        }
+    }
+  return NULL;
+}
+
+bool hot_reload_init(struct hot_reload* reload, const char* directory, struct program_cache* cache)
+{
+  memset(reload, 0, sizeof(*reload));
+  reload->directory = directory;
+  reload->cache = cache;
+  reload->inotifyFd = inotify_init();
+  if (reload->inotifyFd < 0)
+    {
+      perror("inotify_init");
+      return false;
+    }
+  // whole files only: a finished write, or an editor renaming its copy in
+  if (inotify_add_watch(reload->inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+      fprintf(stderr, "ERROR: cannot watch '%s'\n", directory);
+      close(reload->inotifyFd);
+      return false;
+    }
+  if (pipe(reload->quitPipe) != 0)
+    {
+      close(reload->inotifyFd);
+      return false;
+    }
+
+  pthread_mutex_init(&reload->lock, NULL);
+  if (pthread_create(&reload->thread, NULL, watcher_main, reload) != 0)
+    {
+      fprintf(stderr, "Cannot start the file watcher thread\n");
+      pthread_mutex_destroy(&reload->lock);
+      close(reload->quitPipe[0]);
+      close(reload->quitPipe[1]);
+      close(reload->inotifyFd);
+      return false;
+    }
+  printf("watching %s for changes\n", directory);
+  return true;
+}
+
+void hot_reload_free(struct hot_reload* reload)
+{
+  if (write(reload->quitPipe[1], "q", 1) == 1)
+    pthread_join(reload->thread, NULL);
+  close(reload->quitPipe[0]);
+  close(reload->quitPipe[1]);
+  close(reload->inotifyFd);
+  pthread_mutex_destroy(&reload->lock);
+
+  int i;
+  for(i = 0; i < reload->nameCount; i++)
+    free(reload->names[i]);
+  free(reload->names);
+  free(reload->programs);
+  free(reload->textures);
+  memset(reload, 0, sizeof(*reload));
+}
+
+void hot_reload_notify(struct hot_reload* reload, struct app* app)
+{
+  // the watcher thread is already running
+  __atomic_store_n(&reload->app, app, __ATOMIC_RELEASE);
+}
+
+void hot_reload_add_program(struct hot_reload* reload, struct program_source* source)
+{
+  struct program_source** programs = realloc(reload->programs,
+                                             sizeof(struct program_source*) * (reload->programCount + 1));
+  if (programs == NULL)
+    return;
+  reload->programs = programs;
+  reload->programs[reload->programCount++] = source;
+}
+
+void hot_reload_add_texture(struct hot_reload* reload, const char* path, GLuint* texture,
+                            struct texture_info* info, const struct texture_load_options* options)
+{
+  struct hot_reload_texture* textures = realloc(reload->textures,
+                                                sizeof(struct hot_reload_texture) * (reload->textureCount + 1));
+  if (textures == NULL)
+    return;
+  reload->textures = textures;
+  struct hot_reload_texture* entry = &reload->textures[reload->textureCount++];
+  entry->path = path;
+  entry->texture = texture;
+  entry->info = info;
+  entry->options = *options;
+  // the pool usually does not live as long as the program
+  entry->options.pool = NULL;
+}
+
+/* is the file name of 'path' one of the changed names? */
+static bool changed(char** names, int count, const char* path)
+{
+  const char* slash = strrchr(path, '/');
+  const char* base = slash != NULL ? slash + 1 : path;
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      if (strcmp(names[i], base) == 0)
+        return true;
+    }
+  return false;
+}
+
+static bool reload_texture(struct hot_reload_texture* entry)
+{
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  struct texture_info info;
+  if (!load_texture_file(entry->path, &entry->options, &info))
+    {
+      glDeleteTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_2D, *entry->texture);
+      return false;
+    }
+  glDeleteTextures(1, entry->texture);
+  *entry->texture = texture;
+  if (entry->info != NULL)
+    *entry->info = info;
+  return true;
+}
+
+bool hot_reload_apply(struct hot_reload* reload)
+{
+  if (!__atomic_load_n(&reload->changed, __ATOMIC_ACQUIRE))
+    return false;
+
+  pthread_mutex_lock(&reload->lock);
+  char** names = reload->names;
+  int count = reload->nameCount;
+  reload->names = NULL;
+  reload->nameCount = 0;
+  reload->nameCapacity = 0;
+  __atomic_store_n(&reload->changed, 0, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&reload->lock);
+
+  bool replaced = false;
+  int i;
+  for(i = 0; i < reload->programCount; i++)
+    {
+      struct program_source* source = reload->programs[i];
+      bool vertexChanged = changed(names, count, source->vertexPath);
+      bool fragmentChanged = changed(names, count, source->fragmentPath);
+      if (!vertexChanged && !fragmentChanged)
+        continue;
+      if (program_cache_rebuild(reload->cache, source, vertexChanged, fragmentChanged))
+        {
+          printf("reload: %s + %s relinked in %.3f ms\n", source->vertexPath, source->fragmentPath,
+                 reload->cache->buildSeconds * 1000.0);
+          reload->reloads++;
+          replaced = true;
+        }
+      else
+        {
+          fprintf(stderr, "reload: keeping the previous %s + %s\n", source->vertexPath, source->fragmentPath);
+          reload->failures++;
+        }
+    }
+
+  for(i = 0; i < reload->textureCount; i++)
+    {
+      struct hot_reload_texture* entry = &reload->textures[i];
+      if (!changed(names, count, entry->path))
+        continue;
+      double start = timing_now();
+      if (reload_texture(entry))
+        {
+          printf("reload: %s in %.3f ms\n", entry->path, (timing_now() - start) * 1000.0);
+          reload->reloads++;
+          replaced = true;
+        }
+      else
+        {
+          fprintf(stderr, "reload: keeping the previous %s\n", entry->path);
+          reload->failures++;
+        }
+    }
+
+  for(i = 0; i < count; i++)
+    free(names[i]);
+  free(names);
+  return replaced;
+}
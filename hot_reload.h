@@ -0,0 +1,91 @@
+/*
+ * Watch the data directory with inotify and rebuild only what changed:
+ * the affected programs (recompiling the changed stage) and textures.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef HOT_RELOAD_H
+#define HOT_RELOAD_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#include "app.h"
+#include "program_cache.h"
+#include "texture_file.h"
+
+struct hot_reload_texture
+{
+  const char* path;
+  GLuint* texture;        /* the caller's handle, replaced on reload */
+  struct texture_info* info;      /* the caller's, updated on reload; may be NULL */
+  struct texture_load_options options;
+};
+
+/*
+ * A watcher thread blocks in poll() on the inotify descriptor and queues
+ * the names of files written or moved into the directory. The render
+ * thread only reads a flag per frame; nothing else happens until a
+ * watched file has changed.
+ */
+struct hot_reload
+{
+  const char* directory;
+  struct program_cache* cache;
+  int inotifyFd;
+  int quitPipe[2];
+  pthread_t thread;
+  pthread_mutex_t lock;
+  int changed;            /* atomic: names are queued */
+  struct app* app;        /* asked for a redraw on changes, may be NULL */
+  char** names;           /* queued, under lock */
+  int nameCount;
+  int nameCapacity;
+
+  struct program_source** programs;
+  int programCount;
+  struct hot_reload_texture* textures;
+  int textureCount;
+
+  int reloads;            /* programs and textures rebuilt */
+  int failures;           /* rebuilds that kept the old version */
+};
+
+/*
+ * Watch 'directory' (the one given to mapped_file_set_directory, so that
+ * reloads read the same files). Programs are rebuilt through 'cache'.
+ */
+bool hot_reload_init(struct hot_reload* reload, const char* directory, struct program_cache* cache);
+void hot_reload_free(struct hot_reload* reload);
+
+/*
+ * Wake 'app' with app_request_redraw (from the watcher thread) whenever a
+ * file changes, so an --on-demand loop gets to hot_reload_apply.
+ */
+void hot_reload_notify(struct hot_reload* reload, struct app* app);
+
+/* 'source' is rebuilt in place when one of its two files changes */
+void hot_reload_add_program(struct hot_reload* reload, struct program_source* source);
+
+/*
+ * '*texture' is replaced by a freshly loaded texture when 'path' changes,
+ * and the old one deleted; '*info' (unless NULL) then describes the new
+ * one, e.g. its size when padded. options->pool is not kept.
+ */
+void hot_reload_add_texture(struct hot_reload* reload, const char* path, GLuint* texture,
+                            struct texture_info* info, const struct texture_load_options* options);
+
+/*
+ * Call between frames on the GL thread. Rebuilds what changed since the
+ * last call and returns true if any program or texture was replaced;
+ * callers then look up uniforms again and set their values. Failures
+ * keep the previous version.
+ */
+bool hot_reload_apply(struct hot_reload* reload);
+
+#endif
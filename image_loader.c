@@ -0,0 +1,622 @@
+/*
+ * PNG loading (and saving) for textures.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <png.h>
+#include "image_loader.h"
+#include "pixel_convert.h"
+#include "mapped_file.h"
+
+/*
+ * An opened PNG file whose header has been read.
+ *
+ * libpng itself only unpacks interlacing (and, for gray / RGB images with a
+ * tRNS color key, adds the alpha channel); rows are otherwise taken as they
+ * are stored and normalized here: 16-bit samples are stripped to 8 bits,
+ * 1/2/4-bit samples unpacked, palette indices looked up, and the result
+ * converted to the requested layout by pixel_convert while being written to
+ * its flipped position.
+ *
+ * libpng reports a corrupt file by longjmp'ing to png_jmpbuf, so every
+ * function below that has libpng read sets it first and fails cleanly.
+ */
+struct png_reader
+{
+  struct mapped_file file;  /* when opened by name */
+  const char* name;         /* for messages */
+  const unsigned char* data;
+  size_t size;
+  size_t offset;            /* next byte libpng gets */
+  png_structp readStruct;
+  png_infop info;
+  int width;
+  int height;
+  int bitDepth;             /* of the rows libpng hands out: 1, 2, 4, 8 or 16 */
+  int samples;              /* per pixel in those rows */
+  int channels;             /* tightest 8-bit layout: 1 gray .. 4 RGBA */
+  bool palette;
+  bool interlaced;
+  size_t rowBytes;
+  unsigned char colors[256][4];   /* palette entries as RGBA */
+};
+
+/* hand libpng the next slice of the file; no system call involved */
+static void my_read(png_structp readStruct, png_bytep ptr, png_size_t size)
+{
+  struct png_reader* reader = png_get_io_ptr(readStruct);
+  if (size > reader->size - reader->offset)
+    png_error(readStruct, "unexpected end of file");
+  memcpy(ptr, reader->data + reader->offset, size);
+  reader->offset += size;
+}
+
+bool power_of_2(int i)
+{
+  while(true)
+    {
+      if (i == 1 || i == 2)
+        return true;
+      if (i % 2 != 0)
+        return false;
+      i /= 2;
+    }
+  return false;
+}
+
+static void png_reader_close(struct png_reader* reader)
+{
+  png_destroy_read_struct(&reader->readStruct, &reader->info, NULL);
+  mapped_file_close(&reader->file);
+}
+
+static void png_reader_read_palette(struct png_reader* reader)
+{
+  png_colorp entries = NULL;
+  int entryCount = 0;
+  png_bytep alphas = NULL;
+  int alphaCount = 0;
+  png_get_PLTE(reader->readStruct, reader->info, &entries, &entryCount);
+  if (png_get_valid(reader->readStruct, reader->info, PNG_INFO_tRNS))
+    png_get_tRNS(reader->readStruct, reader->info, &alphas, &alphaCount, NULL);
+
+  memset(reader->colors, 0, sizeof(reader->colors));
+  int i;
+  for(i = 0; i < entryCount && i < 256; i++)
+    {
+      reader->colors[i][0] = entries[i].red;
+      reader->colors[i][1] = entries[i].green;
+      reader->colors[i][2] = entries[i].blue;
+      reader->colors[i][3] = i < alphaCount ? alphas[i] : 255;
+    }
+  reader->channels = alphaCount > 0 ? 4 : 3;
+}
+
+/*
+ * Read everything up to the image data from a PNG file held in memory
+ * ('name' is for messages). Any color type and bit depth is accepted.
+ */
+static bool png_reader_open_memory(struct png_reader* reader, const unsigned char* data, size_t size,
+                                   const char* name, int* w, int* h)
+{
+  reader->data = data;
+  reader->size = size;
+  reader->offset = 8;
+  reader->name = name;
+
+  if(size < 8 || png_sig_cmp((png_bytep)data, 0, 8) != 0)
+    {
+      fprintf(stderr, "ERROR: file '%s' is not a PNG file\n", name);
+      mapped_file_close(&reader->file);
+      return false;
+    }
+
+  // libpng prints the reason itself, then jumps back here
+  reader->readStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  reader->info = NULL;
+  if (reader->readStruct == NULL)
+    {
+      mapped_file_close(&reader->file);
+      return false;
+    }
+  if (setjmp(png_jmpbuf(reader->readStruct)))
+    {
+      fprintf(stderr, "ERROR: cannot decode '%s'\n", name);
+      png_reader_close(reader);
+      return false;
+    }
+
+  reader->info = png_create_info_struct(reader->readStruct);
+
+  png_set_read_fn(reader->readStruct, reader, my_read);
+
+  png_set_sig_bytes(reader->readStruct, 8);
+
+  png_read_info(reader->readStruct, reader->info);
+
+  *w = png_get_image_width(reader->readStruct, reader->info);
+  *h = png_get_image_height(reader->readStruct, reader->info);
+
+  int colorType = png_get_color_type(reader->readStruct, reader->info);
+  reader->palette = colorType == PNG_COLOR_TYPE_PALETTE;
+  // a color key is rare enough to leave to libpng
+  if (!reader->palette && png_get_valid(reader->readStruct, reader->info, PNG_INFO_tRNS))
+    png_set_tRNS_to_alpha(reader->readStruct);
+  reader->interlaced = png_set_interlace_handling(reader->readStruct) > 1;
+  png_read_update_info(reader->readStruct, reader->info);
+
+  reader->width = *w;
+  reader->height = *h;
+  reader->bitDepth = png_get_bit_depth(reader->readStruct, reader->info);
+  reader->samples = png_get_channels(reader->readStruct, reader->info);
+  reader->rowBytes = png_get_rowbytes(reader->readStruct, reader->info);
+  reader->channels = reader->samples;
+  if (reader->palette)
+    png_reader_read_palette(reader);
+  return true;
+}
+
+/* map the file, sequential access, then as above */
+static bool png_reader_open(struct png_reader* reader, const char* filename, int* w, int* h)
+{
+  if (!mapped_file_open(&reader->file, filename, MAPPED_SEQUENTIAL))
+    return false;
+  return png_reader_open_memory(reader, reader->file.data, reader->file.size, filename, w, h);
+}
+
+/* 1/2/4-bit samples (most significant first) to one byte each */
+static void unpack_samples(const unsigned char* src, unsigned char* dst, int count,
+                           int bitDepth, bool scale)
+{
+  int perByte = 8 / bitDepth;
+  int mask = (1 << bitDepth) - 1;
+  int factor = scale ? 255 / mask : 1;
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      int shift = 8 - bitDepth * (i % perByte + 1);
+      dst[i] = ((src[i / perByte] >> shift) & mask) * factor;
+    }
+}
+
+static void expand_palette(const unsigned char* indices, unsigned char* dst, int count,
+                           const unsigned char colors[256][4], int channels)
+{
+  int i;
+  if (channels == 4)
+    {
+      for(i = 0; i < count; i++)
+        memcpy(dst + (size_t)i * 4, colors[indices[i]], 4);
+    }
+  else
+    {
+      for(i = 0; i < count; i++)
+        memcpy(dst + (size_t)i * 3, colors[indices[i]], 3);
+    }
+}
+
+/*
+ * One row as libpng handed it out ('row', of reader->rowBytes) to
+ * 'dstChannels' 8-bit channels in 'dst'. 'row8' holds w * samples bytes
+ * and 'expanded' w * 4.
+ */
+static void png_reader_convert_row(const struct png_reader* reader, const unsigned char* row,
+                                   unsigned char* dst, pixel_convert_fn convert,
+                                   unsigned char* row8, unsigned char* expanded)
+{
+  int w = reader->width;
+  if (reader->bitDepth == 16)
+    {
+      pixel_strip16(PIXEL_KERNEL_AUTO)(row, row8, w * reader->samples);
+      row = row8;
+    }
+  else if (reader->bitDepth < 8)
+    {
+      unpack_samples(row, row8, w * reader->samples, reader->bitDepth, !reader->palette);
+      row = row8;
+    }
+  if (reader->palette)
+    {
+      expand_palette(row, expanded, w, (const unsigned char (*)[4])reader->colors,
+                     reader->channels);
+      row = expanded;
+    }
+  convert(row, dst, w);
+}
+
+/*
+ * png_read_row and png_read_image, false (after a message) when libpng
+ * gives up on the file. The jump back lands in these small frames, so
+ * no caller's local can be clobbered by it.
+ */
+static bool png_reader_row(struct png_reader* reader, unsigned char* row)
+{
+  if (setjmp(png_jmpbuf(reader->readStruct)))
+    {
+      fprintf(stderr, "ERROR: cannot decode '%s'\n", reader->name);
+      return false;
+    }
+  png_read_row(reader->readStruct, row, NULL);
+  return true;
+}
+
+static bool png_reader_image(struct png_reader* reader, unsigned char** rowPointers)
+{
+  if (setjmp(png_jmpbuf(reader->readStruct)))
+    {
+      fprintf(stderr, "ERROR: cannot decode '%s'\n", reader->name);
+      return false;
+    }
+  png_read_image(reader->readStruct, rowPointers);
+  return true;
+}
+
+/*
+ * Every raw row of an interlaced image, which libpng only completes at
+ * the last pass; NULL when out of memory or the file is corrupt.
+ */
+static unsigned char* png_reader_read_interlaced(struct png_reader* reader)
+{
+  int h = reader->height;
+  unsigned char* raw = malloc(reader->rowBytes * h);
+  unsigned char** rowPointers = malloc(sizeof(unsigned char*) * h);
+  if (raw == NULL || rowPointers == NULL)
+    {
+      free(raw);
+      free(rowPointers);
+      return NULL;
+    }
+  int y;
+  for(y = 0; y < h; y++)
+    rowPointers[y] = raw + reader->rowBytes * y;
+  if (!png_reader_image(reader, rowPointers))
+    {
+      free(raw);
+      raw = NULL;
+    }
+  free(rowPointers);
+  return raw;
+}
+
+/*
+ * Decode the image as bottom-up rows of 'dstChannels' 8-bit channels,
+ * tightly packed. False when out of memory or the file is corrupt (rows
+ * may then be missing).
+ */
+static bool png_reader_read(struct png_reader* reader, unsigned char* dst, int dstChannels)
+{
+  int w = reader->width;
+  int h = reader->height;
+  size_t dstStride = (size_t)w * dstChannels;
+  pixel_convert_fn convert = pixel_converter(reader->channels, dstChannels, PIXEL_KERNEL_AUTO);
+  bool direct = reader->bitDepth == 8 && !reader->palette && reader->channels == dstChannels;
+  int y;
+
+  // This causes the last row placed in the start of the buffer,
+  // as OpenGL's assumption.
+  // i.e. OpenGL's texture driver assumes upside-down image be sent
+  if (direct && !reader->interlaced)
+    {
+      for(y = 0; y < h; y++)
+        {
+          if (!png_reader_row(reader, dst + (size_t)(h - y - 1) * dstStride))
+            return false;
+        }
+      return true;
+    }
+
+  // interlaced passes refine rows already written, so they need the whole
+  // (unconverted) image; otherwise one row at a time is enough
+  unsigned char* raw = reader->interlaced ? png_reader_read_interlaced(reader)
+                                          : malloc(reader->rowBytes);
+  unsigned char* row8 = malloc((size_t)w * reader->samples);
+  unsigned char* expanded = malloc((size_t)w * 4);
+  bool ok = raw != NULL && row8 != NULL && expanded != NULL;
+  if (ok)
+    {
+      for(y = 0; y < h; y++)
+        {
+          const unsigned char* row = raw;
+          if (reader->interlaced)
+            row += reader->rowBytes * y;
+          else if (!png_reader_row(reader, raw))
+            {
+              ok = false;
+              break;
+            }
+          png_reader_convert_row(reader, row, dst + (size_t)(h - y - 1) * dstStride, convert,
+                                 row8, expanded);
+        }
+    }
+
+  free(raw);
+  free(row8);
+  free(expanded);
+  return ok;
+}
+
+struct image_rows
+{
+  struct png_reader reader;
+  int channels;
+  pixel_convert_fn convert;
+  unsigned char* raw;       /* one row, or the whole image when interlaced */
+  unsigned char* row8;
+  unsigned char* expanded;
+  int next;                 /* rows handed out so far */
+};
+
+struct image_rows* image_rows_open(const char* filename, int channels, int* w, int* h)
+{
+  struct image_rows* rows = calloc(1, sizeof(*rows));
+  if (rows == NULL)
+    return NULL;
+  if (!png_reader_open(&rows->reader, filename, w, h))
+    {
+      free(rows);
+      return NULL;
+    }
+  struct png_reader* reader = &rows->reader;
+  rows->channels = channels;
+  rows->convert = pixel_converter(reader->channels, channels, PIXEL_KERNEL_AUTO);
+  rows->raw = reader->interlaced ? png_reader_read_interlaced(reader) : malloc(reader->rowBytes);
+  rows->row8 = malloc((size_t)reader->width * reader->samples);
+  rows->expanded = malloc((size_t)reader->width * 4);
+  if (rows->raw == NULL || rows->row8 == NULL || rows->expanded == NULL)
+    {
+      image_rows_close(rows);
+      return NULL;
+    }
+  return rows;
+}
+
+bool image_rows_read(struct image_rows* rows, unsigned char* dst)
+{
+  struct png_reader* reader = &rows->reader;
+  if (rows->next == reader->height)
+    return false;
+  const unsigned char* row = rows->raw;
+  if (reader->interlaced)
+    row += reader->rowBytes * rows->next;
+  else if (!png_reader_row(reader, rows->raw))
+    {
+      // no more rows: the decoder's state is undefined now
+      rows->next = reader->height;
+      return false;
+    }
+  png_reader_convert_row(reader, row, dst, rows->convert, rows->row8, rows->expanded);
+  rows->next++;
+  return true;
+}
+
+void image_rows_close(struct image_rows* rows)
+{
+  if (rows == NULL)
+    return;
+  png_reader_close(&rows->reader);
+  free(rows->raw);
+  free(rows->row8);
+  free(rows->expanded);
+  free(rows);
+}
+
+static unsigned char* read_image(struct png_reader* reader, int channels, int* outChannels)
+{
+  if (channels <= 0)
+    channels = reader->channels;
+
+  unsigned char* buf = malloc((size_t)reader->width * reader->height * channels);
+  if (buf != NULL && !png_reader_read(reader, buf, channels))
+    {
+      free(buf);
+      buf = NULL;
+    }
+  png_reader_close(reader);
+  if (outChannels != NULL)
+    *outChannels = channels;
+  return buf;
+}
+
+unsigned char* load_image(const char* filename, int channels, int* w, int* h, int* outChannels)
+{
+  struct png_reader reader;
+  if (!png_reader_open(&reader, filename, w, h))
+    return NULL;
+  return read_image(&reader, channels, outChannels);
+}
+
+unsigned char* load_image_memory(const unsigned char* data, size_t size, const char* name,
+                                 int channels, int* w, int* h, int* outChannels)
+{
+  struct png_reader reader;
+  memset(&reader.file, 0, sizeof(reader.file));
+  if (!png_reader_open_memory(&reader, data, size, name, w, h))
+    return NULL;
+  return read_image(&reader, channels, outChannels);
+}
+
+bool image_size(const char* filename, int* w, int* h)
+{
+  struct png_reader reader;
+  if (!png_reader_open(&reader, filename, w, h))
+    return false;
+  png_reader_close(&reader);
+  return true;
+}
+
+unsigned char* load_image_new(const char* filename, int* w, int* h)
+{
+  return load_image(filename, 4, w, h, NULL);
+}
+
+unsigned char* load_image_new_gray(const char* filename, int* w, int* h)
+{
+  return load_image(filename, 1, w, h, NULL);
+}
+
+GLenum image_gl_format(int channels)
+{
+  static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+  return formats[channels - 1];
+}
+
+bool save_image_png(const char* filename, const unsigned char* pixels,
+                    int w, int h, int channels)
+{
+  static const int colorTypes[] =
+    {
+      PNG_COLOR_TYPE_GRAY, PNG_COLOR_TYPE_GRAY_ALPHA,
+      PNG_COLOR_TYPE_RGB, PNG_COLOR_TYPE_RGB_ALPHA
+    };
+  if (channels < 1 || channels > 4)
+    return false;
+
+  FILE* fp = fopen(filename, "wb");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot write '%s'\n", filename);
+      return false;
+    }
+
+  png_structp writeStruct = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png_create_info_struct(writeStruct);
+  png_init_io(writeStruct, fp);
+  png_set_IHDR(writeStruct, info, w, h, 8, colorTypes[channels - 1],
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(writeStruct, info);
+
+  // PNG stores the top row first
+  int i;
+  for(i = 0; i < h; i++)
+    {
+      png_write_row(writeStruct, (png_bytep)&pixels[(size_t)(h - i - 1) * w * channels]);
+    }
+
+  png_write_end(writeStruct, NULL);
+  png_destroy_write_struct(&writeStruct, &info);
+  return fclose(fp) == 0;
+}
+
+/*
+ * Decode into a freshly created pixel unpack buffer, which is left bound.
+ */
+static bool load_image_pbo(const char* filename, int* channels, GLuint* pbo, int* w, int* h)
+{
+  struct png_reader reader;
+  if (!png_reader_open(&reader, filename, w, h))
+    return false;
+  if (*channels <= 0)
+    *channels = reader.channels;
+
+  size_t size = (size_t)*w * *h * *channels;
+  glGenBuffers(1, pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, *pbo);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+  // every byte is written exactly once (interlaced passes are combined in
+  // client memory), so the mapping can be write-only
+  unsigned char* mapped;
+  if (GLEW_ARB_map_buffer_range)
+    mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  else
+    mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+
+  if (mapped == NULL)
+    {
+      fprintf(stderr, "WARNING: cannot map pixel buffer for '%s'\n", filename);
+      png_reader_close(&reader);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      glDeleteBuffers(1, pbo);
+      return false;
+    }
+
+  // Same bottom-up order as load_image_new, without any row pointer table
+  bool decoded = png_reader_read(&reader, mapped, *channels);
+
+  png_reader_close(&reader);
+  if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE || !decoded)
+    {
+      // buffer contents were lost (e.g. mode switch) or the file is
+      // corrupt; caller falls back
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      glDeleteBuffers(1, pbo);
+      return false;
+    }
+  return true;
+}
+
+/* show 1 / 2 channel textures as gray / gray + alpha to the shaders */
+static void set_gray_swizzle(int channels)
+{
+  GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, channels == 2 ? GL_GREEN : GL_ONE };
+  glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+bool load_texture_image(const char* filename, int* channels, bool usePbo, int* w, int* h)
+{
+  // the tightest layout is only usable if the texture can be swizzled
+  // back into what the shaders expect
+  bool tightest = *channels <= 0;
+  if (tightest && !(GLEW_VERSION_3_3 || GLEW_ARB_texture_swizzle))
+    *channels = 4;
+  int requested = *channels;
+
+  // rows of a gray image are not necessarily 4-byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  GLuint pbo = 0;
+  if (usePbo && GLEW_ARB_pixel_buffer_object
+      && load_image_pbo(filename, channels, &pbo, w, h))
+    {
+      GLenum format = image_gl_format(*channels);
+      // With a bound unpack buffer the last parameter is an offset into it,
+      // and the driver copies (or DMAs) from there on its own schedule.
+      glTexImage2D(GL_TEXTURE_2D, 0, format, *w, *h, 0, format, GL_UNSIGNED_BYTE, NULL);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      // storage is released once the pending transfer is done
+      glDeleteBuffers(1, &pbo);
+      if (tightest && *channels <= 2)
+        set_gray_swizzle(*channels);
+      return true;
+    }
+
+  unsigned char* textureData = load_image(filename, requested, w, h, channels);
+  if (textureData == NULL)
+    return false;
+  GLenum format = image_gl_format(*channels);
+
+  /*
+   * See http://www.opengl.org/sdk/docs/man/xhtml/glTexImage2D.xml
+   * for more information
+   */
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               format,              /* internal format */
+               *w, *h,              /* width & height */
+               0,                   /* border, must be 0*/
+               format,              /* format of the input data*/
+               GL_UNSIGNED_BYTE,    /* data type*/
+               textureData);
+  free(textureData);
+  if (tightest && *channels <= 2)
+    set_gray_swizzle(*channels);
+  return true;
+}
+
+long peak_rss_kb(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
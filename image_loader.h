@@ -0,0 +1,81 @@
+/*
+ * PNG loading (and saving) for textures.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+
+bool power_of_2(int i);
+
+/*
+ * Decode a PNG of any color type (gray, gray + alpha, RGB, RGBA, palette)
+ * and bit depth (1 to 16) into a malloc'ed buffer of 8-bit pixels with
+ * 'channels' channels, last row first as OpenGL expects. channels <= 0
+ * picks the tightest layout that loses nothing (palette: RGB or RGBA);
+ * outChannels (may be NULL) receives the layout used.
+ */
+unsigned char* load_image(const char* filename, int channels, int* w, int* h, int* outChannels);
+
+/* same for a PNG file already in memory; 'name' is only used in messages */
+unsigned char* load_image_memory(const unsigned char* data, size_t size, const char* name,
+                                 int channels, int* w, int* h, int* outChannels);
+
+/*
+ * Decode a PNG one row at a time, top row first (the order of the file),
+ * for images too large to hold: 'channels' (1 to 4) as for load_image.
+ * Only a row is buffered, except for interlaced files, whose raw rows are
+ * all kept (each pass refines rows read before). image_rows_read writes
+ * w * channels bytes and returns false after the last row, or when the
+ * file turns out to be corrupt.
+ */
+struct image_rows;
+struct image_rows* image_rows_open(const char* filename, int channels, int* w, int* h);
+bool image_rows_read(struct image_rows* rows, unsigned char* dst);
+void image_rows_close(struct image_rows* rows);
+
+/* only the dimensions, from the header */
+bool image_size(const char* filename, int* w, int* h);
+
+/* load_image as RGBA (load_image_new) or as gray (load_image_new_gray) */
+unsigned char* load_image_new(const char* filename, int* w, int* h);
+unsigned char* load_image_new_gray(const char* filename, int* w, int* h);
+
+/* GL_RED, GL_RG, GL_RGB or GL_RGBA for 1 to 4 channels */
+GLenum image_gl_format(int channels);
+
+/*
+ * Write 8-bit pixels with 1 (gray), 2 (gray+alpha), 3 (RGB) or 4 (RGBA)
+ * channels. 'pixels' is bottom-up, like everything handed to OpenGL.
+ */
+bool save_image_png(const char* filename, const unsigned char* pixels,
+                    int w, int h, int channels);
+
+/*
+ * Load a PNG into level 0 of the currently bound GL_TEXTURE_2D.
+ * *channels is 1 to 4 (1: gray, stored in the red channel), or 0 for the
+ * tightest layout, in which case gray and gray + alpha textures get a
+ * swizzle so that they sample as (g, g, g, 1) and (g, g, g, a); *channels
+ * receives the layout used.
+ *
+ * With usePbo, rows are decoded one by one straight into a mapped
+ * GL_PIXEL_UNPACK_BUFFER, so no full-size copy ever exists in client memory
+ * and glTexImage2D only schedules a transfer out of the buffer object.
+ * Without it (or when the driver has no PBO support) the image goes through
+ * load_image.
+ */
+bool load_texture_image(const char* filename, int* channels, bool usePbo, int* w, int* h);
+
+/* peak resident set size of this process so far, in KiB */
+long peak_rss_kb(void);
+
+#endif
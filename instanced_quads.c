@@ -0,0 +1,246 @@
+/*
+ * Many textured quads per frame: one instanced draw call, with fallbacks
+ * for GL 2.1 contexts.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "instanced_quads.h"
+
+enum
+{
+  ATTRIBUTE_POSITION,
+  ATTRIBUTE_UV,
+  ATTRIBUTE_RECT,         /* offset.xy, scale.xy */
+  ATTRIBUTE_UV_RECT,
+  ATTRIBUTE_TINT
+};
+
+const char* const quadAttributes[] =
+  {
+    "vertexPosition", "vertexUV", "instanceRect", "instanceUVRect", "instanceTint", NULL
+  };
+
+/* the square of gl_texture.c: position and UV of each corner */
+static const GLfloat quadVertices[] =
+  {
+    -1.0f, 1.0f, 0.0f, 1.0f,
+    1.0f, 1.0f, 1.0f, 1.0f,
+    -1.0f, -1.0f, 0.0f, 0.0f,
+    1.0f, -1.0f, 1.0f, 0.0f
+  };
+
+static const GLushort quadIndices[] =
+  {
+    0, 1, 2, 1, 3, 2
+  };
+
+/* expanded vertices: position, UV, tint */
+#define EXPANDED_FLOATS 8
+
+bool quad_path_supported(enum quad_path path)
+{
+  if (path == QUAD_PATH_INSTANCED)
+    return GLEW_VERSION_3_3 || (GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced);
+  return true;
+}
+
+const char* quad_path_name(enum quad_path path)
+{
+  static const char* const names[] = { "auto", "instanced", "expanded", "separate" };
+  return names[path];
+}
+
+bool quad_renderer_init(struct quad_renderer* renderer, enum quad_path path)
+{
+  memset(renderer, 0, sizeof(*renderer));
+  if (path == QUAD_PATH_AUTO)
+    path = quad_path_supported(QUAD_PATH_INSTANCED) ? QUAD_PATH_INSTANCED : QUAD_PATH_EXPANDED;
+  if (!quad_path_supported(path))
+    {
+      fprintf(stderr, "ERROR: this context cannot draw quads the %s way\n", quad_path_name(path));
+      return false;
+    }
+  renderer->path = path;
+  renderer->arbInstancing = !GLEW_VERSION_3_3;
+
+  glGenBuffers(1, &renderer->quadBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->quadBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+  glGenBuffers(1, &renderer->quadIndices);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->quadIndices);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadIndices), quadIndices, GL_STATIC_DRAW);
+  glGenBuffers(1, &renderer->streamBuffer);
+  return true;
+}
+
+void quad_renderer_free(struct quad_renderer* renderer)
+{
+  glDeleteBuffers(1, &renderer->quadBuffer);
+  glDeleteBuffers(1, &renderer->quadIndices);
+  glDeleteBuffers(1, &renderer->streamBuffer);
+  if (renderer->expandedIndices != 0)
+    glDeleteBuffers(1, &renderer->expandedIndices);
+  free(renderer->scratch);
+  memset(renderer, 0, sizeof(*renderer));
+}
+
+static void set_divisor(const struct quad_renderer* renderer, GLuint index, GLuint divisor)
+{
+  if (renderer->arbInstancing)
+    glVertexAttribDivisorARB(index, divisor);
+  else
+    glVertexAttribDivisor(index, divisor);
+}
+
+static void bind_unit_quad(const struct quad_renderer* renderer)
+{
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->quadBuffer);
+  glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), NULL);
+  glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+                        (void*)(2 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+  glEnableVertexAttribArray(ATTRIBUTE_UV);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->quadIndices);
+}
+
+static void draw_instanced(struct quad_renderer* renderer, const struct quad_instance* instances, int count)
+{
+  bind_unit_quad(renderer);
+
+  // a fresh store every frame: the driver need not wait for the last one
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->streamBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(struct quad_instance) * count, instances, GL_STREAM_DRAW);
+  GLsizei stride = sizeof(struct quad_instance);
+  glVertexAttribPointer(ATTRIBUTE_RECT, 4, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(struct quad_instance, offset));
+  glVertexAttribPointer(ATTRIBUTE_UV_RECT, 4, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(struct quad_instance, uvRect));
+  glVertexAttribPointer(ATTRIBUTE_TINT, 4, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(struct quad_instance, tint));
+  GLuint index;
+  for(index = ATTRIBUTE_RECT; index <= ATTRIBUTE_TINT; index++)
+    {
+      glEnableVertexAttribArray(index);
+      set_divisor(renderer, index, 1);
+    }
+
+  if (renderer->arbInstancing)
+    glDrawElementsInstancedARB(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL, count);
+  else
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL, count);
+  renderer->drawCalls = 1;
+
+  // divisors are not reset by disabling; other code expects them at 0
+  for(index = ATTRIBUTE_RECT; index <= ATTRIBUTE_TINT; index++)
+    {
+      set_divisor(renderer, index, 0);
+      glDisableVertexAttribArray(index);
+    }
+}
+
+static void grow_expanded(struct quad_renderer* renderer, int count)
+{
+  if (count <= renderer->expandedCapacity)
+    return;
+  int capacity = renderer->expandedCapacity > 0 ? renderer->expandedCapacity : 1024;
+  while(capacity < count)
+    capacity *= 2;
+
+  GLuint* indices = malloc(sizeof(GLuint) * 6 * capacity);
+  int i;
+  int j;
+  for(i = 0; i < capacity; i++)
+    {
+      for(j = 0; j < 6; j++)
+        indices[i * 6 + j] = i * 4 + quadIndices[j];
+    }
+  if (renderer->expandedIndices == 0)
+    glGenBuffers(1, &renderer->expandedIndices);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->expandedIndices);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 6 * capacity, indices, GL_STATIC_DRAW);
+  free(indices);
+
+  free(renderer->scratch);
+  renderer->scratch = malloc(sizeof(GLfloat) * EXPANDED_FLOATS * 4 * capacity);
+  renderer->expandedCapacity = capacity;
+}
+
+static void draw_expanded(struct quad_renderer* renderer, const struct quad_instance* instances, int count)
+{
+  grow_expanded(renderer, count);
+  GLfloat* out = renderer->scratch;
+  int i;
+  int corner;
+  for(i = 0; i < count; i++)
+    {
+      const struct quad_instance* q = &instances[i];
+      for(corner = 0; corner < 4; corner++)
+        {
+          const GLfloat* v = &quadVertices[corner * 4];
+          out[0] = v[0] * q->scale[0] + q->offset[0];
+          out[1] = v[1] * q->scale[1] + q->offset[1];
+          out[2] = q->uvRect[0] + v[2] * q->uvRect[2];
+          out[3] = q->uvRect[1] + v[3] * q->uvRect[3];
+          memcpy(&out[4], q->tint, sizeof(q->tint));
+          out += EXPANDED_FLOATS;
+        }
+    }
+
+  glBindBuffer(GL_ARRAY_BUFFER, renderer->streamBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * EXPANDED_FLOATS * 4 * count,
+               renderer->scratch, GL_STREAM_DRAW);
+  GLsizei stride = EXPANDED_FLOATS * sizeof(GLfloat);
+  glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, stride, NULL);
+  glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(GLfloat)));
+  glVertexAttribPointer(ATTRIBUTE_TINT, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+  glEnableVertexAttribArray(ATTRIBUTE_UV);
+  glEnableVertexAttribArray(ATTRIBUTE_TINT);
+  // positions and UVs are final already: identity rectangles
+  glVertexAttrib4f(ATTRIBUTE_RECT, 0.0f, 0.0f, 1.0f, 1.0f);
+  glVertexAttrib4f(ATTRIBUTE_UV_RECT, 0.0f, 0.0f, 1.0f, 1.0f);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->expandedIndices);
+  glDrawElements(GL_TRIANGLES, 6 * count, GL_UNSIGNED_INT, NULL);
+  renderer->drawCalls = 1;
+  glDisableVertexAttribArray(ATTRIBUTE_TINT);
+}
+
+static void draw_separate(struct quad_renderer* renderer, const struct quad_instance* instances, int count)
+{
+  bind_unit_quad(renderer);
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      // offset and scale are adjacent: one vec4
+      glVertexAttrib4fv(ATTRIBUTE_RECT, instances[i].offset);
+      glVertexAttrib4fv(ATTRIBUTE_UV_RECT, instances[i].uvRect);
+      glVertexAttrib4fv(ATTRIBUTE_TINT, instances[i].tint);
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL);
+    }
+  renderer->drawCalls = count;
+}
+
+void quad_renderer_draw(struct quad_renderer* renderer, const struct quad_instance* instances, int count)
+{
+  renderer->drawCalls = 0;
+  if (count <= 0)
+    return;
+  if (renderer->path == QUAD_PATH_INSTANCED)
+    draw_instanced(renderer, instances, count);
+  else if (renderer->path == QUAD_PATH_EXPANDED)
+    draw_expanded(renderer, instances, count);
+  else
+    draw_separate(renderer, instances, count);
+  glDisableVertexAttribArray(ATTRIBUTE_POSITION);
+  glDisableVertexAttribArray(ATTRIBUTE_UV);
+}
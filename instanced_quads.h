@@ -0,0 +1,71 @@
+/*
+ * Many textured quads per frame: one instanced draw call, with fallbacks
+ * for GL 2.1 contexts.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef INSTANCED_QUADS_H
+#define INSTANCED_QUADS_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+
+/*
+ * One quad: the unit square (-1..1) scaled, then moved, in clip space.
+ * 'tint' replaces the backColor uniform of texture.frag, shining through
+ * where the texture is transparent; its alpha is the quad's alpha.
+ */
+struct quad_instance
+{
+  GLfloat offset[2];
+  GLfloat scale[2];
+  GLfloat uvRect[4];      /* u0, v0, width, height */
+  GLfloat tint[4];
+};
+
+enum quad_path
+{
+  QUAD_PATH_AUTO,
+  QUAD_PATH_INSTANCED,    /* per-instance attributes, glDrawElementsInstanced */
+  QUAD_PATH_EXPANDED,     /* GL 2.1: four vertices per quad built on the CPU, one draw */
+  QUAD_PATH_SEPARATE      /* one glDrawElements per quad, like gl_texture.c */
+};
+
+/*
+ * Attribute names of instancedTexture.vertex in location order; pass them
+ * as program_source.attributes so every path finds them where it expects.
+ */
+extern const char* const quadAttributes[];
+
+struct quad_renderer
+{
+  enum quad_path path;
+  bool arbInstancing;     /* ARB_instanced_arrays entry points, not GL 3.3 core */
+  GLuint quadBuffer;      /* unit square: position + UV, interleaved */
+  GLuint quadIndices;
+  GLuint streamBuffer;    /* instances, or expanded vertices */
+  GLuint expandedIndices;
+  int expandedCapacity;   /* quads covered by expandedIndices */
+  GLfloat* scratch;       /* CPU side of the expanded vertices */
+  int drawCalls;          /* in the last quad_renderer_draw */
+};
+
+bool quad_path_supported(enum quad_path path);
+const char* quad_path_name(enum quad_path path);
+
+/* QUAD_PATH_AUTO picks the instanced path when the context has it */
+bool quad_renderer_init(struct quad_renderer* renderer, enum quad_path path);
+void quad_renderer_free(struct quad_renderer* renderer);
+
+/*
+ * Draw 'count' quads with the currently used program (built with
+ * quadAttributes) and the currently bound texture.
+ */
+void quad_renderer_draw(struct quad_renderer* renderer, const struct quad_instance* instances, int count);
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * KTX (version 1.1) files holding block-compressed 2D textures.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ktx.h"
+#include "mapped_file.h"
+
+static const unsigned char ktxIdentifier[12] =
+  {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+  };
+
+struct ktx_header
+{
+  unsigned char identifier[12];
+  uint32_t endianness;
+  uint32_t glType;
+  uint32_t glTypeSize;
+  uint32_t glFormat;
+  uint32_t glInternalFormat;
+  uint32_t glBaseInternalFormat;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t numberOfArrayElements;
+  uint32_t numberOfFaces;
+  uint32_t numberOfMipmapLevels;
+  uint32_t bytesOfKeyValueData;
+};
+
+static int max_int(int a, int b)
+{
+  return a > b ? a : b;
+}
+
+bool ktx_write(const char* path, GLenum internalFormat, GLenum baseFormat,
+               int width, int height, const struct ktx_writer_level* levels, int levelCount)
+{
+  struct ktx_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.identifier, ktxIdentifier, sizeof(ktxIdentifier));
+  header.endianness = 0x04030201;
+  header.glTypeSize = 1;                  // compressed: type and format are 0
+  header.glInternalFormat = internalFormat;
+  header.glBaseInternalFormat = baseFormat;
+  header.pixelWidth = width;
+  header.pixelHeight = height;
+  header.numberOfFaces = 1;
+  header.numberOfMipmapLevels = levelCount;
+
+  FILE* fp = fopen(path, "wb");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot write '%s'\n", path);
+      return false;
+    }
+
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  int i;
+  for(i = 0; i < levelCount && ok; i++)
+    {
+      static const unsigned char padding[3] = { 0, 0, 0 };
+      uint32_t size = levels[i].size;
+      ok = fwrite(&size, sizeof(size), 1, fp) == 1
+        && fwrite(levels[i].data, 1, size, fp) == size
+        && fwrite(padding, 1, (4 - size % 4) % 4, fp) == (4 - size % 4) % 4;
+    }
+  if (fclose(fp) != 0)
+    ok = false;
+  return ok;
+}
+
+bool ktx_format_supported(GLenum internalFormat)
+{
+  switch(internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      return GLEW_EXT_texture_compression_s3tc;
+    case GL_COMPRESSED_RED_RGTC1:
+      return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_R11_EAC:
+      return GLEW_ARB_ES3_compatibility;
+    default:
+      return false;
+    }
+}
+
+/* walk the level table of a mapped file; levels may be NULL to only validate */
+static bool parse_levels(const unsigned char* data, size_t fileSize, const struct ktx_header* header,
+                         struct ktx_level* levels)
+{
+  size_t offset = sizeof(struct ktx_header) + header->bytesOfKeyValueData;
+  int w = header->pixelWidth;
+  int h = header->pixelHeight;
+  uint32_t i;
+  for(i = 0; i < header->numberOfMipmapLevels; i++)
+    {
+      uint32_t size;
+      if (offset + sizeof(size) > fileSize)
+        return false;
+      memcpy(&size, data + offset, sizeof(size));
+      offset += sizeof(size);
+      if (offset + size > fileSize)
+        return false;
+      if (levels != NULL)
+        {
+          levels[i].data = data + offset;
+          levels[i].size = size;
+          levels[i].width = w;
+          levels[i].height = h;
+        }
+      offset += size + (4 - size % 4) % 4;
+      w = max_int(w / 2, 1);
+      h = max_int(h / 2, 1);
+    }
+  return true;
+}
+
+bool ktx_load_texture(const char* path, int* w, int* h, int* levelCount, size_t* bytes)
+{
+  // every byte is read exactly once, front to back
+  struct mapped_file file;
+  if (!mapped_file_open(&file, path, MAPPED_SEQUENTIAL))
+    return false;
+  if (file.size < sizeof(struct ktx_header))
+    {
+      fprintf(stderr, "ERROR: '%s' is too small to be a KTX file\n", path);
+      mapped_file_close(&file);
+      return false;
+    }
+  const unsigned char* data = file.data;
+  size_t fileSize = file.size;
+
+  struct ktx_header header;
+  memcpy(&header, data, sizeof(header));
+  bool ok = true;
+  if (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0
+      || header.endianness != 0x04030201)
+    {
+      fprintf(stderr, "ERROR: '%s' is not a (little endian) KTX file\n", path);
+      ok = false;
+    }
+  else if (header.glFormat != 0 || header.pixelDepth > 1 || header.numberOfFaces != 1
+           || header.numberOfArrayElements != 0 || header.numberOfMipmapLevels == 0
+           || header.numberOfMipmapLevels > 32)
+    {
+      fprintf(stderr, "ERROR: '%s' is not a compressed 2D texture\n", path);
+      ok = false;
+    }
+  else if (!ktx_format_supported(header.glInternalFormat))
+    {
+      fprintf(stderr, "ERROR: '%s' uses format 0x%x, not supported by this GL\n",
+              path, header.glInternalFormat);
+      ok = false;
+    }
+
+  struct ktx_level levels[32];
+  if (ok && !parse_levels(data, fileSize, &header, levels))
+    {
+      fprintf(stderr, "ERROR: '%s' is truncated\n", path);
+      ok = false;
+    }
+
+  if (ok)
+    {
+      *w = header.pixelWidth;
+      *h = header.pixelHeight;
+      *levelCount = header.numberOfMipmapLevels;
+      *bytes = 0;
+      uint32_t i;
+      for(i = 0; i < header.numberOfMipmapLevels; i++)
+        {
+          glCompressedTexImage2D(GL_TEXTURE_2D, i, header.glInternalFormat,
+                                 levels[i].width, levels[i].height, 0,
+                                 levels[i].size, levels[i].data);
+          *bytes += levels[i].size;
+        }
+      // a chain that stops early is still complete with MAX_LEVEL set
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.numberOfMipmapLevels - 1);
+    }
+
+  mapped_file_close(&file);
+  return ok;
+}
@@ -0,0 +1,51 @@
+/*
+ * KTX (version 1.1) files holding block-compressed 2D textures.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef KTX_H
+#define KTX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <GL/glew.h>
+
+struct ktx_level
+{
+  const unsigned char* data;
+  uint32_t size;
+  int width;
+  int height;
+};
+
+struct ktx_writer_level
+{
+  const unsigned char* data;
+  uint32_t size;
+};
+
+/*
+ * Write a compressed 2D texture with 'levelCount' mip levels (level 0 is
+ * width x height, each next one halves, down to 1x1 at most).
+ * Level data must already be in GL's bottom-up row order.
+ */
+bool ktx_write(const char* path, GLenum internalFormat, GLenum baseFormat,
+               int width, int height, const struct ktx_writer_level* levels, int levelCount);
+
+/*
+ * Memory-map 'path' and upload every level to the currently bound
+ * GL_TEXTURE_2D with glCompressedTexImage2D. The mapping is released
+ * before returning. 'bytes' receives the total size of all levels.
+ */
+bool ktx_load_texture(const char* path, int* w, int* h, int* levelCount, size_t* bytes);
+
+/* can this context sample the format stored in a KTX file? */
+bool ktx_format_supported(GLenum internalFormat);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Offline converter: PNG -> KTX with a block-compressed full mip chain.
+ *
+ *   ktx_convert [--format auto|bc1|bc3|bc4] [--filter box|kaiser] [--linear]
+ *               input.png output.ktx
+ *
+ * auto picks BC4 for gray images, BC3 when any texel is not fully opaque
+ * and BC1 otherwise. Compared to an RGBA8 texture with mipmaps this is
+ * 8x (BC1, BC4 vs. R8: 2x) / 4x (BC3) less texture memory, and the program
+ * neither decodes PNG nor runs glGenerateMipmap at startup.
+ *
+ * Mip levels come from mip_chain_build (premultiplied, linear light);
+ * --linear skips the sRGB decode for textures that hold data, not color.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "image_loader.h"
+#include "block_compress.h"
+#include "ktx.h"
+#include "mipmap.h"
+#include "thread_pool.h"
+
+static bool is_gray(const unsigned char* rgba, size_t count)
+{
+  size_t i;
+  for(i = 0; i < count; i++)
+    {
+      const unsigned char* p = &rgba[i * 4];
+      if (p[0] != p[1] || p[1] != p[2] || p[3] != 255)
+        return false;
+    }
+  return true;
+}
+
+static bool is_opaque(const unsigned char* rgba, size_t count)
+{
+  size_t i;
+  for(i = 0; i < count; i++)
+    {
+      if (rgba[i * 4 + 3] != 255)
+        return false;
+    }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  const char* formatName = "auto";
+  struct mip_options mipOptions = { MIP_FILTER_BOX, MIP_KERNEL_AUTO, true };
+  int first = 1;
+  while(first < argc && strncmp(argv[first], "--", 2) == 0)
+    {
+      if (strcmp(argv[first], "--format") == 0 && first + 1 < argc)
+        {
+          formatName = argv[first + 1];
+          first += 2;
+        }
+      else if (strcmp(argv[first], "--filter") == 0 && first + 1 < argc)
+        {
+          mipOptions.filter = strcmp(argv[first + 1], "kaiser") == 0 ? MIP_FILTER_KAISER : MIP_FILTER_BOX;
+          first += 2;
+        }
+      else if (strcmp(argv[first], "--linear") == 0)
+        {
+          mipOptions.srgb = false;
+          first += 1;
+        }
+      else
+        break;
+    }
+  if (argc - first != 2)
+    {
+      fprintf(stderr, "usage: %s [--format auto|bc1|bc3|bc4] [--filter box|kaiser] [--linear] "
+              "input.png output.ktx\n", argv[0]);
+      return -1;
+    }
+
+  int w;
+  int h;
+  unsigned char* pixels = load_image_new(argv[first], &w, &h);
+  if (pixels == NULL)
+    return -1;
+
+  enum block_format format;
+  if (strcmp(formatName, "bc1") == 0)
+    format = BLOCK_BC1;
+  else if (strcmp(formatName, "bc3") == 0)
+    format = BLOCK_BC3;
+  else if (strcmp(formatName, "bc4") == 0)
+    format = BLOCK_BC4;
+  else if (strcmp(formatName, "auto") == 0)
+    format = is_gray(pixels, (size_t)w * h) ? BLOCK_BC4
+      : (is_opaque(pixels, (size_t)w * h) ? BLOCK_BC1 : BLOCK_BC3);
+  else
+    {
+      fprintf(stderr, "ERROR: unknown format '%s'\n", formatName);
+      return -1;
+    }
+
+  GLenum internalFormat = format == BLOCK_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    : (format == BLOCK_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RED_RGTC1);
+  GLenum baseFormat = format == BLOCK_BC1 ? GL_RGB : (format == BLOCK_BC3 ? GL_RGBA : GL_RED);
+
+  struct thread_pool* pool = thread_pool_create(0);
+  struct mip_chain chain;
+  bool built = mip_chain_build(&chain, pixels, w, h, 4, &mipOptions, pool);
+  thread_pool_destroy(pool);
+  free(pixels);
+  if (!built)
+    return -1;
+
+  struct ktx_writer_level levels[MIP_MAX_LEVELS];
+  size_t compressedBytes = 0;
+  size_t rawBytes = 0;
+  int levelCount = chain.count;
+  int i;
+  for(i = 0; i < levelCount; i++)
+    {
+      size_t size = block_compressed_size(format, chain.width[i], chain.height[i]);
+      unsigned char* blocks = malloc(size);
+      block_compress(format, chain.levels[i], chain.width[i], chain.height[i], 4, blocks);
+      levels[i].data = blocks;
+      levels[i].size = size;
+      compressedBytes += size;
+      rawBytes += (size_t)chain.width[i] * chain.height[i] * (format == BLOCK_BC4 ? 1 : 4);
+    }
+  mip_chain_free(&chain);
+
+  bool ok = ktx_write(argv[first + 1], internalFormat, baseFormat, w, h, levels, levelCount);
+  for(i = 0; i < levelCount; i++)
+    free((void*)levels[i].data);
+  if (!ok)
+    return -1;
+
+  printf("%s: %dx%d, %d levels, %s, %zu bytes (uncompressed %zu, %.1fx smaller)\n",
+         argv[first + 1], w, h, levelCount,
+         format == BLOCK_BC1 ? "BC1" : (format == BLOCK_BC3 ? "BC3" : "BC4"),
+         compressedBytes, rawBytes, (double)rawBytes / compressedBytes);
+  return 0;
+}
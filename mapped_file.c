@@ -0,0 +1,126 @@
+/*
+ * Read-only memory-mapped files.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mapped_file.h"
+#include "asset_pack.h"
+#include "embedded_assets.h"
+
+static bool mappingEnabled = true;
+static const char* overlayDirectory = NULL;
+
+void mapped_file_set_directory(const char* directory)
+{
+  overlayDirectory = directory;
+}
+
+void mapped_file_set_enabled(bool enabled)
+{
+  mappingEnabled = enabled;
+}
+
+/* whole file with read(); also works for pipes, whose size is unknown */
+static bool read_whole_file(struct mapped_file* file, int fd, size_t sizeHint)
+{
+  size_t capacity = sizeHint > 0 ? sizeHint + 1 : 4096;
+  size_t size = 0;
+  unsigned char* buffer = malloc(capacity);
+  while(buffer != NULL)
+    {
+      if (size == capacity)
+        {
+          capacity *= 2;
+          unsigned char* grown = realloc(buffer, capacity);
+          if (grown == NULL)
+            break;
+          buffer = grown;
+        }
+      ssize_t count = read(fd, buffer + size, capacity - size);
+      if (count < 0)
+        break;
+      if (count == 0)
+        {
+          file->data = buffer;
+          file->size = size;
+          file->storage = MAPPED_STORAGE_HEAP;
+          return true;
+        }
+      size += count;
+    }
+  free(buffer);
+  return false;
+}
+
+bool mapped_file_open(struct mapped_file* file, const char* path, enum mapped_access access)
+{
+  file->data = NULL;
+  file->size = 0;
+  file->storage = MAPPED_STORAGE_NONE;
+  char overlayPath[4096];
+  if (overlayDirectory != NULL && path[0] != '/')
+    {
+      struct stat overlay;
+      snprintf(overlayPath, sizeof(overlayPath), "%s/%s", overlayDirectory, path);
+      if (stat(overlayPath, &overlay) == 0)
+        path = overlayPath;
+    }
+  if (path != overlayPath
+      && (embedded_assets_open(path, file) || asset_pack_open_mounted(path, file)))
+    return true;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf(stderr, "ERROR: cannot open '%s'\n", path);
+      return false;
+    }
+  struct stat st;
+  bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+  if (mappingEnabled && regular && st.st_size > 0)
+    {
+      void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED)
+        {
+          static const int advice[] = { MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+          madvise(data, st.st_size, advice[access]);
+          // sequential readers also want the first pages right away
+          if (access == MAPPED_SEQUENTIAL)
+            madvise(data, st.st_size, MADV_WILLNEED);
+          close(fd);
+          file->data = data;
+          file->size = st.st_size;
+          file->storage = MAPPED_STORAGE_MAP;
+          return true;
+        }
+    }
+
+  bool ok = read_whole_file(file, fd, regular ? (size_t)st.st_size : 0);
+  close(fd);
+  if (!ok)
+    fprintf(stderr, "ERROR: cannot read '%s'\n", path);
+  return ok;
+}
+
+void mapped_file_close(struct mapped_file* file)
+{
+  if (file->storage == MAPPED_STORAGE_MAP)
+    munmap((void*)file->data, file->size);
+  else if (file->storage == MAPPED_STORAGE_HEAP)
+    free((void*)file->data);
+  file->data = NULL;
+  file->size = 0;
+  file->storage = MAPPED_STORAGE_NONE;
+}
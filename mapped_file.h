@@ -0,0 +1,64 @@
+/*
+ * Read-only memory-mapped files.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* how the contents are going to be read, passed on to madvise */
+enum mapped_access
+{
+  MAPPED_SEQUENTIAL,    /* front to back, once: read ahead aggressively */
+  MAPPED_RANDOM,        /* lookups: no read-ahead */
+  MAPPED_WILLNEED       /* all of it, soon: start reading now */
+};
+
+/* where 'data' lives, and so what mapped_file_close has to do */
+enum mapped_storage
+{
+  MAPPED_STORAGE_NONE,
+  MAPPED_STORAGE_MAP,   /* our own mapping */
+  MAPPED_STORAGE_HEAP,  /* malloc'ed copy */
+  MAPPED_STORAGE_PACK,  /* inside the mounted asset pack's mapping */
+  MAPPED_STORAGE_EMBEDDED /* compiled into the executable */
+};
+
+struct mapped_file
+{
+  const unsigned char* data;
+  size_t size;
+  enum mapped_storage storage;
+};
+
+/*
+ * Map 'path'. Files that cannot be mapped (pipes, empty files, or all of
+ * them after mapped_file_set_enabled(false)) are read into memory instead,
+ * so callers never need a second code path. Embedded files (see
+ * embedded_assets.h) and then files in the mounted asset pack (see
+ * asset_pack_mount) are served from memory first. Prints an error
+ * and returns false when the file cannot be opened.
+ */
+bool mapped_file_open(struct mapped_file* file, const char* path, enum mapped_access access);
+
+void mapped_file_close(struct mapped_file* file);
+
+/*
+ * Look for relative paths in 'directory' first, ahead of the embedded
+ * files, the asset pack and the working directory; NULL turns this off. The string must stay
+ * valid while set. Used to work straight from the source tree.
+ */
+void mapped_file_set_directory(const char* directory);
+
+/* for comparisons: read files into memory instead of mapping them */
+void mapped_file_set_enabled(bool enabled);
+
+#endif
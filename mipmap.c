@@ -0,0 +1,914 @@
+/*
+ * CPU mip chain generation in premultiplied, linear-light space.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#include "mipmap.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define MIP_X86 1
+#  ifdef __SSE2__
+#    include <emmintrin.h>
+#    define MIP_HAVE_SSE2 1
+#  endif
+#  include <immintrin.h>
+#  define MIP_HAVE_AVX2 1
+#  define MIP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/*
+ * linear -> sRGB goes through a table indexed by the quantized linear
+ * value; 4096 steps are fine enough that every 8-bit value survives a
+ * decode/encode round trip
+ */
+#define ENCODE_STEPS 4096
+
+static float srgbToLinear[256];
+static unsigned char linearToSrgb[ENCODE_STEPS + 1];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+static void init_tables(void)
+{
+  int i;
+  for(i = 0; i < 256; i++)
+    {
+      double c = i / 255.0;
+      srgbToLinear[i] = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+    }
+  for(i = 0; i <= ENCODE_STEPS; i++)
+    {
+      double l = (double)i / ENCODE_STEPS;
+      double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1 / 2.4) - 0.055;
+      linearToSrgb[i] = (unsigned char)(c * 255.0 + 0.5);
+    }
+}
+
+static float clamp01(float v)
+{
+  return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static int max_int(int a, int b)
+{
+  return a > b ? a : b;
+}
+
+static int clamp_index(int i, int n)
+{
+  return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+/*
+ * A 2:1 decimation filter along one axis: destination texel x takes
+ * source texels 2x + first .. 2x + first + count - 1 (clamped to the edge).
+ */
+#define MAX_TAPS 8
+
+/* per destination texel, for the general resampler (mip_resample) */
+#define RESAMPLE_MAX_TAPS 64
+
+struct filter_taps
+{
+  int count;
+  int first;
+  float weights[MAX_TAPS];
+};
+
+static double bessel_i0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  int k;
+  for(k = 1; k < 32; k++)
+    {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+  return sum;
+}
+
+static void filter_taps_init(struct filter_taps* taps, enum mip_filter filter)
+{
+  if (filter == MIP_FILTER_BOX)
+    {
+      taps->count = 2;
+      taps->first = 0;
+      taps->weights[0] = 0.5f;
+      taps->weights[1] = 0.5f;
+      return;
+    }
+
+  // sinc cut off at the destination Nyquist frequency, Kaiser window
+  // (beta 4) over +-4 source texels around the destination center 2x + 0.5
+  const double beta = 4.0;
+  const double radius = 4.0;
+  double weights[MAX_TAPS];
+  double sum = 0.0;
+  int t;
+  taps->count = MAX_TAPS;
+  taps->first = -3;
+  for(t = 0; t < MAX_TAPS; t++)
+    {
+      double d = t + taps->first - 0.5;
+      double x = d / 2.0;
+      double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+      double r = d / radius;
+      double window = bessel_i0(beta * sqrt(1.0 - r * r)) / bessel_i0(beta);
+      weights[t] = sinc * window;
+      sum += weights[t];
+    }
+  for(t = 0; t < MAX_TAPS; t++)
+    taps->weights[t] = (float)(weights[t] / sum);
+}
+
+static double sinc(double x)
+{
+  return fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+}
+
+double resample_filter_radius(enum resample_filter filter)
+{
+  return filter == RESAMPLE_LANCZOS3 ? 3.0 : 2.0;
+}
+
+double resample_filter_weight(enum resample_filter filter, double x)
+{
+  x = fabs(x);
+  if (filter == RESAMPLE_LANCZOS3)
+    return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+
+  // Mitchell-Netravali with B = C = 1/3
+  const double b = 1.0 / 3.0;
+  const double c = 1.0 / 3.0;
+  if (x < 1.0)
+    return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x + (6 - 2 * b)) / 6.0;
+  if (x < 2.0)
+    return ((-b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x
+            + (-12 * b - 48 * c) * x + (8 * b + 24 * c)) / 6.0;
+  return 0.0;
+}
+
+/* taps of mip_resample along one axis: any scale, one window per destination texel */
+struct resample_axis
+{
+  int n;                /* destination texels */
+  int count;            /* taps per destination texel, at most RESAMPLE_MAX_TAPS */
+  int* first;           /* n source indices, windows lie inside the source */
+  float* weights;       /* n * count */
+};
+
+static void resample_axis_free(struct resample_axis* axis)
+{
+  free(axis->first);
+  free(axis->weights);
+}
+
+/*
+ * Taps for scaling n source texels to dn. Destination texel x is centered
+ * on source coordinate (x + 0.5) * scale - 0.5; when shrinking, the filter
+ * is stretched by the scale so it still cuts off at the new Nyquist
+ * frequency. Taps that fall off the edge are folded onto the edge texel,
+ * which keeps every window inside the source and the kernels free of
+ * clamping.
+ */
+static bool resample_axis_init(struct resample_axis* axis, int n, int dn, enum resample_filter filter)
+{
+  double scale = (double)n / dn;
+  double stretch = scale > 1.0 ? scale : 1.0;
+  double support = resample_filter_radius(filter) * stretch;
+  int count = (int)ceil(2.0 * support) + 1;
+  memset(axis, 0, sizeof(*axis));
+  if (count > RESAMPLE_MAX_TAPS)
+    return false;
+  if (count > n)
+    count = n;
+  axis->n = dn;
+  axis->count = count;
+  axis->first = malloc(sizeof(int) * dn);
+  axis->weights = calloc((size_t)dn * count, sizeof(float));
+  if (axis->first == NULL || axis->weights == NULL)
+    {
+      resample_axis_free(axis);
+      return false;
+    }
+
+  double weights[RESAMPLE_MAX_TAPS];
+  int x;
+  int t;
+  for(x = 0; x < dn; x++)
+    {
+      double center = (x + 0.5) * scale - 0.5;
+      int natural = (int)floor(center - support) + 1;
+      int first = natural < 0 ? 0 : (natural > n - count ? n - count : natural);
+      double sum = 0.0;
+      for(t = 0; t < count; t++)
+        weights[t] = 0.0;
+      // the natural window may be wider than count when it was cut to n
+      int span = (int)ceil(2.0 * support) + 1;
+      for(t = 0; t < span; t++)
+        {
+          int i = natural + t;
+          double weight = resample_filter_weight(filter, (i - center) / stretch);
+          weights[clamp_index(i, n) - first] += weight;
+          sum += weight;
+        }
+      axis->first[x] = first;
+      for(t = 0; t < count; t++)
+        axis->weights[(size_t)x * count + t] = (float)(weights[t] / sum);
+    }
+  return true;
+}
+
+/*
+ * Kernels. All of them accumulate taps in the same order starting from
+ * w[0] * x[0], so every implementation produces bit-identical results.
+ *
+ * horizontal: one source row (w texels) -> one row of dw texels
+ * resample:   the same along a resample_axis (any scale, per texel taps)
+ * vertical:   acc[i] = sum over t < count of weights[t] * rows[t][i], i < n floats
+ */
+struct mip_kernels
+{
+  void (*horizontal)(const float* src, int w, float* dst, int dw, int channels,
+                     const struct filter_taps* taps);
+  void (*resample)(const float* src, float* dst, int channels, const struct resample_axis* axis);
+  void (*vertical)(const float* const* rows, const float* weights, int count, float* dst, int n);
+};
+
+static void horizontal_scalar(const float* src, int w, float* dst, int dw, int channels,
+                              const struct filter_taps* taps)
+{
+  int x;
+  int t;
+  int c;
+  for(x = 0; x < dw; x++)
+    {
+      for(c = 0; c < channels; c++)
+        {
+          int i = clamp_index(2 * x + taps->first, w);
+          float acc = taps->weights[0] * src[i * channels + c];
+          for(t = 1; t < taps->count; t++)
+            {
+              i = clamp_index(2 * x + taps->first + t, w);
+              acc += taps->weights[t] * src[i * channels + c];
+            }
+          dst[x * channels + c] = acc;
+        }
+    }
+}
+
+static void resample_scalar(const float* src, float* dst, int channels, const struct resample_axis* axis)
+{
+  int x;
+  int t;
+  int c;
+  for(x = 0; x < axis->n; x++)
+    {
+      const float* in = src + (size_t)axis->first[x] * channels;
+      const float* weights = axis->weights + (size_t)x * axis->count;
+      for(c = 0; c < channels; c++)
+        {
+          float acc = weights[0] * in[c];
+          for(t = 1; t < axis->count; t++)
+            acc += weights[t] * in[t * channels + c];
+          dst[x * channels + c] = acc;
+        }
+    }
+}
+
+static void vertical_scalar(const float* const* rows, const float* weights, int count, float* dst, int n)
+{
+  int i;
+  int t;
+  for(i = 0; i < n; i++)
+    {
+      float acc = weights[0] * rows[0][i];
+      for(t = 1; t < count; t++)
+        acc += weights[t] * rows[t][i];
+      dst[i] = acc;
+    }
+}
+
+#ifdef MIP_HAVE_SSE2
+/* one RGBA texel per __m128 */
+static void horizontal_sse2(const float* src, int w, float* dst, int dw, int channels,
+                            const struct filter_taps* taps)
+{
+  if (channels != 4)
+    {
+      horizontal_scalar(src, w, dst, dw, channels, taps);
+      return;
+    }
+  int x;
+  int t;
+  for(x = 0; x < dw; x++)
+    {
+      int i = clamp_index(2 * x + taps->first, w);
+      __m128 acc = _mm_mul_ps(_mm_set1_ps(taps->weights[0]), _mm_loadu_ps(src + i * 4));
+      for(t = 1; t < taps->count; t++)
+        {
+          i = clamp_index(2 * x + taps->first + t, w);
+          acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps->weights[t]), _mm_loadu_ps(src + i * 4)));
+        }
+      _mm_storeu_ps(dst + x * 4, acc);
+    }
+}
+
+static void resample_sse2(const float* src, float* dst, int channels, const struct resample_axis* axis)
+{
+  if (channels != 4)
+    {
+      resample_scalar(src, dst, channels, axis);
+      return;
+    }
+  int x;
+  int t;
+  for(x = 0; x < axis->n; x++)
+    {
+      const float* in = src + (size_t)axis->first[x] * 4;
+      const float* weights = axis->weights + (size_t)x * axis->count;
+      __m128 acc = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(in));
+      for(t = 1; t < axis->count; t++)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(in + t * 4)));
+      _mm_storeu_ps(dst + x * 4, acc);
+    }
+}
+
+static void vertical_sse2(const float* const* rows, const float* weights, int count, float* dst, int n)
+{
+  int i;
+  int t;
+  for(i = 0; i + 4 <= n; i += 4)
+    {
+      __m128 acc = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(rows[0] + i));
+      for(t = 1; t < count; t++)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+      _mm_storeu_ps(dst + i, acc);
+    }
+  if (i < n)
+    {
+      const float* tails[RESAMPLE_MAX_TAPS];
+      for(t = 0; t < count; t++)
+        tails[t] = rows[t] + i;
+      vertical_scalar(tails, weights, count, dst + i, n - i);
+    }
+}
+#endif
+
+#ifdef MIP_HAVE_AVX2
+/* two RGBA texels per __m256: destination x in the low half, x + 1 in the high half */
+MIP_TARGET_AVX2
+static void horizontal_avx2(const float* src, int w, float* dst, int dw, int channels,
+                            const struct filter_taps* taps)
+{
+  if (channels != 4)
+    {
+      horizontal_scalar(src, w, dst, dw, channels, taps);
+      return;
+    }
+  int x;
+  int t;
+  for(x = 0; x + 2 <= dw; x += 2)
+    {
+      __m256 acc = _mm256_setzero_ps();
+      for(t = 0; t < taps->count; t++)
+        {
+          int i0 = clamp_index(2 * x + taps->first + t, w);
+          int i1 = clamp_index(2 * x + 2 + taps->first + t, w);
+          __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + i0 * 4)),
+                                               _mm_loadu_ps(src + i1 * 4), 1);
+          __m256 product = _mm256_mul_ps(_mm256_set1_ps(taps->weights[t]), texels);
+          acc = t == 0 ? product : _mm256_add_ps(acc, product);
+        }
+      _mm256_storeu_ps(dst + x * 4, acc);
+    }
+  for(; x < dw; x++)
+    {
+      int i = clamp_index(2 * x + taps->first, w);
+      __m128 acc = _mm_mul_ps(_mm_set1_ps(taps->weights[0]), _mm_loadu_ps(src + i * 4));
+      for(t = 1; t < taps->count; t++)
+        {
+          i = clamp_index(2 * x + taps->first + t, w);
+          acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps->weights[t]), _mm_loadu_ps(src + i * 4)));
+        }
+      _mm_storeu_ps(dst + x * 4, acc);
+    }
+}
+
+/* as horizontal_avx2: destination x in the low half, x + 1 in the high half */
+MIP_TARGET_AVX2
+static void resample_avx2(const float* src, float* dst, int channels, const struct resample_axis* axis)
+{
+  if (channels != 4)
+    {
+      resample_scalar(src, dst, channels, axis);
+      return;
+    }
+  int x;
+  int t;
+  for(x = 0; x + 2 <= axis->n; x += 2)
+    {
+      const float* in0 = src + (size_t)axis->first[x] * 4;
+      const float* in1 = src + (size_t)axis->first[x + 1] * 4;
+      const float* weights0 = axis->weights + (size_t)x * axis->count;
+      const float* weights1 = weights0 + axis->count;
+      __m256 acc = _mm256_setzero_ps();
+      for(t = 0; t < axis->count; t++)
+        {
+          __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in0 + t * 4)),
+                                               _mm_loadu_ps(in1 + t * 4), 1);
+          __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights0[t])),
+                                               _mm_set1_ps(weights1[t]), 1);
+          __m256 product = _mm256_mul_ps(weight, texels);
+          acc = t == 0 ? product : _mm256_add_ps(acc, product);
+        }
+      _mm256_storeu_ps(dst + x * 4, acc);
+    }
+  for(; x < axis->n; x++)
+    {
+      const float* in = src + (size_t)axis->first[x] * 4;
+      const float* weights = axis->weights + (size_t)x * axis->count;
+      __m128 acc = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(in));
+      for(t = 1; t < axis->count; t++)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(in + t * 4)));
+      _mm_storeu_ps(dst + x * 4, acc);
+    }
+}
+
+MIP_TARGET_AVX2
+static void vertical_avx2(const float* const* rows, const float* weights, int count, float* dst, int n)
+{
+  int i;
+  int t;
+  for(i = 0; i + 8 <= n; i += 8)
+    {
+      __m256 acc = _mm256_mul_ps(_mm256_set1_ps(weights[0]), _mm256_loadu_ps(rows[0] + i));
+      for(t = 1; t < count; t++)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[t]),
+                                               _mm256_loadu_ps(rows[t] + i)));
+      _mm256_storeu_ps(dst + i, acc);
+    }
+  if (i < n)
+    {
+      const float* tails[RESAMPLE_MAX_TAPS];
+      for(t = 0; t < count; t++)
+        tails[t] = rows[t] + i;
+      vertical_scalar(tails, weights, count, dst + i, n - i);
+    }
+}
+#endif
+
+bool mip_kernel_supported(enum mip_kernel kernel)
+{
+  switch(kernel)
+    {
+    case MIP_KERNEL_AUTO:
+    case MIP_KERNEL_SCALAR:
+      return true;
+#ifdef MIP_HAVE_SSE2
+    case MIP_KERNEL_SSE2:
+      return true;
+#endif
+#ifdef MIP_HAVE_AVX2
+    case MIP_KERNEL_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+    }
+}
+
+enum mip_kernel mip_best_kernel(void)
+{
+  if (mip_kernel_supported(MIP_KERNEL_AVX2))
+    return MIP_KERNEL_AVX2;
+  if (mip_kernel_supported(MIP_KERNEL_SSE2))
+    return MIP_KERNEL_SSE2;
+  return MIP_KERNEL_SCALAR;
+}
+
+const char* mip_kernel_name(enum mip_kernel kernel)
+{
+  switch(kernel)
+    {
+    case MIP_KERNEL_AUTO:
+      return "auto";
+    case MIP_KERNEL_SCALAR:
+      return "scalar";
+    case MIP_KERNEL_SSE2:
+      return "sse2";
+    case MIP_KERNEL_AVX2:
+      return "avx2";
+    }
+  return "?";
+}
+
+static struct mip_kernels select_kernels(enum mip_kernel kernel)
+{
+  struct mip_kernels kernels = { horizontal_scalar, resample_scalar, vertical_scalar };
+  if (kernel == MIP_KERNEL_AUTO || !mip_kernel_supported(kernel))
+    kernel = mip_best_kernel();
+#ifdef MIP_HAVE_SSE2
+  if (kernel == MIP_KERNEL_SSE2)
+    {
+      kernels.horizontal = horizontal_sse2;
+      kernels.resample = resample_sse2;
+      kernels.vertical = vertical_sse2;
+    }
+#endif
+#ifdef MIP_HAVE_AVX2
+  if (kernel == MIP_KERNEL_AVX2)
+    {
+      kernels.horizontal = horizontal_avx2;
+      kernels.resample = resample_avx2;
+      kernels.vertical = vertical_avx2;
+    }
+#endif
+  return kernels;
+}
+
+/* everything one level step needs; rows are handed out to the pool */
+struct level_job
+{
+  struct mip_kernels kernels;
+  struct filter_taps horizontalTaps;
+  struct filter_taps verticalTaps;
+  const struct mip_options* options;
+  int channels;
+
+  const unsigned char* bytes;   /* decode: input */
+  const float* src;             /* w x h, premultiplied linear */
+  float* tmp;                   /* dw x h */
+  float* dst;                   /* dw x dh */
+  unsigned char* out;           /* encode: dw x dh */
+  int w;
+  int h;
+  int dw;
+  int dh;
+};
+
+/* n texels of 8-bit input to premultiplied linear floats */
+static void decode_span(const unsigned char* in, float* out, int n, int channels, bool srgb)
+{
+  int x;
+  if (channels == 1)
+    {
+      for(x = 0; x < n; x++)
+        out[x] = srgb ? srgbToLinear[in[x]] : in[x] / 255.0f;
+      return;
+    }
+  for(x = 0; x < n; x++)
+    {
+      float a = in[x * 4 + 3] / 255.0f;
+      int c;
+      for(c = 0; c < 3; c++)
+        out[x * 4 + c] = (srgb ? srgbToLinear[in[x * 4 + c]] : in[x * 4 + c] / 255.0f) * a;
+      out[x * 4 + 3] = a;
+    }
+}
+
+static unsigned char encode_value(float v, bool srgb)
+{
+  v = clamp01(v);
+  if (srgb)
+    return linearToSrgb[(int)(v * ENCODE_STEPS + 0.5f)];
+  return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+/* ... and back to straight alpha 8-bit */
+static void encode_span(const float* in, unsigned char* out, int n, int channels, bool srgb)
+{
+  int x;
+  if (channels == 1)
+    {
+      for(x = 0; x < n; x++)
+        out[x] = encode_value(in[x], srgb);
+      return;
+    }
+  for(x = 0; x < n; x++)
+    {
+      float a = clamp01(in[x * 4 + 3]);
+      unsigned char alpha = (unsigned char)(a * 255.0f + 0.5f);
+      int c;
+      for(c = 0; c < 3; c++)
+        out[x * 4 + c] = alpha == 0 ? 0 : encode_value(in[x * 4 + c] / a, srgb);
+      out[x * 4 + 3] = alpha;
+    }
+}
+
+static void decode_row(void* ctx, int y)
+{
+  struct level_job* job = ctx;
+  decode_span(job->bytes + (size_t)y * job->w * job->channels,
+              job->dst + (size_t)y * job->w * job->channels,
+              job->w, job->channels, job->options->srgb);
+}
+
+static void encode_row(void* ctx, int y)
+{
+  struct level_job* job = ctx;
+  encode_span(job->dst + (size_t)y * job->dw * job->channels,
+              job->out + (size_t)y * job->dw * job->channels,
+              job->dw, job->channels, job->options->srgb);
+}
+
+static void horizontal_row(void* ctx, int y)
+{
+  struct level_job* job = ctx;
+  size_t n = job->channels;
+  if (job->w == 1)
+    memcpy(job->tmp + (size_t)y * n, job->src + (size_t)y * n, sizeof(float) * n);
+  else
+    job->kernels.horizontal(job->src + (size_t)y * job->w * n, job->w,
+                            job->tmp + (size_t)y * job->dw * n, job->dw,
+                            job->channels, &job->horizontalTaps);
+}
+
+static void vertical_row(void* ctx, int y)
+{
+  struct level_job* job = ctx;
+  size_t stride = (size_t)job->dw * job->channels;
+  if (job->h == 1)
+    {
+      memcpy(job->dst, job->tmp, sizeof(float) * stride);
+      return;
+    }
+  const float* rows[MAX_TAPS];
+  int t;
+  for(t = 0; t < job->verticalTaps.count; t++)
+    rows[t] = job->tmp + clamp_index(2 * y + job->verticalTaps.first + t, job->h) * stride;
+  job->kernels.vertical(rows, job->verticalTaps.weights, job->verticalTaps.count,
+                        job->dst + y * stride, stride);
+}
+
+/* small levels are not worth a trip through the queue */
+static struct thread_pool* pool_for(struct thread_pool* pool, int rows)
+{
+  return rows >= 64 ? pool : NULL;
+}
+
+bool mip_chain_build(struct mip_chain* chain, const unsigned char* pixels, int w, int h,
+                     int channels, const struct mip_options* options, struct thread_pool* pool)
+{
+  memset(chain, 0, sizeof(*chain));
+  if ((channels != 1 && channels != 4) || w <= 0 || h <= 0)
+    return false;
+  pthread_once(&tablesOnce, init_tables);
+
+  struct level_job job;
+  memset(&job, 0, sizeof(job));
+  job.kernels = select_kernels(options->kernel);
+  filter_taps_init(&job.horizontalTaps, options->filter);
+  job.verticalTaps = job.horizontalTaps;
+  job.options = options;
+  job.channels = channels;
+
+  size_t size = (size_t)w * h * channels;
+  chain->channels = channels;
+  chain->count = 1;
+  chain->width[0] = w;
+  chain->height[0] = h;
+  chain->levels[0] = malloc(size);
+
+  // level 0 in float; afterwards 'current' always holds the level above
+  float* current = malloc(sizeof(float) * size);
+  float* tmp = malloc(sizeof(float) * max_int(w / 2, 1) * h * channels);
+  float* next = malloc(sizeof(float) * max_int(w / 2, 1) * max_int(h / 2, 1) * channels);
+  if (chain->levels[0] == NULL || current == NULL || tmp == NULL || next == NULL)
+    {
+      free(current);
+      free(tmp);
+      free(next);
+      mip_chain_free(chain);
+      return false;
+    }
+  memcpy(chain->levels[0], pixels, size);
+  job.bytes = pixels;
+  job.dst = current;
+  job.w = w;
+  job.h = h;
+  thread_pool_parallel_for(pool_for(pool, h), h, decode_row, &job);
+
+  while((w > 1 || h > 1) && chain->count < MIP_MAX_LEVELS)
+    {
+      int dw = max_int(w / 2, 1);
+      int dh = max_int(h / 2, 1);
+      job.src = current;
+      job.tmp = tmp;
+      job.dst = next;
+      job.w = w;
+      job.h = h;
+      job.dw = dw;
+      job.dh = dh;
+      job.out = malloc((size_t)dw * dh * channels);
+      if (job.out == NULL)
+        {
+          free(current);
+          free(tmp);
+          free(next);
+          mip_chain_free(chain);
+          return false;
+        }
+      thread_pool_parallel_for(pool_for(pool, h), h, horizontal_row, &job);
+      thread_pool_parallel_for(pool_for(pool, dh), dh, vertical_row, &job);
+      thread_pool_parallel_for(pool_for(pool, dh), dh, encode_row, &job);
+
+      chain->levels[chain->count] = job.out;
+      chain->width[chain->count] = dw;
+      chain->height[chain->count] = dh;
+      chain->count++;
+
+      // the new level becomes the source; the old buffer is big enough
+      // for every level below it
+      float* swap = current;
+      current = next;
+      next = swap;
+      w = dw;
+      h = dh;
+    }
+
+  free(current);
+  free(tmp);
+  free(next);
+  return true;
+}
+
+void mip_chain_free(struct mip_chain* chain)
+{
+  int i;
+  for(i = 0; i < chain->count; i++)
+    free(chain->levels[i]);
+  memset(chain, 0, sizeof(*chain));
+}
+
+bool mip_reduce(const unsigned char* pixels, int w, int h, int channels, unsigned char* out,
+                const struct mip_options* options, struct thread_pool* pool)
+{
+  if ((channels != 1 && channels != 4) || w <= 0 || h <= 0)
+    return false;
+  pthread_once(&tablesOnce, init_tables);
+
+  struct level_job job;
+  memset(&job, 0, sizeof(job));
+  job.kernels = select_kernels(options->kernel);
+  filter_taps_init(&job.horizontalTaps, options->filter);
+  job.verticalTaps = job.horizontalTaps;
+  job.options = options;
+  job.channels = channels;
+  job.w = w;
+  job.h = h;
+  job.dw = (w + 1) / 2;
+  job.dh = (h + 1) / 2;
+
+  float* src = malloc(sizeof(float) * w * h * channels);
+  float* tmp = malloc(sizeof(float) * job.dw * h * channels);
+  float* dst = malloc(sizeof(float) * job.dw * job.dh * channels);
+  bool ok = src != NULL && tmp != NULL && dst != NULL;
+  if (ok)
+    {
+      // decode_row writes to job.dst
+      job.bytes = pixels;
+      job.dst = src;
+      thread_pool_parallel_for(pool_for(pool, h), h, decode_row, &job);
+      job.src = src;
+      job.tmp = tmp;
+      job.dst = dst;
+      job.out = out;
+      thread_pool_parallel_for(pool_for(pool, h), h, horizontal_row, &job);
+      thread_pool_parallel_for(pool_for(pool, job.dh), job.dh, vertical_row, &job);
+      thread_pool_parallel_for(pool_for(pool, job.dh), job.dh, encode_row, &job);
+    }
+  free(src);
+  free(tmp);
+  free(dst);
+  return ok;
+}
+
+// rows per mip_resample task; each task allocates its scratch row once
+#define RESAMPLE_CHUNK_ROWS 16
+
+/* mip_resample's state; like level_job, rows are handed out to the pool */
+struct resample_job
+{
+  struct mip_kernels kernels;
+  struct resample_axis horizontal;
+  struct resample_axis vertical;
+  const struct mip_options* options;
+  int channels;
+
+  const unsigned char* pixels;  /* w x h */
+  float* tmp;                   /* dw x h, premultiplied linear */
+  unsigned char* out;           /* dw x dh */
+  int w;
+  int h;
+  int dw;
+  int dh;
+  int failed;                   /* a task had no scratch row; atomic */
+};
+
+/* source rows of 'chunk': decode, then scale them to dw texels */
+static void resample_source_rows(void* ctx, int chunk)
+{
+  struct resample_job* job = ctx;
+  float* row = malloc(sizeof(float) * job->w * job->channels);
+  if (row == NULL)
+    {
+      __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  int y;
+  for(y = chunk * RESAMPLE_CHUNK_ROWS; y < job->h && y < (chunk + 1) * RESAMPLE_CHUNK_ROWS; y++)
+    {
+      decode_span(job->pixels + (size_t)y * job->w * job->channels, row,
+                  job->w, job->channels, job->options->srgb);
+      job->kernels.resample(row, job->tmp + (size_t)y * job->dw * job->channels,
+                            job->channels, &job->horizontal);
+    }
+  free(row);
+}
+
+/* destination rows of 'chunk': filter the rows of tmp, then encode */
+static void resample_destination_rows(void* ctx, int chunk)
+{
+  struct resample_job* job = ctx;
+  size_t stride = (size_t)job->dw * job->channels;
+  float* row = malloc(sizeof(float) * stride);
+  if (row == NULL)
+    {
+      __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  const struct resample_axis* axis = &job->vertical;
+  const float* rows[RESAMPLE_MAX_TAPS];
+  int y;
+  for(y = chunk * RESAMPLE_CHUNK_ROWS; y < job->dh && y < (chunk + 1) * RESAMPLE_CHUNK_ROWS; y++)
+    {
+      int t;
+      for(t = 0; t < axis->count; t++)
+        rows[t] = job->tmp + (axis->first[y] + t) * stride;
+      job->kernels.vertical(rows, axis->weights + (size_t)y * axis->count, axis->count, row, stride);
+      encode_span(row, job->out + y * stride, job->dw, job->channels, job->options->srgb);
+    }
+  free(row);
+}
+
+bool mip_resample(const unsigned char* pixels, int w, int h, int channels,
+                  unsigned char* out, int dw, int dh, enum resample_filter filter,
+                  const struct mip_options* options, struct thread_pool* pool)
+{
+  if ((channels != 1 && channels != 4) || w <= 0 || h <= 0 || dw <= 0 || dh <= 0)
+    return false;
+  pthread_once(&tablesOnce, init_tables);
+
+  struct resample_job job;
+  memset(&job, 0, sizeof(job));
+  job.kernels = select_kernels(options->kernel);
+  job.options = options;
+  job.channels = channels;
+  job.pixels = pixels;
+  job.out = out;
+  job.w = w;
+  job.h = h;
+  job.dw = dw;
+  job.dh = dh;
+  job.tmp = malloc(sizeof(float) * dw * h * channels);
+  bool ok = job.tmp != NULL
+    && resample_axis_init(&job.horizontal, w, dw, filter)
+    && resample_axis_init(&job.vertical, h, dh, filter);
+  if (ok)
+    {
+      thread_pool_parallel_for(pool_for(pool, h), (h + RESAMPLE_CHUNK_ROWS - 1) / RESAMPLE_CHUNK_ROWS,
+                               resample_source_rows, &job);
+      // a missing source row would be read as garbage
+      if (!job.failed)
+        thread_pool_parallel_for(pool_for(pool, dh), (dh + RESAMPLE_CHUNK_ROWS - 1) / RESAMPLE_CHUNK_ROWS,
+                                 resample_destination_rows, &job);
+      ok = !job.failed;
+    }
+  resample_axis_free(&job.horizontal);
+  resample_axis_free(&job.vertical);
+  free(job.tmp);
+  return ok;
+}
+
+void mip_chain_upload(const struct mip_chain* chain)
+{
+  GLenum format = chain->channels == 1 ? GL_RED : GL_RGBA;
+  int i;
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for(i = 0; i < chain->count; i++)
+    glTexImage2D(GL_TEXTURE_2D, i, format, chain->width[i], chain->height[i], 0,
+                 format, GL_UNSIGNED_BYTE, chain->levels[i]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain->count - 1);
+}
@@ -0,0 +1,113 @@
+/*
+ * CPU mip chain generation in premultiplied, linear-light space.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <stdbool.h>
+#include "thread_pool.h"
+
+#define MIP_MAX_LEVELS 32
+
+enum mip_filter
+{
+  MIP_FILTER_BOX,       /* 2x2 average */
+  MIP_FILTER_KAISER     /* 8-tap Kaiser-windowed sinc, sharper, may ring slightly */
+};
+
+enum mip_kernel
+{
+  MIP_KERNEL_AUTO,      /* best one this CPU runs */
+  MIP_KERNEL_SCALAR,
+  MIP_KERNEL_SSE2,
+  MIP_KERNEL_AVX2
+};
+
+enum resample_filter
+{
+  RESAMPLE_LANCZOS3,    /* 3-lobe windowed sinc: sharpest, rings a little at hard edges */
+  RESAMPLE_MITCHELL     /* Mitchell-Netravali (B = C = 1/3) cubic: softer, barely rings */
+};
+
+struct mip_options
+{
+  enum mip_filter filter;
+  enum mip_kernel kernel;
+  bool srgb;            /* texels are sRGB encoded (colors); false for data */
+};
+
+struct mip_chain
+{
+  int count;
+  int channels;
+  int width[MIP_MAX_LEVELS];
+  int height[MIP_MAX_LEVELS];
+  unsigned char* levels[MIP_MAX_LEVELS];  /* level 0 is a copy of the input */
+};
+
+/*
+ * Build every level down to 1x1 from 8-bit 'pixels' with 1 (gray) or 4
+ * (RGBA, straight alpha) channels.
+ *
+ * Texels are decoded to linear light and, for RGBA, premultiplied by alpha
+ * before filtering, so transparent texels do not bleed their (meaningless)
+ * color into the edges and dark and bright texels average to the right
+ * brightness. Each level is filtered from the previous float level and
+ * converted back to straight-alpha 8-bit on the way out.
+ *
+ * Rows of every pass are split across 'pool' (NULL: run on the caller).
+ */
+bool mip_chain_build(struct mip_chain* chain, const unsigned char* pixels, int w, int h,
+                     int channels, const struct mip_options* options, struct thread_pool* pool);
+
+void mip_chain_free(struct mip_chain* chain);
+
+/*
+ * One level step of mip_chain_build on its own, rounding up instead of
+ * down: 'pixels' (w x h) to (w + 1) / 2 x (h + 1) / 2 texels in 'out',
+ * a missing last column or row repeating the edge. With MIP_FILTER_BOX no
+ * output texel reads past its own 2x2 block, so strips of an image with
+ * an even number of rows reduce independently (see vt_tiler).
+ */
+bool mip_reduce(const unsigned char* pixels, int w, int h, int channels, unsigned char* out,
+                const struct mip_options* options, struct thread_pool* pool);
+
+/*
+ * Scale 'pixels' (w x h, 1 or 4 channels as above) to dw x dh into 'out',
+ * in the same premultiplied linear space, with a separable 'filter'
+ * widened by the scale factor when shrinking. Taps beyond the border
+ * repeat the edge texels. options->kernel picks the SIMD kernels and
+ * options->srgb the encoding; options->filter is not used.
+ *
+ * Source rows (decode + horizontal pass) and destination rows (vertical
+ * pass + encode) are split across 'pool' (NULL: run on the caller). Only
+ * the intermediate dw x h float image is held in full. Fails on shrinking
+ * by more than about 10x (the tap count gets out of hand).
+ */
+bool mip_resample(const unsigned char* pixels, int w, int h, int channels,
+                  unsigned char* out, int dw, int dh, enum resample_filter filter,
+                  const struct mip_options* options, struct thread_pool* pool);
+
+/* filter weight at distance x (in texels at scale 1), and where it ends */
+double resample_filter_weight(enum resample_filter filter, double x);
+double resample_filter_radius(enum resample_filter filter);
+
+/* upload all levels to the currently bound GL_TEXTURE_2D */
+void mip_chain_upload(const struct mip_chain* chain);
+
+/* MIP_KERNEL_AUTO resolved for this CPU */
+enum mip_kernel mip_best_kernel(void);
+
+/* can this build and CPU run 'kernel'? */
+bool mip_kernel_supported(enum mip_kernel kernel);
+
+const char* mip_kernel_name(enum mip_kernel kernel);
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Time CPU mip chain generation (every kernel, single and multi threaded)
+ * against glGenerateMipmap, and check the SIMD kernels against the scalar
+ * reference.
+ *
+ *   mipmap_bench [--headless] [--threads N] [--filter box|kaiser] [--runs N] [file.png]
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "image_loader.h"
+#include "mipmap.h"
+#include "timing.h"
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--threads", "--runs", "--filter", NULL };
+  return app_option_value(argv, i, valued);
+}
+
+/* best of 'runs' builds; the last chain is kept in 'chain' */
+static double time_build(struct mip_chain* chain, const unsigned char* pixels, int w, int h,
+                         const struct mip_options* options, struct thread_pool* pool, int runs)
+{
+  double best = 0;
+  int i;
+  for(i = 0; i < runs; i++)
+    {
+      if (i > 0)
+        mip_chain_free(chain);
+      double start = timing_now();
+      mip_chain_build(chain, pixels, w, h, 4, options, pool);
+      double elapsed = timing_now() - start;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+  return best;
+}
+
+/* largest per-channel difference over all levels */
+static int max_difference(const struct mip_chain* a, const struct mip_chain* b)
+{
+  int worst = 0;
+  int level;
+  for(level = 0; level < a->count && level < b->count; level++)
+    {
+      size_t n = (size_t)a->width[level] * a->height[level] * a->channels;
+      size_t i;
+      for(i = 0; i < n; i++)
+        {
+          int d = abs(a->levels[level][i] - b->levels[level][i]);
+          if (d > worst)
+            worst = d;
+        }
+    }
+  return worst;
+}
+
+static double time_gl_generate(const unsigned char* pixels, int w, int h, int runs)
+{
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glFinish();
+
+  double best = 0;
+  int i;
+  for(i = 0; i < runs; i++)
+    {
+      double start = timing_now();
+      glGenerateMipmap(GL_TEXTURE_2D);
+      glFinish();
+      double elapsed = timing_now() - start;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+  glDeleteTextures(1, &texture);
+  return best;
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Mipmap benchmark", 0))
+    return -1;
+
+  const char* threadsOption = app_option(argc, argv, "--threads");
+  const char* runsOption = app_option(argc, argv, "--runs");
+  const char* filterOption = app_option(argc, argv, "--filter");
+  int runs = runsOption != NULL ? atoi(runsOption) : 5;
+  if (runs < 1)
+    runs = 1;
+  const char* file = "texture.png";
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      file = argv[i];
+    }
+
+  int w;
+  int h;
+  unsigned char* pixels = load_image_new(file, &w, &h);
+  if (pixels == NULL)
+    {
+      app_terminate(&app);
+      return -1;
+    }
+
+  struct mip_options options = { MIP_FILTER_BOX, MIP_KERNEL_SCALAR, true };
+  if (filterOption != NULL && strcmp(filterOption, "kaiser") == 0)
+    options.filter = MIP_FILTER_KAISER;
+  struct thread_pool* pool = thread_pool_create(threadsOption != NULL ? atoi(threadsOption) : 0);
+
+  printf("%s: %dx%d, %s filter, best of %d\n", file, w, h,
+         options.filter == MIP_FILTER_BOX ? "box" : "kaiser", runs);
+  struct mip_chain reference;
+  double scalar = time_build(&reference, pixels, w, h, &options, NULL, runs);
+  printf("%-8s %3d thread  %9.3f ms\n", "scalar", 1, scalar * 1000.0);
+
+  static const enum mip_kernel kernels[] = { MIP_KERNEL_SSE2, MIP_KERNEL_AVX2 };
+  int k;
+  for(k = 0; k < 2; k++)
+    {
+      if (!mip_kernel_supported(kernels[k]))
+        {
+          printf("%-8s not available\n", mip_kernel_name(kernels[k]));
+          continue;
+        }
+      options.kernel = kernels[k];
+      struct mip_chain chain;
+      double single = time_build(&chain, pixels, w, h, &options, NULL, runs);
+      int diff = max_difference(&reference, &chain);
+      mip_chain_free(&chain);
+      double threaded = time_build(&chain, pixels, w, h, &options, pool, runs);
+      mip_chain_free(&chain);
+      printf("%-8s %3d thread  %9.3f ms  (%.2fx scalar, max diff %d)\n",
+             mip_kernel_name(kernels[k]), 1, single * 1000.0, scalar / single, diff);
+      printf("%-8s %3d threads %9.3f ms  (%.2fx scalar)\n",
+             mip_kernel_name(kernels[k]), thread_pool_size(pool), threaded * 1000.0, scalar / threaded);
+    }
+
+  double gl = time_gl_generate(pixels, w, h, runs);
+  printf("%-8s glGenerateMipmap %9.3f ms  (%s)\n", "gl", gl * 1000.0, glGetString(GL_RENDERER));
+
+  mip_chain_free(&reference);
+  thread_pool_destroy(pool);
+  free(pixels);
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * Row converters between 8-bit pixel layouts (gray, gray+alpha, RGB, RGBA).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <string.h>
+#include "pixel_convert.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#  include <emmintrin.h>
+#  include <tmmintrin.h>
+#  define PIXEL_HAVE_SSE2 1
+#  define PIXEL_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+/* scalar: one pixel at a time through RGBA */
+
+static unsigned char luma(unsigned char r, unsigned char g, unsigned char b)
+{
+  return (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+static void convert_scalar(const unsigned char* src, int srcChannels,
+                           unsigned char* dst, int dstChannels, int count)
+{
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      unsigned char r;
+      unsigned char g;
+      unsigned char b;
+      unsigned char a = 255;
+      if (srcChannels <= 2)
+        {
+          r = g = b = src[0];
+          if (srcChannels == 2)
+            a = src[1];
+        }
+      else
+        {
+          r = src[0];
+          g = src[1];
+          b = src[2];
+          if (srcChannels == 4)
+            a = src[3];
+        }
+
+      if (dstChannels <= 2)
+        {
+          dst[0] = srcChannels <= 2 ? r : luma(r, g, b);
+          if (dstChannels == 2)
+            dst[1] = a;
+        }
+      else
+        {
+          dst[0] = r;
+          dst[1] = g;
+          dst[2] = b;
+          if (dstChannels == 4)
+            dst[3] = a;
+        }
+      src += srcChannels;
+      dst += dstChannels;
+    }
+}
+
+#define SCALAR_CONVERTER(from, to)                                      \
+  static void convert_##from##_##to##_scalar(const unsigned char* src,  \
+                                             unsigned char* dst, int count) \
+  {                                                                     \
+    convert_scalar(src, from, dst, to, count);                          \
+  }
+
+SCALAR_CONVERTER(1, 2)
+SCALAR_CONVERTER(1, 3)
+SCALAR_CONVERTER(1, 4)
+SCALAR_CONVERTER(2, 1)
+SCALAR_CONVERTER(2, 3)
+SCALAR_CONVERTER(2, 4)
+SCALAR_CONVERTER(3, 1)
+SCALAR_CONVERTER(3, 2)
+SCALAR_CONVERTER(3, 4)
+SCALAR_CONVERTER(4, 1)
+SCALAR_CONVERTER(4, 2)
+SCALAR_CONVERTER(4, 3)
+
+static void copy_1(const unsigned char* src, unsigned char* dst, int count)
+{
+  memcpy(dst, src, count);
+}
+
+static void copy_2(const unsigned char* src, unsigned char* dst, int count)
+{
+  memcpy(dst, src, (size_t)count * 2);
+}
+
+static void copy_3(const unsigned char* src, unsigned char* dst, int count)
+{
+  memcpy(dst, src, (size_t)count * 3);
+}
+
+static void copy_4(const unsigned char* src, unsigned char* dst, int count)
+{
+  memcpy(dst, src, (size_t)count * 4);
+}
+
+static void strip16_scalar(const unsigned char* src, unsigned char* dst, int count)
+{
+  int i;
+  for(i = 0; i < count; i++)
+    dst[i] = src[i * 2];
+}
+
+#ifdef PIXEL_HAVE_SSE2
+/* gray -> RGBA: 16 pixels per step, byte and word unpacks replicate gray */
+static void convert_1_4_sse2(const unsigned char* src, unsigned char* dst, int count)
+{
+  const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+  int i;
+  for(i = 0; i + 16 <= count; i += 16)
+    {
+      __m128i g = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i gg0 = _mm_unpacklo_epi8(g, g);
+      __m128i gg1 = _mm_unpackhi_epi8(g, g);
+      __m128i* out = (__m128i*)(dst + (size_t)i * 4);
+      _mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi16(gg0, gg0), alpha));
+      _mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(gg0, gg0), alpha));
+      _mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(gg1, gg1), alpha));
+      _mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(gg1, gg1), alpha));
+    }
+  convert_scalar(src + i, 1, dst + (size_t)i * 4, 4, count - i);
+}
+
+/* gray+alpha -> RGBA: 8 pixels per step, (g, a) words become (g, g, g, a) */
+static void convert_2_4_sse2(const unsigned char* src, unsigned char* dst, int count)
+{
+  const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+  int i;
+  for(i = 0; i + 8 <= count; i += 8)
+    {
+      __m128i ga = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 2));
+      __m128i g = _mm_and_si128(ga, lowBytes);
+      __m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+      __m128i* out = (__m128i*)(dst + (size_t)i * 4);
+      _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg, ga));
+      _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg, ga));
+    }
+  convert_scalar(src + (size_t)i * 2, 2, dst + (size_t)i * 4, 4, count - i);
+}
+
+/* RGB -> RGBA: 4 pixels per shuffle; stops while 16 bytes can still be loaded */
+PIXEL_TARGET_SSSE3
+static void convert_3_4_ssse3(const unsigned char* src, unsigned char* dst, int count)
+{
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+  int i;
+  for(i = 0; i + 6 <= count; i += 4)
+    {
+      __m128i rgb = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 3));
+      _mm_storeu_si128((__m128i*)(dst + (size_t)i * 4),
+                       _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+  convert_scalar(src + (size_t)i * 3, 3, dst + (size_t)i * 4, 4, count - i);
+}
+
+/* RGBA -> RGB: 4 pixels per shuffle; the 4 spare bytes stored are overwritten next step */
+PIXEL_TARGET_SSSE3
+static void convert_4_3_ssse3(const unsigned char* src, unsigned char* dst, int count)
+{
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  int i;
+  for(i = 0; i + 6 <= count; i += 4)
+    {
+      __m128i rgba = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 4));
+      _mm_storeu_si128((__m128i*)(dst + (size_t)i * 3), _mm_shuffle_epi8(rgba, shuffle));
+    }
+  convert_scalar(src + (size_t)i * 4, 4, dst + (size_t)i * 3, 3, count - i);
+}
+
+/*
+ * Rec. 601 luma of 8 RGBx pixels (two vectors of 4) as 8 words, exactly
+ * like luma(): the weights are applied with word multiply-adds and the
+ * (r, g) and (b, x) partial sums of every pixel added afterwards.
+ */
+static inline __m128i luma_8(__m128i p0, __m128i p1)
+{
+  const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(128);
+  __m128 s0 = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(p0, zero), weights));
+  __m128 s1 = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(p0, zero), weights));
+  __m128 s2 = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(p1, zero), weights));
+  __m128 s3 = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(p1, zero), weights));
+  __m128i l0 = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))),
+                             _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+  __m128i l1 = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s2, s3, _MM_SHUFFLE(2, 0, 2, 0))),
+                             _mm_castps_si128(_mm_shuffle_ps(s2, s3, _MM_SHUFFLE(3, 1, 3, 1))));
+  l0 = _mm_srli_epi32(_mm_add_epi32(l0, round), 8);
+  l1 = _mm_srli_epi32(_mm_add_epi32(l1, round), 8);
+  return _mm_packs_epi32(l0, l1);
+}
+
+/* RGBA -> gray: 8 pixels per step */
+static void convert_4_1_sse2(const unsigned char* src, unsigned char* dst, int count)
+{
+  int i;
+  for(i = 0; i + 8 <= count; i += 8)
+    {
+      __m128i p0 = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 4));
+      __m128i p1 = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 4 + 16));
+      __m128i l = luma_8(p0, p1);
+      _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(l, l));
+    }
+  convert_scalar(src + (size_t)i * 4, 4, dst + i, 1, count - i);
+}
+
+/* RGB -> gray: spread 4 pixels to RGBx with a shuffle, then as above */
+PIXEL_TARGET_SSSE3
+static void convert_3_1_ssse3(const unsigned char* src, unsigned char* dst, int count)
+{
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  int i;
+  for(i = 0; i + 10 <= count; i += 8)
+    {
+      __m128i p0 = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 3));
+      __m128i p1 = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 3 + 12));
+      __m128i l = luma_8(_mm_shuffle_epi8(p0, shuffle), _mm_shuffle_epi8(p1, shuffle));
+      _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(l, l));
+    }
+  convert_scalar(src + (size_t)i * 3, 3, dst + i, 1, count - i);
+}
+
+/* 16 samples per step: keep the first (high) byte of every big endian word */
+static void strip16_sse2(const unsigned char* src, unsigned char* dst, int count)
+{
+  const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+  int i;
+  for(i = 0; i + 16 <= count; i += 16)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 2));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + (size_t)i * 2 + 16));
+      _mm_storeu_si128((__m128i*)(dst + i),
+                       _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes)));
+    }
+  strip16_scalar(src + (size_t)i * 2, dst + i, count - i);
+}
+
+static bool has_ssse3(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3");
+}
+#endif
+
+struct converter_entry
+{
+  pixel_convert_fn fn;
+  const char* name;
+};
+
+static struct converter_entry find_converter(int srcChannels, int dstChannels, enum pixel_kernel kernel)
+{
+  static const pixel_convert_fn scalar[4][4] =
+    {
+      { copy_1, convert_1_2_scalar, convert_1_3_scalar, convert_1_4_scalar },
+      { convert_2_1_scalar, copy_2, convert_2_3_scalar, convert_2_4_scalar },
+      { convert_3_1_scalar, convert_3_2_scalar, copy_3, convert_3_4_scalar },
+      { convert_4_1_scalar, convert_4_2_scalar, convert_4_3_scalar, copy_4 }
+    };
+  struct converter_entry entry = { NULL, "none" };
+  if (srcChannels < 1 || srcChannels > 4 || dstChannels < 1 || dstChannels > 4)
+    return entry;
+  entry.fn = scalar[srcChannels - 1][dstChannels - 1];
+  entry.name = srcChannels == dstChannels ? "memcpy" : "scalar";
+  if (kernel == PIXEL_KERNEL_SCALAR)
+    return entry;
+
+#ifdef PIXEL_HAVE_SSE2
+  if (srcChannels == 1 && dstChannels == 4)
+    {
+      entry.fn = convert_1_4_sse2;
+      entry.name = "sse2";
+    }
+  else if (srcChannels == 2 && dstChannels == 4)
+    {
+      entry.fn = convert_2_4_sse2;
+      entry.name = "sse2";
+    }
+  else if (srcChannels == 3 && dstChannels == 4 && has_ssse3())
+    {
+      entry.fn = convert_3_4_ssse3;
+      entry.name = "ssse3";
+    }
+  else if (srcChannels == 4 && dstChannels == 3 && has_ssse3())
+    {
+      entry.fn = convert_4_3_ssse3;
+      entry.name = "ssse3";
+    }
+  else if (srcChannels == 4 && dstChannels == 1)
+    {
+      entry.fn = convert_4_1_sse2;
+      entry.name = "sse2";
+    }
+  else if (srcChannels == 3 && dstChannels == 1 && has_ssse3())
+    {
+      entry.fn = convert_3_1_ssse3;
+      entry.name = "ssse3";
+    }
+#endif
+  return entry;
+}
+
+pixel_convert_fn pixel_converter(int srcChannels, int dstChannels, enum pixel_kernel kernel)
+{
+  return find_converter(srcChannels, dstChannels, kernel).fn;
+}
+
+const char* pixel_converter_name(int srcChannels, int dstChannels, enum pixel_kernel kernel)
+{
+  return find_converter(srcChannels, dstChannels, kernel).name;
+}
+
+pixel_convert_fn pixel_strip16(enum pixel_kernel kernel)
+{
+#ifdef PIXEL_HAVE_SSE2
+  if (kernel != PIXEL_KERNEL_SCALAR)
+    return strip16_sse2;
+#endif
+  return strip16_scalar;
+}
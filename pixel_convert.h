@@ -0,0 +1,42 @@
+/*
+ * Row converters between 8-bit pixel layouts (gray, gray+alpha, RGB, RGBA).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <stdbool.h>
+
+enum pixel_kernel
+{
+  PIXEL_KERNEL_AUTO,    /* SIMD where this CPU has a kernel for it */
+  PIXEL_KERNEL_SCALAR
+};
+
+/*
+ * Convert 'count' pixels. src and dst must not overlap.
+ *
+ * Channel counts are 1 (gray), 2 (gray, alpha), 3 (RGB) or 4 (RGBA).
+ * Gray expands to equal RGB, missing alpha becomes 255, RGB narrows to gray
+ * by its Rec. 601 luma.
+ */
+typedef void (*pixel_convert_fn)(const unsigned char* src, unsigned char* dst, int count);
+
+pixel_convert_fn pixel_converter(int srcChannels, int dstChannels, enum pixel_kernel kernel);
+
+/*
+ * 16-bit big endian samples (as PNG stores them) to 8 bits, keeping the
+ * high byte; 'count' is the number of samples, not pixels.
+ */
+pixel_convert_fn pixel_strip16(enum pixel_kernel kernel);
+
+/* name of the implementation pixel_converter picked, e.g. "ssse3" */
+const char* pixel_converter_name(int srcChannels, int dstChannels, enum pixel_kernel kernel);
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Throughput of every pixel layout conversion, scalar against the SIMD
+ * kernel picked for this CPU, with a check that both agree.
+ *
+ *   pixel_convert_bench [--pixels N] [--runs N]
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "app.h"
+#include "pixel_convert.h"
+#include "timing.h"
+
+/* best of 'runs', in seconds */
+static double time_convert(pixel_convert_fn fn, const unsigned char* src, unsigned char* dst,
+                           int count, int runs)
+{
+  double best = 0;
+  int i;
+  for(i = 0; i < runs; i++)
+    {
+      double start = timing_now();
+      fn(src, dst, count);
+      double elapsed = timing_now() - start;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+  return best;
+}
+
+static void report(const char* label, const char* name, size_t bytes,
+                   double scalar, double best, bool same)
+{
+  printf("%-8s scalar %9.1f MB/s  %-7s %9.1f MB/s  %5.2fx%s\n", label,
+         bytes / scalar / 1e6, name, bytes / best / 1e6, scalar / best,
+         same ? "" : "  MISMATCH");
+}
+
+int main(int argc, char** argv)
+{
+  const char* pixelsOption = app_option(argc, argv, "--pixels");
+  const char* runsOption = app_option(argc, argv, "--runs");
+  int count = pixelsOption != NULL ? atoi(pixelsOption) : 2048 * 2048;
+  int runs = runsOption != NULL ? atoi(runsOption) : 10;
+  if (count < 1 || runs < 1)
+    {
+      fprintf(stderr, "usage: %s [--pixels N] [--runs N]\n", argv[0]);
+      return -1;
+    }
+
+  // big enough for 16-bit RGBA; contents do not matter for speed
+  size_t size = (size_t)count * 8;
+  unsigned char* src = malloc(size);
+  unsigned char* scalarOut = malloc(size);
+  unsigned char* simdOut = malloc(size);
+  size_t i;
+  srand(1);
+  for(i = 0; i < size; i++)
+    src[i] = rand();
+
+  printf("%d pixels, best of %d, throughput counts output bytes\n", count, runs);
+  int from;
+  int to;
+  for(from = 1; from <= 4; from++)
+    {
+      for(to = 1; to <= 4; to++)
+        {
+          if (from == to)
+            continue;
+          pixel_convert_fn scalar = pixel_converter(from, to, PIXEL_KERNEL_SCALAR);
+          pixel_convert_fn best = pixel_converter(from, to, PIXEL_KERNEL_AUTO);
+          size_t bytes = (size_t)count * to;
+          double scalarTime = time_convert(scalar, src, scalarOut, count, runs);
+          double bestTime = time_convert(best, src, simdOut, count, runs);
+          char label[16];
+          snprintf(label, sizeof(label), "%d -> %d", from, to);
+          report(label, pixel_converter_name(from, to, PIXEL_KERNEL_AUTO), bytes,
+                 scalarTime, bestTime, memcmp(scalarOut, simdOut, bytes) == 0);
+        }
+    }
+
+  // 16-bit RGBA rows
+  int samples = count * 4;
+  double scalarTime = time_convert(pixel_strip16(PIXEL_KERNEL_SCALAR), src, scalarOut, samples, runs);
+  double bestTime = time_convert(pixel_strip16(PIXEL_KERNEL_AUTO), src, simdOut, samples, runs);
+  report("16 -> 8", "strip16", samples, scalarTime, bestTime,
+         memcmp(scalarOut, simdOut, samples) == 0);
+
+  free(src);
+  free(scalarOut);
+  free(simdOut);
+  return 0;
+}
@@ -0,0 +1,543 @@
+/*
+ * Build GLSL programs in batches, keeping linked binaries on disk.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "program_cache.h"
+#include "shader.h"
+#include "mapped_file.h"
+#include "timing.h"
+
+static const char cacheMagic[8] = "GLHPRG1";
+
+static const char legacyVersion[] = "#version 120";
+
+// these replace the first line of the source
+static const char vertexPreamble[] =
+  "#version 330 core\n"
+  "#define attribute in\n"
+  "#define varying out\n"
+  "#define texture2D texture\n";
+
+static const char fragmentPreamble[] =
+  "#version 330 core\n"
+  "#define varying in\n"
+  "#define texture2D texture\n"
+  "out vec4 fragColor;\n"
+  "#define gl_FragColor fragColor\n";
+
+static const char versionDirective[] = "#version";
+
+struct cache_header
+{
+  char magic[8];
+  uint64_t key;
+  uint32_t format;
+  uint32_t length;
+};
+
+/* per-program scratch data while building */
+struct build_state
+{
+  struct mapped_file vertexCode;
+  struct mapped_file fragmentCode;
+  uint64_t key;
+};
+
+static uint64_t fnv1a_bytes(uint64_t hash, const unsigned char* data, size_t size)
+{
+  size_t i;
+  for(i = 0; i < size; i++)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+  // a terminating NUL so that "ab"+"c" != "a"+"bc"
+  hash *= 1099511628211ULL;
+  return hash;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char* text)
+{
+  return fnv1a_bytes(hash, (const unsigned char*)text, strlen(text));
+}
+
+static const char* gl_string(GLenum name)
+{
+  const char* s = (const char*)glGetString(name);
+  return s == NULL ? "" : s;
+}
+
+static uint64_t program_key(const struct program_cache* cache,
+                            const struct mapped_file* vertexCode,
+                            const struct mapped_file* fragmentCode,
+                            const char* const* attributes, const char* defines)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  if (cache->coreProfile)
+    {
+      hash = fnv1a(hash, vertexPreamble);
+      hash = fnv1a(hash, fragmentPreamble);
+    }
+  if (defines != NULL)
+    hash = fnv1a(hash, defines);
+  hash = fnv1a_bytes(hash, vertexCode->data, vertexCode->size);
+  hash = fnv1a_bytes(hash, fragmentCode->data, fragmentCode->size);
+  // the binary has the attribute locations linked in
+  for(; attributes != NULL && *attributes != NULL; attributes++)
+    hash = fnv1a(hash, *attributes);
+  hash = fnv1a(hash, gl_string(GL_VENDOR));
+  hash = fnv1a(hash, gl_string(GL_RENDERER));
+  hash = fnv1a(hash, gl_string(GL_VERSION));
+  return hash;
+}
+
+static void cache_path(const struct program_cache* cache, uint64_t key, char* path, size_t size)
+{
+  snprintf(path, size, "%s/%016llx.bin", cache->directory, (unsigned long long)key);
+}
+
+static bool load_binary(const struct program_cache* cache, uint64_t key, GLuint program)
+{
+  char path[4096];
+  cache_path(cache, key, path, sizeof(path));
+  // a miss is normal, not worth a message
+  if (access(path, R_OK) != 0)
+    return false;
+  struct mapped_file file;
+  if (!mapped_file_open(&file, path, MAPPED_WILLNEED))
+    return false;
+
+  // the binary goes to the driver straight from the mapping
+  struct cache_header header;
+  bool loaded = false;
+  if (file.size >= sizeof(header))
+    {
+      memcpy(&header, file.data, sizeof(header));
+      if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+          && header.key == key && header.length <= file.size - sizeof(header))
+        {
+          glProgramBinary(program, header.format, file.data + sizeof(header), header.length);
+          GLint linkStatus = GL_FALSE;
+          glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+          loaded = linkStatus == GL_TRUE;
+        }
+    }
+  mapped_file_close(&file);
+  return loaded;
+}
+
+static void store_binary(const struct program_cache* cache, uint64_t key, GLuint program)
+{
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  struct cache_header header;
+  memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+  header.key = key;
+  header.length = length;
+  void* binary = malloc(length);
+  GLenum format;
+  glGetProgramBinary(program, length, NULL, &format, binary);
+  header.format = format;
+
+  // write to a temporary name first, so a crash never leaves a torn file
+  char path[4096];
+  char tempPath[4200];
+  cache_path(cache, key, path, sizeof(path));
+  snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+  FILE* fp = fopen(tempPath, "wb");
+  if (fp != NULL)
+    {
+      bool written = fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(binary, 1, length, fp) == (size_t)length;
+      if (fclose(fp) == 0 && written)
+        rename(tempPath, path);
+      else
+        remove(tempPath);
+    }
+  free(binary);
+}
+
+void program_cache_init(struct program_cache* cache, const char* directory)
+{
+  memset(cache, 0, sizeof(*cache));
+  cache->directory = directory;
+
+  GLint formatCount = 0;
+  if (GLEW_ARB_get_program_binary)
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  cache->binarySupported = formatCount > 0;
+
+  if (GLEW_VERSION_3_2)
+    {
+      GLint profile = 0;
+      glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+      cache->coreProfile = (profile & GL_CONTEXT_CORE_PROFILE_BIT) != 0;
+    }
+
+  if (cache->directory != NULL && cache->binarySupported)
+    {
+      if (mkdir(cache->directory, 0755) != 0 && errno != EEXIST)
+        {
+          fprintf(stderr, "WARNING: cannot create program cache '%s', cache disabled\n",
+                  cache->directory);
+          cache->directory = NULL;
+        }
+    }
+}
+
+/* the number after "#version", within 'length' bytes */
+static int glsl_version(const unsigned char* text, size_t length)
+{
+  size_t i = 0;
+  while(i < length && (text[i] == ' ' || text[i] == '\t'))
+    i++;
+  int version = 0;
+  while(i < length && text[i] >= '0' && text[i] <= '9')
+    version = version * 10 + (text[i++] - '0');
+  return version;
+}
+
+/*
+ * The source comes straight from the mapping: explicit length, no NUL
+ * needed. The core preamble and 'defines' go after the #version line,
+ * followed by a #line directive so that error messages keep the line
+ * numbers of the file.
+ */
+static GLuint submit_shader(const struct program_cache* cache, GLenum type,
+                            const struct mapped_file* code, const char* defines)
+{
+  GLuint shader = glCreateShader(type);
+  const GLchar* texts[4];
+  GLint lengths[4];
+  int count = 0;
+  const GLchar* body = (const GLchar*)code->data;
+  GLint bodyLength = code->size;
+  size_t legacyLength = sizeof(legacyVersion) - 1;
+  size_t versionLength = sizeof(versionDirective) - 1;
+  bool core = cache->coreProfile && code->size >= legacyLength
+    && memcmp(code->data, legacyVersion, legacyLength) == 0;
+  bool versioned = code->size >= versionLength
+    && memcmp(code->data, versionDirective, versionLength) == 0;
+
+  if (core || (defines != NULL && versioned))
+    {
+      const unsigned char* newline = memchr(code->data, '\n', code->size);
+      size_t firstLine = newline != NULL ? (size_t)(newline - code->data) + 1 : code->size;
+      if (core)
+        {
+          // the preamble brings its own #version
+          texts[count] = type == GL_VERTEX_SHADER ? vertexPreamble : fragmentPreamble;
+          lengths[count] = strlen(texts[count]);
+          count++;
+        }
+      else
+        {
+          texts[count] = body;
+          lengths[count++] = firstLine;
+        }
+      if (defines != NULL)
+        {
+          texts[count] = defines;
+          lengths[count++] = strlen(defines);
+        }
+      // before GLSL 3.30, "#line N" numbers the line after it N + 1
+      int version = core ? 330 : glsl_version(code->data + versionLength, firstLine - versionLength);
+      texts[count] = version >= 330 ? "#line 2\n" : "#line 1\n";
+      lengths[count++] = 8;
+      body += firstLine;
+      bodyLength -= firstLine;
+    }
+  else if (defines != NULL)
+    {
+      texts[count] = defines;
+      lengths[count++] = strlen(defines);
+      texts[count] = "#line 0\n";
+      lengths[count++] = 8;
+    }
+  texts[count] = body;
+  lengths[count++] = bodyLength;
+  glShaderSource(shader, count, texts, lengths);
+  glCompileShader(shader);
+  return shader;
+}
+
+static bool check_program(const struct program_source* source)
+{
+  int status;
+  glGetShaderiv(source->vertexShader, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE)
+    {
+      fprintf(stderr, "ERROR: while compiling vertex shader '%s'\n", source->vertexPath);
+      show_gl_shader_compilation_error(source->vertexShader);
+      return false;
+    }
+  glGetShaderiv(source->fragmentShader, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE)
+    {
+      fprintf(stderr, "ERROR: while compiling fragment shader '%s'\n", source->fragmentPath);
+      show_gl_shader_compilation_error(source->fragmentShader);
+      return false;
+    }
+  glGetProgramiv(source->program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE)
+    {
+      fprintf(stderr, "ERROR: while linking shader\n");
+      show_gl_linking_error(source->program);
+      return false;
+    }
+  return true;
+}
+
+bool program_cache_build(struct program_cache* cache, struct program_source* programs, int count)
+{
+  double startTime = timing_now();
+  bool useCache = cache->directory != NULL && cache->binarySupported;
+  // let the driver use as many compiler threads as it likes
+#ifdef GLEW_KHR_parallel_shader_compile
+  if (GLEW_KHR_parallel_shader_compile)
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+#endif
+#ifdef GLEW_ARB_parallel_shader_compile
+  if (GLEW_ARB_parallel_shader_compile)
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+#endif
+
+  struct build_state* states = calloc(count, sizeof(struct build_state));
+  bool success = true;
+  int i;
+
+  // 1. read every source and try the cache
+  for(i = 0; i < count; i++)
+    {
+      struct program_source* source = &programs[i];
+      source->program = 0;
+      source->vertexShader = 0;
+      source->fragmentShader = 0;
+      source->fromCache = false;
+
+      if (!mapped_file_open(&states[i].vertexCode, source->vertexPath, MAPPED_WILLNEED)
+          || !mapped_file_open(&states[i].fragmentCode, source->fragmentPath, MAPPED_WILLNEED))
+        {
+          success = false;
+          continue;
+        }
+
+      source->program = glCreateProgram();
+      if (useCache)
+        {
+          states[i].key = program_key(cache, &states[i].vertexCode, &states[i].fragmentCode,
+                                      source->attributes, source->defines);
+          if (load_binary(cache, states[i].key, source->program))
+            {
+              source->fromCache = true;
+              cache->hits++;
+              continue;
+            }
+        }
+      cache->misses++;
+    }
+
+  // 2. submit all compiles, then all links, without looking at any status
+  for(i = 0; i < count; i++)
+    {
+      struct program_source* source = &programs[i];
+      if (source->program == 0 || source->fromCache)
+        continue;
+      source->vertexShader = submit_shader(cache, GL_VERTEX_SHADER, &states[i].vertexCode,
+                                             source->defines);
+      source->fragmentShader = submit_shader(cache, GL_FRAGMENT_SHADER, &states[i].fragmentCode,
+                                               source->defines);
+    }
+  for(i = 0; i < count; i++)
+    {
+      struct program_source* source = &programs[i];
+      if (source->program == 0 || source->fromCache)
+        continue;
+      glAttachShader(source->program, source->vertexShader);
+      glAttachShader(source->program, source->fragmentShader);
+      GLuint location;
+      for(location = 0; source->attributes != NULL && source->attributes[location] != NULL; location++)
+        glBindAttribLocation(source->program, location, source->attributes[location]);
+      if (useCache)
+        glProgramParameteri(source->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      glLinkProgram(source->program);
+    }
+
+  // 3. only now look at the results; each status query blocks until
+  // that program is done, while the rest keep compiling
+  for(i = 0; i < count; i++)
+    {
+      struct program_source* source = &programs[i];
+      if (source->program == 0 || source->fromCache)
+        continue;
+      if (!check_program(source))
+        {
+          success = false;
+          continue;
+        }
+      if (useCache)
+        store_binary(cache, states[i].key, source->program);
+    }
+
+  for(i = 0; i < count; i++)
+    {
+      mapped_file_close(&states[i].vertexCode);
+      mapped_file_close(&states[i].fragmentCode);
+    }
+  free(states);
+
+  cache->buildSeconds = timing_now() - startTime;
+  return success;
+}
+
+/* compile 'path' as a new shader; 0 (and an error printed) on failure */
+static GLuint compile_file(const struct program_cache* cache, GLenum type, const char* path,
+                           const char* defines)
+{
+  struct mapped_file code;
+  if (!mapped_file_open(&code, path, MAPPED_WILLNEED))
+    return 0;
+  GLuint shader = submit_shader(cache, type, &code, defines);
+  mapped_file_close(&code);
+
+  int status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE)
+    {
+      fprintf(stderr, "ERROR: while compiling %s shader '%s'\n",
+              type == GL_VERTEX_SHADER ? "vertex" : "fragment", path);
+      show_gl_shader_compilation_error(shader);
+      glDeleteShader(shader);
+      return 0;
+    }
+  return shader;
+}
+
+bool program_cache_rebuild(struct program_cache* cache, struct program_source* source,
+                           bool vertexChanged, bool fragmentChanged)
+{
+  double startTime = timing_now();
+  GLuint vertexShader = source->vertexShader;
+  GLuint fragmentShader = source->fragmentShader;
+  if (vertexChanged || vertexShader == 0)
+    vertexShader = compile_file(cache, GL_VERTEX_SHADER, source->vertexPath, source->defines);
+  if (fragmentChanged || fragmentShader == 0)
+    fragmentShader = compile_file(cache, GL_FRAGMENT_SHADER, source->fragmentPath, source->defines);
+
+  GLuint program = 0;
+  if (vertexShader != 0 && fragmentShader != 0)
+    {
+      program = glCreateProgram();
+      glAttachShader(program, vertexShader);
+      glAttachShader(program, fragmentShader);
+      GLuint location;
+      for(location = 0; source->attributes != NULL && source->attributes[location] != NULL; location++)
+        glBindAttribLocation(program, location, source->attributes[location]);
+      if (source->attributes == NULL && source->program != 0)
+        {
+          // VAOs and cached attribute indices stay valid
+          GLint count = 0;
+          glGetProgramiv(source->program, GL_ACTIVE_ATTRIBUTES, &count);
+          GLint i;
+          for(i = 0; i < count; i++)
+            {
+              char name[256];
+              GLint size;
+              GLenum type;
+              glGetActiveAttrib(source->program, i, sizeof(name), NULL, &size, &type, name);
+              GLint old = glGetAttribLocation(source->program, name);
+              if (old >= 0)
+                glBindAttribLocation(program, old, name);
+            }
+        }
+      glLinkProgram(program);
+
+      int status;
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+      if (status != GL_TRUE)
+        {
+          fprintf(stderr, "ERROR: while linking shader\n");
+          show_gl_linking_error(program);
+          glDeleteProgram(program);
+          program = 0;
+        }
+    }
+
+  if (program == 0)
+    {
+      // keep whatever still belongs to the old program
+      if (vertexShader != 0 && vertexShader != source->vertexShader)
+        glDeleteShader(vertexShader);
+      if (fragmentShader != 0 && fragmentShader != source->fragmentShader)
+        glDeleteShader(fragmentShader);
+      return false;
+    }
+
+  // a reused shader is attached to the new program as well
+  if (source->vertexShader != 0)
+    {
+      glDetachShader(source->program, source->vertexShader);
+      if (source->vertexShader != vertexShader)
+        glDeleteShader(source->vertexShader);
+    }
+  if (source->fragmentShader != 0)
+    {
+      glDetachShader(source->program, source->fragmentShader);
+      if (source->fragmentShader != fragmentShader)
+        glDeleteShader(source->fragmentShader);
+    }
+  glDeleteProgram(source->program);
+  source->program = program;
+  source->vertexShader = vertexShader;
+  source->fragmentShader = fragmentShader;
+  source->fromCache = false;
+  cache->buildSeconds = timing_now() - startTime;
+  return true;
+}
+
+void program_source_delete(struct program_source* source)
+{
+  if (source->vertexShader != 0)
+    {
+      glDetachShader(source->program, source->vertexShader);
+      glDeleteShader(source->vertexShader);
+    }
+  if (source->fragmentShader != 0)
+    {
+      glDetachShader(source->program, source->fragmentShader);
+      glDeleteShader(source->fragmentShader);
+    }
+  if (source->program != 0)
+    glDeleteProgram(source->program);
+  source->program = 0;
+  source->vertexShader = 0;
+  source->fragmentShader = 0;
+}
+
+void program_cache_report(const struct program_cache* cache)
+{
+  const char* state;
+  if (cache->directory == NULL || !cache->binarySupported)
+    state = "no cache";
+  else if (cache->misses == 0)
+    state = "warm cache";
+  else
+    state = "cold cache";
+  printf("program setup: %.3f ms (%s, %d loaded, %d compiled)\n",
+         cache->buildSeconds * 1000.0, state, cache->hits, cache->misses);
+}
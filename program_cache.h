@@ -0,0 +1,89 @@
+/*
+ * Build GLSL programs in batches, keeping linked binaries on disk.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+/*
+ * One program to build. Fill in the two paths (and optionally the
+ * attribute list and defines), the rest is output. vertexShader/fragmentShader stay 0
+ * when the program came from the cache.
+ */
+struct program_source
+{
+  const char* vertexPath;
+  const char* fragmentPath;
+  /* NULL-terminated names bound to locations 0, 1, ... before linking;
+     NULL leaves the locations to the linker */
+  const char* const* attributes;
+  /* "#define NAME\n" lines for both stages, inserted after #version;
+     NULL for none. Part of the cache key. */
+  const char* defines;
+
+  GLuint program;
+  GLuint vertexShader;
+  GLuint fragmentShader;
+  bool fromCache;
+};
+
+/*
+ * The shaders are written in GLSL 1.20. In a core profile context, where
+ * 1.20 is not available, a source starting with "#version 120" gets a
+ * GLSL 3.30 preamble instead that maps attribute/varying to in/out,
+ * texture2D to texture and gl_FragColor to an output variable.
+ *
+ * Binaries are stored as <directory>/<key>.bin, where the key is a hash of
+ * both shader sources and GL vendor, renderer and version strings. A driver
+ * update therefore produces a new key; a binary the driver refuses anyway
+ * is silently recompiled and overwritten.
+ */
+struct program_cache
+{
+  const char* directory;  /* NULL: cache disabled */
+  bool binarySupported;   /* GL_ARB_get_program_binary with >0 formats */
+  bool coreProfile;       /* "#version 120" sources are compiled as GLSL 3.30 */
+  int hits;
+  int misses;
+  double buildSeconds;    /* wall time of the last program_cache_build */
+};
+
+void program_cache_init(struct program_cache* cache, const char* directory);
+
+/*
+ * Build all programs. Cache misses are compiled together: every shader is
+ * submitted before any status is queried, so drivers with
+ * KHR_parallel_shader_compile (or threaded compilers in general) can work on
+ * them concurrently. Returns false if any program failed to build.
+ */
+bool program_cache_build(struct program_cache* cache, struct program_source* programs, int count);
+
+/*
+ * Rebuild one program after its sources changed on disk: compile the
+ * changed stages again (the others too if the program came from the
+ * cache and has no shader objects), and link a new program. Attributes
+ * keep the locations they had, even without an attribute list. Only on
+ * success are the old program and replaced shaders deleted and 'source'
+ * updated; otherwise it is left untouched and still usable. Uniform
+ * values start over in the new program. The binary cache is not updated.
+ */
+bool program_cache_rebuild(struct program_cache* cache, struct program_source* source,
+                           bool vertexChanged, bool fragmentChanged);
+
+/* detach and delete shaders and the program */
+void program_source_delete(struct program_source* source);
+
+/* one line summary: build time, hits and misses */
+void program_cache_report(const struct program_cache* cache);
+
+#endif
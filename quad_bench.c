@@ -0,0 +1,161 @@
+/*
+ * Quads per second of every instanced_quads path, sweeping the number of
+ * quads drawn per frame.
+ *
+ *   quad_bench [--headless] [--runs N] [--max N] [texture]
+ *
+ * Counts go 1, 10, 100, ... up to --max (default 100000). Each point draws
+ * --runs frames (default 30, after two warm-up frames), moving every
+ * quad each frame so the instance data is uploaded again, and waits for
+ * the GPU at the end of each frame. "cpu" is the time spent building and
+ * submitting the quads, "frame" includes the wait. Use a small --size to
+ * keep fill rate out of the numbers.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "instanced_quads.h"
+#include "texture_file.h"
+#include "timing.h"
+
+static void layout_quads(struct quad_instance* quads, int count, int frame)
+{
+  int columns = (int)ceil(sqrt(count));
+  float cell = 2.0f / columns;
+  float shift = (frame % 2) * 0.1f * cell;
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      struct quad_instance* q = &quads[i];
+      q->offset[0] = -1.0f + cell * (i % columns + 0.5f) + shift;
+      q->offset[1] = 1.0f - cell * (i / columns + 0.5f);
+      q->scale[0] = 0.4f * cell;
+      q->scale[1] = 0.4f * cell;
+      q->uvRect[0] = 0.0f;
+      q->uvRect[1] = 0.0f;
+      q->uvRect[2] = 1.0f;
+      q->uvRect[3] = 1.0f;
+      q->tint[0] = 195 / 255.0f;
+      q->tint[1] = 180 / 255.0f;
+      q->tint[2] = 218 / 255.0f;
+      q->tint[3] = 1.0f;
+    }
+}
+
+static void run(struct quad_renderer* renderer, struct quad_instance* quads, int count, int frames)
+{
+  double cpuTime = 0;
+  double start = 0;
+  int frame;
+  for(frame = -2; frame < frames; frame++)
+    {
+      if (frame == 0)
+        {
+          cpuTime = 0;
+          start = timing_now();
+        }
+      glClear(GL_COLOR_BUFFER_BIT);
+      double submitStart = timing_now();
+      layout_quads(quads, count, frame);
+      quad_renderer_draw(renderer, quads, count);
+      cpuTime += timing_now() - submitStart;
+      glFinish();
+    }
+  double total = timing_now() - start;
+  printf("%-9s %7d quads %6d draws  cpu %9.3f ms  frame %9.3f ms  %12.0f quads/s\n",
+         quad_path_name(renderer->path), count, renderer->drawCalls,
+         cpuTime * 1000.0 / frames, total * 1000.0 / frames, (double)count * frames / total);
+}
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--runs", "--max", NULL };
+  return app_option_value(argv, i, valued);
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Quad benchmark", 0))
+    return -1;
+
+  const char* runsOption = app_option(argc, argv, "--runs");
+  int frames = runsOption != NULL ? atoi(runsOption) : 30;
+  if (frames < 1)
+    frames = 1;
+  const char* maxOption = app_option(argc, argv, "--max");
+  int maxCount = maxOption != NULL ? atoi(maxOption) : 100000;
+  const char* file = "texture.png";
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      file = argv[i];
+    }
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "instancedTexture.vertex", "texture.frag", quadAttributes);
+  struct shader_variant* program = shader_variants_get(&variants, SHADER_VERTEX_TINT);
+  if (program == NULL)
+    return -1;
+  glUseProgram(program->source.program);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+
+  struct texture_load_options loadOptions;
+  texture_load_options_init(&loadOptions, 0);
+  struct texture_info textureInfo;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  if (!load_texture_file(file, &loadOptions, &textureInfo))
+    return -1;
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  int w;
+  int h;
+  app_get_size(&app, &w, &h);
+  glViewport(0, 0, w, h);
+
+  printf("%dx%d, %d frames per point, %s\n", w, h, frames, glGetString(GL_RENDERER));
+  struct quad_instance* quads = malloc(sizeof(struct quad_instance) * maxCount);
+  enum quad_path path;
+  for(path = QUAD_PATH_INSTANCED; path <= QUAD_PATH_SEPARATE; path++)
+    {
+      if (!quad_path_supported(path))
+        {
+          printf("%-9s not available\n", quad_path_name(path));
+          continue;
+        }
+      struct quad_renderer renderer;
+      quad_renderer_init(&renderer, path);
+      int count;
+      for(count = 1; count <= maxCount; count *= 10)
+        run(&renderer, quads, count, frames);
+      quad_renderer_free(&renderer);
+    }
+
+  free(quads);
+  glDeleteTextures(1, &texture);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+  app_terminate(&app);
+  return 0;
+}
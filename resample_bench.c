@@ -0,0 +1,299 @@
+/*
+ * Time mip_resample (every kernel, single and multi threaded) against a
+ * naive scalar resampler that recomputes every weight and decodes with
+ * pow(), and report how far the two disagree.
+ *
+ *   resample_bench [--size WxH] [--to WxH] [--filter lanczos|mitchell]
+ *                  [--threads N] [--runs N] [--gray] [file.png]
+ *
+ * Without a file the input is a synthetic W x H (default 3840x2160, 4K)
+ * RGBA image of gradients, hard edges and varying alpha; it is scaled to
+ * the next power of two (4096x4096) unless --to says otherwise.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "app.h"
+#include "image_loader.h"
+#include "mipmap.h"
+#include "timing.h"
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--size", "--to", "--filter", "--threads", "--runs", NULL };
+  int k;
+  for(k = 0; valued[k] != NULL; k++)
+    {
+      if (strcmp(argv[i - 1], valued[k]) == 0)
+        return true;
+    }
+  return false;
+}
+
+static int next_power_of_2(int n)
+{
+  int p = 1;
+  while(p < n)
+    p *= 2;
+  return p;
+}
+
+static unsigned char* synthetic_image(int w, int h, int channels)
+{
+  unsigned char* pixels = malloc((size_t)w * h * channels);
+  unsigned int seed = 1;
+  int x;
+  int y;
+  for(y = 0; y < h; y++)
+    {
+      for(x = 0; x < w; x++)
+        {
+          unsigned char* p = pixels + ((size_t)y * w + x) * channels;
+          seed = seed * 1103515245u + 12345u;
+          bool checker = ((x / 37) + (y / 29)) % 2 != 0;
+          p[0] = checker ? (unsigned char)(x * 255 / w) : 255 - (unsigned char)(y * 255 / h);
+          if (channels == 1)
+            continue;
+          p[1] = (unsigned char)((x ^ y) & 0xff);
+          p[2] = (unsigned char)(seed >> 24);
+          p[3] = x % 200 < 20 ? 0 : (unsigned char)(128 + 127 * sin(y * 0.01));
+        }
+    }
+  return pixels;
+}
+
+static float naive_decode(unsigned char v, bool srgb)
+{
+  double c = v / 255.0;
+  if (!srgb)
+    return c;
+  return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static unsigned char naive_encode(double l, bool srgb)
+{
+  l = l < 0.0 ? 0.0 : (l > 1.0 ? 1.0 : l);
+  if (srgb)
+    l = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1 / 2.4) - 0.055;
+  return (unsigned char)(l * 255.0 + 0.5);
+}
+
+/*
+ * The textbook version: decode everything, then for every destination
+ * texel of each pass walk the filter support, computing each weight and
+ * clamping each index on the spot, normalizing by the weight sum.
+ */
+static void naive_pass(const float* src, int n, int count, size_t step, size_t lineStep,
+                       float* dst, int dn, size_t dstStep, size_t dstLineStep,
+                       int channels, enum resample_filter filter)
+{
+  double scale = (double)n / dn;
+  double stretch = scale > 1.0 ? scale : 1.0;
+  double support = resample_filter_radius(filter) * stretch;
+  int line;
+  int x;
+  int c;
+  for(line = 0; line < count; line++)
+    {
+      for(x = 0; x < dn; x++)
+        {
+          double center = (x + 0.5) * scale - 0.5;
+          int first = (int)floor(center - support) + 1;
+          int last = (int)floor(center + support);
+          double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+          double sum = 0.0;
+          int i;
+          for(i = first; i <= last; i++)
+            {
+              double weight = resample_filter_weight(filter, (i - center) / stretch);
+              int clamped = i < 0 ? 0 : (i >= n ? n - 1 : i);
+              const float* texel = src + line * lineStep + clamped * step;
+              for(c = 0; c < channels; c++)
+                acc[c] += weight * texel[c];
+              sum += weight;
+            }
+          float* out = dst + line * dstLineStep + x * dstStep;
+          for(c = 0; c < channels; c++)
+            out[c] = (float)(acc[c] / sum);
+        }
+    }
+}
+
+static void naive_resample(const unsigned char* pixels, int w, int h, int channels,
+                           unsigned char* out, int dw, int dh, enum resample_filter filter, bool srgb)
+{
+  float* src = malloc(sizeof(float) * w * h * channels);
+  float* tmp = malloc(sizeof(float) * dw * h * channels);
+  float* dst = malloc(sizeof(float) * dw * dh * channels);
+  size_t i;
+  int c;
+  for(i = 0; i < (size_t)w * h; i++)
+    {
+      const unsigned char* p = pixels + i * channels;
+      float a = channels == 4 ? p[3] / 255.0f : 1.0f;
+      for(c = 0; c < channels && c < 3; c++)
+        src[i * channels + c] = naive_decode(p[c], srgb) * a;
+      if (channels == 4)
+        src[i * 4 + 3] = a;
+    }
+  // rows, then columns
+  naive_pass(src, w, h, channels, (size_t)w * channels, tmp, dw, channels, (size_t)dw * channels,
+             channels, filter);
+  naive_pass(tmp, h, dw, (size_t)dw * channels, channels, dst, dh, (size_t)dw * channels, channels,
+             channels, filter);
+  for(i = 0; i < (size_t)dw * dh; i++)
+    {
+      const float* p = dst + i * channels;
+      unsigned char* o = out + i * channels;
+      if (channels == 1)
+        {
+          o[0] = naive_encode(p[0], srgb);
+          continue;
+        }
+      double a = p[3] < 0.0f ? 0.0 : (p[3] > 1.0f ? 1.0 : p[3]);
+      o[3] = (unsigned char)(a * 255.0 + 0.5);
+      for(c = 0; c < 3; c++)
+        o[c] = o[3] == 0 ? 0 : naive_encode(p[c] / a, srgb);
+    }
+  free(src);
+  free(tmp);
+  free(dst);
+}
+
+/* largest per-channel difference, and how many values differ at all */
+static int max_difference(const unsigned char* a, const unsigned char* b, size_t n, size_t* differing)
+{
+  int worst = 0;
+  size_t i;
+  *differing = 0;
+  for(i = 0; i < n; i++)
+    {
+      int d = abs(a[i] - b[i]);
+      if (d > worst)
+        worst = d;
+      if (d != 0)
+        (*differing)++;
+    }
+  return worst;
+}
+
+/* best of 'runs' */
+static double time_resample(const unsigned char* pixels, int w, int h, int channels,
+                            unsigned char* out, int dw, int dh, enum resample_filter filter,
+                            const struct mip_options* options, struct thread_pool* pool, int runs)
+{
+  double best = 0;
+  int i;
+  for(i = 0; i < runs; i++)
+    {
+      double start = timing_now();
+      if (!mip_resample(pixels, w, h, channels, out, dw, dh, filter, options, pool))
+        return -1.0;
+      double elapsed = timing_now() - start;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+  return best;
+}
+
+int main(int argc, char** argv)
+{
+  const char* sizeOption = app_option(argc, argv, "--size");
+  const char* toOption = app_option(argc, argv, "--to");
+  const char* filterOption = app_option(argc, argv, "--filter");
+  const char* threadsOption = app_option(argc, argv, "--threads");
+  const char* runsOption = app_option(argc, argv, "--runs");
+  int channels = app_flag(argc, argv, "--gray") ? 1 : 4;
+  int runs = runsOption != NULL ? atoi(runsOption) : 3;
+  if (runs < 1)
+    runs = 1;
+  enum resample_filter filter = RESAMPLE_LANCZOS3;
+  if (filterOption != NULL && strcmp(filterOption, "mitchell") == 0)
+    filter = RESAMPLE_MITCHELL;
+  const char* file = NULL;
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      file = argv[i];
+    }
+
+  int w = 3840;
+  int h = 2160;
+  unsigned char* pixels;
+  if (file != NULL)
+    pixels = load_image(file, channels, &w, &h, NULL);
+  else
+    {
+      if (sizeOption != NULL && (sscanf(sizeOption, "%dx%d", &w, &h) != 2 || w < 1 || h < 1))
+        {
+          fprintf(stderr, "usage: %s [--size WxH] [--to WxH] [--filter lanczos|mitchell] "
+                  "[--threads N] [--runs N] [--gray] [file.png]\n", argv[0]);
+          return -1;
+        }
+      pixels = synthetic_image(w, h, channels);
+    }
+  if (pixels == NULL)
+    return -1;
+  int dw = next_power_of_2(w);
+  int dh = next_power_of_2(h);
+  if (toOption != NULL)
+    sscanf(toOption, "%dx%d", &dw, &dh);
+
+  size_t n = (size_t)dw * dh * channels;
+  unsigned char* reference = malloc(n);
+  unsigned char* out = malloc(n);
+  struct mip_options options = { MIP_FILTER_BOX, MIP_KERNEL_SCALAR, true };
+  struct thread_pool* pool = thread_pool_create(threadsOption != NULL ? atoi(threadsOption) : 0);
+
+  printf("%s: %dx%d -> %dx%d, %d channel%s, %s, best of %d\n",
+         file != NULL ? file : "synthetic", w, h, dw, dh, channels, channels == 1 ? "" : "s",
+         filter == RESAMPLE_LANCZOS3 ? "lanczos3" : "mitchell", runs);
+  double start = timing_now();
+  naive_resample(pixels, w, h, channels, reference, dw, dh, filter, options.srgb);
+  double naive = timing_now() - start;
+  printf("%-8s %3d thread  %9.3f ms  (run once)\n", "naive", 1, naive * 1000.0);
+
+  static const enum mip_kernel kernels[] = { MIP_KERNEL_SCALAR, MIP_KERNEL_SSE2, MIP_KERNEL_AVX2 };
+  int k;
+  for(k = 0; k < 3; k++)
+    {
+      if (!mip_kernel_supported(kernels[k]))
+        {
+          printf("%-8s not available\n", mip_kernel_name(kernels[k]));
+          continue;
+        }
+      options.kernel = kernels[k];
+      double single = time_resample(pixels, w, h, channels, out, dw, dh, filter, &options, NULL, runs);
+      if (single < 0.0)
+        {
+          printf("%-8s failed\n", mip_kernel_name(kernels[k]));
+          continue;
+        }
+      size_t differing;
+      int diff = max_difference(reference, out, n, &differing);
+      double threaded = time_resample(pixels, w, h, channels, out, dw, dh, filter, &options, pool, runs);
+      printf("%-8s %3d thread  %9.3f ms  (%.2fx naive, max diff %d, %.3f%% of values differ)\n",
+             mip_kernel_name(kernels[k]), 1, single * 1000.0, naive / single, diff,
+             100.0 * differing / n);
+      printf("%-8s %3d threads %9.3f ms  (%.2fx naive)\n",
+             mip_kernel_name(kernels[k]), thread_pool_size(pool), threaded * 1000.0, naive / threaded);
+    }
+
+  thread_pool_destroy(pool);
+  free(reference);
+  free(out);
+  free(pixels);
+  return 0;
+}
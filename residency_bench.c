@@ -0,0 +1,170 @@
+/*
+ * A gallery scrolling through more textures than the texture memory
+ * budget holds, to exercise texture_manager: hits, misses, evictions and
+ * resident bytes against the budget, and frame times while it churns.
+ *
+ *   residency_bench [--headless] [--count N] [--visible K] [--step FRAMES]
+ *                   [--budget MIB] [files...]
+ *
+ * --count entries (default 96) are registered, each loaded separately
+ * from the files in turn (default texture.png and Trollface.png, 1.3 and
+ * 5.3 MiB with mipmaps). Every frame draws --visible consecutive ones
+ * (default 12) in a grid; the window moves on by one entry every --step
+ * frames (default 15) and wraps around. --budget defaults to 64 MiB, a
+ * fifth of the default set but enough for the visible part.
+ *
+ * The gallery animates at 60 frames per second; headless, pass
+ * --on-demand to keep that pace, or the render loop takes the CPU the
+ * (lower priority) loader thread needs.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "sprite_batch.h"
+#include "texture_manager.h"
+#include "thread_pool.h"
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--count", "--visible", "--step", "--budget", NULL };
+  return app_option_value(argv, i, valued);
+}
+
+static double mib(size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Texture residency benchmark", 0))
+    return -1;
+
+  const char* countOption = app_option(argc, argv, "--count");
+  const char* visibleOption = app_option(argc, argv, "--visible");
+  const char* stepOption = app_option(argc, argv, "--step");
+  const char* budgetOption = app_option(argc, argv, "--budget");
+  int count = countOption != NULL ? atoi(countOption) : 96;
+  int visible = visibleOption != NULL ? atoi(visibleOption) : 12;
+  int step = stepOption != NULL ? atoi(stepOption) : 15;
+  double budget = budgetOption != NULL ? atof(budgetOption) : 64.0;
+  if (count < 1)
+    count = 1;
+  if (visible < 1 || visible > count)
+    visible = count;
+  if (step < 1)
+    step = 1;
+
+  const char** files = malloc(sizeof(const char*) * argc);
+  int fileCount = 0;
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      files[fileCount++] = argv[i];
+    }
+  if (fileCount == 0)
+    {
+      files[fileCount++] = "texture.png";
+      files[fileCount++] = "Trollface.png";
+    }
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "sprite.vertex", "texture.frag", spriteAttributes);
+  struct shader_variant* program = shader_variants_get(&variants, SHADER_VERTEX_TINT);
+  if (program == NULL)
+    return -1;
+  glUseProgram(program->source.program);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  int w;
+  int h;
+  app_get_size(&app, &w, &h);
+  glViewport(0, 0, w, h);
+
+  struct texture_load_options loadOptions;
+  texture_load_options_init(&loadOptions, 0);
+  loadOptions.pool = thread_pool_create(0);
+  struct texture_manager manager;
+  if (!texture_manager_init(&manager, &app, &loadOptions, (size_t)(budget * 1024.0 * 1024.0)))
+    return -1;
+  struct managed_texture** textures = malloc(sizeof(struct managed_texture*) * count);
+  for(i = 0; i < count; i++)
+    textures[i] = texture_manager_add(&manager, files[i % fileCount]);
+
+  struct sprite_batch batch;
+  sprite_batch_init(&batch, visible);
+  int columns = (int)ceil(sqrt(visible));
+  float cell = 2.0f / columns;
+  long frame = 0;
+  // the gallery scrolls on its own
+  app_set_frame_rate(&app, 60);
+  while(true)
+    {
+      app_begin_frame(&app);
+      texture_manager_begin_frame(&manager);
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      int first = (int)(frame / step % count);
+      sprite_batch_begin(&batch, SPRITE_SORT_NONE);
+      for(i = 0; i < visible; i++)
+        {
+          struct sprite s =
+            {
+              program->source.program,
+              texture_manager_use(&manager, textures[(first + i) % count]), 0,
+              -1.0f + cell * (i % columns + 0.5f), 1.0f - cell * (i / columns + 0.5f),
+              0.9f * cell, 0.9f * cell, 0.0f,
+              { 0.0f, 0.0f, 1.0f, 1.0f },
+              { 195 / 255.0f, 180 / 255.0f, 218 / 255.0f, 1.0f }
+            };
+          sprite_batch_submit(&batch, &s);
+        }
+      sprite_batch_end(&batch);
+      glFlush();
+      frame++;
+      if (!app_end_frame(&app))
+        break;
+    }
+
+  const struct texture_manager_stats* stats = &manager.stats;
+  long uses = stats->hits + stats->misses + stats->waits;
+  printf("residency: %d textures from %d files, %d visible, scrolling every %d frames, %ld frames\n",
+         count, fileCount, visible, step, frame);
+  printf("residency: %ld uses, %ld hits (%.1f%%), %ld misses, %ld placeholder draws, "
+         "%ld evictions, %ld failures\n",
+         uses, stats->hits, uses > 0 ? 100.0 * stats->hits / uses : 0.0, stats->misses,
+         stats->waits, stats->evictions, stats->failures);
+  printf("residency: budget %.1f MiB, peak %.1f MiB, now %.1f MiB in %d textures (%d loading)\n",
+         budget, mib(stats->peakBytes), mib(stats->residentBytes), stats->resident, stats->loading);
+
+  sprite_batch_free(&batch);
+  texture_manager_free(&manager);
+  thread_pool_destroy(loadOptions.pool);
+  free(textures);
+  free(files);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * Signed distance fields from high resolution coverage bitmaps, for
+ * clip art that stays crisp at any scale (texture.frag's SDF feature).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "sdf.h"
+
+// "no feature here"; finite, so the parabola intersections stay numbers
+#define FAR 1e20f
+
+// columns or rows per task; each task allocates its scratch space once
+#define SDF_CHUNK_LINES 16
+
+struct sdf_job
+{
+  const unsigned char* ink;
+  int w;
+  int h;
+  float* toInk;         /* squared distance to the nearest ink pixel */
+  float* toBackground;  /* ... and to the nearest background pixel */
+  const struct sdf_options* options;
+  unsigned char* field;
+  int failed;           /* a task had no scratch space; atomic */
+};
+
+/*
+ * Squared distance transform of the sampled function f (Felzenszwalb and
+ * Huttenlocher): d[q] = min over p of (q - p)^2 + f[p], from the lower
+ * envelope of the parabolas rooted at every p. v and z are scratch space
+ * for n and n + 1 entries.
+ */
+static void distance_1d(const float* f, int n, float* d, int* v, float* z)
+{
+  int k = 0;
+  int q;
+  v[0] = 0;
+  z[0] = -FAR;
+  z[1] = FAR;
+  for(q = 1; q < n; q++)
+    {
+      // |s| stays below FAR, so z[0] always stops this
+      float s;
+      while(true)
+        {
+          int p = v[k];
+          s = ((f[q] + (float)q * q) - (f[p] + (float)p * p)) / (2.0f * (q - p));
+          if (s > z[k])
+            break;
+          k--;
+        }
+      k++;
+      v[k] = q;
+      z[k] = s;
+      z[k + 1] = FAR;
+    }
+  k = 0;
+  for(q = 0; q < n; q++)
+    {
+      while(z[k + 1] < q)
+        k++;
+      float offset = (float)(q - v[k]);
+      d[q] = offset * offset + f[v[k]];
+    }
+}
+
+/* scratch space for distance_1d over n samples */
+struct scratch
+{
+  float* f;
+  float* d;
+  int* v;
+  float* z;
+};
+
+static bool scratch_init(struct scratch* scratch, int n)
+{
+  scratch->f = calloc(n, sizeof(float));
+  scratch->d = malloc(sizeof(float) * n);
+  scratch->v = malloc(sizeof(int) * n);
+  scratch->z = malloc(sizeof(float) * (n + 1));
+  return scratch->f != NULL && scratch->d != NULL && scratch->v != NULL && scratch->z != NULL;
+}
+
+static void scratch_free(struct scratch* scratch)
+{
+  free(scratch->f);
+  free(scratch->d);
+  free(scratch->v);
+  free(scratch->z);
+}
+
+/* first pass: along the columns of 'chunk', from the ink itself */
+static void column_pass(void* ctx, int chunk)
+{
+  struct sdf_job* job = ctx;
+  struct scratch scratch;
+  if (!scratch_init(&scratch, job->h))
+    {
+      __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+      scratch_free(&scratch);
+      return;
+    }
+  int x;
+  for(x = chunk * SDF_CHUNK_LINES; x < job->w && x < (chunk + 1) * SDF_CHUNK_LINES; x++)
+    {
+      int y;
+      for(y = 0; y < job->h; y++)
+        scratch.f[y] = job->ink[(size_t)y * job->w + x] != 0 ? 0.0f : FAR;
+      distance_1d(scratch.f, job->h, scratch.d, scratch.v, scratch.z);
+      for(y = 0; y < job->h; y++)
+        job->toInk[(size_t)y * job->w + x] = scratch.d[y];
+
+      for(y = 0; y < job->h; y++)
+        scratch.f[y] = job->ink[(size_t)y * job->w + x] != 0 ? FAR : 0.0f;
+      distance_1d(scratch.f, job->h, scratch.d, scratch.v, scratch.z);
+      for(y = 0; y < job->h; y++)
+        job->toBackground[(size_t)y * job->w + x] = scratch.d[y];
+    }
+  scratch_free(&scratch);
+}
+
+/* second pass: along the rows of 'chunk', over the column distances */
+static void row_pass(void* ctx, int chunk)
+{
+  struct sdf_job* job = ctx;
+  struct scratch scratch;
+  if (!scratch_init(&scratch, job->w))
+    {
+      __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+      scratch_free(&scratch);
+      return;
+    }
+  int y;
+  for(y = chunk * SDF_CHUNK_LINES; y < job->h && y < (chunk + 1) * SDF_CHUNK_LINES; y++)
+    {
+      float* rows[2] = { job->toInk + (size_t)y * job->w, job->toBackground + (size_t)y * job->w };
+      int r;
+      for(r = 0; r < 2; r++)
+        {
+          distance_1d(rows[r], job->w, scratch.d, scratch.v, scratch.z);
+          int x;
+          for(x = 0; x < job->w; x++)
+            rows[r][x] = scratch.d[x];
+        }
+    }
+  scratch_free(&scratch);
+}
+
+/* signed distance at input pixel i, in input pixels, positive inside */
+static float signed_distance(const struct sdf_job* job, size_t i)
+{
+  // edges lie half way between pixel centers
+  return job->ink[i] != 0
+    ? sqrtf(job->toBackground[i]) - 0.5f
+    : 0.5f - sqrtf(job->toInk[i]);
+}
+
+/* field row 'fy': the distances at the texel centers, interpolated between input pixels */
+static void resample_row(void* ctx, int fy)
+{
+  struct sdf_job* job = ctx;
+  const struct sdf_options* options = job->options;
+  float scaleX = (float)job->w / options->width;
+  float scaleY = (float)job->h / options->height;
+  // input pixels per field texel
+  float scale = 0.5f * (scaleX + scaleY);
+  float v = (fy + 0.5f) * scaleY - 0.5f;
+  if (v < 0.0f)
+    v = 0.0f;
+  int y0 = (int)v;
+  int y1 = y0 + 1 < job->h ? y0 + 1 : y0;
+  float wy = v - y0;
+  int fx;
+  for(fx = 0; fx < options->width; fx++)
+    {
+      float u = (fx + 0.5f) * scaleX - 0.5f;
+      if (u < 0.0f)
+        u = 0.0f;
+      int x0 = (int)u;
+      int x1 = x0 + 1 < job->w ? x0 + 1 : x0;
+      float wx = u - x0;
+      size_t row0 = (size_t)y0 * job->w;
+      size_t row1 = (size_t)y1 * job->w;
+      float top = signed_distance(job, row0 + x0) * (1.0f - wx) + signed_distance(job, row0 + x1) * wx;
+      float bottom = signed_distance(job, row1 + x0) * (1.0f - wx) + signed_distance(job, row1 + x1) * wx;
+      float distance = (top * (1.0f - wy) + bottom * wy) / scale;
+      float value = 128.0f + 127.0f * distance / options->spread;
+      if (value < 0.0f)
+        value = 0.0f;
+      if (value > 255.0f)
+        value = 255.0f;
+      job->field[(size_t)fy * options->width + fx] = (unsigned char)(value + 0.5f);
+    }
+}
+
+bool sdf_generate(const unsigned char* ink, int w, int h, const struct sdf_options* options,
+                  unsigned char* field, struct thread_pool* pool)
+{
+  if (w <= 0 || h <= 0 || options->width <= 0 || options->height <= 0 || options->spread <= 0.0f)
+    return false;
+  struct sdf_job job;
+  job.ink = ink;
+  job.w = w;
+  job.h = h;
+  job.toInk = malloc(sizeof(float) * w * h);
+  job.toBackground = malloc(sizeof(float) * w * h);
+  job.options = options;
+  job.field = field;
+  job.failed = 0;
+  if (job.toInk == NULL || job.toBackground == NULL)
+    {
+      free(job.toInk);
+      free(job.toBackground);
+      return false;
+    }
+  thread_pool_parallel_for(pool, (w + SDF_CHUNK_LINES - 1) / SDF_CHUNK_LINES, column_pass, &job);
+  // a column left out would be read as garbage
+  if (!job.failed)
+    thread_pool_parallel_for(pool, (h + SDF_CHUNK_LINES - 1) / SDF_CHUNK_LINES, row_pass, &job);
+  if (!job.failed)
+    thread_pool_parallel_for(pool, options->height, resample_row, &job);
+  free(job.toInk);
+  free(job.toBackground);
+  return !job.failed;
+}
+
+/* bilinear sample of the field at field texel coordinates, clamped to the edge */
+static float sample(const unsigned char* field, int w, int h, float u, float v)
+{
+  if (u < 0.0f)
+    u = 0.0f;
+  if (v < 0.0f)
+    v = 0.0f;
+  if (u > w - 1)
+    u = w - 1;
+  if (v > h - 1)
+    v = h - 1;
+  int x0 = (int)u;
+  int y0 = (int)v;
+  int x1 = x0 + 1 < w ? x0 + 1 : x0;
+  int y1 = y0 + 1 < h ? y0 + 1 : y0;
+  float fx = u - x0;
+  float fy = v - y0;
+  float top = field[(size_t)y0 * w + x0] * (1.0f - fx) + field[(size_t)y0 * w + x1] * fx;
+  float bottom = field[(size_t)y1 * w + x0] * (1.0f - fx) + field[(size_t)y1 * w + x1] * fx;
+  return (top * (1.0f - fy) + bottom * fy) / 255.0f;
+}
+
+double sdf_mismatch(const unsigned char* field, const struct sdf_options* options,
+                    const unsigned char* ink, int w, int h)
+{
+  size_t wrong = 0;
+  int x;
+  int y;
+  for(y = 0; y < h; y++)
+    {
+      float v = (y + 0.5f) * options->height / h - 0.5f;
+      for(x = 0; x < w; x++)
+        {
+          float u = (x + 0.5f) * options->width / w - 0.5f;
+          bool inside = sample(field, options->width, options->height, u, v) >= 0.5f;
+          if (inside != (ink[(size_t)y * w + x] != 0))
+            wrong++;
+        }
+    }
+  return (double)wrong / ((double)w * h);
+}
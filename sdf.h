@@ -0,0 +1,47 @@
+/*
+ * Signed distance fields from high resolution coverage bitmaps, for
+ * clip art that stays crisp at any scale (texture.frag's SDF feature).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef SDF_H
+#define SDF_H
+
+#include <stdbool.h>
+#include "thread_pool.h"
+
+struct sdf_options
+{
+  int width;            /* of the field, usually far below the input's */
+  int height;
+  float spread;         /* distance, in field texels, that 0 and 255 stand for */
+};
+
+/*
+ * 'ink' is one byte per input pixel, nonzero inside the shape. The
+ * output texels hold 128 + 127 * d / spread (clamped), d being the
+ * distance from the texel center to the edge in field texels, positive
+ * inside; the edge itself is 0.5 when sampled.
+ *
+ * Distances are exact Euclidean ones (Felzenszwalb and Huttenlocher's
+ * separable transform) on the input grid, interpolated at the output
+ * texel centers. Strokes thinner than about one output texel do not
+ * survive. Rows and columns are split across 'pool' (NULL: run on the
+ * caller). False for bad options or when out of memory.
+ */
+bool sdf_generate(const unsigned char* ink, int w, int h, const struct sdf_options* options,
+                  unsigned char* field, struct thread_pool* pool);
+
+/*
+ * Pixels of a w x h rendering of 'field' (bilinear, thresholded at the
+ * edge) that disagree with 'ink', as a fraction of all of them.
+ */
+double sdf_mismatch(const unsigned char* field, const struct sdf_options* options,
+                    const unsigned char* ink, int w, int h);
+
+#endif
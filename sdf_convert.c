@@ -0,0 +1,104 @@
+/*
+ * Offline converter: high resolution clip art PNG -> small single channel
+ * signed distance field PNG (see sdf.h).
+ *
+ *   sdf_convert [--size N] [--spread S] [--alpha] input.png output.png
+ *
+ * Ink is where the image is dark, as texture.frag's GRAY_TINT reads it;
+ * --alpha takes the opaque parts of an RGBA image instead. The field is
+ * N x N (default 64, or N x M keeping the aspect ratio) and spans S field
+ * texels on either side of the edge (default 4). Render it with the SDF
+ * and GRAY_TINT features: the edge is reconstructed per pixel, so it stays
+ * sharp however far the quad is scaled up.
+ *
+ * Also reports how many input pixels a rendering of the field at the
+ * input size gets wrong.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "image_loader.h"
+#include "sdf.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+int main(int argc, char** argv)
+{
+  int size = 64;
+  float spread = 4.0f;
+  bool alpha = false;
+  int first = 1;
+  while(first < argc && strncmp(argv[first], "--", 2) == 0)
+    {
+      if (strcmp(argv[first], "--size") == 0 && first + 1 < argc)
+        {
+          size = atoi(argv[first + 1]);
+          first += 2;
+        }
+      else if (strcmp(argv[first], "--spread") == 0 && first + 1 < argc)
+        {
+          spread = atof(argv[first + 1]);
+          first += 2;
+        }
+      else if (strcmp(argv[first], "--alpha") == 0)
+        {
+          alpha = true;
+          first += 1;
+        }
+      else
+        break;
+    }
+  if (argc - first != 2 || size < 1 || spread <= 0.0f)
+    {
+      fprintf(stderr, "usage: %s [--size N] [--spread S] [--alpha] input.png output.png\n", argv[0]);
+      return -1;
+    }
+
+  int w;
+  int h;
+  unsigned char* pixels = load_image(argv[first], alpha ? 4 : 1, &w, &h, NULL);
+  if (pixels == NULL)
+    return -1;
+  unsigned char* ink = malloc((size_t)w * h);
+  size_t i;
+  for(i = 0; i < (size_t)w * h; i++)
+    ink[i] = alpha ? pixels[i * 4 + 3] >= 128 : pixels[i] < 128;
+  free(pixels);
+
+  struct sdf_options options;
+  options.width = w >= h ? size : (int)((long)size * w / h);
+  options.height = h >= w ? size : (int)((long)size * h / w);
+  options.spread = spread;
+  if (options.width < 1)
+    options.width = 1;
+  if (options.height < 1)
+    options.height = 1;
+
+  unsigned char* field = malloc((size_t)options.width * options.height);
+  struct thread_pool* pool = thread_pool_create(0);
+  double start = timing_now();
+  bool built = sdf_generate(ink, w, h, &options, field, pool);
+  double elapsed = timing_now() - start;
+  int threads = thread_pool_size(pool);
+  thread_pool_destroy(pool);
+  bool ok = built && save_image_png(argv[first + 1], field, options.width, options.height, 1);
+  if (ok)
+    {
+      printf("%s: %dx%d field from %dx%d in %.1f ms (%d threads), %d bytes vs %zu; "
+             "%.3f%% of the pixels differ at %dx%d\n",
+             argv[first + 1], options.width, options.height, w, h, elapsed * 1000.0,
+             threads, options.width * options.height, (size_t)w * h,
+             100.0 * sdf_mismatch(field, &options, ink, w, h), w, h);
+    }
+  free(field);
+  free(ink);
+  return ok ? 0 : -1;
+}
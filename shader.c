@@ -0,0 +1,33 @@
+/*
+ * Small helpers for reporting GL compile errors.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "shader.h"
+
+void show_gl_shader_compilation_error(GLuint shaderHandle)
+{
+  int errorLogLength;
+  glGetShaderiv(shaderHandle, GL_INFO_LOG_LENGTH, &errorLogLength);
+  char* buffer = malloc(errorLogLength + 1);
+  glGetShaderInfoLog(shaderHandle, errorLogLength + 1, NULL, buffer);
+  fprintf(stderr, "%s", buffer);
+  free(buffer);
+}
+
+void show_gl_linking_error(GLuint programHandle)
+{
+  int errorLogLength;
+  glGetProgramiv(programHandle, GL_INFO_LOG_LENGTH, &errorLogLength);
+  char* buffer = malloc(errorLogLength + 1);
+  glGetProgramInfoLog(programHandle, errorLogLength + 1, NULL, buffer);
+  fprintf(stderr, "%s", buffer);
+  free(buffer);
+}
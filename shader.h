@@ -0,0 +1,19 @@
+/*
+ * Small helpers for reporting GL compile errors.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glew.h>
+
+void show_gl_shader_compilation_error(GLuint shaderHandle);
+void show_gl_linking_error(GLuint programHandle);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Programs built from one vertex/fragment source pair with feature
+ * #defines, compiled on first request and kept per feature mask, with
+ * their uniform locations looked up once.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "shader_variants.h"
+
+static const char* const featureNames[SHADER_FEATURE_COUNT] =
+  {
+    "GRAY_TINT", "PREMULTIPLIED", "VERTEX_TINT", "SDF", "VIRTUAL"
+  };
+
+static const char* const uniformNames[SHADER_UNIFORM_COUNT] =
+  {
+    "myTexture", "backColor", "foreColor", "pageTable", "virtualTiles", "tileLayout"
+  };
+
+void shader_variants_init(struct shader_variants* variants, struct program_cache* cache,
+                          const char* vertexPath, const char* fragmentPath,
+                          const char* const* attributes)
+{
+  memset(variants, 0, sizeof(*variants));
+  variants->cache = cache;
+  variants->vertexPath = vertexPath;
+  variants->fragmentPath = fragmentPath;
+  variants->attributes = attributes;
+
+  unsigned mask;
+  for(mask = 0; mask < SHADER_VARIANT_COUNT; mask++)
+    {
+      struct shader_variant* variant = &variants->variants[mask];
+      variant->features = mask;
+      int f;
+      for(f = 0; f < SHADER_FEATURE_COUNT; f++)
+        {
+          if (mask & (1u << f))
+            {
+              size_t used = strlen(variant->defines);
+              snprintf(variant->defines + used, sizeof(variant->defines) - used,
+                       "#define %s\n", featureNames[f]);
+            }
+        }
+      variant->source.vertexPath = vertexPath;
+      variant->source.fragmentPath = fragmentPath;
+      variant->source.attributes = attributes;
+      variant->source.defines = mask != 0 ? variant->defines : NULL;
+    }
+}
+
+void shader_variants_free(struct shader_variants* variants)
+{
+  int i;
+  for(i = 0; i < SHADER_VARIANT_COUNT; i++)
+    {
+      if (variants->variants[i].built)
+        program_source_delete(&variants->variants[i].source);
+    }
+  memset(variants, 0, sizeof(*variants));
+}
+
+bool shader_variants_prepare(struct shader_variants* variants, const unsigned* masks, int count)
+{
+  struct program_source sources[SHADER_VARIANT_COUNT];
+  int indices[SHADER_VARIANT_COUNT];
+  int pending = 0;
+  bool success = true;
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      unsigned mask = masks[i] & (SHADER_VARIANT_COUNT - 1);
+      struct shader_variant* variant = &variants->variants[mask];
+      if (variant->failed)
+        success = false;
+      if (variant->built || variant->failed)
+        continue;
+      int k;
+      for(k = 0; k < pending && indices[k] != (int)mask; k++)
+        ;
+      if (k < pending)
+        continue;
+      indices[pending] = mask;
+      sources[pending++] = variant->source;
+    }
+  if (pending == 0)
+    return success;
+
+  // one batch, so misses compile in parallel where the driver can
+  program_cache_build(variants->cache, sources, pending);
+  variants->builds++;
+  for(i = 0; i < pending; i++)
+    {
+      struct shader_variant* variant = &variants->variants[indices[i]];
+      variant->source = sources[i];
+      GLint linked = GL_FALSE;
+      if (variant->source.program != 0)
+        glGetProgramiv(variant->source.program, GL_LINK_STATUS, &linked);
+      if (linked != GL_TRUE)
+        {
+          fprintf(stderr, "ERROR: shader variant '%s' + '%s' with features 0x%x failed\n",
+                  variants->vertexPath, variants->fragmentPath, variant->features);
+          program_source_delete(&variant->source);
+          variant->failed = true;
+          success = false;
+          continue;
+        }
+      variant->built = true;
+    }
+  return success;
+}
+
+struct shader_variant* shader_variants_get(struct shader_variants* variants, unsigned features)
+{
+  struct shader_variant* variant = &variants->variants[features & (SHADER_VARIANT_COUNT - 1)];
+  if (!variant->built && !shader_variants_prepare(variants, &features, 1))
+    return NULL;
+
+  if (variant->uniformProgram != variant->source.program)
+    {
+      int u;
+      for(u = 0; u < SHADER_UNIFORM_COUNT; u++)
+        variant->uniforms[u] = glGetUniformLocation(variant->source.program, uniformNames[u]);
+      variant->uniformProgram = variant->source.program;
+    }
+  return variant;
+}
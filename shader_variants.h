@@ -0,0 +1,87 @@
+/*
+ * Programs built from one vertex/fragment source pair with feature
+ * #defines, compiled on first request and kept per feature mask, with
+ * their uniform locations looked up once.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+#include "program_cache.h"
+
+/* feature bits; each one is "#define <name>" in the sources (see texture.frag) */
+enum shader_feature
+{
+  SHADER_GRAY_TINT = 1 << 0,
+  SHADER_PREMULTIPLIED = 1 << 1,
+  SHADER_VERTEX_TINT = 1 << 2,
+  SHADER_SDF = 1 << 3,              /* with SHADER_GRAY_TINT */
+  SHADER_VIRTUAL = 1 << 4           /* see virtual_texture.h */
+};
+
+#define SHADER_FEATURE_COUNT 5
+#define SHADER_VARIANT_COUNT (1 << SHADER_FEATURE_COUNT)
+
+/* uniforms of texture.frag; -1 where a variant does not have one */
+enum shader_uniform
+{
+  SHADER_UNIFORM_TEXTURE,       /* myTexture */
+  SHADER_UNIFORM_BACK_COLOR,    /* backColor */
+  SHADER_UNIFORM_FORE_COLOR,    /* foreColor */
+  SHADER_UNIFORM_PAGE_TABLE,    /* pageTable */
+  SHADER_UNIFORM_VIRTUAL_TILES, /* virtualTiles */
+  SHADER_UNIFORM_TILE_LAYOUT,   /* tileLayout */
+  SHADER_UNIFORM_COUNT
+};
+
+struct shader_variant
+{
+  unsigned features;
+  char defines[128];
+  struct program_source source;       /* source.program is the one to use */
+  GLint uniforms[SHADER_UNIFORM_COUNT];
+  GLuint uniformProgram;              /* the program 'uniforms' belong to */
+  bool built;
+  bool failed;                        /* not retried */
+};
+
+struct shader_variants
+{
+  struct program_cache* cache;
+  const char* vertexPath;
+  const char* fragmentPath;
+  const char* const* attributes;
+  struct shader_variant variants[SHADER_VARIANT_COUNT];
+  int builds;                         /* program_cache_build calls made */
+};
+
+void shader_variants_init(struct shader_variants* variants, struct program_cache* cache,
+                          const char* vertexPath, const char* fragmentPath,
+                          const char* const* attributes);
+
+/* deletes every program built */
+void shader_variants_free(struct shader_variants* variants);
+
+/*
+ * Build the variants for 'masks' that do not exist yet, all in one batch
+ * (see program_cache_build), typically at startup. Returns false if any
+ * of them failed.
+ */
+bool shader_variants_prepare(struct shader_variants* variants, const unsigned* masks, int count);
+
+/*
+ * The program for 'features', built on first use; NULL when it does not
+ * compile. Uniform locations are looked up again when the program was
+ * replaced (hot_reload rebuilds variant->source in place).
+ */
+struct shader_variant* shader_variants_get(struct shader_variants* variants, unsigned features);
+
+#endif
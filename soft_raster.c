@@ -0,0 +1,835 @@
+/*
+ * A CPU rasterizer for the textured square pipeline (texture.vertex +
+ * texture.frag, with or without GRAY_TINT), for hosts without a GPU.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "soft_raster.h"
+#include "image_loader.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  ifdef __SSE2__
+#    include <emmintrin.h>
+#    define SOFT_HAVE_SSE2 1
+#  endif
+#  include <immintrin.h>
+#  define SOFT_HAVE_AVX2 1
+#  define SOFT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// window coordinates are snapped to 1/256 pixel
+#define SUBPIXEL_BITS 8
+#define SUBPIXEL (1 << SUBPIXEL_BITS)
+
+/* a texture level as the kernels see it */
+struct soft_level
+{
+  const uint32_t* texels;
+  int width;
+  int height;
+};
+
+/*
+ * Edge i is a[i] * x + b[i] * y + c[i] at the center of pixel (x, y), in
+ * 1/256 pixel units: >= 0 inside, with the top-left rule folded into c.
+ * Texture coordinates are planes over pixel indices too.
+ */
+struct soft_triangle
+{
+  int64_t a[3];
+  int64_t b[3];
+  int64_t c[3];
+  int minX;             /* bounding box in pixels, inclusive, within the viewport */
+  int minY;
+  int maxX;
+  int maxY;
+  double u;             /* at pixel (0, 0) */
+  double v;
+  double dudx;
+  double dudy;
+  double dvdx;
+  double dvdy;
+  struct soft_level levels[2];
+  float levelBlend;     /* weight of levels[1]; 0: levels[0] alone */
+  const struct soft_material* material;
+};
+
+/* shade 'count' pixels of a row, starting where the texture coordinates are (u, v) */
+typedef void (*span_fn)(const struct soft_triangle* triangle, float u, float v, int count,
+                        uint32_t* dst);
+
+bool soft_texture_init(struct soft_texture* texture, const struct mip_chain* chain)
+{
+  memset(texture, 0, sizeof(*texture));
+  if (chain->channels != 1 && chain->channels != 4)
+    return false;
+  int level;
+  for(level = 0; level < chain->count; level++)
+    {
+      size_t n = (size_t)chain->width[level] * chain->height[level];
+      uint32_t* texels = malloc(sizeof(uint32_t) * n);
+      if (texels == NULL)
+        {
+          soft_texture_free(texture);
+          return false;
+        }
+      const unsigned char* src = chain->levels[level];
+      size_t i;
+      if (chain->channels == 4)
+        memcpy(texels, src, n * 4);
+      else
+        {
+          for(i = 0; i < n; i++)
+            texels[i] = src[i] * 0x010101u | 0xff000000u;
+        }
+      texture->texels[level] = texels;
+      texture->width[level] = chain->width[level];
+      texture->height[level] = chain->height[level];
+      texture->levels = level + 1;
+    }
+  return true;
+}
+
+void soft_texture_free(struct soft_texture* texture)
+{
+  int level;
+  for(level = 0; level < texture->levels; level++)
+    free(texture->texels[level]);
+  memset(texture, 0, sizeof(*texture));
+}
+
+/* float color (0..1) to a byte, as GL writes unorm8 */
+static uint32_t to_byte(float c)
+{
+  c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+  return (uint32_t)(c * 255.0f + 0.5f);
+}
+
+/* bilinear, repeating; texel channels stay 0..255 */
+static void sample_scalar(const struct soft_level* level, float u, float v, float out[4])
+{
+  int w = level->width;
+  int h = level->height;
+  float x = (u - floorf(u)) * w - 0.5f;
+  float y = (v - floorf(v)) * h - 0.5f;
+  float x0f = floorf(x);
+  float y0f = floorf(y);
+  float fx = x - x0f;
+  float fy = y - y0f;
+  int x0 = (int)x0f;
+  int y0 = (int)y0f;
+  int x1 = x0 + 1;
+  int y1 = y0 + 1;
+  // only -1 and w can fall outside
+  if (x0 < 0)
+    x0 += w;
+  if (x1 >= w)
+    x1 -= w;
+  if (y0 < 0)
+    y0 += h;
+  if (y1 >= h)
+    y1 -= h;
+  uint32_t t00 = level->texels[(size_t)y0 * w + x0];
+  uint32_t t10 = level->texels[(size_t)y0 * w + x1];
+  uint32_t t01 = level->texels[(size_t)y1 * w + x0];
+  uint32_t t11 = level->texels[(size_t)y1 * w + x1];
+  int c;
+  for(c = 0; c < 4; c++)
+    {
+      int shift = 8 * c;
+      float c00 = (float)(t00 >> shift & 0xff);
+      float c10 = (float)(t10 >> shift & 0xff);
+      float c01 = (float)(t01 >> shift & 0xff);
+      float c11 = (float)(t11 >> shift & 0xff);
+      float top = c00 + (c10 - c00) * fx;
+      float bottom = c01 + (c11 - c01) * fx;
+      out[c] = top + (bottom - top) * fy;
+    }
+}
+
+static void span_scalar(const struct soft_triangle* triangle, float u, float v, int count,
+                        uint32_t* dst)
+{
+  const struct soft_material* material = triangle->material;
+  float dudx = (float)triangle->dudx;
+  float dvdx = (float)triangle->dvdx;
+  int i;
+  int c;
+  for(i = 0; i < count; i++)
+    {
+      float pu = u + dudx * i;
+      float pv = v + dvdx * i;
+      float texel[4];
+      sample_scalar(&triangle->levels[0], pu, pv, texel);
+      if (triangle->levelBlend != 0.0f)
+        {
+          float coarser[4];
+          sample_scalar(&triangle->levels[1], pu, pv, coarser);
+          for(c = 0; c < 4; c++)
+            texel[c] = texel[c] + (coarser[c] - texel[c]) * triangle->levelBlend;
+        }
+
+      // texture.frag
+      float alpha;
+      float color[3];
+      if (material->grayTint)
+        {
+          alpha = 1.0f - texel[0] * (1.0f / 255.0f);
+          for(c = 0; c < 3; c++)
+            color[c] = material->foreColor[c] * alpha;
+        }
+      else
+        {
+          alpha = texel[3] * (1.0f / 255.0f);
+          for(c = 0; c < 3; c++)
+            color[c] = texel[c] * (1.0f / 255.0f) * alpha;
+        }
+      uint32_t pixel = 0xff000000u;
+      for(c = 0; c < 3; c++)
+        pixel |= to_byte(material->backColor[c] * (1.0f - alpha) + color[c]) << (8 * c);
+      dst[i] = pixel;
+    }
+}
+
+#ifdef SOFT_HAVE_SSE2
+/* SSE4.1 has a floor; for |x| < 2^31, truncating and stepping down is the same */
+static __m128 floor_sse2(__m128 x)
+{
+  __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+/* sample_scalar for 4 pixels: channels out[0..3] */
+static void sample_sse2(const struct soft_level* level, __m128 u, __m128 v, __m128 out[4])
+{
+  int w = level->width;
+  int h = level->height;
+  __m128 half = _mm_set1_ps(0.5f);
+  __m128 x = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(u, floor_sse2(u)), _mm_set1_ps((float)w)), half);
+  __m128 y = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(v, floor_sse2(v)), _mm_set1_ps((float)h)), half);
+  __m128 x0f = floor_sse2(x);
+  __m128 y0f = floor_sse2(y);
+  __m128 fx = _mm_sub_ps(x, x0f);
+  __m128 fy = _mm_sub_ps(y, y0f);
+  __m128i one = _mm_set1_epi32(1);
+  __m128i wv = _mm_set1_epi32(w);
+  __m128i hv = _mm_set1_epi32(h);
+  __m128i x0 = _mm_cvttps_epi32(x0f);
+  __m128i y0 = _mm_cvttps_epi32(y0f);
+  __m128i x1 = _mm_add_epi32(x0, one);
+  __m128i y1 = _mm_add_epi32(y0, one);
+  x0 = _mm_add_epi32(x0, _mm_and_si128(_mm_cmplt_epi32(x0, _mm_setzero_si128()), wv));
+  y0 = _mm_add_epi32(y0, _mm_and_si128(_mm_cmplt_epi32(y0, _mm_setzero_si128()), hv));
+  x1 = _mm_sub_epi32(x1, _mm_and_si128(_mm_cmpgt_epi32(x1, _mm_sub_epi32(wv, one)), wv));
+  y1 = _mm_sub_epi32(y1, _mm_and_si128(_mm_cmpgt_epi32(y1, _mm_sub_epi32(hv, one)), hv));
+
+  // no gather before AVX2
+  int32_t xs0[4];
+  int32_t xs1[4];
+  int32_t ys0[4];
+  int32_t ys1[4];
+  _mm_storeu_si128((__m128i*)xs0, x0);
+  _mm_storeu_si128((__m128i*)xs1, x1);
+  _mm_storeu_si128((__m128i*)ys0, y0);
+  _mm_storeu_si128((__m128i*)ys1, y1);
+  uint32_t t[4][4];
+  int i;
+  for(i = 0; i < 4; i++)
+    {
+      const uint32_t* row0 = level->texels + (size_t)ys0[i] * w;
+      const uint32_t* row1 = level->texels + (size_t)ys1[i] * w;
+      t[0][i] = row0[xs0[i]];
+      t[1][i] = row0[xs1[i]];
+      t[2][i] = row1[xs0[i]];
+      t[3][i] = row1[xs1[i]];
+    }
+  __m128i t00 = _mm_loadu_si128((const __m128i*)t[0]);
+  __m128i t10 = _mm_loadu_si128((const __m128i*)t[1]);
+  __m128i t01 = _mm_loadu_si128((const __m128i*)t[2]);
+  __m128i t11 = _mm_loadu_si128((const __m128i*)t[3]);
+  __m128i mask = _mm_set1_epi32(0xff);
+  int c;
+  for(c = 0; c < 4; c++)
+    {
+      __m128 c00 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(t00, 8 * c), mask));
+      __m128 c10 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(t10, 8 * c), mask));
+      __m128 c01 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(t01, 8 * c), mask));
+      __m128 c11 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(t11, 8 * c), mask));
+      __m128 top = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), fx));
+      __m128 bottom = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), fx));
+      out[c] = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy));
+    }
+}
+
+static __m128i to_bytes_sse2(__m128 c)
+{
+  c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+/* span_scalar, 4 pixels at a time */
+static void span_sse2(const struct soft_triangle* triangle, float u, float v, int count,
+                      uint32_t* dst)
+{
+  const struct soft_material* material = triangle->material;
+  __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+  __m128 dudx = _mm_set1_ps((float)triangle->dudx);
+  __m128 dvdx = _mm_set1_ps((float)triangle->dvdx);
+  __m128 blend = _mm_set1_ps(triangle->levelBlend);
+  __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+  __m128 one = _mm_set1_ps(1.0f);
+  int i;
+  int c;
+  for(i = 0; i < count; i += 4)
+    {
+      __m128 x = _mm_add_ps(_mm_set1_ps((float)i), lanes);
+      __m128 pu = _mm_add_ps(_mm_set1_ps(u), _mm_mul_ps(dudx, x));
+      __m128 pv = _mm_add_ps(_mm_set1_ps(v), _mm_mul_ps(dvdx, x));
+      __m128 texel[4];
+      sample_sse2(&triangle->levels[0], pu, pv, texel);
+      if (triangle->levelBlend != 0.0f)
+        {
+          __m128 coarser[4];
+          sample_sse2(&triangle->levels[1], pu, pv, coarser);
+          for(c = 0; c < 4; c++)
+            texel[c] = _mm_add_ps(texel[c], _mm_mul_ps(_mm_sub_ps(coarser[c], texel[c]), blend));
+        }
+
+      __m128 alpha;
+      __m128 color[3];
+      if (material->grayTint)
+        {
+          alpha = _mm_sub_ps(one, _mm_mul_ps(texel[0], scale));
+          for(c = 0; c < 3; c++)
+            color[c] = _mm_mul_ps(_mm_set1_ps(material->foreColor[c]), alpha);
+        }
+      else
+        {
+          alpha = _mm_mul_ps(texel[3], scale);
+          for(c = 0; c < 3; c++)
+            color[c] = _mm_mul_ps(_mm_mul_ps(texel[c], scale), alpha);
+        }
+      __m128i pixel = _mm_set1_epi32((int)0xff000000u);
+      for(c = 0; c < 3; c++)
+        {
+          __m128 result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(material->backColor[c]),
+                                                _mm_sub_ps(one, alpha)), color[c]);
+          pixel = _mm_or_si128(pixel, _mm_slli_epi32(to_bytes_sse2(result), 8 * c));
+        }
+      if (count - i >= 4)
+        _mm_storeu_si128((__m128i*)(dst + i), pixel);
+      else
+        {
+          uint32_t tail[4];
+          _mm_storeu_si128((__m128i*)tail, pixel);
+          memcpy(dst + i, tail, sizeof(uint32_t) * (count - i));
+        }
+    }
+}
+#endif
+
+#ifdef SOFT_HAVE_AVX2
+/* sample_sse2 for 8 pixels, with gathers */
+SOFT_TARGET_AVX2
+static void sample_avx2(const struct soft_level* level, __m256 u, __m256 v, __m256 out[4])
+{
+  __m256 half = _mm256_set1_ps(0.5f);
+  __m256 x = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(u, _mm256_floor_ps(u)),
+                                         _mm256_set1_ps((float)level->width)), half);
+  __m256 y = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(v, _mm256_floor_ps(v)),
+                                         _mm256_set1_ps((float)level->height)), half);
+  __m256 x0f = _mm256_floor_ps(x);
+  __m256 y0f = _mm256_floor_ps(y);
+  __m256 fx = _mm256_sub_ps(x, x0f);
+  __m256 fy = _mm256_sub_ps(y, y0f);
+  __m256i one = _mm256_set1_epi32(1);
+  __m256i wv = _mm256_set1_epi32(level->width);
+  __m256i hv = _mm256_set1_epi32(level->height);
+  __m256i x0 = _mm256_cvttps_epi32(x0f);
+  __m256i y0 = _mm256_cvttps_epi32(y0f);
+  __m256i x1 = _mm256_add_epi32(x0, one);
+  __m256i y1 = _mm256_add_epi32(y0, one);
+  x0 = _mm256_add_epi32(x0, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), x0), wv));
+  y0 = _mm256_add_epi32(y0, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), y0), hv));
+  x1 = _mm256_sub_epi32(x1, _mm256_and_si256(_mm256_cmpgt_epi32(x1, _mm256_sub_epi32(wv, one)), wv));
+  y1 = _mm256_sub_epi32(y1, _mm256_and_si256(_mm256_cmpgt_epi32(y1, _mm256_sub_epi32(hv, one)), hv));
+  __m256i row0 = _mm256_mullo_epi32(y0, wv);
+  __m256i row1 = _mm256_mullo_epi32(y1, wv);
+  const int* texels = (const int*)level->texels;
+  __m256i t00 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row0, x0), 4);
+  __m256i t10 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row0, x1), 4);
+  __m256i t01 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row1, x0), 4);
+  __m256i t11 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row1, x1), 4);
+  __m256i mask = _mm256_set1_epi32(0xff);
+  int c;
+  for(c = 0; c < 4; c++)
+    {
+      __m128i shift = _mm_cvtsi32_si128(8 * c);
+      __m256 c00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t00, shift), mask));
+      __m256 c10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t10, shift), mask));
+      __m256 c01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t01, shift), mask));
+      __m256 c11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(t11, shift), mask));
+      __m256 top = _mm256_add_ps(c00, _mm256_mul_ps(_mm256_sub_ps(c10, c00), fx));
+      __m256 bottom = _mm256_add_ps(c01, _mm256_mul_ps(_mm256_sub_ps(c11, c01), fx));
+      out[c] = _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fy));
+    }
+}
+
+SOFT_TARGET_AVX2
+static __m256i to_bytes_avx2(__m256 c)
+{
+  c = _mm256_min_ps(_mm256_max_ps(c, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+  return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(255.0f)),
+                                           _mm256_set1_ps(0.5f)));
+}
+
+/* span_scalar, 8 pixels at a time */
+SOFT_TARGET_AVX2
+static void span_avx2(const struct soft_triangle* triangle, float u, float v, int count,
+                      uint32_t* dst)
+{
+  const struct soft_material* material = triangle->material;
+  __m256 lanes = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+  __m256 dudx = _mm256_set1_ps((float)triangle->dudx);
+  __m256 dvdx = _mm256_set1_ps((float)triangle->dvdx);
+  __m256 blend = _mm256_set1_ps(triangle->levelBlend);
+  __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+  __m256 one = _mm256_set1_ps(1.0f);
+  int i;
+  int c;
+  for(i = 0; i < count; i += 8)
+    {
+      __m256 x = _mm256_add_ps(_mm256_set1_ps((float)i), lanes);
+      __m256 pu = _mm256_add_ps(_mm256_set1_ps(u), _mm256_mul_ps(dudx, x));
+      __m256 pv = _mm256_add_ps(_mm256_set1_ps(v), _mm256_mul_ps(dvdx, x));
+      __m256 texel[4];
+      sample_avx2(&triangle->levels[0], pu, pv, texel);
+      if (triangle->levelBlend != 0.0f)
+        {
+          __m256 coarser[4];
+          sample_avx2(&triangle->levels[1], pu, pv, coarser);
+          for(c = 0; c < 4; c++)
+            texel[c] = _mm256_add_ps(texel[c], _mm256_mul_ps(_mm256_sub_ps(coarser[c], texel[c]), blend));
+        }
+
+      __m256 alpha;
+      __m256 color[3];
+      if (material->grayTint)
+        {
+          alpha = _mm256_sub_ps(one, _mm256_mul_ps(texel[0], scale));
+          for(c = 0; c < 3; c++)
+            color[c] = _mm256_mul_ps(_mm256_set1_ps(material->foreColor[c]), alpha);
+        }
+      else
+        {
+          alpha = _mm256_mul_ps(texel[3], scale);
+          for(c = 0; c < 3; c++)
+            color[c] = _mm256_mul_ps(_mm256_mul_ps(texel[c], scale), alpha);
+        }
+      __m256i pixel = _mm256_set1_epi32((int)0xff000000u);
+      for(c = 0; c < 3; c++)
+        {
+          __m256 result = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(material->backColor[c]),
+                                                      _mm256_sub_ps(one, alpha)), color[c]);
+          pixel = _mm256_or_si256(pixel, _mm256_sll_epi32(to_bytes_avx2(result),
+                                                          _mm_cvtsi32_si128(8 * c)));
+        }
+      if (count - i >= 8)
+        _mm256_storeu_si256((__m256i*)(dst + i), pixel);
+      else
+        {
+          uint32_t tail[8];
+          _mm256_storeu_si256((__m256i*)tail, pixel);
+          memcpy(dst + i, tail, sizeof(uint32_t) * (count - i));
+        }
+    }
+}
+#endif
+
+static span_fn select_span(enum mip_kernel kernel)
+{
+#ifdef SOFT_HAVE_SSE2
+  if (kernel == MIP_KERNEL_SSE2)
+    return span_sse2;
+#endif
+#ifdef SOFT_HAVE_AVX2
+  if (kernel == MIP_KERNEL_AVX2)
+    return span_avx2;
+#endif
+  return span_scalar;
+}
+
+bool soft_raster_init(struct soft_raster* raster, int w, int h, struct thread_pool* pool,
+                      enum mip_kernel kernel)
+{
+  memset(raster, 0, sizeof(*raster));
+  if (w <= 0 || h <= 0)
+    return false;
+  if (kernel == MIP_KERNEL_AUTO || !mip_kernel_supported(kernel))
+    kernel = mip_best_kernel();
+  raster->width = w;
+  raster->height = h;
+  raster->pool = pool;
+  raster->kernel = kernel;
+  raster->tilesX = (w + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+  raster->tilesY = (h + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+  int tiles = raster->tilesX * raster->tilesY;
+  raster->pixels = calloc((size_t)w * h, sizeof(uint32_t));
+  raster->bins = calloc(tiles, sizeof(int*));
+  raster->binCounts = calloc(tiles, sizeof(int));
+  raster->binCapacities = calloc(tiles, sizeof(int));
+  raster->busyTiles = malloc(sizeof(int) * tiles);
+  if (raster->pixels == NULL || raster->bins == NULL || raster->binCounts == NULL
+      || raster->binCapacities == NULL || raster->busyTiles == NULL)
+    {
+      soft_raster_free(raster);
+      return false;
+    }
+  soft_raster_viewport(raster, 0, 0, w, h);
+  return true;
+}
+
+void soft_raster_free(struct soft_raster* raster)
+{
+  int i;
+  for(i = 0; raster->bins != NULL && i < raster->tilesX * raster->tilesY; i++)
+    free(raster->bins[i]);
+  free(raster->bins);
+  free(raster->binCounts);
+  free(raster->binCapacities);
+  free(raster->busyTiles);
+  free(raster->triangles);
+  free(raster->pixels);
+  memset(raster, 0, sizeof(*raster));
+}
+
+void soft_raster_viewport(struct soft_raster* raster, int x, int y, int w, int h)
+{
+  raster->viewport[0] = x;
+  raster->viewport[1] = y;
+  raster->viewport[2] = w;
+  raster->viewport[3] = h;
+}
+
+struct clear_job
+{
+  struct soft_raster* raster;
+  uint32_t pixel;
+};
+
+static void clear_row(void* ctx, int y)
+{
+  struct clear_job* job = ctx;
+  uint32_t* row = job->raster->pixels + (size_t)y * job->raster->width;
+  int x;
+  for(x = 0; x < job->raster->width; x++)
+    row[x] = job->pixel;
+}
+
+void soft_raster_clear(struct soft_raster* raster, const float color[4])
+{
+  struct clear_job job;
+  job.raster = raster;
+  job.pixel = to_byte(color[0]) | to_byte(color[1]) << 8 | to_byte(color[2]) << 16
+    | to_byte(color[3]) << 24;
+  thread_pool_parallel_for(raster->pool, raster->height, clear_row, &job);
+}
+
+/* rounding towards minus infinity, for d > 0 */
+static int64_t floor_div(int64_t n, int64_t d)
+{
+  int64_t q = n / d;
+  return (n % d != 0 && n < 0) ? q - 1 : q;
+}
+
+static int64_t min64(int64_t a, int64_t b)
+{
+  return a < b ? a : b;
+}
+
+static int64_t max64(int64_t a, int64_t b)
+{
+  return a > b ? a : b;
+}
+
+/* the finest level of 'texture' and the blend to the next one, for texels per pixel 'rho' */
+static void pick_levels(struct soft_triangle* triangle, const struct soft_material* material,
+                        double rho)
+{
+  const struct soft_texture* texture = material->texture;
+  double lambda = rho > 0.0 ? log2(rho) : 0.0;
+  int level = 0;
+  float blend = 0.0f;
+  // lambda <= 0 is magnification: GL_LINEAR on level 0
+  if (material->filter == SOFT_FILTER_TRILINEAR && lambda > 0.0 && texture->levels > 1)
+    {
+      if (lambda >= texture->levels - 1)
+        level = texture->levels - 1;
+      else
+        {
+          level = (int)floor(lambda);
+          blend = (float)(lambda - level);
+        }
+    }
+  int next = level + 1 < texture->levels ? level + 1 : level;
+  triangle->levels[0].texels = texture->texels[level];
+  triangle->levels[0].width = texture->width[level];
+  triangle->levels[0].height = texture->height[level];
+  triangle->levels[1].texels = texture->texels[next];
+  triangle->levels[1].width = texture->width[next];
+  triangle->levels[1].height = texture->height[next];
+  triangle->levelBlend = next != level ? blend : 0.0f;
+}
+
+/* viewport transform, edge functions, bounding box and planes; false if nothing is covered */
+static bool setup_triangle(const struct soft_raster* raster, struct soft_triangle* triangle,
+                           const struct soft_material* material,
+                           const float* const position[3], const float* const uv[3])
+{
+  const int* viewport = raster->viewport;
+  int64_t X[3];
+  int64_t Y[3];
+  const float* uvs[3] = { uv[0], uv[1], uv[2] };
+  int i;
+  for(i = 0; i < 3; i++)
+    {
+      X[i] = llround((viewport[0] + (position[i][0] + 1.0) * 0.5 * viewport[2]) * SUBPIXEL);
+      Y[i] = llround((viewport[1] + (position[i][1] + 1.0) * 0.5 * viewport[3]) * SUBPIXEL);
+    }
+  int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+  if (area == 0)
+    return false;
+  // counterclockwise from here on: inside is to the left of every edge
+  if (area < 0)
+    {
+      int64_t swap = X[1];
+      X[1] = X[2];
+      X[2] = swap;
+      swap = Y[1];
+      Y[1] = Y[2];
+      Y[2] = swap;
+      uvs[1] = uv[2];
+      uvs[2] = uv[1];
+    }
+
+  for(i = 0; i < 3; i++)
+    {
+      int j = (i + 1) % 3;
+      int64_t dx = X[j] - X[i];
+      int64_t dy = Y[j] - Y[i];
+      // pixel centers on a left or top edge are in, on the others out,
+      // so the two triangles of a quad never both cover one
+      bool topLeft = dy < 0 || (dy == 0 && dx < 0);
+      triangle->a[i] = -dy * SUBPIXEL;
+      triangle->b[i] = dx * SUBPIXEL;
+      triangle->c[i] = dx * (SUBPIXEL / 2 - Y[i]) - dy * (SUBPIXEL / 2 - X[i]) - (topLeft ? 0 : 1);
+    }
+
+  int64_t minX = max64(floor_div(min64(X[0], min64(X[1], X[2])), SUBPIXEL),
+                       max64(viewport[0], 0));
+  int64_t maxX = min64(floor_div(max64(X[0], max64(X[1], X[2])), SUBPIXEL),
+                       min64((int64_t)viewport[0] + viewport[2], raster->width) - 1);
+  int64_t minY = max64(floor_div(min64(Y[0], min64(Y[1], Y[2])), SUBPIXEL),
+                       max64(viewport[1], 0));
+  int64_t maxY = min64(floor_div(max64(Y[0], max64(Y[1], Y[2])), SUBPIXEL),
+                       min64((int64_t)viewport[1] + viewport[3], raster->height) - 1);
+  if (minX > maxX || minY > maxY)
+    return false;
+  triangle->minX = (int)minX;
+  triangle->maxX = (int)maxX;
+  triangle->minY = (int)minY;
+  triangle->maxY = (int)maxY;
+
+  // texture coordinates over the snapped positions; w is 1, so plain
+  // planes are perspective correct
+  double x[3];
+  double y[3];
+  for(i = 0; i < 3; i++)
+    {
+      x[i] = (double)X[i] / SUBPIXEL;
+      y[i] = (double)Y[i] / SUBPIXEL;
+    }
+  double det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+  double du1 = uvs[1][0] - uvs[0][0];
+  double du2 = uvs[2][0] - uvs[0][0];
+  double dv1 = uvs[1][1] - uvs[0][1];
+  double dv2 = uvs[2][1] - uvs[0][1];
+  triangle->dudx = (du1 * (y[2] - y[0]) - du2 * (y[1] - y[0])) / det;
+  triangle->dudy = (du2 * (x[1] - x[0]) - du1 * (x[2] - x[0])) / det;
+  triangle->dvdx = (dv1 * (y[2] - y[0]) - dv2 * (y[1] - y[0])) / det;
+  triangle->dvdy = (dv2 * (x[1] - x[0]) - dv1 * (x[2] - x[0])) / det;
+  // pixel (px, py) samples at its center (px + 0.5, py + 0.5)
+  triangle->u = uvs[0][0] - triangle->dudx * (x[0] - 0.5) - triangle->dudy * (y[0] - 0.5);
+  triangle->v = uvs[0][1] - triangle->dvdx * (x[0] - 0.5) - triangle->dvdy * (y[0] - 0.5);
+
+  // constant over the triangle for the same reason
+  const struct soft_texture* texture = material->texture;
+  double rho = fmax(hypot(triangle->dudx * texture->width[0], triangle->dvdx * texture->height[0]),
+                    hypot(triangle->dudy * texture->width[0], triangle->dvdy * texture->height[0]));
+  pick_levels(triangle, material, rho);
+  triangle->material = material;
+  return true;
+}
+
+/* can 'triangle' cover any pixel center of the tile at pixels x0..x1, y0..y1? */
+static bool touches_tile(const struct soft_triangle* triangle, int x0, int y0, int x1, int y1)
+{
+  int i;
+  for(i = 0; i < 3; i++)
+    {
+      // the edge function is largest at one of the corners
+      int64_t x = triangle->a[i] > 0 ? x1 : x0;
+      int64_t y = triangle->b[i] > 0 ? y1 : y0;
+      if (triangle->a[i] * x + triangle->b[i] * y + triangle->c[i] < 0)
+        return false;
+    }
+  return true;
+}
+
+static bool bin_triangle(struct soft_raster* raster, int index, int* busy)
+{
+  const struct soft_triangle* triangle = &raster->triangles[index];
+  int tx0 = triangle->minX / SOFT_TILE_SIZE;
+  int tx1 = triangle->maxX / SOFT_TILE_SIZE;
+  int ty0 = triangle->minY / SOFT_TILE_SIZE;
+  int ty1 = triangle->maxY / SOFT_TILE_SIZE;
+  int tx;
+  int ty;
+  for(ty = ty0; ty <= ty1; ty++)
+    {
+      for(tx = tx0; tx <= tx1; tx++)
+        {
+          int x0 = tx * SOFT_TILE_SIZE;
+          int y0 = ty * SOFT_TILE_SIZE;
+          if (!touches_tile(triangle, x0, y0, x0 + SOFT_TILE_SIZE - 1, y0 + SOFT_TILE_SIZE - 1))
+            continue;
+          int tile = ty * raster->tilesX + tx;
+          if (raster->binCounts[tile] == raster->binCapacities[tile])
+            {
+              int capacity = raster->binCapacities[tile] == 0 ? 16 : raster->binCapacities[tile] * 2;
+              int* bin = realloc(raster->bins[tile], sizeof(int) * capacity);
+              if (bin == NULL)
+                return false;
+              raster->bins[tile] = bin;
+              raster->binCapacities[tile] = capacity;
+            }
+          if (raster->binCounts[tile] == 0)
+            raster->busyTiles[(*busy)++] = tile;
+          raster->bins[tile][raster->binCounts[tile]++] = index;
+          raster->stats.binned++;
+        }
+    }
+  return true;
+}
+
+struct tile_job
+{
+  struct soft_raster* raster;
+  span_fn span;
+  long pixels;
+};
+
+/* every triangle binned to busy tile 'i', in order, one row span at a time */
+static void raster_tile(void* ctx, int i)
+{
+  struct tile_job* job = ctx;
+  struct soft_raster* raster = job->raster;
+  int tile = raster->busyTiles[i];
+  int tileX0 = tile % raster->tilesX * SOFT_TILE_SIZE;
+  int tileY0 = tile / raster->tilesX * SOFT_TILE_SIZE;
+  int tileX1 = tileX0 + SOFT_TILE_SIZE - 1;
+  int tileY1 = tileY0 + SOFT_TILE_SIZE - 1;
+  long pixels = 0;
+  int k;
+  for(k = 0; k < raster->binCounts[tile]; k++)
+    {
+      const struct soft_triangle* triangle = &raster->triangles[raster->bins[tile][k]];
+      int y0 = triangle->minY > tileY0 ? triangle->minY : tileY0;
+      int y1 = triangle->maxY < tileY1 ? triangle->maxY : tileY1;
+      int y;
+      for(y = y0; y <= y1; y++)
+        {
+          // the pixels of this row inside all three edges
+          int64_t first = triangle->minX > tileX0 ? triangle->minX : tileX0;
+          int64_t last = triangle->maxX < tileX1 ? triangle->maxX : tileX1;
+          int e;
+          for(e = 0; e < 3 && first <= last; e++)
+            {
+              int64_t a = triangle->a[e];
+              int64_t c = triangle->b[e] * y + triangle->c[e];
+              if (a > 0)
+                first = max64(first, -floor_div(c, a));
+              else if (a < 0)
+                last = min64(last, floor_div(c, -a));
+              else if (c < 0)
+                last = first - 1;
+            }
+          if (first > last)
+            continue;
+          float u = (float)(triangle->u + triangle->dudx * first + triangle->dudy * y);
+          float v = (float)(triangle->v + triangle->dvdx * first + triangle->dvdy * y);
+          int count = (int)(last - first + 1);
+          job->span(triangle, u, v, count, raster->pixels + (size_t)y * raster->width + first);
+          pixels += count;
+        }
+    }
+  __atomic_add_fetch(&job->pixels, pixels, __ATOMIC_RELAXED);
+}
+
+void soft_raster_draw(struct soft_raster* raster, const struct soft_material* material,
+                      const float* positions, const float* uvs, const unsigned* indices,
+                      int indexCount)
+{
+  int count = indexCount / 3;
+  if (count > raster->triangleCapacity)
+    {
+      struct soft_triangle* triangles = realloc(raster->triangles, sizeof(struct soft_triangle) * count);
+      if (triangles == NULL)
+        return;
+      raster->triangles = triangles;
+      raster->triangleCapacity = count;
+    }
+
+  int busy = 0;
+  int setup = 0;
+  int t;
+  for(t = 0; t < count; t++)
+    {
+      const unsigned* index = indices + 3 * t;
+      const float* position[3] = { positions + 3 * index[0], positions + 3 * index[1], positions + 3 * index[2] };
+      const float* uv[3] = { uvs + 2 * index[0], uvs + 2 * index[1], uvs + 2 * index[2] };
+      if (!setup_triangle(raster, &raster->triangles[setup], material, position, uv))
+        continue;
+      if (!bin_triangle(raster, setup, &busy))
+        break;
+      setup++;
+    }
+  raster->stats.triangles += setup;
+
+  struct tile_job job;
+  job.raster = raster;
+  job.span = select_span(raster->kernel);
+  job.pixels = 0;
+  thread_pool_parallel_for(raster->pool, busy, raster_tile, &job);
+  raster->stats.tiles += busy;
+  raster->stats.pixels += job.pixels;
+
+  int i;
+  for(i = 0; i < busy; i++)
+    raster->binCounts[raster->busyTiles[i]] = 0;
+}
+
+bool soft_raster_save_png(const struct soft_raster* raster, const char* filename)
+{
+  // RGBA bytes in memory order on little endian hosts
+  return save_image_png(filename, (const unsigned char*)raster->pixels, raster->width,
+                        raster->height, 4);
+}
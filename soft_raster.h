@@ -0,0 +1,119 @@
+/*
+ * A CPU rasterizer for the textured square pipeline (texture.vertex +
+ * texture.frag, with or without GRAY_TINT), for hosts without a GPU:
+ * triangles are binned into screen tiles, the tiles shaded in parallel,
+ * a span of pixels at a time with SSE2 or AVX2.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mipmap.h"
+#include "thread_pool.h"
+
+/* screen tiles are SOFT_TILE_SIZE pixels square */
+#define SOFT_TILE_SIZE 64
+
+/* RGBA8 texels packed in 32 bits (R in the lowest byte), bottom row first */
+struct soft_texture
+{
+  int levels;
+  int width[MIP_MAX_LEVELS];
+  int height[MIP_MAX_LEVELS];
+  uint32_t* texels[MIP_MAX_LEVELS];
+};
+
+/*
+ * Copy a mip chain (1 channel: gray, expanded to (g, g, g, 255), or 4)
+ * as the texture's levels; chain->count == 1 for no mipmaps.
+ */
+bool soft_texture_init(struct soft_texture* texture, const struct mip_chain* chain);
+void soft_texture_free(struct soft_texture* texture);
+
+enum soft_filter
+{
+  SOFT_FILTER_BILINEAR,     /* GL_LINEAR */
+  SOFT_FILTER_TRILINEAR     /* GL_LINEAR_MIPMAP_LINEAR (and GL_LINEAR when magnified) */
+};
+
+/* texture.frag's features and uniforms; the texture repeats, as by default in GL */
+struct soft_material
+{
+  const struct soft_texture* texture;
+  enum soft_filter filter;
+  bool grayTint;            /* GRAY_TINT: red is coverage, painted in foreColor */
+  float backColor[3];
+  float foreColor[3];
+};
+
+struct soft_raster_stats
+{
+  long triangles;
+  long binned;              /* triangle references in tile bins */
+  long tiles;               /* tiles shaded */
+  long pixels;              /* pixels shaded */
+};
+
+/* one setup triangle; see soft_raster.c */
+struct soft_triangle;
+
+struct soft_raster
+{
+  int width;
+  int height;
+  uint32_t* pixels;         /* the framebuffer: RGBA8 as in soft_texture, bottom row first */
+  int viewport[4];          /* x, y, width, height, as glViewport */
+  struct thread_pool* pool;
+  enum mip_kernel kernel;   /* resolved: never MIP_KERNEL_AUTO */
+
+  int tilesX;
+  int tilesY;
+  int** bins;               /* triangle indices per tile */
+  int* binCounts;
+  int* binCapacities;
+  int* busyTiles;           /* tiles with a non-empty bin, this draw */
+  struct soft_triangle* triangles;
+  int triangleCapacity;
+  struct soft_raster_stats stats;
+};
+
+/*
+ * A w x h framebuffer, shaded by 'pool' (NULL: on the caller) with
+ * 'kernel' (SSE2 and AVX2 kernels shade 4 and 8 pixels at a time; AUTO
+ * picks the best this CPU runs). The viewport starts as the whole
+ * framebuffer.
+ */
+bool soft_raster_init(struct soft_raster* raster, int w, int h, struct thread_pool* pool,
+                      enum mip_kernel kernel);
+void soft_raster_free(struct soft_raster* raster);
+
+void soft_raster_viewport(struct soft_raster* raster, int x, int y, int w, int h);
+
+/* glClear with this glClearColor */
+void soft_raster_clear(struct soft_raster* raster, const float color[4]);
+
+/*
+ * glDrawElements(GL_TRIANGLES) with texture.vertex and texture.frag:
+ * 'positions' are vertexPosition (3 floats, clip space with w = 1, not
+ * clipped: keep them within a few viewports of the screen), 'uvs'
+ * vertexUV, 'indices' the index buffer. Both windings are drawn; pixel
+ * centers exactly on a shared edge belong to one triangle only. Blending
+ * with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA amounts to a copy, since
+ * texture.frag writes alpha 1. Returns when the pixels are written.
+ */
+void soft_raster_draw(struct soft_raster* raster, const struct soft_material* material,
+                      const float* positions, const float* uvs, const unsigned* indices,
+                      int indexCount);
+
+/* the framebuffer as a PNG */
+bool soft_raster_save_png(const struct soft_raster* raster, const char* filename);
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * Draw the same scenes with GL (llvmpipe on GPU-less hosts) and with
+ * soft_raster, every kernel single threaded and the best one on every
+ * core, and compare both the time per frame and the pictures.
+ *
+ *   soft_raster_bench [--headless] [--size WxH] [--runs N] [--threads N]
+ *                     [--quads N] [--bilinear] [--png PREFIX]
+ *
+ * Scenes: gl_texture's square, gl_texture_grayscale's (Trollface, gray
+ * tint) and --quads N (default 256) rotated, overlapping squares of
+ * various sizes over the whole window, their textures repeating twice.
+ * Both sides sample the same mip chain (mip_chain_build), trilinear
+ * unless --bilinear. A GL frame is glClear, the draw and glFinish; times
+ * are averages over --runs frames (default 20). --png PREFIX saves both
+ * pictures of every scene.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "image_loader.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "soft_raster.h"
+#include "timing.h"
+
+struct scene
+{
+  const char* name;
+  struct soft_texture texture;
+  struct soft_material material;
+  struct shader_variant* program;
+  GLuint glTexture;
+  float* positions;
+  float* uvs;
+  unsigned* indices;
+  int vertexCount;
+  int indexCount;
+  int viewport[4];
+};
+
+/* the square of textured_quad.c */
+static const float squarePositions[] = { -1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, -1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f };
+static const float squareUVs[] = { 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+static const unsigned squareIndices[] = { 0, 1, 2, 1, 3, 2 };
+
+/* room for 'quads' squares */
+static bool scene_alloc(struct scene* scene, int quads)
+{
+  scene->vertexCount = 4 * quads;
+  scene->indexCount = 6 * quads;
+  scene->positions = malloc(sizeof(float) * 3 * scene->vertexCount);
+  scene->uvs = malloc(sizeof(float) * 2 * scene->vertexCount);
+  scene->indices = malloc(sizeof(unsigned) * scene->indexCount);
+  return scene->positions != NULL && scene->uvs != NULL && scene->indices != NULL;
+}
+
+/* gl_texture's square: centered, 1:1 */
+static void layout_square(struct scene* scene, int w, int h)
+{
+  memcpy(scene->positions, squarePositions, sizeof(squarePositions));
+  memcpy(scene->uvs, squareUVs, sizeof(squareUVs));
+  memcpy(scene->indices, squareIndices, sizeof(squareIndices));
+  int side = w < h ? w : h;
+  scene->viewport[0] = (w - side) / 2;
+  scene->viewport[1] = (h - side) / 2;
+  scene->viewport[2] = side;
+  scene->viewport[3] = side;
+}
+
+/* 'quads' squares with a fixed pseudo random size, angle and place */
+static void layout_quads(struct scene* scene, int quads, int w, int h)
+{
+  unsigned seed = 12345;
+  int q;
+  for(q = 0; q < quads; q++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      float size = 0.05f + 0.45f * (seed >> 16 & 0xffff) / 65535.0f;
+      seed = seed * 1103515245u + 12345u;
+      float angle = 6.2831853f * (seed >> 16 & 0xffff) / 65535.0f;
+      seed = seed * 1103515245u + 12345u;
+      float cx = -1.0f + 2.0f * (seed >> 16 & 0xffff) / 65535.0f;
+      seed = seed * 1103515245u + 12345u;
+      float cy = -1.0f + 2.0f * (seed >> 16 & 0xffff) / 65535.0f;
+      int k;
+      for(k = 0; k < 4; k++)
+        {
+          float x = squarePositions[3 * k] * size;
+          float y = squarePositions[3 * k + 1] * size;
+          float* position = scene->positions + 3 * (4 * q + k);
+          // square in pixels, whatever the window's aspect
+          position[0] = cx + (x * cosf(angle) - y * sinf(angle)) * h / w;
+          position[1] = cy + x * sinf(angle) + y * cosf(angle);
+          position[2] = 0.0f;
+          scene->uvs[2 * (4 * q + k)] = squareUVs[2 * k] * 2.0f;
+          scene->uvs[2 * (4 * q + k) + 1] = squareUVs[2 * k + 1] * 2.0f;
+        }
+      for(k = 0; k < 6; k++)
+        scene->indices[6 * q + k] = 4 * q + squareIndices[k];
+    }
+  scene->viewport[0] = 0;
+  scene->viewport[1] = 0;
+  scene->viewport[2] = w;
+  scene->viewport[3] = h;
+}
+
+/* the soft texture from 'file' and a GL texture with the very same levels */
+static bool scene_texture(struct scene* scene, const char* file, int channels, bool mipmaps)
+{
+  int w;
+  int h;
+  unsigned char* pixels = load_image(file, channels, &w, &h, NULL);
+  if (pixels == NULL)
+    return false;
+  struct mip_options options = { MIP_FILTER_BOX, MIP_KERNEL_AUTO, true };
+  struct mip_chain chain;
+  bool ok = mip_chain_build(&chain, pixels, w, h, channels, &options, NULL);
+  free(pixels);
+  if (!ok)
+    return false;
+  // bilinear: level 0 alone
+  int count = chain.count;
+  if (!mipmaps)
+    chain.count = 1;
+  ok = soft_texture_init(&scene->texture, &chain);
+  chain.count = count;
+  mip_chain_free(&chain);
+  if (!ok)
+    return false;
+
+  glGenTextures(1, &scene->glTexture);
+  glBindTexture(GL_TEXTURE_2D, scene->glTexture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  int level;
+  for(level = 0; level < scene->texture.levels; level++)
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, scene->texture.width[level], scene->texture.height[level],
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, scene->texture.texels[level]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, scene->texture.levels - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  scene->material.texture = &scene->texture;
+  scene->material.filter = mipmaps ? SOFT_FILTER_TRILINEAR : SOFT_FILTER_BILINEAR;
+  return true;
+}
+
+static void scene_free(struct scene* scene)
+{
+  glDeleteTextures(1, &scene->glTexture);
+  soft_texture_free(&scene->texture);
+  free(scene->positions);
+  free(scene->uvs);
+  free(scene->indices);
+}
+
+/* average seconds per frame of 'frames' GL frames; the last one stays in 'pixels' */
+static double time_gl(const struct scene* scene, int frames, int w, int h, unsigned char* pixels)
+{
+  GLuint program = scene->program->source.program;
+  glUseProgram(program);
+  glUniform1i(scene->program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+  glUniform3fv(scene->program->uniforms[SHADER_UNIFORM_BACK_COLOR], 1, scene->material.backColor);
+  if (scene->material.grayTint)
+    glUniform3fv(scene->program->uniforms[SHADER_UNIFORM_FORE_COLOR], 1, scene->material.foreColor);
+  glBindTexture(GL_TEXTURE_2D, scene->glTexture);
+  glViewport(scene->viewport[0], scene->viewport[1], scene->viewport[2], scene->viewport[3]);
+
+  GLuint buffers[3];
+  glGenBuffers(3, buffers);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * scene->vertexCount, scene->positions, GL_STATIC_DRAW);
+  GLint positionIndex = glGetAttribLocation(program, "vertexPosition");
+  glVertexAttribPointer(positionIndex, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+  glEnableVertexAttribArray(positionIndex);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 2 * scene->vertexCount, scene->uvs, GL_STATIC_DRAW);
+  GLint uvIndex = glGetAttribLocation(program, "vertexUV");
+  glVertexAttribPointer(uvIndex, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+  glEnableVertexAttribArray(uvIndex);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[2]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * scene->indexCount, scene->indices, GL_STATIC_DRAW);
+
+  double total = 0;
+  int i;
+  // one frame more: the first one compiles llvmpipe's shaders
+  for(i = -1; i < frames; i++)
+    {
+      double start = timing_now();
+      glClear(GL_COLOR_BUFFER_BIT);
+      glDrawElements(GL_TRIANGLES, scene->indexCount, GL_UNSIGNED_INT, NULL);
+      glFinish();
+      if (i >= 0)
+        total += timing_now() - start;
+    }
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+  glDisableVertexAttribArray(positionIndex);
+  glDisableVertexAttribArray(uvIndex);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glDeleteBuffers(3, buffers);
+  return total / frames;
+}
+
+/* average seconds per frame of 'frames' frames drawn into 'raster' */
+static double time_soft(struct soft_raster* raster, const struct scene* scene, int frames)
+{
+  static const float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  soft_raster_viewport(raster, scene->viewport[0], scene->viewport[1], scene->viewport[2],
+                       scene->viewport[3]);
+  double total = 0;
+  int i;
+  for(i = -1; i < frames; i++)
+    {
+      double start = timing_now();
+      soft_raster_clear(raster, clear);
+      soft_raster_draw(raster, &scene->material, scene->positions, scene->uvs, scene->indices,
+                       scene->indexCount);
+      if (i >= 0)
+        total += timing_now() - start;
+    }
+  return total / frames;
+}
+
+/* largest channel difference, and how many pixels differ by more than 1 anywhere */
+static int compare(const unsigned char* a, const unsigned char* b, int w, int h, long* differing)
+{
+  int worst = 0;
+  long count = 0;
+  size_t i;
+  for(i = 0; i < (size_t)w * h; i++)
+    {
+      int c;
+      int pixelWorst = 0;
+      for(c = 0; c < 3; c++)
+        {
+          int d = abs(a[4 * i + c] - b[4 * i + c]);
+          if (d > pixelWorst)
+            pixelWorst = d;
+        }
+      if (pixelWorst > 1)
+        count++;
+      if (pixelWorst > worst)
+        worst = pixelWorst;
+    }
+  *differing = count;
+  return worst;
+}
+
+static void run_scene(struct scene* scene, struct thread_pool* pool, int frames, int w, int h,
+                      const char* pngPrefix)
+{
+  unsigned char* glPixels = malloc((size_t)w * h * 4);
+  if (glPixels == NULL)
+    return;
+  printf("%s: %dx%d texture (%d levels), %d triangles, %dx%d viewport, %s\n", scene->name,
+         scene->texture.width[0], scene->texture.height[0], scene->texture.levels,
+         scene->indexCount / 3, scene->viewport[2], scene->viewport[3],
+         scene->material.filter == SOFT_FILTER_TRILINEAR ? "trilinear" : "bilinear");
+  double gl = time_gl(scene, frames, w, h, glPixels);
+
+  static const enum mip_kernel kernels[] = { MIP_KERNEL_SCALAR, MIP_KERNEL_SSE2, MIP_KERNEL_AVX2 };
+  struct soft_raster raster;
+  double pixels = 0;
+  unsigned char* scalarPixels = NULL;
+  int k;
+  for(k = 0; k < 3; k++)
+    {
+      if (!mip_kernel_supported(kernels[k]))
+        {
+          printf("  %-8s not available\n", mip_kernel_name(kernels[k]));
+          continue;
+        }
+      if (!soft_raster_init(&raster, w, h, NULL, kernels[k]))
+        break;
+      double soft = time_soft(&raster, scene, frames);
+      pixels = (double)raster.stats.pixels / (frames + 1);
+      printf("  %-8s %2d thread  %8.3f ms/frame  %8.1f Mpixels/s  (%.2fx gl",
+             mip_kernel_name(kernels[k]), 1, soft * 1000.0, pixels / soft / 1e6, gl / soft);
+      // the SIMD kernels against the scalar reference
+      if (scalarPixels == NULL)
+        {
+          scalarPixels = malloc((size_t)w * h * 4);
+          if (scalarPixels != NULL)
+            memcpy(scalarPixels, raster.pixels, (size_t)w * h * 4);
+          printf(")\n");
+        }
+      else
+        {
+          long differing;
+          printf(", max diff %d from scalar)\n",
+                 compare((const unsigned char*)raster.pixels, scalarPixels, w, h, &differing));
+        }
+      soft_raster_free(&raster);
+    }
+  free(scalarPixels);
+
+  if (soft_raster_init(&raster, w, h, pool, MIP_KERNEL_AUTO))
+    {
+      double soft = time_soft(&raster, scene, frames);
+      printf("  %-8s %2d threads %8.3f ms/frame  %8.1f Mpixels/s  (%.2fx gl; %.1f tiles, "
+             "%.1f binned triangles per frame)\n",
+             mip_kernel_name(raster.kernel), thread_pool_size(pool), soft * 1000.0,
+             pixels / soft / 1e6, gl / soft, (double)raster.stats.tiles / (frames + 1),
+             (double)raster.stats.binned / (frames + 1));
+      printf("  %-8s           %8.3f ms/frame  %8.1f Mpixels/s  (%s)\n", "gl", gl * 1000.0,
+             pixels / gl / 1e6, glGetString(GL_RENDERER));
+      long differing;
+      int worst = compare((const unsigned char*)raster.pixels, glPixels, w, h, &differing);
+      printf("  picture: max difference %d, %.3f%% of pixels off by more than 1\n", worst,
+             100.0 * differing / ((double)w * h));
+      if (pngPrefix != NULL)
+        {
+          char path[4096];
+          snprintf(path, sizeof(path), "%s_%s_soft.png", pngPrefix, scene->name);
+          soft_raster_save_png(&raster, path);
+          snprintf(path, sizeof(path), "%s_%s_gl.png", pngPrefix, scene->name);
+          save_image_png(path, glPixels, w, h, 4);
+        }
+      soft_raster_free(&raster);
+    }
+  free(glPixels);
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Software rasterizer benchmark", 0))
+    return -1;
+
+  const char* runsOption = app_option(argc, argv, "--runs");
+  const char* threadsOption = app_option(argc, argv, "--threads");
+  const char* quadsOption = app_option(argc, argv, "--quads");
+  const char* pngPrefix = app_option(argc, argv, "--png");
+  bool mipmaps = !app_flag(argc, argv, "--bilinear");
+  int frames = runsOption != NULL ? atoi(runsOption) : 20;
+  if (frames < 1)
+    frames = 1;
+  int quads = quadsOption != NULL ? atoi(quadsOption) : 256;
+  if (quads < 1)
+    quads = 1;
+  int w;
+  int h;
+  app_get_size(&app, &w, &h);
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "texture.vertex", "texture.frag", NULL);
+  struct shader_variant* plain = shader_variants_get(&variants, 0);
+  struct shader_variant* gray = shader_variants_get(&variants, SHADER_GRAY_TINT);
+  if (plain == NULL || gray == NULL)
+    return -1;
+
+  // texture.frag writes alpha 1, so this is a copy; set up as the demos do
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  struct scene scenes[3];
+  memset(scenes, 0, sizeof(scenes));
+  scenes[0].name = "texture";
+  scenes[0].program = plain;
+  scenes[1].name = "grayscale";
+  scenes[1].program = gray;
+  scenes[1].material.grayTint = true;
+  scenes[2].name = "quads";
+  scenes[2].program = plain;
+  bool ok = scene_texture(&scenes[0], "texture.png", 4, mipmaps) && scene_alloc(&scenes[0], 1)
+    && scene_texture(&scenes[1], "Trollface.png", 1, mipmaps) && scene_alloc(&scenes[1], 1)
+    && scene_texture(&scenes[2], "texture.png", 4, mipmaps) && scene_alloc(&scenes[2], quads);
+  if (!ok)
+    return -1;
+  layout_square(&scenes[0], w, h);
+  layout_square(&scenes[1], w, h);
+  layout_quads(&scenes[2], quads, w, h);
+  // the demos' colors
+  float texturesBack[3] = { 195 / 255.0f, 180 / 255.0f, 218 / 255.0f };
+  float trollBack[3] = { 216 / 255.0f, 232 / 255.0f, 194 / 255.0f };
+  float trollFore[3] = { 156 / 255.0f, 15 / 255.0f, 15 / 255.0f };
+  memcpy(scenes[0].material.backColor, texturesBack, sizeof(texturesBack));
+  memcpy(scenes[1].material.backColor, trollBack, sizeof(trollBack));
+  memcpy(scenes[1].material.foreColor, trollFore, sizeof(trollFore));
+  memcpy(scenes[2].material.backColor, texturesBack, sizeof(texturesBack));
+
+  struct thread_pool* pool = thread_pool_create(threadsOption != NULL ? atoi(threadsOption) : 0);
+  printf("%dx%d framebuffer, %d frames per run\n", w, h, frames);
+  int i;
+  for(i = 0; i < 3; i++)
+    {
+      run_scene(&scenes[i], pool, frames, w, h, pngPrefix);
+      scene_free(&scenes[i]);
+    }
+
+  thread_pool_destroy(pool);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+  app_terminate(&app);
+  return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Sprite batching: sprites are collected between begin and end, sorted
+ * by program and texture, built into one dynamic vertex buffer and drawn
+ * with one call per run of equal state.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sprite_batch.h"
+
+const char* const spriteAttributes[] =
+  {
+    "vertexPosition", "vertexUV", "vertexTint", NULL
+  };
+
+/* position, UV, tint */
+#define VERTEX_FLOATS 8
+
+/* corners in the order of gl_texture.c's square, and their UVs */
+static const GLfloat corners[4][4] =
+  {
+    { -0.5f, 0.5f, 0.0f, 1.0f },
+    { 0.5f, 0.5f, 1.0f, 1.0f },
+    { -0.5f, -0.5f, 0.0f, 0.0f },
+    { 0.5f, -0.5f, 1.0f, 0.0f }
+  };
+
+static const GLuint quadIndices[] =
+  {
+    0, 1, 2, 1, 3, 2
+  };
+
+void sprite_batch_init(struct sprite_batch* batch, int capacity)
+{
+  memset(batch, 0, sizeof(*batch));
+  batch->capacity = capacity > 0 ? capacity : 1;
+  batch->sprites = malloc(sizeof(struct sprite) * batch->capacity);
+  batch->order = malloc(sizeof(int) * batch->capacity);
+  batch->vertices = malloc(sizeof(GLfloat) * VERTEX_FLOATS * 4 * batch->capacity);
+
+  GLuint* indices = malloc(sizeof(GLuint) * 6 * batch->capacity);
+  int i;
+  int j;
+  for(i = 0; i < batch->capacity; i++)
+    {
+      for(j = 0; j < 6; j++)
+        indices[i * 6 + j] = i * 4 + quadIndices[j];
+    }
+  glGenBuffers(1, &batch->indexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 6 * batch->capacity, indices, GL_STATIC_DRAW);
+  free(indices);
+
+  glGenBuffers(1, &batch->vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * VERTEX_FLOATS * 4 * batch->capacity,
+               NULL, GL_STREAM_DRAW);
+}
+
+void sprite_batch_free(struct sprite_batch* batch)
+{
+  glDeleteBuffers(1, &batch->vertexBuffer);
+  glDeleteBuffers(1, &batch->indexBuffer);
+  free(batch->sprites);
+  free(batch->order);
+  free(batch->vertices);
+  memset(batch, 0, sizeof(*batch));
+}
+
+void sprite_batch_begin(struct sprite_batch* batch, enum sprite_sort sort)
+{
+  batch->sort = sort;
+  batch->count = 0;
+  // the caller may have bound anything since the last frame
+  batch->boundProgram = 0;
+  batch->boundTexture = 0;
+  memset(&batch->stats, 0, sizeof(batch->stats));
+}
+
+/* qsort has no context argument */
+static const struct sprite* sortSprites;
+static enum sprite_sort sortMode;
+
+static int compare_sprites(const void* a, const void* b)
+{
+  int ia = *(const int*)a;
+  int ib = *(const int*)b;
+  const struct sprite* sa = &sortSprites[ia];
+  const struct sprite* sb = &sortSprites[ib];
+  if (sa->layer != sb->layer)
+    return sa->layer < sb->layer ? -1 : 1;
+  if (sortMode == SPRITE_SORT_STATE)
+    {
+      if (sa->program != sb->program)
+        return sa->program < sb->program ? -1 : 1;
+      if (sa->texture != sb->texture)
+        return sa->texture < sb->texture ? -1 : 1;
+    }
+  // keep submission order otherwise
+  return ia - ib;
+}
+
+static void build_vertices(struct sprite_batch* batch)
+{
+  GLfloat* out = batch->vertices;
+  int i;
+  int c;
+  for(i = 0; i < batch->count; i++)
+    {
+      const struct sprite* s = &batch->sprites[batch->order[i]];
+      float cosine = 1.0f;
+      float sine = 0.0f;
+      if (s->rotation != 0.0f)
+        {
+          cosine = cosf(s->rotation);
+          sine = sinf(s->rotation);
+        }
+      for(c = 0; c < 4; c++)
+        {
+          float dx = corners[c][0] * s->width;
+          float dy = corners[c][1] * s->height;
+          out[0] = s->x + dx * cosine - dy * sine;
+          out[1] = s->y + dx * sine + dy * cosine;
+          out[2] = s->uvRect[0] + corners[c][2] * s->uvRect[2];
+          out[3] = s->uvRect[1] + corners[c][3] * s->uvRect[3];
+          memcpy(&out[4], s->tint, sizeof(s->tint));
+          out += VERTEX_FLOATS;
+        }
+    }
+}
+
+static void flush(struct sprite_batch* batch)
+{
+  if (batch->count == 0)
+    return;
+  int i;
+  for(i = 0; i < batch->count; i++)
+    batch->order[i] = i;
+  sortSprites = batch->sprites;
+  sortMode = batch->sort;
+  qsort(batch->order, batch->count, sizeof(int), compare_sprites);
+  build_vertices(batch);
+
+  // orphan the old store, so the upload never waits for the previous draws
+  size_t bytes = sizeof(GLfloat) * VERTEX_FLOATS * 4 * batch->count;
+  glBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * VERTEX_FLOATS * 4 * batch->capacity,
+               NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, batch->vertices);
+
+  GLsizei stride = VERTEX_FLOATS * sizeof(GLfloat);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, NULL);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(GLfloat)));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->indexBuffer);
+
+  // one draw call per run of sprites sharing program and texture
+  int first = 0;
+  while(first < batch->count)
+    {
+      const struct sprite* s = &batch->sprites[batch->order[first]];
+      int end = first + 1;
+      while(end < batch->count
+            && batch->sprites[batch->order[end]].program == s->program
+            && batch->sprites[batch->order[end]].texture == s->texture)
+        end++;
+
+      if (s->program != batch->boundProgram)
+        {
+          glUseProgram(s->program);
+          batch->boundProgram = s->program;
+          batch->stats.stateChanges++;
+        }
+      if (s->texture != batch->boundTexture)
+        {
+          glBindTexture(GL_TEXTURE_2D, s->texture);
+          batch->boundTexture = s->texture;
+          batch->stats.stateChanges++;
+        }
+      glDrawElements(GL_TRIANGLES, 6 * (end - first), GL_UNSIGNED_INT,
+                     (void*)(sizeof(GLuint) * 6 * first));
+      batch->stats.drawCalls++;
+      first = end;
+    }
+
+  glDisableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+  glDisableVertexAttribArray(2);
+
+  batch->stats.flushes++;
+  batch->stats.vertices += batch->count * 4;
+  if (batch->count * 4 > batch->stats.maxFlushVertices)
+    batch->stats.maxFlushVertices = batch->count * 4;
+  batch->count = 0;
+}
+
+void sprite_batch_submit(struct sprite_batch* batch, const struct sprite* sprite)
+{
+  if (batch->count == batch->capacity)
+    flush(batch);
+  batch->sprites[batch->count++] = *sprite;
+  batch->stats.sprites++;
+}
+
+void sprite_batch_end(struct sprite_batch* batch)
+{
+  flush(batch);
+}
@@ -0,0 +1,86 @@
+/*
+ * Sprite batching: sprites are collected between begin and end, sorted
+ * by program and texture, built into one dynamic vertex buffer and drawn
+ * with one call per run of equal state.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+
+struct sprite
+{
+  GLuint program;         /* built with spriteAttributes */
+  GLuint texture;
+  int layer;              /* lower layers are drawn first */
+  GLfloat x;              /* center, clip space */
+  GLfloat y;
+  GLfloat width;
+  GLfloat height;
+  GLfloat rotation;       /* radians, counterclockwise */
+  GLfloat uvRect[4];      /* u0, v0, width, height */
+  GLfloat tint[4];
+};
+
+enum sprite_sort
+{
+  /*
+   * Reorder sprites within a layer by program and texture. Only right
+   * when sprites of one layer do not overlap, or blend order-independently.
+   */
+  SPRITE_SORT_STATE,
+  /* submission order; only neighbours with equal state share a draw call */
+  SPRITE_SORT_NONE
+};
+
+/* attribute names of sprite.vertex, for program_source.attributes */
+extern const char* const spriteAttributes[];
+
+/* per frame, reset by sprite_batch_begin */
+struct sprite_batch_stats
+{
+  int sprites;
+  int flushes;            /* vertex buffer uploads */
+  int vertices;           /* uploaded by all flushes */
+  int drawCalls;
+  int stateChanges;       /* program or texture binds */
+  int maxFlushVertices;   /* most vertices uploaded by one flush */
+};
+
+struct sprite_batch
+{
+  int capacity;           /* sprites per flush */
+  enum sprite_sort sort;
+  struct sprite* sprites;
+  int count;
+  int* order;
+  GLfloat* vertices;
+  GLuint vertexBuffer;
+  GLuint indexBuffer;
+  GLuint boundProgram;
+  GLuint boundTexture;
+  struct sprite_batch_stats stats;
+};
+
+/*
+ * 'capacity' sprites are kept until the batch is flushed; submitting more
+ * flushes early. A capacity of 1 gives one upload and one draw per sprite.
+ */
+void sprite_batch_init(struct sprite_batch* batch, int capacity);
+void sprite_batch_free(struct sprite_batch* batch);
+
+void sprite_batch_begin(struct sprite_batch* batch, enum sprite_sort sort);
+void sprite_batch_submit(struct sprite_batch* batch, const struct sprite* sprite);
+
+/* flush what is left; leaves the last program in use */
+void sprite_batch_end(struct sprite_batch* batch);
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * Worst-case frame time while a set of textures is loaded during the
+ * frame loop: inline on the render thread, or streamed in by
+ * texture_streamer.
+ *
+ *   stream_bench [--headless] [--inline] [--count N] [--at FRAME]
+ *                [--gpu-mipmaps] [files...]
+ *
+ * A grid of --count squares (default 64) is drawn every frame, each with
+ * its own texture; the files (default texture.png and Trollface.png) are
+ * used in turn. At frame --at (default 30) every texture is requested.
+ * --inline loads them all within that frame, the way the demos load
+ * theirs before the loop; otherwise they show the placeholder until the
+ * loader thread has them ready. The streamer always builds mipmaps on
+ * the CPU, so --inline does too, for a fair comparison; --gpu-mipmaps
+ * makes --inline use glGenerateMipmap instead. The report names the path
+ * used. The run ends 30 frames after the last texture arrived, or
+ * at --frames / --seconds (mind the headless default of 1000 frames).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "frame_stats.h"
+#include "program_cache.h"
+#include "shader_variants.h"
+#include "sprite_batch.h"
+#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--count", "--at", NULL };
+  return app_option_value(argv, i, valued);
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Texture streaming benchmark", 0))
+    return -1;
+
+  bool inlineLoad = app_flag(argc, argv, "--inline");
+  const char* countOption = app_option(argc, argv, "--count");
+  const char* atOption = app_option(argc, argv, "--at");
+  int count = countOption != NULL ? atoi(countOption) : 64;
+  int requestFrame = atOption != NULL ? atoi(atOption) : 30;
+  if (count < 1)
+    count = 1;
+
+  const char** files = malloc(sizeof(const char*) * argc);
+  int fileCount = 0;
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      files[fileCount++] = argv[i];
+    }
+  if (fileCount == 0)
+    {
+      files[fileCount++] = "texture.png";
+      files[fileCount++] = "Trollface.png";
+    }
+
+  struct program_cache programCache;
+  program_cache_init(&programCache, app.options.programCacheDir);
+  struct shader_variants variants;
+  shader_variants_init(&variants, &programCache, "sprite.vertex", "texture.frag", spriteAttributes);
+  struct shader_variant* program = shader_variants_get(&variants, SHADER_VERTEX_TINT);
+  if (program == NULL)
+    return -1;
+  glUseProgram(program->source.program);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  int w;
+  int h;
+  app_get_size(&app, &w, &h);
+  glViewport(0, 0, w, h);
+
+  struct texture_load_options loadOptions;
+  texture_load_options_init(&loadOptions, 0);
+  // the streamer forces cpuMipmaps; the pool builds the chains of both modes
+  loadOptions.cpuMipmaps = !app_flag(argc, argv, "--gpu-mipmaps");
+  if (!loadOptions.cpuMipmaps && !inlineLoad)
+    fprintf(stderr, "WARNING: --gpu-mipmaps only applies to --inline\n");
+  loadOptions.pool = thread_pool_create(0);
+
+  // the inline mode uses the streamer only for its placeholder
+  struct texture_streamer streamer;
+  if (!texture_streamer_init(&streamer, &app, &loadOptions))
+    return -1;
+  struct streamed_texture** items = calloc(count, sizeof(struct streamed_texture*));
+  GLuint* inlineTextures = calloc(count, sizeof(GLuint));
+  GLuint* textures = malloc(sizeof(GLuint) * count);
+  for(i = 0; i < count; i++)
+    textures[i] = streamer.placeholder;
+
+  struct sprite_batch batch;
+  sprite_batch_init(&batch, count);
+  int columns = (int)ceil(sqrt(count));
+  float cell = 2.0f / columns;
+
+  struct frame_stats before;
+  struct frame_stats during;
+  struct frame_stats after;
+  frame_stats_init(&before);
+  frame_stats_init(&during);
+  frame_stats_init(&after);
+  int readyCount = 0;
+  int frame = 0;
+  int tailFrames = 0;
+  double requestTime = 0;
+  double allReadyTime = 0;
+  // frames are this benchmark's clock
+  app_set_frame_rate(&app, 60);
+  while(tailFrames < 30)
+    {
+      double frameStart = timing_now();
+      // the frame that completes the set still counts as loading
+      bool loading = frame >= requestFrame && allReadyTime == 0;
+      app_begin_frame(&app);
+
+      if (frame == requestFrame)
+        {
+          requestTime = timing_now();
+          for(i = 0; i < count; i++)
+            {
+              const char* path = files[i % fileCount];
+              if (inlineLoad)
+                {
+                  struct texture_info info;
+                  glGenTextures(1, &inlineTextures[i]);
+                  glBindTexture(GL_TEXTURE_2D, inlineTextures[i]);
+                  if (load_texture_file(path, &loadOptions, &info))
+                    textures[i] = inlineTextures[i];
+                  readyCount++;
+                }
+              else
+                {
+                  items[i] = texture_streamer_request(&streamer, path);
+                }
+            }
+        }
+      if (texture_streamer_poll(&streamer) > 0)
+        {
+          readyCount = 0;
+          for(i = 0; i < count; i++)
+            {
+              textures[i] = items[i]->texture;
+              if (items[i]->ready)
+                readyCount++;
+            }
+        }
+      bool allReady = frame >= requestFrame && readyCount == count;
+      if (allReady && allReadyTime == 0)
+        allReadyTime = timing_now();
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      sprite_batch_begin(&batch, SPRITE_SORT_NONE);
+      for(i = 0; i < count; i++)
+        {
+          struct sprite s =
+            {
+              program->source.program, textures[i], 0,
+              -1.0f + cell * (i % columns + 0.5f), 1.0f - cell * (i / columns + 0.5f),
+              0.9f * cell, 0.9f * cell, 0.0f,
+              { 0.0f, 0.0f, 1.0f, 1.0f },
+              { 195 / 255.0f, 180 / 255.0f, 218 / 255.0f, 1.0f }
+            };
+          sprite_batch_submit(&batch, &s);
+        }
+      sprite_batch_end(&batch);
+      glFlush();
+
+      bool more = app_end_frame(&app);
+      double frameEnd = timing_now();
+      if (frame < requestFrame)
+        frame_stats_add(&before, frameStart, frameEnd);
+      else if (loading)
+        frame_stats_add(&during, frameStart, frameEnd);
+      else
+        frame_stats_add(&after, frameStart, frameEnd);
+      if (allReady)
+        tailFrames++;
+      frame++;
+      if (!more)
+        break;
+    }
+
+  printf("%s: %d textures from %d files, requested at frame %d, mipmaps by %s\n",
+         inlineLoad ? "inline" : "streamed", count, fileCount, requestFrame,
+         inlineLoad && !loadOptions.cpuMipmaps ? "glGenerateMipmap" : "the CPU");
+  int failed = 0;
+  for(i = 0; i < count; i++)
+    {
+      if (frame > requestFrame && textures[i] == streamer.placeholder)
+        failed++;
+    }
+  if (allReadyTime > 0)
+    printf("%s: all ready %.3f ms after the request, %d failed\n", inlineLoad ? "inline" : "streamed",
+           (allReadyTime - requestTime) * 1000.0, failed);
+  frame_stats_report(&before, "before", stdout);
+  frame_stats_report(&during, "loading", stdout);
+  frame_stats_report(&after, "after", stdout);
+
+  frame_stats_free(&before);
+  frame_stats_free(&during);
+  frame_stats_free(&after);
+  sprite_batch_free(&batch);
+  for(i = 0; i < count; i++)
+    {
+      if (inlineTextures[i] != 0)
+        glDeleteTextures(1, &inlineTextures[i]);
+    }
+  texture_streamer_free(&streamer);
+  if (loadOptions.pool != NULL)
+    thread_pool_destroy(loadOptions.pool);
+  free(items);
+  free(inlineTextures);
+  free(textures);
+  free(files);
+  glUseProgram(0);
+  shader_variants_free(&variants);
+  app_terminate(&app);
+  return 0;
+}
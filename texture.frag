@@ -1,19 +1,84 @@
 #version 120
 
-varying vec2 UV;
+// One source for every textured square; shader_variants.c defines the
+// features a program is built with:
+//
+//   GRAY_TINT      single channel coverage (0 = ink): foreColor where
+//                  the texture is dark, backColor elsewhere
+//   SDF            with GRAY_TINT: the red channel is a signed distance
+//                  field (sdf_convert, 0.5 on the edge, larger inside);
+//                  the edge is rebuilt per pixel, sharp at any scale
+//   PREMULTIPLIED  texel colors are already multiplied by their alpha
+//   VERTEX_TINT    backColor and the output alpha come from the vertex
+//                  shader's 'tint' (instanced quads, sprites)
+//   VIRTUAL        myTexture is a virtual_texture's tile cache and UV
+//                  addresses the whole image: the page table says which
+//                  cache slot holds the tile under UV, and at which level
 
+varying vec2 UV;
+#ifdef VERTEX_TINT
+varying vec4 tint;
+#else
 uniform vec3 backColor;
+#endif
+#ifdef GRAY_TINT
+uniform vec3 foreColor;
+#endif
 uniform sampler2D myTexture;
+#ifdef VIRTUAL
+uniform sampler2D pageTable;
+uniform vec4 virtualTiles;      // image size in level 0 tiles; page table size
+uniform vec3 tileLayout;        // border and content per stored tile size; slots per side
+
+vec4 sampleTexture(vec2 uv)
+{
+        vec2 tile = uv * virtualTiles.xy;
+        vec4 page = floor(texture2D(pageTable, (floor(tile) + 0.5) / virtualTiles.zw) * 255.0 + 0.5);
+        // position inside the tile of that level, past its border
+        vec2 inTile = fract(tile / exp2(page.b));
+        return texture2D(myTexture, (page.rg + tileLayout.x + inTile * tileLayout.y) / tileLayout.z);
+}
+#else
+vec4 sampleTexture(vec2 uv)
+{
+        return texture2D(myTexture, uv);
+}
+#endif
 
 void main()
 {
-        vec3 textureColor = texture2D(myTexture, UV).rgb;
-        float textureAlpha = texture2D(myTexture, UV).a;
+#ifdef VERTEX_TINT
+        vec3 background = tint.rgb;
+        float alpha = tint.a;
+#else
+        vec3 background = backColor;
+        float alpha = 1.0;
+#endif
+
+#ifdef GRAY_TINT
+#ifdef SDF
+        // one screen pixel of antialiasing around the edge, at any scale
+        float field = sampleTexture(UV).r;
+        float edgeWidth = 0.5 * fwidth(field);
+        float textureAlpha = smoothstep(0.5 - edgeWidth, 0.5 + edgeWidth, field);
+#else
+        float textureAlpha = 1.0 - sampleTexture(UV).r;
+#endif
+        vec3 textureColor = foreColor * textureAlpha;
+#else
+        vec4 texel = sampleTexture(UV);
+        float textureAlpha = texel.a;
+#ifdef PREMULTIPLIED
+        vec3 textureColor = texel.rgb;
+#else
+        vec3 textureColor = texel.rgb * textureAlpha;
+#endif
+#endif
 
         // Do manual alpha blending on square
         // Alpha blending done here will not affect alpha blending between this square
         //  and OpenGL scene
-        vec3 finalColor = backColor * (1 - textureAlpha) + textureColor * textureAlpha;
+        vec3 finalColor = background * (1.0 - textureAlpha) + textureColor;
 
-        gl_FragColor = vec4(finalColor, 1.0f);
+        gl_FragColor = vec4(finalColor, alpha);
 }
@@ -0,0 +1,108 @@
+/*
+ * Decode many PNG files on worker threads, upload them on the GL thread.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "texture_batch.h"
+#include "image_loader.h"
+#include "timing.h"
+
+/* finished items, in the order the workers completed them */
+struct completion_queue
+{
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  int* indices;
+  int written;
+};
+
+struct decode_job
+{
+  struct texture_batch_item* item;
+  int index;
+  struct completion_queue* queue;
+};
+
+static void decode_item(struct texture_batch_item* item)
+{
+  double start = timing_now();
+  item->pixels = item->channels == 1
+    ? load_image_new_gray(item->path, &item->width, &item->height)
+    : load_image_new(item->path, &item->width, &item->height);
+  item->decodeSeconds = timing_now() - start;
+}
+
+static void decode_job_run(void* arg)
+{
+  struct decode_job* job = arg;
+  decode_item(job->item);
+
+  pthread_mutex_lock(&job->queue->lock);
+  job->queue->indices[job->queue->written++] = job->index;
+  pthread_cond_signal(&job->queue->ready);
+  pthread_mutex_unlock(&job->queue->lock);
+}
+
+void texture_batch_load(struct thread_pool* pool, struct texture_batch_item* items, int count,
+                        texture_batch_upload_fn upload, void* user)
+{
+  struct completion_queue queue;
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_cond_init(&queue.ready, NULL);
+  queue.indices = malloc(sizeof(int) * count);
+  queue.written = 0;
+
+  struct decode_job* jobs = malloc(sizeof(struct decode_job) * count);
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      jobs[i].item = &items[i];
+      jobs[i].index = i;
+      jobs[i].queue = &queue;
+      thread_pool_submit(pool, decode_job_run, &jobs[i]);
+    }
+
+  int consumed;
+  for(consumed = 0; consumed < count; consumed++)
+    {
+      pthread_mutex_lock(&queue.lock);
+      while(queue.written == consumed)
+        pthread_cond_wait(&queue.ready, &queue.lock);
+      int index = queue.indices[consumed];
+      pthread_mutex_unlock(&queue.lock);
+
+      // GL calls only ever happen here, on the caller's thread
+      upload(&items[index], user);
+      free(items[index].pixels);
+      items[index].pixels = NULL;
+    }
+
+  // the last worker may still be releasing the lock after its signal;
+  // the pool itself may be shared, so it is not waited for
+  pthread_mutex_lock(&queue.lock);
+  pthread_mutex_unlock(&queue.lock);
+  free(jobs);
+  free(queue.indices);
+  pthread_cond_destroy(&queue.ready);
+  pthread_mutex_destroy(&queue.lock);
+}
+
+void texture_batch_load_serial(struct texture_batch_item* items, int count,
+                               texture_batch_upload_fn upload, void* user)
+{
+  int i;
+  for(i = 0; i < count; i++)
+    {
+      decode_item(&items[i]);
+      upload(&items[i], user);
+      free(items[i].pixels);
+      items[i].pixels = NULL;
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ * Decode many PNG files on worker threads, upload them on the GL thread.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef TEXTURE_BATCH_H
+#define TEXTURE_BATCH_H
+
+#include <stdbool.h>
+#include "thread_pool.h"
+
+struct texture_batch_item
+{
+  /* input */
+  const char* path;
+  int channels;           /* 4: RGBA, 1: gray */
+
+  /* filled in by the decoder */
+  unsigned char* pixels;  /* bottom-up rows, NULL when decoding failed */
+  int width;
+  int height;
+  double decodeSeconds;
+};
+
+/* called on the thread that runs texture_batch_load */
+typedef void (*texture_batch_upload_fn)(struct texture_batch_item* item, void* user);
+
+/*
+ * Decode every item on the pool and hand each one to 'upload' as soon as
+ * it is finished (completion order, not list order). Call this on the GL
+ * thread; uploads overlap with the decoding of the remaining files.
+ * Pixel buffers are freed right after their upload callback returns.
+ */
+void texture_batch_load(struct thread_pool* pool, struct texture_batch_item* items, int count,
+                        texture_batch_upload_fn upload, void* user);
+
+/* same, but decode and upload one file after another on this thread */
+void texture_batch_load_serial(struct texture_batch_item* items, int count,
+                               texture_batch_upload_fn upload, void* user);
+
+#endif
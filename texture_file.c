@@ -0,0 +1,221 @@
+/*
+ * Load a texture file (PNG or KTX) into a complete, mipmapped texture.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "texture_file.h"
+#include "image_loader.h"
+#include "ktx.h"
+
+bool has_suffix(const char* name, const char* suffix)
+{
+  size_t nameLength = strlen(name);
+  size_t suffixLength = strlen(suffix);
+  return nameLength >= suffixLength
+    && strcmp(name + nameLength - suffixLength, suffix) == 0;
+}
+
+void texture_load_options_init(struct texture_load_options* options, int channels)
+{
+  memset(options, 0, sizeof(*options));
+  options->channels = channels;
+  options->usePbo = true;
+  options->mip.filter = MIP_FILTER_BOX;
+  options->mip.kernel = MIP_KERNEL_AUTO;
+  options->mip.srgb = true;
+  options->npot = TEXTURE_NPOT_RESAMPLE;
+  options->resampleFilter = RESAMPLE_LANCZOS3;
+}
+
+/* levels and bytes of a full chain over info's size, as glGenerateMipmap makes it */
+static void count_levels(struct texture_info* info)
+{
+  int w = info->width;
+  int h = info->height;
+  while(true)
+    {
+      info->bytes += (size_t)w * h * info->channels;
+      info->levels++;
+      if (w == 1 && h == 1)
+        break;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+    }
+}
+
+/* build every level of info's size from 'pixels' on the CPU, upload them all */
+static bool upload_cpu_mipmaps(const unsigned char* pixels, const struct texture_load_options* options,
+                               struct texture_info* info)
+{
+  struct mip_chain chain;
+  if (!mip_chain_build(&chain, pixels, info->width, info->height, info->channels,
+                       &options->mip, options->pool))
+    return false;
+  mip_chain_upload(&chain);
+  info->levels = chain.count;
+  int i;
+  for(i = 0; i < chain.count; i++)
+    info->bytes += (size_t)chain.width[i] * chain.height[i] * chain.channels;
+  mip_chain_free(&chain);
+  info->path = "cpu-mip";
+  return true;
+}
+
+/* decode to memory, build every level on the CPU, upload them all */
+static bool load_with_cpu_mipmaps(const char* filename, const struct texture_load_options* options,
+                                  struct texture_info* info)
+{
+  // the chain is built from gray or RGBA only
+  info->channels = options->channels == 1 ? 1 : 4;
+  unsigned char* pixels = load_image(filename, info->channels, &info->width, &info->height, NULL);
+  if (pixels == NULL)
+    return false;
+  bool ok = upload_cpu_mipmaps(pixels, options, info);
+  free(pixels);
+  return ok;
+}
+
+static bool is_power_of_2(int n)
+{
+  return (n & (n - 1)) == 0;
+}
+
+/* smallest power of two >= n, but no more than 'limit' (a power of two itself) */
+static int next_power_of_2(int n, int limit)
+{
+  int p = 1;
+  while(p < n && p < limit)
+    p *= 2;
+  return p;
+}
+
+/* w x h 'pixels' at the origin of dw x dh, the last row and column repeated over the rest */
+static void pad_image(const unsigned char* pixels, int w, int h, int channels,
+                      unsigned char* out, int dw, int dh)
+{
+  size_t row = (size_t)w * channels;
+  size_t stride = (size_t)dw * channels;
+  int x;
+  int y;
+  for(y = 0; y < dh; y++)
+    {
+      unsigned char* dst = out + y * stride;
+      memcpy(dst, pixels + (y < h ? y : h - 1) * row, row);
+      for(x = w; x < dw; x++)
+        memcpy(dst + x * channels, dst + (w - 1) * channels, channels);
+    }
+}
+
+/* decode, resample or pad to powers of two, then mipmap as usual */
+static bool load_npot(const char* filename, const struct texture_load_options* options,
+                      struct texture_info* info)
+{
+  // mip_resample (and the CPU chain) take gray or RGBA only
+  info->channels = options->channels == 1 ? 1 : 4;
+  unsigned char* pixels = load_image(filename, info->channels, &info->imageWidth, &info->imageHeight, NULL);
+  if (pixels == NULL)
+    return false;
+  GLint limit;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+  info->width = next_power_of_2(info->imageWidth, limit);
+  info->height = next_power_of_2(info->imageHeight, limit);
+  unsigned char* texels = malloc((size_t)info->width * info->height * info->channels);
+  if (texels == NULL)
+    {
+      free(pixels);
+      return false;
+    }
+
+  bool ok = true;
+  if (options->npot == TEXTURE_NPOT_PAD
+      && info->width >= info->imageWidth && info->height >= info->imageHeight)
+    {
+      pad_image(pixels, info->imageWidth, info->imageHeight, info->channels,
+                texels, info->width, info->height);
+      info->npot = TEXTURE_NPOT_PAD;
+    }
+  else
+    {
+      ok = mip_resample(pixels, info->imageWidth, info->imageHeight, info->channels,
+                        texels, info->width, info->height, options->resampleFilter,
+                        &options->mip, options->pool);
+      info->npot = TEXTURE_NPOT_RESAMPLE;
+    }
+  free(pixels);
+
+  if (ok && options->cpuMipmaps)
+    ok = upload_cpu_mipmaps(texels, options, info);
+  else if (ok)
+    {
+      GLenum format = image_gl_format(info->channels);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexImage2D(GL_TEXTURE_2D, 0, format, info->width, info->height, 0,
+                   format, GL_UNSIGNED_BYTE, texels);
+      glGenerateMipmap(GL_TEXTURE_2D);
+      count_levels(info);
+      info->path = "copy";
+    }
+  free(texels);
+  // the image only covers the bottom left corner; keep its left and
+  // bottom edges from wrapping around into the padding
+  if (ok && info->npot == TEXTURE_NPOT_PAD)
+    {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+  return ok;
+}
+
+bool load_texture_file(const char* filename, const struct texture_load_options* options,
+                       struct texture_info* info)
+{
+  memset(info, 0, sizeof(*info));
+  info->npot = TEXTURE_NPOT_KEEP;
+
+  int w;
+  int h;
+  if (has_suffix(filename, ".ktx"))
+    {
+      // precomputed chain: no decoding and no glGenerateMipmap
+      if (!ktx_load_texture(filename, &info->width, &info->height, &info->levels, &info->bytes))
+        return false;
+      info->path = "ktx";
+    }
+  else if (options->npot != TEXTURE_NPOT_KEEP && image_size(filename, &w, &h)
+           && !(is_power_of_2(w) && is_power_of_2(h)))
+    {
+      if (!load_npot(filename, options, info))
+        return false;
+    }
+  else if (options->cpuMipmaps)
+    {
+      if (!load_with_cpu_mipmaps(filename, options, info))
+        return false;
+    }
+  else
+    {
+      info->channels = options->channels;
+      if (!load_texture_image(filename, &info->channels, options->usePbo,
+                              &info->width, &info->height))
+        return false;
+      glGenerateMipmap(GL_TEXTURE_2D);
+      info->path = options->usePbo && GLEW_ARB_pixel_buffer_object ? "pbo" : "copy";
+      count_levels(info);
+    }
+  if (info->npot == TEXTURE_NPOT_KEEP)
+    {
+      info->imageWidth = info->width;
+      info->imageHeight = info->height;
+    }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  return true;
+}
@@ -0,0 +1,78 @@
+/*
+ * Load a texture file (PNG or KTX) into a complete, mipmapped texture.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+#include "mipmap.h"
+
+/* what load_texture_file does with PNGs whose sides are not powers of two */
+enum texture_npot
+{
+  TEXTURE_NPOT_RESAMPLE,        /* scale to the next power of two (mip_resample) */
+  TEXTURE_NPOT_PAD,             /* place at the origin of one, repeating the last row and column */
+  TEXTURE_NPOT_KEEP             /* upload as is */
+};
+
+struct texture_info
+{
+  int width;
+  int height;
+  int imageWidth;     /* of the file: less than width / height when resampled */
+  int imageHeight;    /* or padded (padding: the image covers this part of it) */
+  enum texture_npot npot;       /* what was done, TEXTURE_NPOT_KEEP when nothing */
+  int levels;
+  int channels;       /* 1 to 4, 0 for compressed formats */
+  size_t bytes;       /* texture memory of all levels */
+  const char* path;   /* how it was loaded: "pbo", "copy", "cpu-mip" or "ktx" */
+};
+
+struct texture_load_options
+{
+  int channels;                 /* 1 to 4 (see load_texture_image), 0: tightest */
+  bool usePbo;
+  bool cpuMipmaps;              /* build the chain with mip_chain_build, not glGenerateMipmap */
+  struct mip_options mip;
+  enum texture_npot npot;
+  enum resample_filter resampleFilter;
+  struct thread_pool* pool;     /* for cpuMipmaps and resampling, may be NULL */
+};
+
+/* given channels, PBO uploads, glGenerateMipmap, NPOT images resampled with Lanczos */
+void texture_load_options_init(struct texture_load_options* options, int channels);
+
+/*
+ * Fill the currently bound GL_TEXTURE_2D from 'filename' and set linear /
+ * trilinear filtering.
+ *
+ * *.ktx files carry their own (compressed) mip chain and are uploaded as
+ * they are. Anything else is read as PNG with options->channels channels
+ * through load_texture_image and mipmapped with glGenerateMipmap, or, with
+ * cpuMipmaps, decoded to memory and given a gamma-correct, premultiplied
+ * chain built on the CPU.
+ *
+ * GL 2.1 hardware mipmaps non-power-of-two textures slowly or not at all,
+ * so unless options->npot is TEXTURE_NPOT_KEEP such PNGs are decoded to
+ * memory and resampled (options->resampleFilter) or padded up to the next
+ * power of two (at most GL_MAX_TEXTURE_SIZE; padding falls back to
+ * resampling when the image does not fit) before the mip chain is made.
+ * A padded texture clamps to the edge; only texture coordinates up to
+ * imageWidth / width and imageHeight / height show the image.
+ */
+bool load_texture_file(const char* filename, const struct texture_load_options* options,
+                       struct texture_info* info);
+
+/* does 'name' end with 'suffix'? */
+bool has_suffix(const char* name, const char* suffix);
+
+#endif
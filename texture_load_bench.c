@@ -0,0 +1,129 @@
+/*
+ * Compare loading a list of PNG textures one by one against decoding them
+ * on all cores with texture_batch_load.
+ *
+ *   texture_load_bench [--headless] [--threads N] [--gray] a.png b.png ...
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <GL/glfw3.h>
+#include "app.h"
+#include "texture_batch.h"
+#include "timing.h"
+
+struct upload_state
+{
+  GLuint* textures;
+  int uploaded;
+  int failed;
+};
+
+static void upload_texture(struct texture_batch_item* item, void* user)
+{
+  struct upload_state* state = user;
+  if (item->pixels == NULL)
+    {
+      state->failed++;
+      return;
+    }
+
+  GLenum format = item->channels == 1 ? GL_RED : GL_RGBA;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, item->width, item->height, 0,
+               format, GL_UNSIGNED_BYTE, item->pixels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  state->textures[state->uploaded++] = texture;
+}
+
+/* is argv[i] the value of an option rather than a file? */
+static bool is_option_value(char** argv, int i)
+{
+  static const char* const valued[] = { "--threads", NULL };
+  return app_option_value(argv, i, valued);
+}
+
+static double run(struct texture_batch_item* items, int count, struct thread_pool* pool)
+{
+  struct upload_state state;
+  state.textures = malloc(sizeof(GLuint) * count);
+  state.uploaded = 0;
+  state.failed = 0;
+
+  double start = timing_now();
+  if (pool == NULL)
+    texture_batch_load_serial(items, count, upload_texture, &state);
+  else
+    texture_batch_load(pool, items, count, upload_texture, &state);
+  glFinish();
+  double elapsed = timing_now() - start;
+
+  if (state.failed > 0)
+    fprintf(stderr, "WARNING: %d of %d files failed to load\n", state.failed, count);
+  glDeleteTextures(state.uploaded, state.textures);
+  free(state.textures);
+  return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+  struct app app;
+  if (!app_init(&app, argc, argv, "Texture load benchmark", 0))
+    return -1;
+
+  const char* threadsOption = app_option(argc, argv, "--threads");
+  int threads = threadsOption != NULL ? atoi(threadsOption) : 0;
+  int channels = app_flag(argc, argv, "--gray") ? 1 : 4;
+
+  struct texture_batch_item* items = calloc(argc, sizeof(struct texture_batch_item));
+  int count = 0;
+  int i;
+  for(i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--", 2) == 0 || is_option_value(argv, i))
+        continue;
+      items[count].path = argv[i];
+      items[count].channels = channels;
+      count++;
+    }
+  if (count == 0)
+    {
+      fprintf(stderr, "usage: %s [--headless] [--threads N] [--gray] file.png...\n", argv[0]);
+      app_terminate(&app);
+      return -1;
+    }
+
+  double serial = run(items, count, NULL);
+  double serialDecode = 0;
+  for(i = 0; i < count; i++)
+    serialDecode += items[i].decodeSeconds;
+
+  struct thread_pool* pool = thread_pool_create(threads);
+  double parallel = run(items, count, pool);
+
+  printf("%-40s %12s\n", "file", "decode ms");
+  for(i = 0; i < count; i++)
+    printf("%-40s %12.3f\n", items[i].path, items[i].decodeSeconds * 1000.0);
+  printf("serial:   %.3f ms wall (%.3f ms decoding)\n", serial * 1000.0, serialDecode * 1000.0);
+  printf("parallel: %.3f ms wall on %d threads, speedup %.2fx\n",
+         parallel * 1000.0, thread_pool_size(pool), parallel > 0 ? serial / parallel : 0.0);
+
+  thread_pool_destroy(pool);
+  free(items);
+  app_terminate(&app);
+  return 0;
+}
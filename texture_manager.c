@@ -0,0 +1,143 @@
+/*
+ * Keep the textures of a large asset set within a texture memory budget:
+ * load them when first drawn, evict the least recently used ones.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "texture_manager.h"
+
+bool texture_manager_init(struct texture_manager* manager, struct app* app,
+                          const struct texture_load_options* options, size_t budget)
+{
+  memset(manager, 0, sizeof(*manager));
+  manager->budget = budget;
+  return texture_streamer_init(&manager->streamer, app, options);
+}
+
+void texture_manager_free(struct texture_manager* manager)
+{
+  // the streamer deletes the textures that are still resident
+  texture_streamer_free(&manager->streamer);
+  int i;
+  for(i = 0; i < manager->count; i++)
+    {
+      free(manager->textures[i]->path);
+      free(manager->textures[i]);
+    }
+  free(manager->textures);
+  memset(manager, 0, sizeof(*manager));
+}
+
+struct managed_texture* texture_manager_add(struct texture_manager* manager, const char* path)
+{
+  if (manager->count == manager->capacity)
+    {
+      int capacity = manager->capacity == 0 ? 64 : manager->capacity * 2;
+      struct managed_texture** textures = realloc(manager->textures,
+                                                  sizeof(struct managed_texture*) * capacity);
+      if (textures == NULL)
+        return NULL;
+      manager->textures = textures;
+      manager->capacity = capacity;
+    }
+  struct managed_texture* texture = calloc(1, sizeof(*texture));
+  if (texture == NULL)
+    return NULL;
+  texture->path = strdup(path);
+  texture->state = MANAGED_EVICTED;
+  manager->textures[manager->count++] = texture;
+  return texture;
+}
+
+/* a load finished: account for it, or give up on the file */
+static void arrived(struct texture_manager* manager, struct managed_texture* texture)
+{
+  struct texture_manager_stats* stats = &manager->stats;
+  stats->loading--;
+  if (texture->stream->failed)
+    {
+      texture_streamer_release(&manager->streamer, texture->stream);
+      texture->stream = NULL;
+      texture->state = MANAGED_FAILED;
+      stats->failures++;
+      return;
+    }
+  texture->state = MANAGED_RESIDENT;
+  texture->bytes = texture->stream->info.bytes;
+  stats->resident++;
+  stats->residentBytes += texture->bytes;
+  if (stats->residentBytes > stats->peakBytes)
+    stats->peakBytes = stats->residentBytes;
+}
+
+static void evict(struct texture_manager* manager, struct managed_texture* texture)
+{
+  texture_streamer_release(&manager->streamer, texture->stream);
+  texture->stream = NULL;
+  texture->state = MANAGED_EVICTED;
+  manager->stats.resident--;
+  manager->stats.residentBytes -= texture->bytes;
+  manager->stats.evictions++;
+}
+
+void texture_manager_begin_frame(struct texture_manager* manager)
+{
+  manager->frame++;
+  int i;
+  if (texture_streamer_poll(&manager->streamer) > 0)
+    {
+      for(i = 0; i < manager->count; i++)
+        {
+          struct managed_texture* texture = manager->textures[i];
+          if (texture->state == MANAGED_LOADING && texture->stream->ready)
+            arrived(manager, texture);
+        }
+    }
+
+  // a linear scan per eviction keeps texture_manager_use down to a
+  // store; evictions are rare next to uses
+  while(manager->stats.residentBytes > manager->budget)
+    {
+      struct managed_texture* oldest = NULL;
+      for(i = 0; i < manager->count; i++)
+        {
+          struct managed_texture* texture = manager->textures[i];
+          if (texture->state == MANAGED_RESIDENT && texture->lastUse + 1 < manager->frame
+              && (oldest == NULL || texture->lastUse < oldest->lastUse))
+            oldest = texture;
+        }
+      if (oldest == NULL)
+        break;
+      evict(manager, oldest);
+    }
+}
+
+GLuint texture_manager_use(struct texture_manager* manager, struct managed_texture* texture)
+{
+  texture->lastUse = manager->frame;
+  switch(texture->state)
+    {
+    case MANAGED_RESIDENT:
+      manager->stats.hits++;
+      return texture->stream->texture;
+    case MANAGED_EVICTED:
+      texture->stream = texture_streamer_request(&manager->streamer, texture->path);
+      texture->state = MANAGED_LOADING;
+      manager->stats.misses++;
+      manager->stats.loading++;
+      break;
+    case MANAGED_LOADING:
+      manager->stats.waits++;
+      break;
+    case MANAGED_FAILED:
+      break;
+    }
+  return manager->streamer.placeholder;
+}
@@ -0,0 +1,92 @@
+/*
+ * Keep the textures of a large asset set within a texture memory budget:
+ * load them when first drawn, evict the least recently used ones.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+#include "app.h"
+#include "texture_streamer.h"
+
+enum managed_state
+{
+  MANAGED_EVICTED,      /* not in texture memory (also before the first use) */
+  MANAGED_LOADING,      /* requested from the streamer, drawn as the placeholder */
+  MANAGED_RESIDENT,
+  MANAGED_FAILED        /* drawn as the placeholder for good */
+};
+
+struct managed_texture
+{
+  char* path;
+  enum managed_state state;
+  struct streamed_texture* stream;    /* while loading or resident */
+  size_t bytes;         /* texture memory with all levels, once loaded */
+  unsigned long lastUse;              /* frame number */
+};
+
+struct texture_manager_stats
+{
+  long hits;            /* uses of a resident texture */
+  long misses;          /* uses that started a load */
+  long waits;           /* uses while loading (the placeholder was drawn) */
+  long evictions;
+  long failures;
+  int resident;
+  int loading;
+  size_t residentBytes;
+  size_t peakBytes;
+};
+
+struct texture_manager
+{
+  struct texture_streamer streamer;
+  size_t budget;
+  unsigned long frame;
+  struct managed_texture** textures;
+  int count;
+  int capacity;
+  struct texture_manager_stats stats;
+};
+
+/*
+ * Load through a texture_streamer (see texture_streamer_init for 'app'
+ * and 'options') and keep at most 'budget' bytes of texture memory
+ * resident, except that textures used in the previous frame are never
+ * evicted: a frame that needs more than the budget gets it. Sizes are
+ * only known once loaded, so the textures arriving in one frame may
+ * overshoot the budget until the evictions that follow.
+ */
+bool texture_manager_init(struct texture_manager* manager, struct app* app,
+                          const struct texture_load_options* options, size_t budget);
+
+/* deletes every texture */
+void texture_manager_free(struct texture_manager* manager);
+
+/* register 'path' (copied); nothing is loaded until its first use */
+struct managed_texture* texture_manager_add(struct texture_manager* manager, const char* path);
+
+/*
+ * Call once per frame before drawing: publishes finished loads, then
+ * evicts least recently used textures while over the budget.
+ */
+void texture_manager_begin_frame(struct texture_manager* manager);
+
+/*
+ * The texture to draw 'texture' with this frame: the real one when
+ * resident, the streamer's placeholder otherwise. The first use after
+ * registration or eviction starts loading it.
+ */
+GLuint texture_manager_use(struct texture_manager* manager, struct managed_texture* texture);
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * Load textures on a background thread with its own shared GL context:
+ * decode, upload and mip there, and hand the finished textures to the
+ * render thread once their fence has signaled.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "texture_streamer.h"
+#include "timing.h"
+
+static void load(struct texture_streamer* streamer, struct streamed_texture* item)
+{
+  glGenTextures(1, &item->loaded);
+  glBindTexture(GL_TEXTURE_2D, item->loaded);
+  if (!load_texture_file(item->path, &streamer->options, &item->info))
+    {
+      glDeleteTextures(1, &item->loaded);
+      item->loaded = 0;
+      return;
+    }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // The render thread may only sample the texture once the GPU has
+  // executed the upload; the flush makes the fence visible to it.
+  if (streamer->fences)
+    {
+      item->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush();
+    }
+  else
+    {
+      glFinish();
+    }
+}
+
+static void* loader_main(void* arg)
+{
+  struct texture_streamer* streamer = arg;
+  // Linux nice values are per thread: let the render thread win the CPU
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), 5);
+  bool current = app_shared_context_make_current(&streamer->context);
+
+  pthread_mutex_lock(&streamer->lock);
+  while(true)
+    {
+      while(!streamer->quit && streamer->queue == NULL)
+        pthread_cond_wait(&streamer->wake, &streamer->lock);
+      if (streamer->quit)
+        break;
+      struct streamed_texture* item = streamer->queue;
+      streamer->queue = item->next;
+      if (streamer->queue == NULL)
+        streamer->queueTail = NULL;
+      pthread_mutex_unlock(&streamer->lock);
+
+      if (current)
+        load(streamer, item);
+
+      pthread_mutex_lock(&streamer->lock);
+      item->next = streamer->done;
+      streamer->done = item;
+    }
+  pthread_mutex_unlock(&streamer->lock);
+
+  if (current)
+    app_shared_context_release(&streamer->context);
+  return NULL;
+}
+
+static GLuint create_placeholder(void)
+{
+  static const unsigned char pixels[] =
+    {
+      96, 96, 96, 255,   160, 160, 160, 255,
+      160, 160, 160, 255,   96, 96, 96, 255
+    };
+  static const unsigned char average[] = { 128, 128, 128, 255 };
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  // Same filtering as load_texture_file: drivers that specialize shaders
+  // on sampler state (llvmpipe) need no new variant when the real
+  // texture replaces this one.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glTexImage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, average);
+  return texture;
+}
+
+bool texture_streamer_init(struct texture_streamer* streamer, struct app* app,
+                           const struct texture_load_options* options)
+{
+  memset(streamer, 0, sizeof(*streamer));
+  streamer->options = *options;
+  // glGenerateMipmap is a draw into the texture; llvmpipe renders it
+  // while holding the share group's texture lock, stalling the render
+  // thread for up to 130 ms. A chain built on the CPU only needs uploads.
+  streamer->options.cpuMipmaps = true;
+  streamer->fences = GLEW_VERSION_3_2 || GLEW_ARB_sync;
+  if (!app_shared_context_create(app, &streamer->context))
+    return false;
+  streamer->placeholder = create_placeholder();
+
+  pthread_mutex_init(&streamer->lock, NULL);
+  pthread_cond_init(&streamer->wake, NULL);
+  if (pthread_create(&streamer->thread, NULL, loader_main, streamer) != 0)
+    {
+      fprintf(stderr, "Cannot start the texture loader thread\n");
+      pthread_cond_destroy(&streamer->wake);
+      pthread_mutex_destroy(&streamer->lock);
+      glDeleteTextures(1, &streamer->placeholder);
+      app_shared_context_destroy(&streamer->context);
+      return false;
+    }
+  return true;
+}
+
+void texture_streamer_free(struct texture_streamer* streamer)
+{
+  pthread_mutex_lock(&streamer->lock);
+  streamer->quit = true;
+  pthread_cond_signal(&streamer->wake);
+  pthread_mutex_unlock(&streamer->lock);
+  pthread_join(streamer->thread, NULL);
+
+  struct streamed_texture* item = streamer->owned;
+  while(item != NULL)
+    {
+      struct streamed_texture* next = item->nextOwned;
+      if (item->fence != NULL)
+        glDeleteSync(item->fence);
+      if (item->loaded != 0)
+        glDeleteTextures(1, &item->loaded);
+      free(item);
+      item = next;
+    }
+
+  pthread_cond_destroy(&streamer->wake);
+  pthread_mutex_destroy(&streamer->lock);
+  glDeleteTextures(1, &streamer->placeholder);
+  app_shared_context_destroy(&streamer->context);
+  memset(streamer, 0, sizeof(*streamer));
+}
+
+struct streamed_texture* texture_streamer_request(struct texture_streamer* streamer, const char* path)
+{
+  struct streamed_texture* item = calloc(1, sizeof(*item));
+  item->path = path;
+  item->texture = streamer->placeholder;
+  item->requestTime = timing_now();
+  item->nextOwned = streamer->owned;
+  streamer->owned = item;
+  streamer->pending++;
+
+  pthread_mutex_lock(&streamer->lock);
+  if (streamer->queueTail != NULL)
+    streamer->queueTail->next = item;
+  else
+    streamer->queue = item;
+  streamer->queueTail = item;
+  pthread_cond_signal(&streamer->wake);
+  pthread_mutex_unlock(&streamer->lock);
+  return item;
+}
+
+int texture_streamer_poll(struct texture_streamer* streamer)
+{
+  // the common case, nothing in flight, costs no lock
+  if (streamer->pending == 0)
+    return 0;
+
+  pthread_mutex_lock(&streamer->lock);
+  struct streamed_texture* done = streamer->done;
+  streamer->done = NULL;
+  pthread_mutex_unlock(&streamer->lock);
+
+  int published = 0;
+  struct streamed_texture* waiting = NULL;
+  while(done != NULL)
+    {
+      struct streamed_texture* item = done;
+      done = item->next;
+      if (item->fence != NULL)
+        {
+          GLenum status = glClientWaitSync(item->fence, 0, 0);
+          if (status == GL_TIMEOUT_EXPIRED)
+            {
+              item->next = waiting;
+              waiting = item;
+              continue;
+            }
+          glDeleteSync(item->fence);
+          item->fence = NULL;
+        }
+
+      if (item->loaded != 0)
+        item->texture = item->loaded;
+      else
+        item->failed = true;
+      item->ready = true;
+      item->readyTime = timing_now();
+      streamer->pending--;
+      published++;
+    }
+
+  // not signaled yet: try again next frame
+  if (waiting != NULL)
+    {
+      pthread_mutex_lock(&streamer->lock);
+      struct streamed_texture* last = waiting;
+      while(last->next != NULL)
+        last = last->next;
+      last->next = streamer->done;
+      streamer->done = waiting;
+      pthread_mutex_unlock(&streamer->lock);
+    }
+  return published;
+}
+
+void texture_streamer_release(struct texture_streamer* streamer, struct streamed_texture* item)
+{
+  if (!item->ready)
+    return;
+  struct streamed_texture** link = &streamer->owned;
+  while(*link != NULL && *link != item)
+    link = &(*link)->nextOwned;
+  if (*link == NULL)
+    return;
+  *link = item->nextOwned;
+  if (item->loaded != 0)
+    glDeleteTextures(1, &item->loaded);
+  free(item);
+}
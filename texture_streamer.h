@@ -0,0 +1,89 @@
+/*
+ * Load textures on a background thread with its own shared GL context:
+ * decode, upload and mip there, and hand the finished textures to the
+ * render thread once their fence has signaled.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#include "app.h"
+#include "texture_file.h"
+
+struct streamed_texture
+{
+  const char* path;
+  /* the streamer's placeholder until 'ready'; keeps it when loading failed */
+  GLuint texture;
+  bool ready;
+  bool failed;
+  struct texture_info info;
+  double requestTime;     /* timing_now() values */
+  double readyTime;
+
+  /* loader side */
+  GLuint loaded;
+  GLsync fence;
+  struct streamed_texture* next;      /* in the queue or the done list */
+  struct streamed_texture* nextOwned;
+};
+
+struct texture_streamer
+{
+  struct app_shared_context context;
+  struct texture_load_options options;
+  bool fences;            /* GL 3.2 or ARB_sync; otherwise the loader calls glFinish */
+  GLuint placeholder;     /* 2x2 gray checkerboard, mipmapped */
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  struct streamed_texture* queue;     /* waiting for the loader */
+  struct streamed_texture* queueTail;
+  struct streamed_texture* done;      /* loaded, not yet published */
+  bool quit;
+  struct streamed_texture* owned;     /* every request, for texture_streamer_free */
+  int pending;            /* requested, not yet published; render thread only */
+};
+
+/*
+ * Create the shared context and start the loader thread. Textures are
+ * loaded with 'options' (see load_texture_file), always with cpuMipmaps;
+ * options->pool may be shared with other users. The loader runs at a
+ * lower priority than the render thread. Call on the render thread, as
+ * all functions here.
+ */
+bool texture_streamer_init(struct texture_streamer* streamer, struct app* app,
+                           const struct texture_load_options* options);
+
+/* stops the loader, deletes the placeholder and every streamed texture */
+void texture_streamer_free(struct texture_streamer* streamer);
+
+/*
+ * Queue 'path' (which must outlive the request). The returned texture is
+ * usable at once and shows the placeholder until a later
+ * texture_streamer_poll publishes the real one.
+ */
+struct streamed_texture* texture_streamer_request(struct texture_streamer* streamer, const char* path);
+
+/*
+ * Publish the textures whose uploads have completed; never waits. Call
+ * once per frame, before drawing. Returns how many became ready.
+ */
+int texture_streamer_poll(struct texture_streamer* streamer);
+
+/*
+ * Delete a 'ready' request's texture and the request itself, e.g. to
+ * evict it; requests still in flight cannot be released.
+ */
+void texture_streamer_release(struct texture_streamer* streamer, struct streamed_texture* item);
+
+#endif
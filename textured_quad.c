@@ -0,0 +1,174 @@
+/*
+ * The textured square of gl_texture.c, drawn the GL 2.1 way or from a
+ * vertex array object.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "textured_quad.h"
+
+static const GLfloat vertices[] =
+  {
+    -1.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,
+    1.0f, -1.0f, 0.0f
+  };
+
+static const GLfloat UV[] =
+  {
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+    0.0f, 0.0f,
+    1.0f, 0.0f
+  };
+
+static const GLint indices[] =
+  {
+    0, 1, 2, 1, 3, 2
+  };
+
+/* gl33: position and UV of each corner side by side */
+static const GLfloat interleaved[] =
+  {
+    -1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+    1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+    -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+    1.0f, -1.0f, 0.0f, 1.0f, 0.0f
+  };
+
+static const GLushort shortIndices[] =
+  {
+    0, 1, 2, 1, 3, 2
+  };
+
+static void init_gl21(struct textured_quad* quad)
+{
+  glGenBuffers(1, &quad->vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+  glGenBuffers(1, &quad->uvBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->uvBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(UV), UV, GL_STATIC_DRAW);
+
+  glGenBuffers(1, &quad->indexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad->indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+static void init_gl33(struct textured_quad* quad)
+{
+  glGenVertexArrays(1, &quad->vertexArray);
+  glBindVertexArray(quad->vertexArray);
+
+  glGenBuffers(1, &quad->vertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(interleaved), interleaved, GL_STATIC_DRAW);
+  GLsizei stride = 5 * sizeof(GLfloat);
+  glVertexAttribPointer(quad->positionIndex, 3, GL_FLOAT, GL_FALSE, stride, NULL);
+  glVertexAttribPointer(quad->uvIndex, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(quad->positionIndex);
+  glEnableVertexAttribArray(quad->uvIndex);
+
+  // the element array binding is part of the VAO too
+  glGenBuffers(1, &quad->indexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad->indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(shortIndices), shortIndices, GL_STATIC_DRAW);
+}
+
+bool textured_quad_init(struct textured_quad* quad, enum app_backend backend, GLuint program)
+{
+  memset(quad, 0, sizeof(*quad));
+  quad->backend = backend;
+  quad->positionIndex = glGetAttribLocation(program, "vertexPosition");
+  quad->uvIndex = glGetAttribLocation(program, "vertexUV");
+  if (quad->positionIndex < 0 || quad->uvIndex < 0)
+    {
+      fprintf(stderr, "ERROR: program has no vertexPosition / vertexUV attribute\n");
+      return false;
+    }
+  if (backend == APP_BACKEND_GL33)
+    {
+      if (!GLEW_VERSION_3_0 && !GLEW_ARB_vertex_array_object)
+        {
+          fprintf(stderr, "ERROR: vertex array objects are not supported\n");
+          return false;
+        }
+      init_gl33(quad);
+    }
+  else
+    {
+      init_gl21(quad);
+    }
+  return true;
+}
+
+void textured_quad_draw(const struct textured_quad* quad)
+{
+  if (quad->backend == APP_BACKEND_GL33)
+    {
+      glBindVertexArray(quad->vertexArray);
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL);
+      return;
+    }
+
+  glEnableVertexAttribArray(quad->positionIndex);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->vertexBuffer);
+  glVertexAttribPointer(quad->positionIndex, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+
+  glEnableVertexAttribArray(quad->uvIndex);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->uvBuffer);
+  glVertexAttribPointer(quad->uvIndex, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad->indexBuffer);
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+
+  glDisableVertexAttribArray(quad->positionIndex);
+  glDisableVertexAttribArray(quad->uvIndex);
+}
+
+void textured_quad_set_uv_scale(const struct textured_quad* quad, float su, float sv)
+{
+  int i;
+  if (quad->backend == APP_BACKEND_GL33)
+    {
+      GLfloat scaled[sizeof(interleaved) / sizeof(GLfloat)];
+      memcpy(scaled, interleaved, sizeof(interleaved));
+      for(i = 0; i < 4; i++)
+        {
+          scaled[5 * i + 3] *= su;
+          scaled[5 * i + 4] *= sv;
+        }
+      glBindBuffer(GL_ARRAY_BUFFER, quad->vertexBuffer);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(scaled), scaled);
+    }
+  else
+    {
+      GLfloat scaled[sizeof(UV) / sizeof(GLfloat)];
+      for(i = 0; i < 4; i++)
+        {
+          scaled[2 * i] = UV[2 * i] * su;
+          scaled[2 * i + 1] = UV[2 * i + 1] * sv;
+        }
+      glBindBuffer(GL_ARRAY_BUFFER, quad->uvBuffer);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(scaled), scaled);
+    }
+}
+
+void textured_quad_free(struct textured_quad* quad)
+{
+  if (quad->vertexArray != 0)
+    glDeleteVertexArrays(1, &quad->vertexArray);
+  glDeleteBuffers(1, &quad->vertexBuffer);
+  if (quad->uvBuffer != 0)
+    glDeleteBuffers(1, &quad->uvBuffer);
+  glDeleteBuffers(1, &quad->indexBuffer);
+  memset(quad, 0, sizeof(*quad));
+}
@@ -0,0 +1,49 @@
+/*
+ * The textured square of gl_texture.c, drawn the GL 2.1 way or from a
+ * vertex array object.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef TEXTURED_QUAD_H
+#define TEXTURED_QUAD_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+#include "app.h"
+
+/*
+ * gl21: separate position and UV buffers and 32-bit indices; every draw
+ * enables, binds and specifies both attribute arrays and disables them
+ * again (what gl_texture.c always did).
+ * gl33: one interleaved position + UV buffer and 16-bit indices, all
+ * recorded once in a VAO; a draw is a bind and glDrawElements. Needs
+ * GL 3.0 or ARB_vertex_array_object, and leaves the VAO bound.
+ */
+struct textured_quad
+{
+  enum app_backend backend;
+  GLint positionIndex;
+  GLint uvIndex;
+  GLuint vertexBuffer;    /* gl33: interleaved position + UV */
+  GLuint uvBuffer;        /* gl21 only */
+  GLuint indexBuffer;
+  GLuint vertexArray;     /* gl33 only */
+};
+
+/* attribute locations are looked up in 'program' */
+bool textured_quad_init(struct textured_quad* quad, enum app_backend backend, GLuint program);
+void textured_quad_draw(const struct textured_quad* quad);
+/*
+ * UVs of 0..su, 0..sv instead of 0..1, e.g. the part of a padded texture
+ * (TEXTURE_NPOT_PAD) the image covers
+ */
+void textured_quad_set_uv_scale(const struct textured_quad* quad, float su, float sv);
+
+void textured_quad_free(struct textured_quad* quad);
+
+#endif
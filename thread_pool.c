@@ -0,0 +1,270 @@
+/*
+ * Minimal fixed-size worker pool (pthreads).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+struct job
+{
+  void (*fn)(void* arg);
+  void* arg;
+  struct job* next;
+};
+
+struct thread_pool
+{
+  pthread_t* threads;
+  int threadCount;
+
+  pthread_mutex_t lock;
+  pthread_cond_t workAvailable;
+  pthread_cond_t workDone;
+  struct job* head;
+  struct job* tail;
+  int unfinished;   /* queued + running */
+  bool stopping;
+};
+
+int cpu_count(void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n < 1 ? 1 : (int)n;
+}
+
+static void* worker_main(void* arg)
+{
+  struct thread_pool* pool = arg;
+  pthread_mutex_lock(&pool->lock);
+  while(true)
+    {
+      while(pool->head == NULL && !pool->stopping)
+        pthread_cond_wait(&pool->workAvailable, &pool->lock);
+      if (pool->head == NULL)
+        break;
+
+      struct job* job = pool->head;
+      pool->head = job->next;
+      if (pool->head == NULL)
+        pool->tail = NULL;
+      pthread_mutex_unlock(&pool->lock);
+
+      job->fn(job->arg);
+      free(job);
+
+      pthread_mutex_lock(&pool->lock);
+      if (--pool->unfinished == 0)
+        pthread_cond_broadcast(&pool->workDone);
+    }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+struct thread_pool* thread_pool_create(int threads)
+{
+  if (threads <= 0)
+    threads = cpu_count();
+
+  struct thread_pool* pool = calloc(1, sizeof(struct thread_pool));
+  if (pool == NULL)
+    return NULL;
+  pool->threads = calloc(threads, sizeof(pthread_t));
+  if (pool->threads == NULL)
+    {
+      free(pool);
+      return NULL;
+    }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->workAvailable, NULL);
+  pthread_cond_init(&pool->workDone, NULL);
+
+  int i;
+  for(i = 0; i < threads; i++)
+    {
+      if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0)
+        break;
+      pool->threadCount++;
+    }
+  // nothing would ever take jobs off the queue
+  if (pool->threadCount == 0)
+    {
+      thread_pool_destroy(pool);
+      return NULL;
+    }
+  return pool;
+}
+
+void thread_pool_destroy(struct thread_pool* pool)
+{
+  if (pool == NULL)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->workAvailable);
+  pthread_mutex_unlock(&pool->lock);
+
+  int i;
+  for(i = 0; i < pool->threadCount; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->workDone);
+  pthread_cond_destroy(&pool->workAvailable);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+int thread_pool_size(const struct thread_pool* pool)
+{
+  return pool == NULL ? 1 : pool->threadCount;
+}
+
+void thread_pool_submit(struct thread_pool* pool, void (*fn)(void* arg), void* arg)
+{
+  struct job* job = malloc(sizeof(struct job));
+  if (job == NULL)
+    {
+      fn(arg);
+      return;
+    }
+  job->fn = fn;
+  job->arg = arg;
+  job->next = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->tail != NULL)
+    pool->tail->next = job;
+  else
+    pool->head = job;
+  pool->tail = job;
+  pool->unfinished++;
+  pthread_cond_signal(&pool->workAvailable);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(struct thread_pool* pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while(pool->unfinished > 0)
+    pthread_cond_wait(&pool->workDone, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * The state of one parallel_for call. Chunks are claimed from nextChunk
+ * by the caller and by the helpers it queued, and the caller waits only
+ * for its own chunks to finish, not for the rest of the pool. Since the
+ * caller claims chunks too, the call completes even when no worker is
+ * free (e.g. when it runs inside a pool job); a helper that starts late
+ * finds nothing left and just drops its reference.
+ */
+struct parallel_for_job
+{
+  void (*fn)(void* ctx, int index);
+  void* ctx;
+  int count;
+  int chunks;
+  int nextChunk;        /* atomic */
+
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  int finished;         /* chunks */
+  int references;       /* the caller and the helpers not done yet */
+};
+
+static void run_chunks(struct parallel_for_job* job)
+{
+  int ran = 0;
+  int chunk;
+  while((chunk = __atomic_fetch_add(&job->nextChunk, 1, __ATOMIC_RELAXED)) < job->chunks)
+    {
+      int begin = (int)((long long)job->count * chunk / job->chunks);
+      int end = (int)((long long)job->count * (chunk + 1) / job->chunks);
+      int i;
+      for(i = begin; i < end; i++)
+        job->fn(job->ctx, i);
+      ran++;
+    }
+  if (ran == 0)
+    return;
+  pthread_mutex_lock(&job->lock);
+  job->finished += ran;
+  if (job->finished == job->chunks)
+    pthread_cond_signal(&job->done);
+  pthread_mutex_unlock(&job->lock);
+}
+
+static void release(struct parallel_for_job* job)
+{
+  pthread_mutex_lock(&job->lock);
+  bool last = --job->references == 0;
+  pthread_mutex_unlock(&job->lock);
+  if (last)
+    {
+      pthread_cond_destroy(&job->done);
+      pthread_mutex_destroy(&job->lock);
+      free(job);
+    }
+}
+
+static void help(void* arg)
+{
+  struct parallel_for_job* job = arg;
+  run_chunks(job);
+  release(job);
+}
+
+void thread_pool_parallel_for(struct thread_pool* pool, int count,
+                              void (*fn)(void* ctx, int index), void* ctx)
+{
+  if (count <= 0)
+    return;
+
+  // a few chunks per thread keeps the load balanced without
+  // paying one queue round trip per index
+  int chunks = thread_pool_size(pool) * 4;
+  if (chunks > count)
+    chunks = count;
+  struct parallel_for_job* job = pool != NULL && chunks > 1 ? malloc(sizeof(*job)) : NULL;
+  if (job == NULL)
+    {
+      int i;
+      for(i = 0; i < count; i++)
+        fn(ctx, i);
+      return;
+    }
+  job->fn = fn;
+  job->ctx = ctx;
+  job->count = count;
+  job->chunks = chunks;
+  job->nextChunk = 0;
+  job->finished = 0;
+  pthread_mutex_init(&job->lock, NULL);
+  pthread_cond_init(&job->done, NULL);
+
+  // one helper per worker at most; the caller works too
+  int helpers = thread_pool_size(pool);
+  if (helpers > chunks - 1)
+    helpers = chunks - 1;
+  job->references = helpers + 1;
+  int i;
+  for(i = 0; i < helpers; i++)
+    thread_pool_submit(pool, help, job);
+
+  run_chunks(job);
+  pthread_mutex_lock(&job->lock);
+  while(job->finished < job->chunks)
+    pthread_cond_wait(&job->done, &job->lock);
+  pthread_mutex_unlock(&job->lock);
+  release(job);
+}
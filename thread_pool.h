@@ -0,0 +1,47 @@
+/*
+ * Minimal fixed-size worker pool (pthreads).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+struct thread_pool;
+
+/* number of online processors, at least 1 */
+int cpu_count(void);
+
+/*
+ * threads <= 0 means one thread per processor. NULL when out of memory or
+ * when no thread could be started; thread_pool_destroy, thread_pool_size
+ * and thread_pool_parallel_for accept a NULL pool.
+ */
+struct thread_pool* thread_pool_create(int threads);
+
+/* finishes queued work, then joins all threads */
+void thread_pool_destroy(struct thread_pool* pool);
+
+int thread_pool_size(const struct thread_pool* pool);
+
+/* queue fn(arg) to run on some worker; out of memory, it runs right away on the caller */
+void thread_pool_submit(struct thread_pool* pool, void (*fn)(void* arg), void* arg);
+
+/* block until every submitted job has finished, whoever submitted it */
+void thread_pool_wait(struct thread_pool* pool);
+
+/*
+ * Run fn(ctx, i) for every i in [0, count) and wait for all of them.
+ * Indices are handed out in chunks so that short jobs do not drown in
+ * queueing overhead; the caller runs chunks as well. Only this call's
+ * work is waited for, so the pool may be shared, and the call may be
+ * made from a pool job. With a NULL pool everything runs on the caller.
+ */
+void thread_pool_parallel_for(struct thread_pool* pool, int count,
+                              void (*fn)(void* ctx, int index), void* ctx);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * Monotonic wall clock used by benchmarks and frame statistics.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+
+/* seconds since an arbitrary (but fixed) point in time */
+static inline double timing_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
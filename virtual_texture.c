@@ -0,0 +1,510 @@
+/*
+ * Tiled virtual texturing: images larger than GL_MAX_TEXTURE_SIZE (or
+ * than texture memory) cut into tiles by vt_tiler, of which only the ones
+ * visible at the current scale are kept in a fixed size cache texture.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "virtual_texture.h"
+#include "image_loader.h"
+#include "mapped_file.h"
+
+bool vt_layout_init(struct vt_layout* layout, int w, int h, int tileSize, int border)
+{
+  memset(layout, 0, sizeof(*layout));
+  if (w <= 0 || h <= 0 || border < 0 || tileSize <= 2 * border)
+    return false;
+  layout->width = w;
+  layout->height = h;
+  layout->tileSize = tileSize;
+  layout->border = border;
+  layout->content = tileSize - 2 * border;
+  int level;
+  for(level = 0; level < VT_MAX_LEVELS; level++)
+    {
+      layout->levelWidth[level] = w;
+      layout->levelHeight[level] = h;
+      layout->tilesX[level] = (w + layout->content - 1) / layout->content;
+      layout->tilesY[level] = (h + layout->content - 1) / layout->content;
+      layout->firstTile[level] = layout->tileCount;
+      layout->tileCount += layout->tilesX[level] * layout->tilesY[level];
+      if (w <= layout->content && h <= layout->content)
+        {
+          layout->levels = level + 1;
+          return true;
+        }
+      w = (w + 1) / 2;
+      h = (h + 1) / 2;
+    }
+  return false;
+}
+
+static const char layoutFormat[] = "virtual texture\nwidth %d\nheight %d\ntile %d\nborder %d\nlevels %d\n";
+
+bool vt_layout_save(const struct vt_layout* layout, const char* directory)
+{
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/tiles.txt", directory);
+  FILE* fp = fopen(path, "w");
+  if (fp == NULL)
+    {
+      fprintf(stderr, "ERROR: cannot write '%s'\n", path);
+      return false;
+    }
+  fprintf(fp, layoutFormat, layout->width, layout->height, layout->tileSize, layout->border,
+          layout->levels);
+  return fclose(fp) == 0;
+}
+
+bool vt_layout_load(struct vt_layout* layout, const char* directory)
+{
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/tiles.txt", directory);
+  struct mapped_file file;
+  if (!mapped_file_open(&file, path, MAPPED_SEQUENTIAL))
+    return false;
+  char text[256];
+  size_t n = file.size < sizeof(text) - 1 ? file.size : sizeof(text) - 1;
+  memcpy(text, file.data, n);
+  text[n] = '\0';
+  mapped_file_close(&file);
+
+  int w;
+  int h;
+  int tileSize;
+  int border;
+  int levels;
+  if (sscanf(text, layoutFormat, &w, &h, &tileSize, &border, &levels) != 5
+      || !vt_layout_init(layout, w, h, tileSize, border) || layout->levels != levels)
+    {
+      fprintf(stderr, "ERROR: '%s' is not a tile set description\n", path);
+      return false;
+    }
+  return true;
+}
+
+void vt_tile_path(char* path, size_t size, const char* directory, int level, int x, int y)
+{
+  snprintf(path, size, "%s/%d_%d_%d.png", directory, level, x, y);
+}
+
+/* level and position of tile index 'tile' */
+static void tile_position(const struct vt_layout* layout, int tile, int* level, int* x, int* y)
+{
+  int l = layout->levels - 1;
+  while(layout->firstTile[l] > tile)
+    l--;
+  int i = tile - layout->firstTile[l];
+  *level = l;
+  *x = i % layout->tilesX[l];
+  *y = i / layout->tilesX[l];
+}
+
+static int tile_index(const struct vt_layout* layout, int level, int x, int y)
+{
+  return layout->firstTile[level] + y * layout->tilesX[level] + x;
+}
+
+/* a tile's pixels, or NULL */
+static unsigned char* decode_tile(const struct virtual_texture* vt, int tile)
+{
+  int level;
+  int x;
+  int y;
+  tile_position(&vt->layout, tile, &level, &x, &y);
+  char path[4096];
+  vt_tile_path(path, sizeof(path), vt->directory, level, x, y);
+  int w;
+  int h;
+  unsigned char* pixels = load_image(path, 4, &w, &h, NULL);
+  if (pixels != NULL && (w != vt->layout.tileSize || h != vt->layout.tileSize))
+    {
+      fprintf(stderr, "ERROR: tile '%s' is %dx%d, not %dx%d\n", path, w, h,
+              vt->layout.tileSize, vt->layout.tileSize);
+      free(pixels);
+      pixels = NULL;
+    }
+  return pixels;
+}
+
+static void* loader_main(void* arg)
+{
+  struct virtual_texture* vt = arg;
+  // Linux nice values are per thread: let the render thread win the CPU
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), 5);
+
+  pthread_mutex_lock(&vt->lock);
+  while(true)
+    {
+      while(!vt->quit && vt->wantedNext == vt->wantedCount)
+        pthread_cond_wait(&vt->wake, &vt->lock);
+      if (vt->quit)
+        break;
+      int tile = vt->wanted[vt->wantedNext++];
+      pthread_mutex_unlock(&vt->lock);
+
+      struct vt_decoded* item = malloc(sizeof(*item));
+      item->tile = tile;
+      item->pixels = decode_tile(vt, tile);
+      app_request_redraw(vt->app);
+
+      pthread_mutex_lock(&vt->lock);
+      item->next = vt->decoded;
+      vt->decoded = item;
+    }
+  pthread_mutex_unlock(&vt->lock);
+  return NULL;
+}
+
+static void upload_tile(struct virtual_texture* vt, int slot, int tile, const unsigned char* pixels)
+{
+  int size = vt->layout.tileSize;
+  glBindTexture(GL_TEXTURE_2D, vt->cache);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, slot % vt->slotsPerSide * size, slot / vt->slotsPerSide * size,
+                  size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  vt->slots[slot] = tile;
+  vt->tiles[tile].slot = slot;
+  vt->tiles[tile].state = VT_TILE_RESIDENT;
+  vt->stats.uploads++;
+  vt->stats.resident++;
+  vt->pagesDirty = true;
+}
+
+static GLuint create_texture(int w, int h, GLint filter)
+{
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  return texture;
+}
+
+bool virtual_texture_open(struct virtual_texture* vt, const char* directory, int slotsPerSide,
+                          int uploadsPerFrame, struct app* app)
+{
+  memset(vt, 0, sizeof(*vt));
+  if (!vt_layout_load(&vt->layout, directory))
+    return false;
+  const struct vt_layout* layout = &vt->layout;
+  GLint maxSize;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  // the page table stores slot coordinates in 8 bits
+  if (slotsPerSide > 256)
+    slotsPerSide = 256;
+  if (slotsPerSide > maxSize / layout->tileSize)
+    slotsPerSide = maxSize / layout->tileSize;
+  if (slotsPerSide < 2 || layout->tilesX[0] > maxSize || layout->tilesY[0] > maxSize)
+    {
+      fprintf(stderr, "ERROR: '%s' does not fit this driver's textures\n", directory);
+      return false;
+    }
+  vt->directory = strdup(directory);
+  vt->app = app;
+  vt->slotsPerSide = slotsPerSide;
+  vt->uploadsPerFrame = uploadsPerFrame > 0 ? uploadsPerFrame : 1;
+  vt->tiles = calloc(layout->tileCount, sizeof(struct vt_tile));
+  vt->slots = malloc(sizeof(int) * slotsPerSide * slotsPerSide);
+  vt->pages = calloc((size_t)layout->tilesX[0] * layout->tilesY[0], 4);
+  int i;
+  for(i = 0; i < slotsPerSide * slotsPerSide; i++)
+    vt->slots[i] = -1;
+  vt->stats.level = -1;
+
+  vt->cache = create_texture(slotsPerSide * layout->tileSize, slotsPerSide * layout->tileSize, GL_LINEAR);
+  vt->pageTable = create_texture(layout->tilesX[0], layout->tilesY[0], GL_NEAREST);
+
+  // the last level is drawn wherever nothing better is resident; slot 0
+  // keeps it for good
+  int last = tile_index(layout, layout->levels - 1, 0, 0);
+  unsigned char* pixels = decode_tile(vt, last);
+  if (pixels == NULL)
+    {
+      virtual_texture_free(vt);
+      return false;
+    }
+  upload_tile(vt, 0, last, pixels);
+  vt->stats.uploads = 0;
+  free(pixels);
+
+  pthread_mutex_init(&vt->lock, NULL);
+  pthread_cond_init(&vt->wake, NULL);
+  if (pthread_create(&vt->thread, NULL, loader_main, vt) != 0)
+    {
+      fprintf(stderr, "Cannot start the tile loader thread\n");
+      pthread_cond_destroy(&vt->wake);
+      pthread_mutex_destroy(&vt->lock);
+      vt->thread = 0;
+      virtual_texture_free(vt);
+      return false;
+    }
+  return true;
+}
+
+static void free_decoded(struct vt_decoded* item)
+{
+  while(item != NULL)
+    {
+      struct vt_decoded* next = item->next;
+      free(item->pixels);
+      free(item);
+      item = next;
+    }
+}
+
+void virtual_texture_free(struct virtual_texture* vt)
+{
+  if (vt->thread != 0)
+    {
+      pthread_mutex_lock(&vt->lock);
+      vt->quit = true;
+      pthread_cond_signal(&vt->wake);
+      pthread_mutex_unlock(&vt->lock);
+      pthread_join(vt->thread, NULL);
+      pthread_cond_destroy(&vt->wake);
+      pthread_mutex_destroy(&vt->lock);
+    }
+  free_decoded(vt->decoded);
+  free_decoded(vt->ready);
+  glDeleteTextures(1, &vt->cache);
+  glDeleteTextures(1, &vt->pageTable);
+  free(vt->directory);
+  free(vt->tiles);
+  free(vt->slots);
+  free(vt->pages);
+  free(vt->wanted);
+  memset(vt, 0, sizeof(*vt));
+}
+
+/* the level whose texels come closest to one per screen pixel */
+static int pick_level(const struct vt_layout* layout, float uvWidth, float pixelsAcross)
+{
+  double texelsPerPixel = uvWidth * layout->width / pixelsAcross;
+  int level = texelsPerPixel > 1.0 ? (int)floor(log2(texelsPerPixel) + 0.5) : 0;
+  return level < layout->levels ? level : layout->levels - 1;
+}
+
+/* tiles first..last of 'level' along one axis that cover u0..u1 */
+static void tile_range(int imageSize, int content, int level, int tiles, float u0, float u1,
+                       int* first, int* last)
+{
+  // level texel i covers level 0 texels i * 2^level and up
+  double scale = (double)imageSize / ((double)content * (1 << level));
+  *first = (int)floor(u0 * scale);
+  *last = (int)floor(u1 * scale);
+  *first = *first < 0 ? 0 : (*first > tiles - 1 ? tiles - 1 : *first);
+  *last = *last < *first ? *first : (*last > tiles - 1 ? tiles - 1 : *last);
+}
+
+/* a slot for a new tile: a free one, or the least recently used one not drawn this frame */
+static int find_slot(struct virtual_texture* vt)
+{
+  int best = -1;
+  int i;
+  // slot 0 holds the last level
+  for(i = 1; i < vt->slotsPerSide * vt->slotsPerSide; i++)
+    {
+      if (vt->slots[i] < 0)
+        return i;
+      const struct vt_tile* tile = &vt->tiles[vt->slots[i]];
+      if (tile->lastUse < vt->frame
+          && (best < 0 || tile->lastUse < vt->tiles[vt->slots[best]].lastUse))
+        best = i;
+    }
+  if (best >= 0)
+    {
+      vt->tiles[vt->slots[best]].state = VT_TILE_ABSENT;
+      vt->slots[best] = -1;
+      vt->stats.resident--;
+      vt->stats.evictions++;
+    }
+  return best;
+}
+
+/* upload decoded tiles, those drawn this frame first, up to the limit */
+static void upload_decoded(struct virtual_texture* vt)
+{
+  int uploads = 0;
+  int pass;
+  for(pass = 0; pass < 2; pass++)
+    {
+      struct vt_decoded** link = &vt->ready;
+      while(*link != NULL && uploads < vt->uploadsPerFrame)
+        {
+          struct vt_decoded* item = *link;
+          struct vt_tile* tile = &vt->tiles[item->tile];
+          if (pass == 0 && tile->lastUse != vt->frame && item->pixels != NULL)
+            {
+              link = &item->next;
+              continue;
+            }
+          *link = item->next;
+          if (item->pixels == NULL)
+            {
+              tile->state = VT_TILE_FAILED;
+              vt->stats.failures++;
+            }
+          else
+            {
+              // a tile nobody draws any more is not worth an eviction
+              int slot = -1;
+              if (tile->lastUse == vt->frame || vt->stats.resident < vt->slotsPerSide * vt->slotsPerSide)
+                slot = find_slot(vt);
+              if (slot >= 0)
+                {
+                  upload_tile(vt, slot, item->tile, item->pixels);
+                  uploads++;
+                }
+              else
+                tile->state = VT_TILE_ABSENT;
+            }
+          free(item->pixels);
+          free(item);
+        }
+    }
+}
+
+/* point every level 0 tile at the finest resident tile covering it, from 'level' up */
+static void update_pages(struct virtual_texture* vt, int level)
+{
+  const struct vt_layout* layout = &vt->layout;
+  int x;
+  int y;
+  for(y = 0; y < layout->tilesY[0]; y++)
+    {
+      for(x = 0; x < layout->tilesX[0]; x++)
+        {
+          int l;
+          for(l = level; l < layout->levels - 1; l++)
+            {
+              if (vt->tiles[tile_index(layout, l, x >> l, y >> l)].state == VT_TILE_RESIDENT)
+                break;
+            }
+          const struct vt_tile* tile = &vt->tiles[tile_index(layout, l, x >> l, y >> l)];
+          unsigned char* page = vt->pages + ((size_t)y * layout->tilesX[0] + x) * 4;
+          page[0] = (unsigned char)(tile->slot % vt->slotsPerSide);
+          page[1] = (unsigned char)(tile->slot / vt->slotsPerSide);
+          page[2] = (unsigned char)l;
+          page[3] = 255;
+        }
+    }
+  glBindTexture(GL_TEXTURE_2D, vt->pageTable);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, layout->tilesX[0], layout->tilesY[0],
+                  GL_RGBA, GL_UNSIGNED_BYTE, vt->pages);
+  vt->stats.pageUpdates++;
+  vt->pagesDirty = false;
+}
+
+void virtual_texture_update(struct virtual_texture* vt, const float visible[4], float pixelsAcross)
+{
+  const struct vt_layout* layout = &vt->layout;
+  vt->frame++;
+  int level = pick_level(layout, visible[2] - visible[0], pixelsAcross);
+  if (level != vt->stats.level)
+    vt->pagesDirty = true;
+  vt->stats.level = level;
+  int x0;
+  int x1;
+  int y0;
+  int y1;
+  tile_range(layout->width, layout->content, level, layout->tilesX[level],
+             visible[0], visible[2], &x0, &x1);
+  tile_range(layout->height, layout->content, level, layout->tilesY[level],
+             visible[1], visible[3], &y0, &y1);
+
+  pthread_mutex_lock(&vt->lock);
+  // what the loader has not started on is replaced by this frame's list
+  int i;
+  for(i = vt->wantedNext; i < vt->wantedCount; i++)
+    vt->tiles[vt->wanted[i]].state = VT_TILE_ABSENT;
+  vt->wantedCount = 0;
+  vt->wantedNext = 0;
+  int needed = (x1 - x0 + 1) * (y1 - y0 + 1);
+  if (needed > vt->wantedCapacity)
+    {
+      vt->wanted = realloc(vt->wanted, sizeof(int) * needed);
+      vt->wantedCapacity = needed;
+    }
+  vt->stats.wanted = 0;
+  vt->stats.missing = 0;
+  int x;
+  int y;
+  for(y = y0; y <= y1; y++)
+    {
+      for(x = x0; x <= x1; x++)
+        {
+          int index = tile_index(layout, level, x, y);
+          struct vt_tile* tile = &vt->tiles[index];
+          // the coarser tiles drawn until this one arrives stay too
+          int l;
+          for(l = level; l < layout->levels; l++)
+            vt->tiles[tile_index(layout, l, x >> (l - level), y >> (l - level))].lastUse = vt->frame;
+          vt->stats.wanted++;
+          if (tile->state == VT_TILE_RESIDENT)
+            continue;
+          vt->stats.missing++;
+          if (tile->state == VT_TILE_ABSENT)
+            {
+              tile->state = VT_TILE_LOADING;
+              vt->wanted[vt->wantedCount++] = index;
+              vt->stats.requests++;
+            }
+        }
+    }
+  if (vt->wantedCount > 0)
+    pthread_cond_signal(&vt->wake);
+  struct vt_decoded* arrived = vt->decoded;
+  vt->decoded = NULL;
+  pthread_mutex_unlock(&vt->lock);
+
+  while(arrived != NULL)
+    {
+      struct vt_decoded* next = arrived->next;
+      arrived->next = vt->ready;
+      vt->ready = arrived;
+      arrived = next;
+    }
+  upload_decoded(vt);
+  if (vt->pagesDirty)
+    update_pages(vt, level);
+}
+
+void virtual_texture_bind(struct virtual_texture* vt, const struct shader_variant* program)
+{
+  const struct vt_layout* layout = &vt->layout;
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, vt->pageTable);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, vt->cache);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_TEXTURE], 0);
+  glUniform1i(program->uniforms[SHADER_UNIFORM_PAGE_TABLE], 1);
+  glUniform4f(program->uniforms[SHADER_UNIFORM_VIRTUAL_TILES],
+              (float)layout->width / layout->content, (float)layout->height / layout->content,
+              layout->tilesX[0], layout->tilesY[0]);
+  glUniform3f(program->uniforms[SHADER_UNIFORM_TILE_LAYOUT],
+              (float)layout->border / layout->tileSize, (float)layout->content / layout->tileSize,
+              vt->slotsPerSide);
+}
+
+size_t virtual_texture_bytes(const struct virtual_texture* vt)
+{
+  size_t side = (size_t)vt->slotsPerSide * vt->layout.tileSize;
+  return side * side * 4 + (size_t)vt->layout.tilesX[0] * vt->layout.tilesY[0] * 4;
+}
@@ -0,0 +1,160 @@
+/*
+ * Tiled virtual texturing: images larger than GL_MAX_TEXTURE_SIZE (or
+ * than texture memory) cut into tiles by vt_tiler, of which only the ones
+ * visible at the current scale are kept in a fixed size cache texture.
+ * texture.frag's VIRTUAL feature finds them through a page table.
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#include "app.h"
+#include "shader_variants.h"
+
+#define VT_MAX_LEVELS 24
+
+/*
+ * A tile set, as described by the "tiles.txt" file in its directory.
+ * Level 0 is the image; level L + 1 halves level L, rounding up, so that
+ * texel i of level L always covers texels i * 2^L .. (i + 1) * 2^L - 1 of
+ * level 0 (past the edge: the edge repeated). Every level is cut into
+ * tiles of 'content' texels, stored as 'tileSize' square PNGs with a
+ * 'border' of neighbouring texels on each side for bilinear filtering;
+ * tile (x, y) of level L is "L_x_y.png", y counting from the bottom row.
+ * The last level is a single tile.
+ */
+struct vt_layout
+{
+  int width;
+  int height;
+  int tileSize;
+  int border;
+  int content;          /* tileSize - 2 * border */
+  int levels;
+  int levelWidth[VT_MAX_LEVELS];
+  int levelHeight[VT_MAX_LEVELS];
+  int tilesX[VT_MAX_LEVELS];
+  int tilesY[VT_MAX_LEVELS];
+  int firstTile[VT_MAX_LEVELS];       /* index of tile (0, 0) of each level */
+  int tileCount;                      /* over all levels */
+};
+
+/* the layout of a w x h image; false if it needs more than VT_MAX_LEVELS */
+bool vt_layout_init(struct vt_layout* layout, int w, int h, int tileSize, int border);
+
+/* write / read 'directory'/tiles.txt */
+bool vt_layout_save(const struct vt_layout* layout, const char* directory);
+bool vt_layout_load(struct vt_layout* layout, const char* directory);
+
+void vt_tile_path(char* path, size_t size, const char* directory, int level, int x, int y);
+
+enum vt_tile_state
+{
+  VT_TILE_ABSENT,
+  VT_TILE_LOADING,      /* wanted by the loader, or decoded and waiting for a slot */
+  VT_TILE_RESIDENT,
+  VT_TILE_FAILED
+};
+
+struct vt_tile
+{
+  unsigned char state;
+  int slot;
+  unsigned long lastUse;              /* frame number */
+};
+
+/* a tile decoded by the loader thread */
+struct vt_decoded
+{
+  int tile;
+  unsigned char* pixels;              /* NULL: the file could not be read */
+  struct vt_decoded* next;
+};
+
+struct virtual_texture_stats
+{
+  long requests;        /* tiles handed to the loader */
+  long uploads;
+  long evictions;
+  long failures;
+  long pageUpdates;     /* page table uploads */
+  int resident;         /* tiles in the cache */
+  int wanted;           /* visible tiles at the current level, this frame */
+  int missing;          /* ... drawn from a coarser level instead */
+  int level;            /* the current level */
+};
+
+struct virtual_texture
+{
+  struct vt_layout layout;
+  char* directory;
+  struct app* app;      /* woken when tiles arrive */
+  struct vt_tile* tiles;
+  unsigned long frame;
+
+  GLuint cache;         /* slotsPerSide^2 tiles, no mipmaps */
+  int slotsPerSide;
+  int* slots;           /* tile index per slot, -1 when free */
+  int uploadsPerFrame;
+
+  GLuint pageTable;     /* one RGBA texel per level 0 tile: slot x, slot y, level */
+  unsigned char* pages;
+  bool pagesDirty;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int* wanted;          /* tiles for the loader, taken from 'wantedNext' on */
+  int wantedCount;
+  int wantedNext;
+  int wantedCapacity;
+  struct vt_decoded* decoded;         /* from the loader, newest first */
+  bool quit;
+  struct vt_decoded* ready;           /* taken from 'decoded', not uploaded yet; render thread only */
+
+  struct virtual_texture_stats stats;
+};
+
+/*
+ * Open the tile set in 'directory' with a cache of slotsPerSide x
+ * slotsPerSide tiles (one of them holding the last level for good),
+ * uploading at most 'uploadsPerFrame' tiles per update. Tiles are decoded
+ * on a thread of their own, which calls app_request_redraw(app) whenever
+ * one is ready. Texture memory stays at the cache and page table,
+ * whatever the size of the image.
+ */
+bool virtual_texture_open(struct virtual_texture* vt, const char* directory, int slotsPerSide,
+                          int uploadsPerFrame, struct app* app);
+
+void virtual_texture_free(struct virtual_texture* vt);
+
+/*
+ * Call once per frame before drawing: 'visible' is the part of the image
+ * on screen (u0, v0, u1, v1 in 0..1) and pixelsAcross its width in screen
+ * pixels. Picks the level, asks the loader for the missing tiles of the
+ * visible part, uploads decoded ones (evicting the least recently used)
+ * and updates the page table.
+ */
+void virtual_texture_update(struct virtual_texture* vt, const float visible[4], float pixelsAcross);
+
+/*
+ * Bind the cache to texture unit 0 and the page table to unit 1 and set
+ * the uniforms of 'program', a variant with SHADER_VIRTUAL, which must be
+ * in use. Texture coordinates then address the whole image.
+ */
+void virtual_texture_bind(struct virtual_texture* vt, const struct shader_variant* program);
+
+/* texture memory used: cache and page table */
+size_t virtual_texture_bytes(const struct virtual_texture* vt);
+
+#endif
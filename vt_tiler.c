@@ -0,0 +1,305 @@
+/*
+ * Offline tiler for virtual_texture: cuts an image of any size into
+ * fixed size PNG tiles with a mip pyramid (see struct vt_layout).
+ *
+ *   vt_tiler [--tile N] [--border B] input.png directory
+ *
+ * Tiles are N x N (default 256) with B texels of border (default 1), so
+ * N - 2B texels of the image each; N - 2B must be even. The image is
+ * decoded a row at a time and each tile row written as soon as its last
+ * row arrives; every further level is reduced from the tiles of the one
+ * before, a strip at a time. Memory stays at a few strips of the image
+ * width, whatever its height (interlaced PNGs excepted: libpng needs them
+ * whole).
+ *
+ * Copyright © 2013 Inori Sakura <inorindesu@gmail.com>
+ *
+ * This work is free. You can redistribute it and/or modify it under the
+ * terms of the Do What The Fuck You Want To Public License, Version 2,
+ * as published by Sam Hocevar. See the COPYING file for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "image_loader.h"
+#include "mipmap.h"
+#include "thread_pool.h"
+#include "timing.h"
+#include "virtual_texture.h"
+
+// rows per mip_reduce call when building a level from the one below
+#define REDUCE_ROWS 32
+
+/*
+ * One level being cut: rows arrive top row first and go into a ring of
+ * tileSize rows (row r at r % tileSize); a row of tiles is written as
+ * soon as the lowest row it needs (its border included) has arrived.
+ */
+struct level_cutter
+{
+  const struct vt_layout* layout;
+  const char* directory;
+  struct thread_pool* pool;
+  int level;
+  int w;
+  int h;
+  unsigned char* ring;
+  int nextRow;          /* counting down from h - 1 */
+  int tileRow;          /* the next to write, counting down */
+  int tileY;            /* the one being written (write_tile) */
+  int failures;
+  long tiles;
+};
+
+static int clamp_int(int v, int low, int high)
+{
+  return v < low ? low : (v > high ? high : v);
+}
+
+/* tile (x, cutter->tileY) from the ring, border texels past the edge repeating it */
+static void write_tile(void* ctx, int x)
+{
+  struct level_cutter* cutter = ctx;
+  const struct vt_layout* layout = cutter->layout;
+  int size = layout->tileSize;
+  int left = x * layout->content - layout->border;
+  unsigned char* pixels = malloc((size_t)size * size * 4);
+  if (pixels == NULL)
+    {
+      __atomic_add_fetch(&cutter->failures, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  int j;
+  for(j = 0; j < size; j++)
+    {
+      int r = clamp_int(cutter->tileY * layout->content - layout->border + j, 0, cutter->h - 1);
+      const unsigned char* src = cutter->ring + (size_t)(r % size) * cutter->w * 4;
+      unsigned char* dst = pixels + (size_t)j * size * 4;
+      // the part inside the image in one copy, then the edges
+      int first = clamp_int(left, 0, cutter->w);
+      int end = clamp_int(left + size, 0, cutter->w);
+      int i;
+      if (end > first)
+        memcpy(dst + (size_t)(first - left) * 4, src + (size_t)first * 4, (size_t)(end - first) * 4);
+      for(i = 0; i < first - left; i++)
+        memcpy(dst + (size_t)i * 4, src, 4);
+      for(i = end - left; i < size; i++)
+        memcpy(dst + (size_t)i * 4, src + (size_t)(cutter->w - 1) * 4, 4);
+    }
+  char path[4096];
+  vt_tile_path(path, sizeof(path), cutter->directory, cutter->level, x, cutter->tileY);
+  if (!save_image_png(path, pixels, size, size, 4))
+    __atomic_add_fetch(&cutter->failures, 1, __ATOMIC_RELAXED);
+  free(pixels);
+}
+
+static bool cutter_init(struct level_cutter* cutter, const struct vt_layout* layout,
+                        const char* directory, int level, struct thread_pool* pool)
+{
+  memset(cutter, 0, sizeof(*cutter));
+  cutter->layout = layout;
+  cutter->directory = directory;
+  cutter->pool = pool;
+  cutter->level = level;
+  cutter->w = layout->levelWidth[level];
+  cutter->h = layout->levelHeight[level];
+  cutter->ring = malloc((size_t)layout->tileSize * cutter->w * 4);
+  cutter->nextRow = cutter->h - 1;
+  cutter->tileRow = layout->tilesY[level] - 1;
+  return cutter->ring != NULL;
+}
+
+/* the next row down, w RGBA texels */
+static void cutter_add_row(struct level_cutter* cutter, const unsigned char* row)
+{
+  const struct vt_layout* layout = cutter->layout;
+  int r = cutter->nextRow--;
+  memcpy(cutter->ring + (size_t)(r % layout->tileSize) * cutter->w * 4, row, (size_t)cutter->w * 4);
+  while(cutter->tileRow >= 0 && r <= clamp_int(cutter->tileRow * layout->content - layout->border,
+                                                0, cutter->h - 1))
+    {
+      cutter->tileY = cutter->tileRow--;
+      thread_pool_parallel_for(cutter->pool, layout->tilesX[cutter->level], write_tile, cutter);
+      cutter->tiles += layout->tilesX[cutter->level];
+    }
+}
+
+/* level 0, streamed from the PNG */
+static bool cut_image(const char* input, const struct vt_layout* layout, const char* directory,
+                      struct thread_pool* pool, long* tiles)
+{
+  int w;
+  int h;
+  struct image_rows* rows = image_rows_open(input, 4, &w, &h);
+  if (rows == NULL)
+    return false;
+  struct level_cutter cutter;
+  unsigned char* row = malloc((size_t)w * 4);
+  bool ok = cutter_init(&cutter, layout, directory, 0, pool) && row != NULL;
+  while(ok && image_rows_read(rows, row))
+    cutter_add_row(&cutter, row);
+  image_rows_close(rows);
+  ok = ok && cutter.nextRow < 0 && cutter.failures == 0;
+  *tiles += cutter.tiles;
+  free(cutter.ring);
+  free(row);
+  return ok;
+}
+
+/* the tiles of one row of a level, read back */
+struct strip_job
+{
+  const struct vt_layout* layout;
+  const char* directory;
+  int level;
+  int tileY;
+  unsigned char** tiles;
+};
+
+static void read_tile(void* ctx, int x)
+{
+  struct strip_job* job = ctx;
+  char path[4096];
+  vt_tile_path(path, sizeof(path), job->directory, job->level, x, job->tileY);
+  int w;
+  int h;
+  job->tiles[x] = load_image(path, 4, &w, &h, NULL);
+  if (job->tiles[x] != NULL && (w != job->layout->tileSize || h != job->layout->tileSize))
+    {
+      free(job->tiles[x]);
+      job->tiles[x] = NULL;
+    }
+}
+
+/* level 'level' from the tiles of the level below, one tile row (an even number of rows) at a time */
+static bool reduce_level(const struct vt_layout* layout, const char* directory, int level,
+                         struct thread_pool* pool, long* tiles)
+{
+  int below = level - 1;
+  int w = layout->levelWidth[below];
+  int h = layout->levelHeight[below];
+  int content = layout->content;
+  int border = layout->border;
+  int size = layout->tileSize;
+  struct mip_options options = { MIP_FILTER_BOX, MIP_KERNEL_AUTO, true };
+  struct level_cutter cutter;
+  struct strip_job job = { layout, directory, below, 0, NULL };
+  job.tiles = calloc(layout->tilesX[below], sizeof(unsigned char*));
+  unsigned char* strip = malloc((size_t)w * content * 4);
+  unsigned char* reduced = malloc((size_t)(w + 1) / 2 * (REDUCE_ROWS / 2) * 4);
+  bool ok = cutter_init(&cutter, layout, directory, level, pool)
+    && job.tiles != NULL && strip != NULL && reduced != NULL;
+
+  int ty;
+  for(ty = layout->tilesY[below] - 1; ok && ty >= 0; ty--)
+    {
+      job.tileY = ty;
+      thread_pool_parallel_for(pool, layout->tilesX[below], read_tile, &job);
+      int rows = h - ty * content < content ? h - ty * content : content;
+      int tx;
+      for(tx = 0; tx < layout->tilesX[below]; tx++)
+        {
+          if (job.tiles[tx] == NULL)
+            {
+              ok = false;
+              continue;
+            }
+          int columns = w - tx * content < content ? w - tx * content : content;
+          int j;
+          for(j = 0; j < rows; j++)
+            memcpy(strip + ((size_t)j * w + (size_t)tx * content) * 4,
+                   job.tiles[tx] + ((size_t)(border + j) * size + border) * 4, (size_t)columns * 4);
+          free(job.tiles[tx]);
+          job.tiles[tx] = NULL;
+        }
+
+      // top chunk first, since the cutter takes rows top down
+      int start;
+      for(start = (rows - 1) / REDUCE_ROWS * REDUCE_ROWS; ok && start >= 0; start -= REDUCE_ROWS)
+        {
+          int count = rows - start < REDUCE_ROWS ? rows - start : REDUCE_ROWS;
+          if (!mip_reduce(strip + (size_t)start * w * 4, w, count, 4, reduced, &options, pool))
+            {
+              ok = false;
+              break;
+            }
+          int j;
+          for(j = (count + 1) / 2 - 1; j >= 0; j--)
+            cutter_add_row(&cutter, reduced + (size_t)j * ((w + 1) / 2) * 4);
+        }
+    }
+  ok = ok && cutter.nextRow < 0 && cutter.failures == 0;
+  *tiles += cutter.tiles;
+  free(cutter.ring);
+  free(job.tiles);
+  free(strip);
+  free(reduced);
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  int tileSize = 256;
+  int border = 1;
+  int first = 1;
+  while(first < argc && strncmp(argv[first], "--", 2) == 0)
+    {
+      if (strcmp(argv[first], "--tile") == 0 && first + 1 < argc)
+        {
+          tileSize = atoi(argv[first + 1]);
+          first += 2;
+        }
+      else if (strcmp(argv[first], "--border") == 0 && first + 1 < argc)
+        {
+          border = atoi(argv[first + 1]);
+          first += 2;
+        }
+      else
+        break;
+    }
+  // a tile row has to reduce on its own: its rows must pair up
+  if (argc - first != 2 || border < 0 || tileSize <= 2 * border || (tileSize - 2 * border) % 2 != 0)
+    {
+      fprintf(stderr, "usage: %s [--tile N] [--border B] input.png directory\n", argv[0]);
+      return -1;
+    }
+  const char* input = argv[first];
+  const char* directory = argv[first + 1];
+
+  int w;
+  int h;
+  struct vt_layout layout;
+  if (!image_size(input, &w, &h))
+    return -1;
+  if (!vt_layout_init(&layout, w, h, tileSize, border))
+    {
+      fprintf(stderr, "ERROR: %dx%d needs more than %d levels\n", w, h, VT_MAX_LEVELS);
+      return -1;
+    }
+  mkdir(directory, 0777);
+
+  struct thread_pool* pool = thread_pool_create(0);
+  double start = timing_now();
+  long tiles = 0;
+  bool ok = cut_image(input, &layout, directory, pool, &tiles);
+  int level;
+  for(level = 1; ok && level < layout.levels; level++)
+    ok = reduce_level(&layout, directory, level, pool, &tiles);
+  ok = ok && vt_layout_save(&layout, directory);
+  double elapsed = timing_now() - start;
+  int threads = thread_pool_size(pool);
+  thread_pool_destroy(pool);
+  if (!ok)
+    {
+      fprintf(stderr, "ERROR: cannot cut '%s' into '%s'\n", input, directory);
+      return -1;
+    }
+  printf("%s: %dx%d in %ld tiles of %d (%d levels) in %.2f s (%d threads); "
+         "peak RSS %.1f MiB for a %.1f MiB image\n",
+         directory, w, h, tiles, tileSize, layout.levels, elapsed, threads,
+         peak_rss_kb() / 1024.0, (double)w * h * 4 / (1024.0 * 1024.0));
+  return 0;
+}